@@ -0,0 +1,1118 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <map>
+#include <random>
+#include "Geometry.h"
+#include "CollisionTester.h"
+#include "StaticCollisionTester.h"
+#include "SweepAndPrune.h"
+#include "SpatialHashGrid.h"
+#include "BatchIntersectionHelper.h"
+#include "FrustumCuller.h"
+#include "TiledHeightMap.h"
+#include "ContactCache.h"
+#include "ParallelCollisionTester.h"
+#include "ContinuousCollisionTester.h"
+#include "MortonBvhBuilder.h"
+#include "SceneCache.h"
+#include "SeparationCache.h"
+
+/**
+ * Collision tester dispatching through std::map lookups, as CollisionTester did before the dense dispatch table.
+ * Used as the "before" baseline for dispatch benchmarks. Tests are taken from the dense tables so both testers run the same kernels.
+ */
+class MapDispatchCollisionTester : public CollisionTester {
+  std::map<std::pair<GeometryType, GeometryType>, IntersectionTest> intersectionTestsMap;
+  std::map<std::pair<GeometryType, GeometryType>, ContactTest> contactTestsMap;
+public:
+  MapDispatchCollisionTester() {
+    for(unsigned int typeOp1 = 0; typeOp1 < GEOMETRY_TYPE_COUNT; typeOp1++) {
+      for(unsigned int typeOp2 = 0; typeOp2 < GEOMETRY_TYPE_COUNT; typeOp2++) {
+        if(intersectionTestsTable[typeOp1][typeOp2].test != nullptr && !intersectionTestsTable[typeOp1][typeOp2].swapped) {
+          intersectionTestsMap[std::pair<GeometryType, GeometryType>((GeometryType)typeOp1, (GeometryType)typeOp2)] = intersectionTestsTable[typeOp1][typeOp2].test;
+        }
+        if(contactTestsTable[typeOp1][typeOp2].test != nullptr && !contactTestsTable[typeOp1][typeOp2].swapped) {
+          contactTestsMap[std::pair<GeometryType, GeometryType>((GeometryType)typeOp1, (GeometryType)typeOp2)] = contactTestsTable[typeOp1][typeOp2].test;
+        }
+      }
+    }
+  }
+
+  bool intersects(const Geometry &op1, const Geometry & op2) const override {
+    std::pair<GeometryType, GeometryType > key(op1.getType(), op2.getType());
+
+    if(intersectionTestsMap.count(key) > 0) {
+        return (this->*intersectionTestsMap.at(key))(op1, op2);
+    } else {
+        std::pair<GeometryType, GeometryType > inverseKey(op2.getType(), op1.getType());
+
+        if(intersectionTestsMap.count(inverseKey) > 0) {
+            return (this->*intersectionTestsMap.at(inverseKey))(op2, op1);
+        }
+    }
+
+    return false;
+  }
+
+  using CollisionTester::detectCollision;
+
+  void detectCollision(const Geometry &op1, const Geometry &op2, ContactBuffer &contacts) const override {
+    std::pair<GeometryType, GeometryType > key(op1.getType(), op2.getType());
+
+    if(contactTestsMap.count(key) > 0) {
+        (this->*contactTestsMap.at(key))(op1, op2, contacts);
+    } else {
+        std::pair<GeometryType, GeometryType > inverseKey(op2.getType(), op1.getType());
+
+        if(contactTestsMap.count(inverseKey) > 0) {
+            (this->*contactTestsMap.at(inverseKey))(op2, op1, contacts);
+        }
+    }
+  }
+
+  String typeName(GeometryType type) const {
+    return toString(type);
+  }
+};
+
+class FlatHeightMap : public HeightMap {
+public:
+  real getWidth() const override { return 100; }
+  real getHeight() const override { return 10; }
+  real getDepth() const override { return 100; }
+  real heightAt(real x, real z) const override { return 5; }
+  vector normalAt(real x, real z) const override { return vector(0, 1, 0); }
+};
+
+/**
+ * One overlapping sample per geometry type, so that every registered pair exercises its full test.
+ */
+class BenchmarkScene {
+  FlatHeightMap heightMap;
+public:
+  Sphere sphere = Sphere(vector(0, 0, 0), 2);
+  Plane plane = Plane(vector(0, 0, 0), vector(0, 1, 0));
+  Line line = Line(vector(-10, 0, 0), vector(1, 0, 0));
+  AABB aabb = AABB(vector(1, 0, 0), vector(1, 1, 1));
+  OOBB oobb = OOBB(vector(0.5, 0.5, 0), vector(1, 1, 1), vector(1, 1, 0), vector(-1, 1, 0));
+  HierarchicalGeometry hierarchy = HierarchicalGeometry(std::unique_ptr<Geometry>(new Sphere(vector(0, 0, 0), 4)), std::unique_ptr<Geometry>(new Sphere(vector(1, 0, 0), 1)));
+  HeightMapGeometry heightMapGeometry = HeightMapGeometry(vector(-50, -8, -50), heightMap);
+  Frustum frustum = Frustum(std::vector<Plane> {Plane(vector(0, 0, 0), vector(0, 1, 0))});
+
+  const Geometry *get(GeometryType type) const {
+    switch(type) {
+      case GeometryType::SPHERE:
+        return &sphere;
+      case GeometryType::PLANE:
+        return &plane;
+      case GeometryType::LINE:
+        return &line;
+      case GeometryType::AABB:
+        return &aabb;
+      case GeometryType::OOBB:
+        return &oobb;
+      case GeometryType::HIERARCHY:
+        return &hierarchy;
+      case GeometryType::HEIGHTMAP:
+        return &heightMapGeometry;
+      case GeometryType::FRUSTUM:
+        return &frustum;
+      default:
+        return nullptr;
+    }
+  }
+};
+
+TEST_CASE("Dispatch: dense table vs std::map, every registered pair") {
+  CollisionTester denseTester;
+  MapDispatchCollisionTester mapTester;
+  BenchmarkScene scene;
+
+  for(unsigned int typeOp1 = 0; typeOp1 < GEOMETRY_TYPE_COUNT; typeOp1++) {
+    for(unsigned int typeOp2 = 0; typeOp2 < GEOMETRY_TYPE_COUNT; typeOp2++) {
+      const Geometry *op1 = scene.get((GeometryType)typeOp1);
+      const Geometry *op2 = scene.get((GeometryType)typeOp2);
+      if(op1 == nullptr || op2 == nullptr) {
+        continue;
+      }
+
+      String pairName = mapTester.typeName((GeometryType)typeOp1) + "<->" + mapTester.typeName((GeometryType)typeOp2);
+      bool swapped;
+
+      if(denseTester.getIntersectionTest((GeometryType)typeOp1, (GeometryType)typeOp2, swapped) != nullptr) {
+        BENCHMARK("intersects map " + pairName) {
+          return mapTester.intersects(*op1, *op2);
+        };
+        BENCHMARK("intersects dense " + pairName) {
+          return denseTester.intersects(*op1, *op2);
+        };
+      }
+
+      if(denseTester.getContactTest((GeometryType)typeOp1, (GeometryType)typeOp2, swapped) != nullptr) {
+        BENCHMARK("detectCollision map " + pairName) {
+          return mapTester.detectCollision(*op1, *op2);
+        };
+        BENCHMARK("detectCollision dense " + pairName) {
+          return denseTester.detectCollision(*op1, *op2);
+        };
+        ContactBuffer contacts;
+        BENCHMARK("detectCollision dense, contact buffer " + pairName) {
+          contacts.clear();
+          denseTester.detectCollision(*op1, *op2, contacts);
+          return contacts.size();
+        };
+      }
+    }
+  }
+}
+
+/**
+ * Same pair through runtime dispatch, compile time dispatch and a direct kernel call
+ */
+template<typename A, typename B, typename Kernel> static void benchmarkIntersectionDispatch(const String &pairName, const CollisionTester &tester, const A &a, const B &b, Kernel kernel) {
+  BENCHMARK("intersects CollisionTester " + pairName) {
+    return tester.intersects(a, b);
+  };
+  BENCHMARK("intersects StaticCollisionTester " + pairName) {
+    return StaticCollisionTester::intersects(a, b);
+  };
+  BENCHMARK("intersects IntersectionHelper " + pairName) {
+    return kernel(a, b);
+  };
+}
+
+template<typename A, typename B, typename Kernel> static void benchmarkContactDispatch(const String &pairName, const CollisionTester &tester, const A &a, const B &b, Kernel kernel) {
+  ContactBuffer contacts;
+  BENCHMARK("detectCollision CollisionTester " + pairName) {
+    contacts.clear();
+    tester.detectCollision(a, b, contacts);
+    return contacts.size();
+  };
+  BENCHMARK("detectCollision StaticCollisionTester " + pairName) {
+    contacts.clear();
+    StaticCollisionTester::detectCollision(a, b, contacts);
+    return contacts.size();
+  };
+  BENCHMARK("detectCollision IntersectionHelper " + pairName) {
+    contacts.clear();
+    kernel(a, b, contacts);
+    return contacts.size();
+  };
+}
+
+TEST_CASE("Dispatch: runtime table vs compile time vs direct kernel call") {
+  CollisionTester tester;
+  BenchmarkScene scene;
+  Sphere anotherSphere(vector(1, 1, 0), 1);
+  AABB anotherAabb(vector(0, 1.5, 0), vector(1, 1, 1));
+  OOBB anotherOobb(vector(1, -0.5, 0.5), vector(1, 0.5, 1), vector(1, 0, 1), vector(0, 1, 0));
+
+  benchmarkIntersectionDispatch("LINE<->AABB", tester, scene.line, scene.aabb, [](const Line &line, const AABB &aabb) { return IntersectionHelper::lineAabb(line, aabb); });
+  benchmarkIntersectionDispatch("PLANE<->SPHERE", tester, scene.plane, scene.sphere, [](const Plane &plane, const Sphere &sphere) { return IntersectionHelper::planeSphere(plane, sphere); });
+  benchmarkIntersectionDispatch("SPHERE<->SPHERE", tester, scene.sphere, anotherSphere, [](const Sphere &sphere, const Sphere &another) { return IntersectionHelper::sphereSphere(sphere, another); });
+  benchmarkIntersectionDispatch("SPHERE<->AABB", tester, scene.sphere, scene.aabb, [](const Sphere &sphere, const AABB &aabb) { return IntersectionHelper::sphereAabb(sphere, aabb); });
+  benchmarkIntersectionDispatch("SPHERE<->OOBB", tester, scene.sphere, scene.oobb, IntersectionHelper::sphereOobb);
+  benchmarkIntersectionDispatch("AABB<->AABB", tester, scene.aabb, anotherAabb, [](const AABB &aabb, const AABB &another) { return IntersectionHelper::aabbAabb(aabb, another); });
+  benchmarkIntersectionDispatch("OOBB<->OOBB", tester, scene.oobb, anotherOobb, IntersectionHelper::oobbOobb);
+
+  benchmarkContactDispatch("PLANE<->SPHERE", tester, scene.plane, scene.sphere, [](const Plane &plane, const Sphere &sphere, ContactBuffer &contacts) { IntersectionHelper::planeSphereContact(plane, sphere, contacts); });
+  benchmarkContactDispatch("SPHERE<->SPHERE", tester, scene.sphere, anotherSphere, [](const Sphere &sphere, const Sphere &another, ContactBuffer &contacts) { IntersectionHelper::sphereSphereContact(sphere, another, contacts); });
+  benchmarkContactDispatch("SPHERE<->AABB", tester, scene.sphere, scene.aabb, [](const Sphere &sphere, const AABB &aabb, ContactBuffer &contacts) { IntersectionHelper::sphereAabbContact(sphere, aabb, contacts); });
+  benchmarkContactDispatch("OOBB<->OOBB", tester, scene.oobb, anotherOobb, [](const OOBB &oobb, const OOBB &another, ContactBuffer &contacts) { IntersectionHelper::oobbOobbContact(oobb, another, contacts); });
+}
+
+/**
+ * Hierarchy of bounding spheres: every node has fanOut children of half its radius around its center, leaves are spheres
+ */
+static std::unique_ptr<Geometry> buildHierarchy(const vector &center, real radius, unsigned int depth, unsigned int fanOut) {
+  if(depth == 0) {
+    return std::unique_ptr<Geometry>(new Sphere(center, radius));
+  }
+
+  std::unique_ptr<HierarchicalGeometry> hierarchy(new HierarchicalGeometry(std::unique_ptr<Geometry>(new Sphere(center, radius))));
+  for(unsigned int child = 0; child < fanOut; child++) {
+    real angle = (real)6.283185307179586 * child / fanOut;
+    vector childCenter = center + vector(std::cos(angle), depth % 2 == 0 ? 0.3 : -0.3, std::sin(angle)) * (radius * 0.5);
+    hierarchy->addChildren(buildHierarchy(childCenter, radius * 0.45, depth - 1, fanOut));
+  }
+  return hierarchy;
+}
+
+TEST_CASE("Hierarchy traversal: depth 1 to 4, fan-out 2, 4 and 8") {
+  std::mt19937 random(1234);
+  std::uniform_real_distribution<real> position(-100, 100);
+  std::uniform_real_distribution<real> size(1, 5);
+
+  std::vector<Sphere> queries;
+  for(unsigned int index = 0; index < 1000; index++) {
+    queries.emplace_back(vector(position(random), position(random) * 0.2, position(random)), size(random));
+  }
+
+  CollisionTester tester;
+  ContactBuffer contacts;
+  for(unsigned int fanOut : {2u, 4u, 8u}) {
+    for(unsigned int depth = 1; depth <= 4; depth++) {
+      std::unique_ptr<Geometry> hierarchy = buildHierarchy(vector(0, 0, 0), 100, depth, fanOut);
+      LinearBvh bvh(*hierarchy);
+      String suffix = ", depth " + std::to_string(depth) + ", fan-out " + std::to_string(fanOut);
+
+      BENCHMARK("1k spheres intersects hierarchy" + suffix) {
+        unsigned int count = 0;
+        for(const Sphere &query : queries) {
+          count += tester.intersects(query, *hierarchy) ? 1 : 0;
+        }
+        return count;
+      };
+
+      BENCHMARK("1k spheres detectCollision hierarchy" + suffix) {
+        contacts.clear();
+        for(const Sphere &query : queries) {
+          tester.detectCollision(query, *hierarchy, contacts);
+        }
+        return contacts.size();
+      };
+
+      BENCHMARK("1k spheres intersects linear bvh" + suffix) {
+        unsigned int count = 0;
+        for(const Sphere &query : queries) {
+          count += tester.intersects(query, bvh) ? 1 : 0;
+        }
+        return count;
+      };
+
+      BENCHMARK("1k spheres detectCollision linear bvh" + suffix) {
+        contacts.clear();
+        for(const Sphere &query : queries) {
+          tester.detectCollision(query, bvh, contacts);
+        }
+        return contacts.size();
+      };
+    }
+  }
+}
+
+TEST_CASE("Hierarchy moves: 50 part ragdoll, 5 limbs of 10 parts") {
+  HierarchicalGeometry ragdoll(std::unique_ptr<Geometry>(new Sphere(vector(0, 0, 0), 1)));
+  for(unsigned int limb = 0; limb < 5; limb++) {
+    real angle = (real)6.283185307179586 * limb / 5;
+    vector direction(std::cos(angle), 0, std::sin(angle));
+    std::unique_ptr<HierarchicalGeometry> limbHierarchy(new HierarchicalGeometry(std::unique_ptr<Geometry>(new Sphere(direction, 0.5))));
+    for(unsigned int part = 0; part < 10; part++) {
+      limbHierarchy->addChildren(std::unique_ptr<Geometry>(new Sphere(direction * (1 + part * 0.2), 0.2)));
+    }
+    ragdoll.addChildren(std::move(limbHierarchy));
+  }
+
+  CollisionTester tester;
+  Sphere probe(vector(0, 0, 0), 0.1);
+
+  BENCHMARK("100 moves") {
+    for(unsigned int step = 0; step < 100; step++) {
+      ragdoll.setOrigin(vector(step * 0.01, 0, 0));
+    }
+    return ragdoll.getOrigin().x;
+  };
+
+  BENCHMARK("100 moves, then one query") {
+    for(unsigned int step = 0; step < 100; step++) {
+      ragdoll.setOrigin(vector(step * 0.01, 0, 0));
+    }
+    return tester.intersects(probe, ragdoll);
+  };
+
+  BENCHMARK("100 moves, a query after each") {
+    unsigned int count = 0;
+    for(unsigned int step = 0; step < 100; step++) {
+      ragdoll.setOrigin(vector(step * 0.01, 0, 0));
+      count += tester.intersects(probe, ragdoll) ? 1 : 0;
+    }
+    return count;
+  };
+}
+
+TEST_CASE("Sweep and prune: 50k mostly static geometries, 300 moving per frame") {
+  std::mt19937 random(1234);
+  std::uniform_real_distribution<real> position(-500, 500);
+  std::uniform_real_distribution<real> size(0.5, 2);
+  std::uniform_real_distribution<real> step(-0.2, 0.2);
+
+  std::vector<std::unique_ptr<Geometry>> geometries;
+  SweepAndPrune sweepAndPrune;
+  std::vector<unsigned int> proxies;
+
+  for(unsigned int index = 0; index < 50000; index++) {
+    if(index % 2 == 0) {
+      geometries.emplace_back(new Sphere(vector(position(random), position(random) * 0.1, position(random)), size(random)));
+    } else {
+      geometries.emplace_back(new AABB(vector(position(random), position(random) * 0.1, position(random)), vector(size(random), size(random), size(random))));
+    }
+    proxies.push_back(sweepAndPrune.addGeometry(geometries.back().get()));
+  }
+
+  BENCHMARK("initial sort of 50k geometries") {
+    SweepAndPrune fresh;
+    for(auto &geometry : geometries) {
+      fresh.addGeometry(geometry.get());
+    }
+    fresh.update();
+    return fresh.getPairCount();
+  };
+
+  sweepAndPrune.update();
+
+  BENCHMARK("frame update with 300 moving geometries") {
+    for(unsigned int index = 0; index < 300; index++) {
+      unsigned int moved = (index * 7919) % geometries.size();
+      geometries[moved]->setOrigin(geometries[moved]->getOrigin() + vector(step(random), step(random), step(random)));
+      sweepAndPrune.updateGeometry(proxies[moved]);
+    }
+    sweepAndPrune.update();
+    return sweepAndPrune.getPairs().size();
+  };
+}
+
+TEST_CASE("Spatial hash grid: 200k spheres") {
+  std::mt19937 random(1234);
+  std::uniform_real_distribution<real> position(-300, 300);
+  std::uniform_real_distribution<real> size(0.4, 0.6);
+
+  std::vector<std::unique_ptr<Sphere>> spheres;
+  SpatialHashGrid grid;
+  for(unsigned int index = 0; index < 200000; index++) {
+    spheres.emplace_back(new Sphere(vector(position(random), position(random) * 0.1, position(random)), size(random)));
+    grid.addSphere(spheres.back().get());
+  }
+
+  std::vector<BroadPhasePair> pairs;
+  BENCHMARK("rebuild and find all pairs") {
+    grid.update();
+    pairs.clear();
+    grid.getPairs(pairs);
+    return pairs.size();
+  };
+}
+
+TEST_CASE("Batch kernels: one sphere against 10k spheres and aabbs") {
+  std::mt19937 random(1234);
+  std::uniform_real_distribution<real> position(-100, 100);
+  std::uniform_real_distribution<real> size(0.5, 2);
+
+  std::vector<std::unique_ptr<Sphere>> spheres;
+  std::vector<std::unique_ptr<AABB>> aabbs;
+  SphereBatch sphereBatch;
+  AabbBatch aabbBatch;
+  FloatSphereBatch floatSphereBatch;
+  FloatAabbBatch floatAabbBatch;
+  for(unsigned int index = 0; index < 10000; index++) {
+    spheres.emplace_back(new Sphere(vector(position(random), position(random), position(random)), size(random)));
+    aabbs.emplace_back(new AABB(vector(position(random), position(random), position(random)), vector(size(random), size(random), size(random))));
+    sphereBatch.add(*spheres.back());
+    aabbBatch.add(*aabbs.back());
+    floatSphereBatch.add(*spheres.back());
+    floatAabbBatch.add(*aabbs.back());
+  }
+
+  Sphere querySphere(vector(0, 0, 0), 20);
+  std::vector<uint64_t> mask;
+  std::vector<unsigned int> indices;
+  indices.reserve(10000);
+
+  BENCHMARK("sphereSphere one by one") {
+    unsigned int count = 0;
+    for(auto &sphere : spheres) {
+      count += IntersectionHelper::sphereSphere(querySphere, *sphere) ? 1 : 0;
+    }
+    return count;
+  };
+
+  BENCHMARK("sphereSphere batch mask") {
+    BatchIntersectionHelper::sphereSphere(querySphere, sphereBatch, mask);
+    return mask.size();
+  };
+
+  BENCHMARK("sphereSphere batch indices") {
+    indices.clear();
+    BatchIntersectionHelper::sphereSphere(querySphere, sphereBatch, indices);
+    return indices.size();
+  };
+
+  BENCHMARK("sphereAabb one by one") {
+    unsigned int count = 0;
+    for(auto &aabb : aabbs) {
+      count += IntersectionHelper::sphereAabb(querySphere, *aabb) ? 1 : 0;
+    }
+    return count;
+  };
+
+  BENCHMARK("sphereAabb batch mask") {
+    BatchIntersectionHelper::sphereAabb(querySphere, aabbBatch, mask);
+    return mask.size();
+  };
+
+  BENCHMARK("sphereSphere float batch mask") {
+    BatchIntersectionHelper::sphereSphere(querySphere, floatSphereBatch, mask);
+    return mask.size();
+  };
+
+  BENCHMARK("sphereAabb float batch mask") {
+    BatchIntersectionHelper::sphereAabb(querySphere, floatAabbBatch, mask);
+    return mask.size();
+  };
+}
+
+TEST_CASE("Ray casting: slab test against 10k aabbs, packets of 8 rays") {
+  std::mt19937 random(1234);
+  std::uniform_real_distribution<real> position(-100, 100);
+  std::uniform_real_distribution<real> size(0.5, 2);
+
+  std::vector<std::unique_ptr<AABB>> aabbs;
+  AabbBatch aabbBatch;
+  for(unsigned int index = 0; index < 10000; index++) {
+    aabbs.emplace_back(new AABB(vector(position(random), position(random), position(random)), vector(size(random), size(random), size(random))));
+    aabbBatch.add(*aabbs.back());
+  }
+
+  Line ray(vector(0, 0, -150), vector(0.1, 0.05, 1));
+  std::vector<uint64_t> mask;
+  std::vector<real> tEnters;
+
+  BENCHMARK("lineAabb one by one") {
+    unsigned int count = 0;
+    for(auto &aabb : aabbs) {
+      count += IntersectionHelper::lineAabb(ray, *aabb) ? 1 : 0;
+    }
+    return count;
+  };
+
+  BENCHMARK("lineAabb batch mask") {
+    BatchIntersectionHelper::lineAabb(ray, aabbBatch, mask);
+    return mask.size();
+  };
+
+  BENCHMARK("lineAabb batch mask and entry t") {
+    BatchIntersectionHelper::lineAabb(ray, aabbBatch, mask, tEnters);
+    return tEnters.size();
+  };
+
+  RayBatch packet;
+  for(unsigned int index = 0; index < 8; index++) {
+    packet.add(Line(vector(index * 0.01, 0, -150), vector(0.1, 0.05, 1)));
+  }
+
+  BENCHMARK("packet of 8 rays against 10k aabbs") {
+    unsigned int count = 0;
+    for(auto &aabb : aabbs) {
+      mask.clear();
+      BatchIntersectionHelper::lineAabb(packet, *aabb, mask);
+      count += mask[0] != 0 ? 1 : 0;
+    }
+    return count;
+  };
+}
+
+TEST_CASE("Frustum culling: 1k, 10k and 100k spheres and aabbs against 6 planes") {
+  std::mt19937 random(1234);
+  std::uniform_real_distribution<real> position(-100, 100);
+  std::uniform_real_distribution<real> size(0.5, 2);
+
+  Frustum frustum(std::vector<Plane> {
+    Plane(vector(50, 0, 0), vector(1, 0, 0.2)), Plane(vector(-50, 0, 0), vector(-1, 0, 0.2)),
+    Plane(vector(0, 50, 0), vector(0, 1, 0.2)), Plane(vector(0, -50, 0), vector(0, -1, 0.2)),
+    Plane(vector(0, 0, 80), vector(0, 0, 1)), Plane(vector(0, 0, -80), vector(0, 0, -1))
+  });
+  FrustumCuller culler(frustum);
+  CollisionTester tester;
+
+  std::vector<std::unique_ptr<Sphere>> spheres;
+  std::vector<std::unique_ptr<AABB>> aabbs;
+  for(unsigned int index = 0; index < 100000; index++) {
+    spheres.emplace_back(new Sphere(vector(position(random), position(random), position(random)), size(random)));
+    aabbs.emplace_back(new AABB(vector(position(random), position(random), position(random)), vector(size(random), size(random), size(random))));
+  }
+
+  std::vector<CullResult> results;
+  for(unsigned int count : {1000u, 10000u, 100000u}) {
+    String suffix = " (" + std::to_string(count / 1000) + "k)";
+    SphereBatch sphereBatch;
+    AabbBatch aabbBatch;
+    for(unsigned int index = 0; index < count; index++) {
+      sphereBatch.add(*spheres[index]);
+      aabbBatch.add(*aabbs[index]);
+    }
+
+    BENCHMARK("spheres through CollisionTester frustum dispatch" + suffix) {
+      unsigned int inside = 0;
+      for(unsigned int index = 0; index < count; index++) {
+        inside += tester.intersects(*spheres[index], frustum) ? 1 : 0;
+      }
+      return inside;
+    };
+
+    BENCHMARK("spheres one by one" + suffix) {
+      unsigned int inside = 0;
+      for(unsigned int index = 0; index < count; index++) {
+        inside += culler.cull(*spheres[index]) != CullResult::OUTSIDE ? 1 : 0;
+      }
+      return inside;
+    };
+
+    BENCHMARK("sphere batch" + suffix) {
+      culler.cull(sphereBatch, results);
+      return results.size();
+    };
+
+    BENCHMARK("aabbs one by one" + suffix) {
+      unsigned int inside = 0;
+      for(unsigned int index = 0; index < count; index++) {
+        inside += culler.cull(*aabbs[index]) != CullResult::OUTSIDE ? 1 : 0;
+      }
+      return inside;
+    };
+
+    BENCHMARK("aabb batch" + suffix) {
+      culler.cull(aabbBatch, results);
+      return results.size();
+    };
+  }
+}
+
+TEST_CASE("Contact cache: 10k resting spheres on a plane") {
+  std::mt19937 random(1234);
+  std::uniform_real_distribution<real> position(-500, 500);
+
+  Plane plane(vector(0, 0, 0), vector(0, 1, 0));
+  std::vector<std::unique_ptr<Sphere>> spheres;
+  for(unsigned int index = 0; index < 10000; index++) {
+    spheres.emplace_back(new Sphere(vector(position(random), 0.9, position(random)), 1));
+  }
+
+  CollisionTester tester;
+  ContactBuffer contacts;
+  ContactCache cache;
+
+  BENCHMARK("detect contacts only") {
+    contacts.clear();
+    for(auto &sphere : spheres) {
+      tester.detectCollision(*sphere, plane, contacts);
+    }
+    return contacts.size();
+  };
+
+  BENCHMARK("detect contacts and update cache") {
+    cache.beginFrame();
+    contacts.clear();
+    for(auto &sphere : spheres) {
+      tester.detectCollision(*sphere, plane, contacts);
+    }
+    cache.addContacts(contacts);
+    return cache.endFrame();
+  };
+}
+
+TEST_CASE("Parallel narrow phase: 100k pairs") {
+  std::mt19937 random(1234);
+  std::uniform_real_distribution<real> position(-100, 100);
+  std::uniform_real_distribution<real> size(0.5, 2);
+
+  std::vector<std::unique_ptr<Geometry>> geometries;
+  for(unsigned int index = 0; index < 2000; index++) {
+    geometries.emplace_back(new Sphere(vector(position(random), position(random), position(random)), size(random)));
+    geometries.emplace_back(new AABB(vector(position(random), position(random), position(random)), vector(size(random), size(random), size(random))));
+  }
+
+  std::uniform_int_distribution<unsigned int> geometry(0, geometries.size() - 1);
+  std::vector<BroadPhasePair> pairs;
+  for(unsigned int index = 0; index < 100000; index++) {
+    pairs.emplace_back(geometries[geometry(random)].get(), geometries[geometry(random)].get());
+  }
+
+  CollisionTester tester;
+  ContactBuffer contacts;
+
+  BENCHMARK("serial") {
+    contacts.clear();
+    for(const BroadPhasePair &pair : pairs) {
+      tester.detectCollision(*pair.getGeometryA(), *pair.getGeometryB(), contacts);
+    }
+    return contacts.size();
+  };
+
+  for(unsigned int threadCount : {1u, 2u, 4u, 8u, 16u}) {
+    WorkStealingThreadPool threadPool(threadCount);
+    ParallelCollisionTester parallelTester(tester, threadPool);
+    BENCHMARK(std::to_string(threadCount) + " threads") {
+      contacts.clear();
+      parallelTester.detectCollisions(pairs, contacts);
+      return contacts.size();
+    };
+  }
+}
+
+TEST_CASE("Static level bvh build: 300k aabbs and spheres") {
+  std::mt19937 random(2023);
+  std::uniform_real_distribution<real> position(-1000, 1000);
+  std::uniform_real_distribution<real> size(0.5, 4);
+
+  std::vector<std::unique_ptr<Geometry>> level;
+  std::vector<const Geometry *> geometries;
+  for(unsigned int index = 0; index < 150000; index++) {
+    level.emplace_back(new Sphere(vector(position(random), position(random), position(random)), size(random)));
+    level.emplace_back(new AABB(vector(position(random), position(random), position(random)), vector(size(random), size(random), size(random))));
+  }
+  for(auto &geometry : level) {
+    geometries.push_back(geometry.get());
+  }
+
+  BENCHMARK("LinearBvh median split, serial") {
+    LinearBvh bvh(geometries);
+    return bvh.size();
+  };
+
+  LinearBvh bvh;
+  for(bool wideCodes : {false, true}) {
+    for(unsigned int threadCount : {1u, 2u, 4u, 8u, 16u}) {
+      WorkStealingThreadPool threadPool(threadCount);
+      MortonBvhBuilder builder(threadPool, wideCodes);
+      BENCHMARK("Morton codes, " + std::to_string(builder.getCodeBits()) + " bits, " + std::to_string(threadCount) + " threads") {
+        builder.build(geometries, bvh);
+        return bvh.size();
+      };
+    }
+  }
+
+  // query cost of either tree
+  std::vector<Sphere> probes;
+  for(unsigned int index = 0; index < 10000; index++) {
+    probes.emplace_back(vector(position(random), position(random), position(random)), 5);
+  }
+  CollisionTester tester;
+  LinearBvh medianBvh(geometries);
+  WorkStealingThreadPool threadPool;
+  MortonBvhBuilder builder(threadPool);
+  LinearBvh mortonBvh;
+  builder.build(geometries, mortonBvh);
+
+  BENCHMARK("10k probes, median split bvh") {
+    unsigned int hits = 0;
+    for(const Sphere &probe : probes) {
+      hits += tester.intersects(probe, medianBvh) ? 1 : 0;
+    }
+    return hits;
+  };
+
+  BENCHMARK("10k probes, morton bvh") {
+    unsigned int hits = 0;
+    for(const Sphere &probe : probes) {
+      hits += tester.intersects(probe, mortonBvh) ? 1 : 0;
+    }
+    return hits;
+  };
+}
+
+TEST_CASE("Level startup: 500k colliders") {
+  std::mt19937 random(2024);
+  std::uniform_real_distribution<real> position(-1000, 1000);
+  std::uniform_real_distribution<real> size(0.5, 4);
+
+  std::vector<std::unique_ptr<Geometry>> level;
+  std::vector<const Geometry *> geometries;
+  for(unsigned int index = 0; index < 250000; index++) {
+    level.emplace_back(new Sphere(vector(position(random), position(random), position(random)), size(random)));
+    level.emplace_back(new AABB(vector(position(random), position(random), position(random)), vector(size(random), size(random), size(random))));
+  }
+  for(auto &geometry : level) {
+    geometries.push_back(geometry.get());
+  }
+
+  WorkStealingThreadPool threadPool;
+  MortonBvhBuilder builder(threadPool);
+  LinearBvh bvh;
+  builder.build(geometries, bvh);
+  String path = "level_startup_benchmark.bin";
+  SceneCache::write(path, bvh);
+
+  BENCHMARK("build morton bvh, " + std::to_string(threadPool.getThreadCount()) + " threads") {
+    LinearBvh built;
+    builder.build(geometries, built);
+    return built.size();
+  };
+
+  BENCHMARK("open scene cache and load") {
+    SceneCache cache(path);
+    LinearBvh loaded;
+    cache.load(loaded);
+    return loaded.size();
+  };
+
+  std::remove(path.c_str());
+}
+
+TEST_CASE("Separation cache: 10k coherent crate and ball pairs") {
+  std::mt19937 random(2025);
+  std::uniform_real_distribution<real> unit(-1, 1);
+  std::uniform_real_distribution<real> size(0.5, 1);
+
+  std::vector<std::unique_ptr<Geometry>> bodies;
+  std::vector<vector> velocities;
+  for(unsigned int index = 0; index < 2000; index++) {
+    vector origin = vector(unit(random), unit(random), unit(random)) * 40;
+    if(index % 2 == 0) {
+      bodies.emplace_back(new OOBB(origin, vector(size(random), size(random), size(random)), vector(unit(random), unit(random), unit(random)), vector(unit(random), unit(random), unit(random))));
+    } else {
+      bodies.emplace_back(new Sphere(origin, size(random)));
+    }
+    velocities.push_back(vector(unit(random), unit(random), unit(random)) * 0.01);
+  }
+
+  std::uniform_int_distribution<unsigned int> body(0, bodies.size() - 1);
+  std::vector<BroadPhasePair> pairs; // near pairs, as a loose broad phase would report them
+  while(pairs.size() < 10000) {
+    const Geometry *first = bodies[body(random)].get();
+    const Geometry *second = bodies[body(random)].get();
+    if(first != second && (first->getOrigin() - second->getOrigin()).modulo() < 6) {
+      pairs.emplace_back(first, second);
+    }
+  }
+
+  auto step = [&bodies, &velocities]() {
+    for(unsigned int index = 0; index < bodies.size(); index++) {
+      bodies[index]->setOrigin(bodies[index]->getOrigin() + velocities[index]);
+    }
+  };
+
+  CollisionTester tester;
+  ContactBuffer contacts;
+  BENCHMARK("detectCollision every pair") {
+    step();
+    contacts.clear();
+    for(const BroadPhasePair &pair : pairs) {
+      tester.detectCollision(*pair.getGeometryA(), *pair.getGeometryB(), contacts);
+    }
+    return contacts.size();
+  };
+
+  SeparationCache cache(tester, 16384);
+  BENCHMARK("detectCollision through separation cache") {
+    step();
+    contacts.clear();
+    for(const BroadPhasePair &pair : pairs) {
+      cache.detectCollision(*pair.getGeometryA(), *pair.getGeometryB(), contacts);
+    }
+    return contacts.size();
+  };
+}
+
+TEST_CASE("Height map: 10k wheel probes") {
+  std::mt19937 random(1234);
+  std::uniform_real_distribution<real> height(0, 20);
+  std::uniform_real_distribution<real> position(0, 255);
+
+  std::vector<real> samples;
+  for(unsigned int index = 0; index < 256 * 256; index++) {
+    samples.push_back(height(random));
+  }
+  GridHeightMap grid(256, 256, 1, samples);
+  HeightMapGeometry geometry(vector(0, 0, 0), grid);
+
+  std::vector<std::unique_ptr<Sphere>> wheels;
+  SphereBatch batch;
+  std::vector<real> x, z;
+  for(unsigned int index = 0; index < 10000; index++) {
+    wheels.emplace_back(new Sphere(vector(position(random), 10, position(random)), 0.5));
+    batch.add(*wheels.back());
+    x.push_back(wheels.back()->getOrigin().x);
+    z.push_back(wheels.back()->getOrigin().z);
+  }
+
+  CollisionTester tester;
+  const HeightMap &heightMap = grid;
+  std::vector<real> heights(x.size());
+  std::vector<uint64_t> mask;
+  ContactBuffer contacts;
+
+  BENCHMARK("heightAt through HeightMap virtual calls") {
+    real total = 0;
+    for(unsigned int index = 0; index < x.size(); index++) {
+      total += heightMap.heightAt(x[index], z[index]);
+    }
+    return total;
+  };
+
+  BENCHMARK("heightsAt batch") {
+    geometry.heightsAt(x.data(), z.data(), x.size(), heights.data());
+    return heights[0];
+  };
+
+  BENCHMARK("sphereHeightmap through CollisionTester") {
+    unsigned int count = 0;
+    for(auto &wheel : wheels) {
+      count += tester.intersects(*wheel, geometry) ? 1 : 0;
+    }
+    return count;
+  };
+
+  BENCHMARK("sphereHeightmap batch") {
+    BatchIntersectionHelper::sphereHeightmap(batch, geometry, mask);
+    return mask.size();
+  };
+
+  BENCHMARK("sphereHeightmapContact through CollisionTester") {
+    contacts.clear();
+    for(auto &wheel : wheels) {
+      tester.detectCollision(*wheel, geometry, contacts);
+    }
+    return contacts.size();
+  };
+}
+
+TEST_CASE("Height map pyramid: 10k rays and boxes") {
+  std::mt19937 random(4321);
+  std::uniform_real_distribution<real> height(0, 20);
+  std::uniform_real_distribution<real> position(0, 255);
+  std::uniform_real_distribution<real> unit(-1, 1);
+
+  std::vector<real> samples;
+  for(unsigned int index = 0; index < 256 * 256; index++) {
+    samples.push_back(height(random));
+  }
+  GridHeightMap grid(256, 256, 1, samples);
+  HeightMapGeometry geometry(vector(0, 0, 0), grid);
+
+  std::vector<Line> rays;
+  std::vector<std::unique_ptr<AABB>> boxes;
+  for(unsigned int index = 0; index < 10000; index++) {
+    rays.emplace_back(vector(position(random), 40, position(random)), vector(unit(random), -0.5, unit(random)).normalizado());
+    boxes.emplace_back(new AABB(vector(position(random), 25, position(random)), vector(2, 4, 2)));
+  }
+
+  CollisionTester tester;
+
+  BENCHMARK("lineHeightmap pyramid traversal") {
+    real total = 0;
+    real t;
+    vector normal;
+    for(const Line &ray : rays) {
+      if(IntersectionHelper::lineHeightmap(ray, geometry, t, normal)) {
+        total += t;
+      }
+    }
+    return total;
+  };
+
+  BENCHMARK("aabbHeightmap through CollisionTester") {
+    unsigned int count = 0;
+    for(auto &box : boxes) {
+      count += tester.intersects(*box, geometry) ? 1 : 0;
+    }
+    return count;
+  };
+}
+
+TEST_CASE("Tiled height map: 10k wheel probes") {
+  std::mt19937 random(1234);
+  std::uniform_real_distribution<real> height(0, 20);
+  std::uniform_real_distribution<real> position(0, 1023);
+
+  std::vector<real> samples;
+  for(unsigned int index = 0; index < 1024 * 1024; index++) {
+    samples.push_back(height(random));
+  }
+  GridHeightMap grid(1024, 1024, 1, samples);
+  String path = "tiled_height_map_benchmark.bin";
+  REQUIRE(TiledHeightMap::write(path, 1024, 1024, 1, samples));
+
+  TiledHeightMap tiled(path, 16 << 20);
+  REQUIRE(tiled.isOpen());
+  std::vector<real> x, z;
+  for(unsigned int index = 0; index < 10000; index++) {
+    x.push_back(position(random));
+    z.push_back(position(random));
+  }
+  std::vector<real> heights(x.size());
+  tiled.heightsAt(x.data(), z.data(), x.size(), heights.data()); // loads every tile
+  tiled.waitForPrefetch();
+
+  BENCHMARK("GridHeightMap heightsAt, all in memory") {
+    grid.heightsAt(x.data(), z.data(), x.size(), heights.data());
+    return heights[0];
+  };
+
+  BENCHMARK("TiledHeightMap heightsAt, resident tiles") {
+    tiled.heightsAt(x.data(), z.data(), x.size(), heights.data());
+    return heights[0];
+  };
+
+  BENCHMARK("TiledHeightMap heightAt, resident tiles") {
+    real total = 0;
+    for(unsigned int index = 0; index < x.size(); index++) {
+      total += tiled.heightAt(x[index], z[index]);
+    }
+    return total;
+  };
+
+  std::remove(path.c_str());
+}
+
+TEST_CASE("OOBB: 10k rotated crate pairs") {
+  std::mt19937 random(1234);
+  std::uniform_real_distribution<real> position(-6, 6);
+  std::uniform_real_distribution<real> size(0.2, 1.5);
+  std::uniform_real_distribution<real> unit(-1, 1);
+
+  std::vector<std::unique_ptr<OOBB>> crates;
+  for(unsigned int index = 0; index < 20000; index++) {
+    crates.emplace_back(new OOBB(vector(position(random), position(random), position(random)), vector(size(random), size(random) * 0.5, size(random)),
+        vector(unit(random), unit(random), unit(random)), vector(unit(random), unit(random), unit(random))));
+  }
+
+  CollisionTester tester;
+  ContactBuffer contacts;
+
+  BENCHMARK("bounds overlap (loose aabbs)") {
+    unsigned int count = 0;
+    for(unsigned int index = 0; index < crates.size(); index += 2) {
+      count += crates[index]->getBounds().overlaps(crates[index + 1]->getBounds()) ? 1 : 0;
+    }
+    return count;
+  };
+
+  BENCHMARK("oobbOobb SAT through CollisionTester") {
+    unsigned int count = 0;
+    for(unsigned int index = 0; index < crates.size(); index += 2) {
+      count += tester.intersects(*crates[index], *crates[index + 1]) ? 1 : 0;
+    }
+    return count;
+  };
+
+  BENCHMARK("oobbOobbContact through CollisionTester") {
+    contacts.clear();
+    for(unsigned int index = 0; index < crates.size(); index += 2) {
+      tester.detectCollision(*crates[index], *crates[index + 1], contacts);
+    }
+    return contacts.size();
+  };
+}
+
+TEST_CASE("GJK: 1k touching crate pairs") {
+  std::mt19937 random(1234);
+  std::uniform_real_distribution<real> position(-60, 60);
+  std::uniform_real_distribution<real> offset(-1.5, 1.5);
+  std::uniform_real_distribution<real> size(0.2, 1.5);
+  std::uniform_real_distribution<real> unit(-1, 1);
+
+  std::vector<std::unique_ptr<OOBB>> crates; // pairs a broad phase would report: bounds close, about two thirds intersecting
+  for(unsigned int index = 0; index < 1000; index++) {
+    vector origin(position(random), position(random), position(random));
+    crates.emplace_back(new OOBB(origin, vector(size(random), size(random) * 0.5, size(random)),
+        vector(unit(random), unit(random), unit(random)), vector(unit(random), unit(random), unit(random))));
+    crates.emplace_back(new OOBB(origin + vector(offset(random), offset(random), offset(random)), vector(size(random), size(random) * 0.5, size(random)),
+        vector(unit(random), unit(random), unit(random)), vector(unit(random), unit(random), unit(random))));
+  }
+
+  SimplexCache cache(2048);
+  for(unsigned int index = 0; index < crates.size(); index += 2) { // previous frame
+    GjkEpa::intersects(*crates[index], *crates[index + 1], &cache);
+  }
+
+  BENCHMARK("oobbOobb SAT") {
+    unsigned int count = 0;
+    for(unsigned int index = 0; index < crates.size(); index += 2) {
+      count += IntersectionHelper::oobbOobb(*crates[index], *crates[index + 1]) ? 1 : 0;
+    }
+    return count;
+  };
+
+  BENCHMARK("GJK, cold") {
+    unsigned int count = 0;
+    for(unsigned int index = 0; index < crates.size(); index += 2) {
+      count += GjkEpa::intersects(*crates[index], *crates[index + 1]) ? 1 : 0;
+    }
+    return count;
+  };
+
+  BENCHMARK("GJK, cached simplex") {
+    unsigned int count = 0;
+    for(unsigned int index = 0; index < crates.size(); index += 2) {
+      count += GjkEpa::intersects(*crates[index], *crates[index + 1], &cache) ? 1 : 0;
+    }
+    return count;
+  };
+
+  ContactBuffer contacts;
+  BENCHMARK("oobbOobbContact") {
+    contacts.clear();
+    for(unsigned int index = 0; index < crates.size(); index += 2) {
+      IntersectionHelper::oobbOobbContact(*crates[index], *crates[index + 1], contacts);
+    }
+    return contacts.size();
+  };
+
+  BENCHMARK("GJK + EPA contacts") {
+    contacts.clear();
+    for(unsigned int index = 0; index < crates.size(); index += 2) {
+      GjkEpa::contact(*crates[index], *crates[index + 1], contacts);
+    }
+    return contacts.size();
+  };
+}
+
+TEST_CASE("Continuous collision: 10k projectiles against thin walls") {
+  std::mt19937 random(1234);
+  std::uniform_real_distribution<real> position(-20, 20);
+  std::uniform_real_distribution<real> unit(-1, 1);
+
+  std::vector<std::unique_ptr<Sphere>> bullets;
+  std::vector<std::unique_ptr<OOBB>> crates;
+  std::vector<vector> ends;
+  for(unsigned int index = 0; index < 10000; index++) {
+    vector start(-30, position(random) * 0.1, position(random) * 0.1);
+    bullets.emplace_back(new Sphere(start, 0.05));
+    crates.emplace_back(new OOBB(start, vector(0.1, 0.1, 0.1), vector(unit(random), unit(random), unit(random)), vector(unit(random), unit(random), unit(random))));
+    ends.push_back(vector(30, position(random) * 0.1, position(random) * 0.1));
+  }
+  AABB wall(vector(0, 0, 0), vector(0.05, 3, 3));
+  OOBB rotatedWall(vector(0, 0, 0), vector(0.05, 3, 3), vector(1, 0.2, 0), vector(0, 1, 0));
+
+  CollisionTester tester;
+  ContinuousCollisionTester sweepTester;
+  TimeOfImpact result;
+
+  BENCHMARK("spheres, 64 discrete substeps (still tunnels)") {
+    unsigned int count = 0;
+    for(unsigned int index = 0; index < bullets.size(); index++) {
+      vector step = (ends[index] - bullets[index]->getOrigin()) * ((real)1 / 64);
+      for(unsigned int substep = 0; substep <= 64; substep++) {
+        if(tester.intersects(Sphere(bullets[index]->getOrigin() + step * substep, 0.05), wall)) {
+          count++;
+          break;
+        }
+      }
+    }
+    return count;
+  };
+
+  BENCHMARK("spheres, analytic sweep") {
+    unsigned int count = 0;
+    for(unsigned int index = 0; index < bullets.size(); index++) {
+      count += sweepTester.timeOfImpact(*bullets[index], ends[index], wall, wall.getOrigin(), result) ? 1 : 0;
+    }
+    return count;
+  };
+
+  BENCHMARK("spheres, conservative advancement") {
+    unsigned int count = 0;
+    for(unsigned int index = 0; index < bullets.size(); index++) {
+      count += ContinuousCollisionTester::conservativeAdvancement(*bullets[index], ends[index] - bullets[index]->getOrigin(), wall, vector(0, 0, 0),
+          sweepTester.getTolerance(), result) ? 1 : 0;
+    }
+    return count;
+  };
+
+  BENCHMARK("rotated crates, conservative advancement") {
+    unsigned int count = 0;
+    for(unsigned int index = 0; index < crates.size(); index++) {
+      count += sweepTester.timeOfImpact(*crates[index], ends[index], rotatedWall, rotatedWall.getOrigin(), result) ? 1 : 0;
+    }
+    return count;
+  };
+}
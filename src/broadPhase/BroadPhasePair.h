@@ -0,0 +1,32 @@
+/*
+ * BroadPhasePair.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: leandro
+ */
+
+#pragma once
+
+#include <Geometry.h>
+
+/**
+ * Candidate pair reported by a broad phase, meant to be fed to CollisionTester::intersects / detectCollision.
+ * Bounds overlap, but geometries might still not intersect.
+ */
+class BroadPhasePair {
+  const Geometry *geometryA;
+  const Geometry *geometryB;
+public:
+  BroadPhasePair(const Geometry *geometryA, const Geometry *geometryB) {
+    this->geometryA = geometryA;
+    this->geometryB = geometryB;
+  }
+
+  const Geometry *getGeometryA() const {
+    return this->geometryA;
+  }
+
+  const Geometry *getGeometryB() const {
+    return this->geometryB;
+  }
+};
@@ -0,0 +1,467 @@
+/*
+ * DynamicAabbTree.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: leandro
+ */
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <Geometry.h>
+#include "BroadPhasePair.h"
+
+/**
+ * Small traversal stack living on the call stack, falling back to the heap only for unusually deep trees.
+ */
+class TraversalStack {
+  static constexpr unsigned int capacity = 128;
+  int buffer[capacity];
+  std::vector<int> overflow;
+  unsigned int count = 0;
+public:
+  void push(int value) {
+    if(count < capacity) {
+      buffer[count] = value;
+    } else {
+      overflow.push_back(value);
+    }
+    count++;
+  }
+
+  int pop() {
+    count--;
+    if(count < capacity) {
+      return buffer[count];
+    }
+
+    int value = overflow.back();
+    overflow.pop_back();
+    return value;
+  }
+
+  bool empty() const {
+    return count == 0;
+  }
+};
+
+/**
+ * Dynamic bounding volume hierarchy of fat (padded) bounds, meant as a scene level spatial index. Based on Erin Catto's Box2D dynamic tree.
+ *
+ *  - Leaves store the geometry bounds expanded by a margin. Moving a geometry only touches the tree when its bounds leave the fat bounds.
+ *  - Insert picks the sibling with the lowest surface area cost, and the path back to the root is rebalanced with AVL like rotations, so
+ *    insert, remove and move are O(log N).
+ *  - query() reports leaves overlapping given bounds, getPairs() reports every pair of overlapping leaves and getMovedPairs() only the pairs
+ *    involving leaves reinserted since last clearMoved() - the usual per frame broad phase.
+ *
+ * Reported pairs are candidates: fat bounds overlap, geometries might not. Geometries are not owned.
+ * Intended for bounded geometries - unbounded ones (such as planes) have infinite bounds and should be tested separately.
+ */
+class DynamicAabbTree {
+public:
+  static constexpr int NULL_NODE = -1;
+
+private:
+  class Node {
+  public:
+    Bounds bounds;
+    const Geometry *geometry = nullptr;
+    int parent = NULL_NODE; // next free node while in free list
+    int left = NULL_NODE;
+    int right = NULL_NODE;
+    int height = -1; // -1 for free nodes, 0 for leaves
+    bool moved = false;
+
+    bool isLeaf() const {
+      return left == NULL_NODE;
+    }
+  };
+
+  std::vector<Node> nodes;
+  int root = NULL_NODE;
+  int freeList = NULL_NODE;
+  unsigned int leafCount = 0;
+  real margin;
+  std::vector<int> movedLeaves;
+
+public:
+  DynamicAabbTree(real margin = 0.1) {
+    this->margin = margin;
+  }
+
+  /**
+   * Inserts the geometry and returns its leaf id, valid until removed.
+   */
+  int insert(const Geometry *geometry) {
+    int leaf = allocateNode();
+    nodes[leaf].geometry = geometry;
+    nodes[leaf].bounds = geometry->getBounds().expand(margin);
+    nodes[leaf].height = 0;
+
+    insertLeaf(leaf);
+    markMoved(leaf);
+    leafCount++;
+
+    return leaf;
+  }
+
+  void remove(int leaf) {
+    removeLeaf(leaf);
+    if(nodes[leaf].moved) {
+      movedLeaves.erase(std::find(movedLeaves.begin(), movedLeaves.end(), leaf));
+    }
+    freeNode(leaf);
+    leafCount--;
+  }
+
+  /**
+   * Refreshes the leaf after its geometry moved. The tree is only modified if the geometry bounds left the fat bounds, in which case the leaf
+   * is reinserted with new fat bounds and true is returned.
+   */
+  bool move(int leaf) {
+    Bounds bounds = nodes[leaf].geometry->getBounds();
+    if(nodes[leaf].bounds.contains(bounds)) {
+      return false;
+    }
+
+    removeLeaf(leaf);
+    nodes[leaf].bounds = bounds.expand(margin);
+    insertLeaf(leaf);
+    markMoved(leaf);
+
+    return true;
+  }
+
+  /**
+   * Calls callback(leaf) for every leaf whose fat bounds overlap the given bounds. Callback returns false to stop the query.
+   */
+  template<typename Callback> void query(const Bounds &bounds, Callback callback) const {
+    if(root == NULL_NODE) {
+      return;
+    }
+
+    TraversalStack stack;
+    stack.push(root);
+
+    while(!stack.empty()) {
+      int index = stack.pop();
+      const Node &node = nodes[index];
+
+      if(node.bounds.overlaps(bounds)) {
+        if(node.isLeaf()) {
+          if(!callback(index)) {
+            return;
+          }
+        } else {
+          stack.push(node.left);
+          stack.push(node.right);
+        }
+      }
+    }
+  }
+
+  /**
+   * Geometries whose fat bounds overlap the given bounds.
+   */
+  std::vector<const Geometry *> query(const Bounds &bounds) const {
+    std::vector<const Geometry *> result;
+    query(bounds, [this, &result](int leaf) {
+      result.push_back(nodes[leaf].geometry);
+      return true;
+    });
+    return result;
+  }
+
+  /**
+   * Appends every pair of leaves with overlapping fat bounds: for every internal node, its left subtree is traversed against its right subtree.
+   */
+  void getPairs(std::vector<BroadPhasePair> &pairs) const {
+    if(root == NULL_NODE || nodes[root].isLeaf()) {
+      return;
+    }
+
+    std::vector<std::pair<int, int>> stack;
+    std::vector<int> internalNodes {root};
+
+    while(!internalNodes.empty()) {
+      int index = internalNodes.back();
+      internalNodes.pop_back();
+      stack.emplace_back(nodes[index].left, nodes[index].right);
+
+      for(int child : {nodes[index].left, nodes[index].right}) {
+        if(!nodes[child].isLeaf()) {
+          internalNodes.push_back(child);
+        }
+      }
+
+      while(!stack.empty()) {
+        std::pair<int, int> current = stack.back();
+        stack.pop_back();
+
+        const Node &a = nodes[current.first];
+        const Node &b = nodes[current.second];
+        if(!a.bounds.overlaps(b.bounds)) {
+          continue;
+        }
+
+        if(a.isLeaf() && b.isLeaf()) {
+          pairs.emplace_back(a.geometry, b.geometry);
+        } else if(b.isLeaf() || (!a.isLeaf() && a.height >= b.height)) {
+          stack.emplace_back(a.left, current.second);
+          stack.emplace_back(a.right, current.second);
+        } else {
+          stack.emplace_back(current.first, b.left);
+          stack.emplace_back(current.first, b.right);
+        }
+      }
+    }
+  }
+
+  /**
+   * Appends pairs of overlapping leaves where at least one of them was inserted or reinserted since last clearMoved(). Each pair is reported once.
+   */
+  void getMovedPairs(std::vector<BroadPhasePair> &pairs) const {
+    for(int movedLeaf : movedLeaves) {
+      query(nodes[movedLeaf].bounds, [this, movedLeaf, &pairs](int leaf) {
+        if(leaf != movedLeaf && (!nodes[leaf].moved || leaf > movedLeaf)) {
+          pairs.emplace_back(nodes[movedLeaf].geometry, nodes[leaf].geometry);
+        }
+        return true;
+      });
+    }
+  }
+
+  void clearMoved() {
+    for(int leaf : movedLeaves) {
+      nodes[leaf].moved = false;
+    }
+    movedLeaves.clear();
+  }
+
+  const Geometry *getGeometry(int leaf) const {
+    return nodes[leaf].geometry;
+  }
+
+  const Bounds &getFatBounds(int leaf) const {
+    return nodes[leaf].bounds;
+  }
+
+  int getHeight() const {
+    return root == NULL_NODE ? 0 : nodes[root].height;
+  }
+
+  unsigned int size() const {
+    return leafCount;
+  }
+
+  real getMargin() const {
+    return margin;
+  }
+
+  /**
+   * Checks parent links, heights and that every node bounds contain its children. Meant for tests and debugging.
+   */
+  bool validate() const {
+    return root == NULL_NODE || (nodes[root].parent == NULL_NODE && validate(root) >= 0);
+  }
+
+  String toString() const {
+    return "DynamicAabbTree(leaves: " + std::to_string(leafCount) + ", height: " + std::to_string(getHeight()) + ")";
+  }
+
+protected:
+  int allocateNode() {
+    if(freeList == NULL_NODE) {
+      nodes.emplace_back();
+      return nodes.size() - 1;
+    }
+
+    int index = freeList;
+    freeList = nodes[index].parent;
+    nodes[index] = Node();
+    return index;
+  }
+
+  void freeNode(int index) {
+    nodes[index] = Node();
+    nodes[index].parent = freeList;
+    freeList = index;
+  }
+
+  void markMoved(int leaf) {
+    if(!nodes[leaf].moved) {
+      nodes[leaf].moved = true;
+      movedLeaves.push_back(leaf);
+    }
+  }
+
+  void replaceChild(int parent, int oldChild, int newChild) {
+    if(parent == NULL_NODE) {
+      root = newChild;
+    } else if(nodes[parent].left == oldChild) {
+      nodes[parent].left = newChild;
+    } else {
+      nodes[parent].right = newChild;
+    }
+  }
+
+  /**
+   * Surface area heuristic: descend towards the child where the leaf increases area the least, and stop where making a new parent is cheaper.
+   */
+  void insertLeaf(int leaf) {
+    if(root == NULL_NODE) {
+      root = leaf;
+      nodes[leaf].parent = NULL_NODE;
+      return;
+    }
+
+    Bounds leafBounds = nodes[leaf].bounds;
+    int index = root;
+    while(!nodes[index].isLeaf()) {
+      const Node &node = nodes[index];
+      real area = node.bounds.getSurfaceArea();
+      real combinedArea = node.bounds.merge(leafBounds).getSurfaceArea();
+
+      real cost = 2.0 * combinedArea; // cost of creating a new parent for this node and the leaf
+      real inheritanceCost = 2.0 * (combinedArea - area); // minimum cost of pushing the leaf further down
+
+      real leftCost = descendCost(node.left, leafBounds) + inheritanceCost;
+      real rightCost = descendCost(node.right, leafBounds) + inheritanceCost;
+
+      if(cost < leftCost && cost < rightCost) {
+        break;
+      }
+
+      index = leftCost < rightCost ? node.left : node.right;
+    }
+
+    int sibling = index;
+    int oldParent = nodes[sibling].parent;
+    int newParent = allocateNode();
+    nodes[newParent].parent = oldParent;
+    nodes[newParent].bounds = leafBounds.merge(nodes[sibling].bounds);
+    nodes[newParent].height = nodes[sibling].height + 1;
+    nodes[newParent].left = sibling;
+    nodes[newParent].right = leaf;
+    nodes[sibling].parent = newParent;
+    nodes[leaf].parent = newParent;
+    replaceChild(oldParent, sibling, newParent);
+
+    refit(nodes[leaf].parent);
+  }
+
+  real descendCost(int child, const Bounds &leafBounds) const {
+    real combinedArea = leafBounds.merge(nodes[child].bounds).getSurfaceArea();
+    return nodes[child].isLeaf() ? combinedArea : combinedArea - nodes[child].bounds.getSurfaceArea();
+  }
+
+  void removeLeaf(int leaf) {
+    if(leaf == root) {
+      root = NULL_NODE;
+      return;
+    }
+
+    int parent = nodes[leaf].parent;
+    int grandParent = nodes[parent].parent;
+    int sibling = nodes[parent].left == leaf ? nodes[parent].right : nodes[parent].left;
+
+    replaceChild(grandParent, parent, sibling);
+    nodes[sibling].parent = grandParent;
+    freeNode(parent);
+
+    refit(grandParent);
+  }
+
+  /**
+   * Walks up to the root rebalancing and refreshing bounds and heights.
+   */
+  void refit(int index) {
+    while(index != NULL_NODE) {
+      index = balance(index);
+
+      Node &node = nodes[index];
+      node.height = 1 + std::max(nodes[node.left].height, nodes[node.right].height);
+      node.bounds = nodes[node.left].bounds.merge(nodes[node.right].bounds);
+
+      index = node.parent;
+    }
+  }
+
+  /**
+   * If the subtree at a is unbalanced, rotates its higher child up and returns the new subtree root.
+   */
+  int balance(int a) {
+    if(nodes[a].isLeaf() || nodes[a].height < 2) {
+      return a;
+    }
+
+    int b = nodes[a].left;
+    int c = nodes[a].right;
+    int difference = nodes[c].height - nodes[b].height;
+
+    if(difference > 1) {
+      return rotateUp(a, c, b, false);
+    }
+
+    if(difference < -1) {
+      return rotateUp(a, b, c, true);
+    }
+
+    return a;
+  }
+
+  /**
+   * Rotates child up to take a's place. a keeps sibling and takes the lower grandchild, child keeps a and the higher grandchild.
+   */
+  int rotateUp(int a, int child, int sibling, bool childIsLeft) {
+    int f = nodes[child].left;
+    int g = nodes[child].right;
+
+    nodes[child].left = a;
+    nodes[child].parent = nodes[a].parent;
+    nodes[a].parent = child;
+    replaceChild(nodes[child].parent, a, child);
+
+    int higher = nodes[f].height > nodes[g].height ? f : g;
+    int lower = higher == f ? g : f;
+
+    nodes[child].right = higher;
+    if(childIsLeft) {
+      nodes[a].left = lower;
+    } else {
+      nodes[a].right = lower;
+    }
+    nodes[lower].parent = a;
+
+    nodes[a].bounds = nodes[sibling].bounds.merge(nodes[lower].bounds);
+    nodes[a].height = 1 + std::max(nodes[sibling].height, nodes[lower].height);
+    nodes[child].bounds = nodes[a].bounds.merge(nodes[higher].bounds);
+    nodes[child].height = 1 + std::max(nodes[a].height, nodes[higher].height);
+
+    return child;
+  }
+
+  /**
+   * Returns subtree height, or -1 if invalid.
+   */
+  int validate(int index) const {
+    const Node &node = nodes[index];
+    if(node.isLeaf()) {
+      return node.height == 0 && node.right == NULL_NODE ? 0 : -1;
+    }
+
+    if(nodes[node.left].parent != index || nodes[node.right].parent != index ||
+        !node.bounds.contains(nodes[node.left].bounds) || !node.bounds.contains(nodes[node.right].bounds)) {
+      return -1;
+    }
+
+    int leftHeight = validate(node.left);
+    int rightHeight = validate(node.right);
+    if(leftHeight < 0 || rightHeight < 0 || node.height != 1 + std::max(leftHeight, rightHeight)) {
+      return -1;
+    }
+
+    return node.height;
+  }
+};
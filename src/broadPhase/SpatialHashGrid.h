@@ -0,0 +1,316 @@
+/*
+ * SpatialHashGrid.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: leandro
+ */
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <Geometry.h>
+#include <IntersectionHelper.h>
+#include "BroadPhasePair.h"
+
+/**
+ * Uniform grid for dense populations of spheres with similar radius (crowds, particles).
+ *
+ * Cells are not allocated: update() packs the integer cell coordinates of each sphere in a single key, z major and x minor, and radix sorts
+ * sphere snapshots by key into a flat array. Each row of cells (same y and z) is then a contiguous, ordered run of the array, so the neighbour cells of a
+ * sphere are found by scanning key ranges, with one cursor per neighbour row moving forward only. Every pass is sequential, which matters more than
+ * the hashing cost for hundreds of thousands of spheres. Arrays only grow, so steady state frames do not allocate.
+ *
+ * The cell size is never smaller than the largest sphere diameter, so intersecting spheres are always in the same or adjacent cells.
+ * Each pair of cells is visited once (own row forward plus 4 forward rows), and candidates are tested with IntersectionHelper::sphereSphere,
+ * the same kernel CollisionTester::sphereSphere uses, so reported pairs match exactly.
+ *
+ * Usage:
+ *    grid.addSphere(&sphere);
+ *    ...
+ *    grid.update();
+ *    grid.getPairs(pairs);
+ *    grid.query(center, radius, spheres);
+ *
+ * Spheres are not owned.
+ */
+class SpatialHashGrid {
+  /**
+   * Per frame snapshot of a sphere
+   */
+  struct Entry {
+    real x;
+    real y;
+    real z;
+    real radius;
+    uint32_t sphere;
+  };
+
+  real cellSize;
+  real effectiveCellSize = 0;
+  real inverseCellSize = 0;
+
+  /**
+   * Cell keys: ((cellZ - minCellZ) << shiftZ) | ((cellY - minCellY) << shiftY) | (cellX - minCellX).
+   * Minimum cells are one less than the occupied minimum, maximum cells one more than the occupied maximum,
+   * so that keys of neighbour cells never wrap into another row.
+   */
+  int32_t minCellX = 0;
+  int32_t minCellY = 0;
+  int32_t minCellZ = 0;
+  int32_t maxCellX = 0;
+  int32_t maxCellY = 0;
+  int32_t maxCellZ = 0;
+  unsigned int shiftY = 0;
+  unsigned int shiftZ = 0;
+
+  std::vector<const Sphere *> spheres;
+
+  /**
+   * Sorted by key
+   */
+  std::vector<uint64_t> keys;
+  std::vector<Entry> entries;
+
+  /**
+   * Scratch arrays for the radix sort
+   */
+  std::vector<Entry> unsortedEntries;
+  std::vector<uint64_t> unsortedKeys;
+  std::vector<uint32_t> sortedIndices;
+  std::vector<uint32_t> scratchIndices;
+  std::vector<uint64_t> scratchKeys;
+public:
+  /**
+   * Cell size defaults to the largest sphere diameter. Larger cells can be given to reduce cells visited by large radius queries.
+   */
+  SpatialHashGrid(real cellSize = 0) {
+    this->cellSize = cellSize;
+  }
+
+  /**
+   * Returns the index of the sphere in this grid
+   */
+  unsigned int addSphere(const Sphere *sphere) {
+    spheres.push_back(sphere);
+    return spheres.size() - 1;
+  }
+
+  void clear() {
+    spheres.clear();
+  }
+
+  unsigned int size() const {
+    return spheres.size();
+  }
+
+  const Sphere *getSphere(unsigned int index) const {
+    return spheres[index];
+  }
+
+  real getCellSize() const {
+    return effectiveCellSize;
+  }
+
+  /**
+   * Rebuilds the grid from current sphere positions and radiuses.
+   */
+  void update() {
+    unsigned int count = spheres.size();
+    unsortedEntries.resize(count);
+    unsortedKeys.resize(count);
+    keys.resize(count);
+    entries.resize(count);
+
+    if(count == 0) {
+      return;
+    }
+
+    // snapshot - sequential pass over spheres
+    real maxRadius = 0;
+    vector mins(REAL_MAX, REAL_MAX, REAL_MAX);
+    vector maxs(-REAL_MAX, -REAL_MAX, -REAL_MAX);
+    for(unsigned int index = 0; index < count; index++) {
+      const Sphere *sphere = spheres[index];
+      const vector &origin = sphere->getOrigin();
+      unsortedEntries[index] = Entry {origin.x, origin.y, origin.z, sphere->getRadius(), index};
+
+      maxRadius = std::max(maxRadius, sphere->getRadius());
+      mins = vector(std::min(mins.x, origin.x), std::min(mins.y, origin.y), std::min(mins.z, origin.z));
+      maxs = vector(std::max(maxs.x, origin.x), std::max(maxs.y, origin.y), std::max(maxs.z, origin.z));
+    }
+
+    effectiveCellSize = std::max(cellSize, 2 * maxRadius);
+    if(effectiveCellSize <= 0) {
+      effectiveCellSize = 1;
+    }
+
+    // keys must fit in 64 bits - coarser cells are still correct, just less selective
+    unsigned int bitsX, bitsY, bitsZ;
+    while(true) {
+      inverseCellSize = 1.0 / effectiveCellSize;
+      minCellX = cellCoordinate(mins.x) - 1;
+      minCellY = cellCoordinate(mins.y) - 1;
+      minCellZ = cellCoordinate(mins.z) - 1;
+      maxCellX = cellCoordinate(maxs.x) + 1;
+      maxCellY = cellCoordinate(maxs.y) + 1;
+      maxCellZ = cellCoordinate(maxs.z) + 1;
+      bitsX = bitsFor((uint64_t)((int64_t)maxCellX - minCellX));
+      bitsY = bitsFor((uint64_t)((int64_t)maxCellY - minCellY));
+      bitsZ = bitsFor((uint64_t)((int64_t)maxCellZ - minCellZ));
+      if(bitsX + bitsY + bitsZ <= 60) {
+        break;
+      }
+      effectiveCellSize *= 2;
+    }
+    shiftY = bitsX;
+    shiftZ = bitsX + bitsY;
+
+    for(unsigned int index = 0; index < count; index++) {
+      const Entry &entry = unsortedEntries[index];
+      unsortedKeys[index] = key(cellCoordinate(entry.x), cellCoordinate(entry.y), cellCoordinate(entry.z));
+    }
+
+    radixSort(bitsX + bitsY + bitsZ);
+
+    // gather
+    for(unsigned int position = 0; position < count; position++) {
+      uint32_t index = sortedIndices[position];
+      keys[position] = unsortedKeys[index];
+      entries[position] = unsortedEntries[index];
+    }
+  }
+
+  /**
+   * Appends every pair of intersecting spheres, as of last update.
+   */
+  void getPairs(std::vector<BroadPhasePair> &pairs) const {
+    // forward rows (dy, dz): every neighbour row not before the own row in key order. Cells x - 1 to x + 1 are scanned in each of them
+    static const int forwardRows[4][2] = {
+        {1, 0}, {-1, 1}, {0, 1}, {1, 1}
+    };
+
+    unsigned int count = entries.size();
+    uint32_t cursors[4] = {0, 0, 0, 0};
+
+    for(uint32_t position = 0; position < count; position++) {
+      const Entry &entry = entries[position];
+      uint64_t entryKey = keys[position];
+
+      // own row: rest of own cell, then cell x + 1
+      for(uint32_t other = position + 1; other < count && keys[other] <= entryKey + 1; other++) {
+        addPairIfIntersecting(entry, entries[other], pairs);
+      }
+
+      for(unsigned int row = 0; row < 4; row++) {
+        uint64_t rowKey = entryKey + ((uint64_t)forwardRows[row][0] << shiftY) + ((uint64_t)forwardRows[row][1] << shiftZ); // unsigned: negative rows wrap around
+
+        // keys only grow along the array, so cursors only move forward
+        uint32_t &cursor = cursors[row];
+        while(cursor < count && keys[cursor] < rowKey - 1) {
+          cursor++;
+        }
+
+        for(uint32_t other = cursor; other < count && keys[other] <= rowKey + 1; other++) {
+          addPairIfIntersecting(entry, entries[other], pairs);
+        }
+      }
+    }
+  }
+
+  /**
+   * Appends the index of every sphere intersecting the sphere at center with given radius, as of last update.
+   */
+  void query(const vector &center, real queryRadius, std::vector<unsigned int> &result) const {
+    if(entries.empty()) {
+      return;
+    }
+
+    // reach covers the query radius plus the largest sphere radius, which is at most half a cell. Cells are clamped to the key range
+    real reach = queryRadius + effectiveCellSize * 0.5;
+    int32_t fromX = clampedCellCoordinate(center.x - reach, minCellX, maxCellX), toX = clampedCellCoordinate(center.x + reach, minCellX, maxCellX);
+    int32_t fromY = clampedCellCoordinate(center.y - reach, minCellY, maxCellY), toY = clampedCellCoordinate(center.y + reach, minCellY, maxCellY);
+    int32_t fromZ = clampedCellCoordinate(center.z - reach, minCellZ, maxCellZ), toZ = clampedCellCoordinate(center.z + reach, minCellZ, maxCellZ);
+
+    for(int32_t cellZ = fromZ; cellZ <= toZ; cellZ++) {
+      for(int32_t cellY = fromY; cellY <= toY; cellY++) {
+        uint64_t lastKey = key(toX, cellY, cellZ);
+        for(auto other = std::lower_bound(keys.begin(), keys.end(), key(fromX, cellY, cellZ)); other != keys.end() && *other <= lastKey; other++) {
+          const Entry &candidate = entries[other - keys.begin()];
+          if(IntersectionHelper::sphereSphere(center, queryRadius, vector(candidate.x, candidate.y, candidate.z), candidate.radius)) {
+            result.push_back(candidate.sphere);
+          }
+        }
+      }
+    }
+  }
+
+  String toString() const {
+    return "SpatialHashGrid(spheres: " + std::to_string(spheres.size()) + ", cellSize: " + std::to_string(effectiveCellSize) + ")";
+  }
+
+protected:
+  void addPairIfIntersecting(const Entry &entry, const Entry &candidate, std::vector<BroadPhasePair> &pairs) const {
+    if(IntersectionHelper::sphereSphere(vector(entry.x, entry.y, entry.z), entry.radius, vector(candidate.x, candidate.y, candidate.z), candidate.radius)) {
+      pairs.emplace_back(spheres[entry.sphere], spheres[candidate.sphere]);
+    }
+  }
+
+  /**
+   * Least significant digit radix sort of unsortedKeys, eight bits per pass, leaving the sorted permutation in sortedIndices. Stable, so equal keys keep sphere order.
+   */
+  void radixSort(unsigned int bits) {
+    unsigned int count = unsortedKeys.size();
+    sortedIndices.resize(count);
+    scratchIndices.resize(count);
+    scratchKeys.resize(count);
+
+    for(unsigned int index = 0; index < count; index++) {
+      sortedIndices[index] = index;
+    }
+    keys = unsortedKeys;
+
+    for(unsigned int shift = 0; shift < bits; shift += 8) {
+      uint32_t offsets[257] = {};
+      for(unsigned int index = 0; index < count; index++) {
+        offsets[((keys[index] >> shift) & 0xFF) + 1]++;
+      }
+      for(unsigned int digit = 0; digit < 256; digit++) {
+        offsets[digit + 1] += offsets[digit];
+      }
+      for(unsigned int index = 0; index < count; index++) {
+        uint32_t target = offsets[(keys[index] >> shift) & 0xFF]++;
+        scratchKeys[target] = keys[index];
+        scratchIndices[target] = sortedIndices[index];
+      }
+      keys.swap(scratchKeys);
+      sortedIndices.swap(scratchIndices);
+    }
+  }
+
+  uint64_t key(int32_t cellX, int32_t cellY, int32_t cellZ) const {
+    return ((uint64_t)(cellZ - minCellZ) << shiftZ) | ((uint64_t)(cellY - minCellY) << shiftY) | (uint64_t)(cellX - minCellX);
+  }
+
+  static unsigned int bitsFor(uint64_t value) {
+    unsigned int bits = 1;
+    while(bits < 64 && (value >> bits) != 0) {
+      bits++;
+    }
+    return bits;
+  }
+
+  int32_t cellCoordinate(real value) const {
+    return (int32_t)std::floor(value * inverseCellSize);
+  }
+
+  /**
+   * Clamps in real space first, so that far away queries do not overflow the integer conversion
+   */
+  int32_t clampedCellCoordinate(real value, int32_t minCell, int32_t maxCell) const {
+    real cell = std::floor(value * inverseCellSize);
+    return cell < minCell ? minCell : (cell > maxCell ? maxCell : (int32_t)cell);
+  }
+};
@@ -0,0 +1,410 @@
+/*
+ * SweepAndPrune.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: leandro
+ */
+
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+#include <Geometry.h>
+#include "BroadPhasePair.h"
+
+/**
+ * Incremental sweep and prune broad phase (a.k.a. sort and sweep).
+ *
+ * Keeps one sorted list of bounds endpoints per axis from frame to frame. When geometries move, their endpoints are moved with insertion sort,
+ * which is close to linear for coherent motion, and overlapping pairs are added or removed as endpoints cross each other. Cost per frame is
+ * proportional to the moved geometries and the endpoints they cross, so mostly static scenes are cheap no matter how many geometries they hold.
+ *
+ * Usage:
+ *    unsigned int proxy = sweepAndPrune.addGeometry(&geometry);
+ *    ...
+ *    geometry.setOrigin(newOrigin);
+ *    sweepAndPrune.updateGeometry(proxy);
+ *    sweepAndPrune.update();
+ *    for(auto &pair : sweepAndPrune.getPairs()) {
+ *      collisionTester.detectCollision(*pair.getGeometryA(), *pair.getGeometryB());
+ *    }
+ *
+ * Bounds are taken from Geometry::getBounds(). Unbounded geometries (planes, lines) get infinite bounds and are paired with everything.
+ * Geometries are not owned and should outlive the sweep and prune, or be removed before being destroyed.
+ */
+class SweepAndPrune {
+  class Endpoint {
+  public:
+    real value;
+    unsigned int proxy;
+    bool isMax;
+
+    Endpoint(real value, unsigned int proxy, bool isMax) : value(value), proxy(proxy), isMax(isMax) {
+    }
+
+    /**
+     * On equal values mins go before maxs, so that touching bounds overlap.
+     */
+    bool operator <(const Endpoint &other) const {
+      return value < other.value || (value == other.value && !isMax && other.isMax);
+    }
+  };
+
+  class Proxy {
+  public:
+    const Geometry *geometry = nullptr;
+    Bounds bounds;
+    unsigned int minIndex[3] = {0, 0, 0};
+    unsigned int maxIndex[3] = {0, 0, 0};
+    bool alive = false;
+    bool moved = false;
+    bool added = false;
+  };
+
+  std::vector<Proxy> proxies;
+  std::vector<unsigned int> freeProxies;
+  std::vector<Endpoint> endpoints[3];
+
+  std::vector<unsigned int> addedProxies;
+  std::vector<unsigned int> movedProxies;
+  std::vector<unsigned int> removedProxies;
+
+  std::unordered_map<uint64_t, unsigned int> pairIndices;
+  std::vector<uint64_t> pairKeys;
+  std::vector<BroadPhasePair> pairs;
+  bool rebuildRequired = true;
+  unsigned int aliveProxies = 0;
+public:
+  /**
+   * Adds a geometry and returns its proxy id. The geometry is inserted on next update.
+   */
+  unsigned int addGeometry(const Geometry *geometry) {
+    unsigned int proxy;
+    if(freeProxies.empty()) {
+      proxy = proxies.size();
+      proxies.emplace_back();
+    } else {
+      proxy = freeProxies.back();
+      freeProxies.pop_back();
+    }
+
+    Proxy &current = proxies[proxy];
+    current.geometry = geometry;
+    current.alive = true;
+    current.moved = false;
+    current.added = true;
+    addedProxies.push_back(proxy);
+    aliveProxies++;
+
+    return proxy;
+  }
+
+  /**
+   * Removes the geometry from the broad phase. The proxy id might be reused by later additions.
+   */
+  void removeGeometry(unsigned int proxy) {
+    Proxy &current = proxies.at(proxy);
+    if(current.alive) {
+      current.alive = false;
+      current.geometry = nullptr;
+      removedProxies.push_back(proxy);
+      aliveProxies--;
+    }
+  }
+
+  /**
+   * Flags the geometry as moved, so that its bounds are refreshed on next update.
+   */
+  void updateGeometry(unsigned int proxy) {
+    Proxy &current = proxies.at(proxy);
+    if(current.alive && !current.moved && !current.added) {
+      current.moved = true;
+      movedProxies.push_back(proxy);
+    }
+  }
+
+  /**
+   * Flags every geometry as moved.
+   */
+  void updateAllGeometries() {
+    for(unsigned int proxy = 0; proxy < proxies.size(); proxy++) {
+      updateGeometry(proxy);
+    }
+  }
+
+  /**
+   * Applies pending additions, removals and moves and refreshes the overlapping pairs.
+   * Large batches of additions (such as the initial load) sort all endpoints from scratch, otherwise endpoints are moved incrementally.
+   */
+  void update() {
+    if(!removedProxies.empty()) {
+      applyRemovals();
+    }
+
+    if(rebuildRequired || addedProxies.size() > aliveProxies / 8) {
+      rebuild();
+    } else {
+      for(unsigned int proxy : addedProxies) {
+        insertProxy(proxy);
+      }
+      addedProxies.clear();
+
+      for(unsigned int proxy : movedProxies) {
+        Proxy &current = proxies[proxy];
+        current.moved = false;
+        if(current.alive) {
+          moveProxy(proxy, current.geometry->getBounds());
+        }
+      }
+      movedProxies.clear();
+    }
+  }
+
+  /**
+   * Overlapping pairs as of last update. Pairs are kept in a flat list updated in place (removals swap with the last pair),
+   * so the order only depends on the sequence of operations and is the same on every run.
+   */
+  const std::vector<BroadPhasePair> &getPairs() const {
+    return pairs;
+  }
+
+  unsigned int getPairCount() const {
+    return pairKeys.size();
+  }
+
+  unsigned int size() const {
+    return aliveProxies;
+  }
+
+  const Geometry *getGeometry(unsigned int proxy) const {
+    return proxies.at(proxy).geometry;
+  }
+
+  const Bounds &getBounds(unsigned int proxy) const {
+    return proxies.at(proxy).bounds;
+  }
+
+  String toString() const {
+    return "SweepAndPrune(geometries: " + std::to_string(aliveProxies) + ", pairs: " + std::to_string(pairs.size()) + ")";
+  }
+
+protected:
+  static uint64_t pairKey(unsigned int proxyA, unsigned int proxyB) {
+    return proxyA < proxyB ? ((uint64_t)proxyA << 32) | proxyB : ((uint64_t)proxyB << 32) | proxyA;
+  }
+
+  static real axisValue(const vector &value, unsigned int axis) {
+    return axis == 0 ? value.x : (axis == 1 ? value.y : value.z);
+  }
+
+  void addPair(unsigned int proxyA, unsigned int proxyB) {
+    if(proxyA != proxyB && proxies[proxyA].bounds.overlaps(proxies[proxyB].bounds)) {
+      uint64_t key = pairKey(proxyA, proxyB);
+      if(pairIndices.emplace(key, pairKeys.size()).second) {
+        pairKeys.push_back(key);
+        pairs.emplace_back(proxies[(unsigned int)(key >> 32)].geometry, proxies[(unsigned int)(key & 0xffffffff)].geometry);
+      }
+    }
+  }
+
+  void removePair(unsigned int proxyA, unsigned int proxyB) {
+    auto iterator = pairIndices.find(pairKey(proxyA, proxyB));
+    if(iterator != pairIndices.end()) {
+      removePairAt(iterator->second);
+      pairIndices.erase(iterator);
+    }
+  }
+
+  void removePairAt(unsigned int index) {
+    unsigned int last = pairKeys.size() - 1;
+    if(index != last) {
+      pairKeys[index] = pairKeys[last];
+      pairs[index] = pairs[last];
+      pairIndices[pairKeys[index]] = index;
+    }
+    pairKeys.pop_back();
+    pairs.pop_back();
+  }
+
+  void setEndpointIndex(const Endpoint &endpoint, unsigned int axis, unsigned int index) {
+    if(endpoint.isMax) {
+      proxies[endpoint.proxy].maxIndex[axis] = index;
+    } else {
+      proxies[endpoint.proxy].minIndex[axis] = index;
+    }
+  }
+
+  /**
+   * Insertion sort step towards lower values. A min crossing a max means bounds might start overlapping, a max crossing a min means they stopped overlapping.
+   */
+  void sortDown(unsigned int axis, unsigned int index) {
+    std::vector<Endpoint> &axisEndpoints = endpoints[axis];
+    Endpoint endpoint = axisEndpoints[index];
+
+    while(index > 0 && endpoint < axisEndpoints[index - 1]) {
+      const Endpoint &previous = axisEndpoints[index - 1];
+      if(!endpoint.isMax && previous.isMax) {
+        addPair(endpoint.proxy, previous.proxy);
+      } else if(endpoint.isMax && !previous.isMax) {
+        removePair(endpoint.proxy, previous.proxy);
+      }
+
+      axisEndpoints[index] = previous;
+      setEndpointIndex(previous, axis, index);
+      index--;
+    }
+
+    axisEndpoints[index] = endpoint;
+    setEndpointIndex(endpoint, axis, index);
+  }
+
+  /**
+   * Insertion sort step towards higher values. A max crossing a min means bounds might start overlapping, a min crossing a max means they stopped overlapping.
+   */
+  void sortUp(unsigned int axis, unsigned int index) {
+    std::vector<Endpoint> &axisEndpoints = endpoints[axis];
+    Endpoint endpoint = axisEndpoints[index];
+    unsigned int last = axisEndpoints.size() - 1;
+
+    while(index < last && axisEndpoints[index + 1] < endpoint) {
+      const Endpoint &next = axisEndpoints[index + 1];
+      if(endpoint.isMax && !next.isMax) {
+        addPair(endpoint.proxy, next.proxy);
+      } else if(!endpoint.isMax && next.isMax) {
+        removePair(endpoint.proxy, next.proxy);
+      }
+
+      axisEndpoints[index] = next;
+      setEndpointIndex(next, axis, index);
+      index++;
+    }
+
+    axisEndpoints[index] = endpoint;
+    setEndpointIndex(endpoint, axis, index);
+  }
+
+  /**
+   * Updates endpoints of a proxy already in the lists. Bounds are updated first so that pair checks triggered while sorting see the final bounds.
+   */
+  void moveProxy(unsigned int proxy, const Bounds &bounds) {
+    proxies[proxy].bounds = bounds;
+
+    for(unsigned int axis = 0; axis < 3; axis++) {
+      Proxy &current = proxies[proxy];
+      endpoints[axis][current.minIndex[axis]].value = axisValue(bounds.mins, axis);
+      endpoints[axis][current.maxIndex[axis]].value = axisValue(bounds.maxs, axis);
+
+      sortDown(axis, current.minIndex[axis]);
+      sortDown(axis, current.maxIndex[axis]);
+      sortUp(axis, current.maxIndex[axis]);
+      sortUp(axis, current.minIndex[axis]);
+    }
+  }
+
+  /**
+   * Appends the proxy endpoints at the end of the lists and sorts them down into place, which discovers its overlapping pairs.
+   */
+  void insertProxy(unsigned int proxy) {
+    Proxy &current = proxies[proxy];
+    current.added = false;
+    if(!current.alive) {
+      return;
+    }
+
+    current.bounds = current.geometry->getBounds();
+    for(unsigned int axis = 0; axis < 3; axis++) {
+      endpoints[axis].emplace_back(axisValue(current.bounds.mins, axis), proxy, false);
+      current.minIndex[axis] = endpoints[axis].size() - 1;
+      endpoints[axis].emplace_back(axisValue(current.bounds.maxs, axis), proxy, true);
+      current.maxIndex[axis] = endpoints[axis].size() - 1;
+
+      sortDown(axis, current.minIndex[axis]);
+      sortDown(axis, current.maxIndex[axis]);
+    }
+  }
+
+  void applyRemovals() {
+    for(unsigned int axis = 0; axis < 3; axis++) {
+      std::vector<Endpoint> &axisEndpoints = endpoints[axis];
+      axisEndpoints.erase(std::remove_if(axisEndpoints.begin(), axisEndpoints.end(), [this](const Endpoint &endpoint) {
+        return !proxies[endpoint.proxy].alive;
+      }), axisEndpoints.end());
+
+      for(unsigned int index = 0; index < axisEndpoints.size(); index++) {
+        setEndpointIndex(axisEndpoints[index], axis, index);
+      }
+    }
+
+    for(unsigned int index = 0; index < pairKeys.size(); ) {
+      uint64_t key = pairKeys[index];
+      if(!proxies[(unsigned int)(key >> 32)].alive || !proxies[(unsigned int)(key & 0xffffffff)].alive) {
+        pairIndices.erase(key);
+        removePairAt(index);
+      } else {
+        index++;
+      }
+    }
+
+    for(unsigned int proxy : removedProxies) {
+      proxies[proxy].moved = false;
+      freeProxies.push_back(proxy);
+    }
+    removedProxies.clear();
+  }
+
+  /**
+   * Sorts all endpoints from scratch and finds overlapping pairs sweeping the x axis.
+   */
+  void rebuild() {
+    std::vector<unsigned int> active;
+    std::vector<unsigned int> activeIndex(proxies.size());
+
+    for(unsigned int axis = 0; axis < 3; axis++) {
+      endpoints[axis].clear();
+    }
+
+    for(unsigned int proxy = 0; proxy < proxies.size(); proxy++) {
+      Proxy &current = proxies[proxy];
+      current.added = false;
+      current.moved = false;
+      if(current.alive) {
+        current.bounds = current.geometry->getBounds();
+        for(unsigned int axis = 0; axis < 3; axis++) {
+          endpoints[axis].emplace_back(axisValue(current.bounds.mins, axis), proxy, false);
+          endpoints[axis].emplace_back(axisValue(current.bounds.maxs, axis), proxy, true);
+        }
+      }
+    }
+
+    for(unsigned int axis = 0; axis < 3; axis++) {
+      std::sort(endpoints[axis].begin(), endpoints[axis].end());
+      for(unsigned int index = 0; index < endpoints[axis].size(); index++) {
+        setEndpointIndex(endpoints[axis][index], axis, index);
+      }
+    }
+
+    pairIndices.clear();
+    pairKeys.clear();
+    pairs.clear();
+    for(const Endpoint &endpoint : endpoints[0]) {
+      if(endpoint.isMax) {
+        unsigned int position = activeIndex[endpoint.proxy];
+        active[position] = active.back();
+        activeIndex[active[position]] = position;
+        active.pop_back();
+      } else {
+        for(unsigned int other : active) {
+          addPair(endpoint.proxy, other);
+        }
+        activeIndex[endpoint.proxy] = active.size();
+        active.push_back(endpoint.proxy);
+      }
+    }
+
+    addedProxies.clear();
+    movedProxies.clear();
+    rebuildRequired = false;
+  }
+};
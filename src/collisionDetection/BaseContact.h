@@ -7,17 +7,24 @@
 
 #pragma once
 #include<Math3d.h>
+#include<Vector3.h>
+
+/**
+ * Contact data on scalar T - BaseContact is BasicContact<real>
+ */
+template<typename T> class BasicContact {
+public:
+  typedef typename ScalarVector<T>::type vector;
 
-class BaseContact {
 protected:
   vector normal;
   vector intersection;
-  real penetration {0};
-  real restitution {0};
+  T penetration {0};
+  T restitution {0};
 
 public:
-  BaseContact(const vector &intersection, const vector &normal,
-      real restitution, real penetration = 0.0) {
+  BasicContact(const vector &intersection, const vector &normal,
+      T restitution, T penetration = 0.0) {
     this->intersection = intersection;
     this->normal = normal;
     this->penetration = penetration;
@@ -32,11 +39,11 @@ public:
     return this->intersection;
   }
 
-  real getPenetration() const {
+  T getPenetration() const {
     return this->penetration;
   }
 
-  real getRestitution() const {
+  T getRestitution() const {
     return this->restitution;
   }
 
@@ -44,3 +51,5 @@ public:
     return this->penetration >= 0.0;
   }
 };
+
+typedef BasicContact<real> BaseContact;
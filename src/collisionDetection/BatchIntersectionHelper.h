@@ -0,0 +1,297 @@
+/*
+ * BatchIntersectionHelper.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: leandro
+ */
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <limits>
+#include <Geometry.h>
+#include <GeometryBatch.h>
+#include "SimdLanes.h"
+#include "IntersectionHelper.h"
+
+/**
+ * Intersection kernels testing one shape against a batch, or a batch against another batch pair by pair (element i against element i),
+ * SimdLanes<T>::width shapes at a time, where T is the scalar type of the batch. Trailing shapes that do not fill a register are tested with the same code on scalar lanes.
+ * Shapes given as reals are converted to T the same way batches convert them (see BatchScalar), so real queries can be run against float batches.
+ *
+ * Results are either:
+ *    std::vector<uint64_t>: bitmask, resized to the batch - bit (i % 64) of word (i / 64) is set when shape i intersects
+ *    std::vector<unsigned int>: indices of intersecting shapes are appended, in increasing order
+ *
+ * Math matches IntersectionHelper::sphereSphere, IntersectionHelper::sphereAabb, IntersectionHelper::sphereHeightmap and IntersectionHelper::lineAabb (used by CollisionTester) operation by operation,
+ * so batch and one by one results are the same for batches of reals.
+ */
+class BatchIntersectionHelper {
+public:
+  template<typename T, typename Result> static void sphereSphere(const vector &origin, real radius, const BasicSphereBatch<T> &batch, Result &result) {
+    T x, y, z, batchRadius;
+    BatchScalar<T>::sphere(origin, radius, x, y, z, batchRadius);
+
+    run<T>(batch.size(), result, [&](auto lanes, unsigned int index) {
+      typedef decltype(lanes) Lanes;
+      return sphereSphereLanes<Lanes>(Lanes::broadcast(x), Lanes::broadcast(y), Lanes::broadcast(z), Lanes::broadcast(batchRadius),
+          Lanes::load(batch.getX() + index), Lanes::load(batch.getY() + index), Lanes::load(batch.getZ() + index), Lanes::load(batch.getRadiuses() + index));
+    });
+  }
+
+  template<typename T, typename Result> static void sphereSphere(const Sphere &sphere, const BasicSphereBatch<T> &batch, Result &result) {
+    sphereSphere(sphere.getOrigin(), sphere.getRadius(), batch, result);
+  }
+
+  /**
+   * Pair by pair - tests batch[i] against anotherBatch[i], up to the smallest batch size
+   */
+  template<typename T, typename Result> static void sphereSphere(const BasicSphereBatch<T> &batch, const BasicSphereBatch<T> &anotherBatch, Result &result) {
+    run<T>(std::min(batch.size(), anotherBatch.size()), result, [&](auto lanes, unsigned int index) {
+      typedef decltype(lanes) Lanes;
+      return sphereSphereLanes<Lanes>(Lanes::load(batch.getX() + index), Lanes::load(batch.getY() + index), Lanes::load(batch.getZ() + index), Lanes::load(batch.getRadiuses() + index),
+          Lanes::load(anotherBatch.getX() + index), Lanes::load(anotherBatch.getY() + index), Lanes::load(anotherBatch.getZ() + index), Lanes::load(anotherBatch.getRadiuses() + index));
+    });
+  }
+
+  template<typename T, typename Result> static void sphereAabb(const vector &origin, real radius, const BasicAabbBatch<T> &batch, Result &result) {
+    T x, y, z, batchRadius;
+    BatchScalar<T>::sphere(origin, radius, x, y, z, batchRadius);
+
+    run<T>(batch.size(), result, [&](auto lanes, unsigned int index) {
+      typedef decltype(lanes) Lanes;
+      return sphereAabbLanes<Lanes>(Lanes::broadcast(x), Lanes::broadcast(y), Lanes::broadcast(z), Lanes::broadcast(batchRadius),
+          Lanes::load(batch.getMinX() + index), Lanes::load(batch.getMinY() + index), Lanes::load(batch.getMinZ() + index),
+          Lanes::load(batch.getMaxX() + index), Lanes::load(batch.getMaxY() + index), Lanes::load(batch.getMaxZ() + index));
+    });
+  }
+
+  template<typename T, typename Result> static void sphereAabb(const Sphere &sphere, const BasicAabbBatch<T> &batch, Result &result) {
+    sphereAabb(sphere.getOrigin(), sphere.getRadius(), batch, result);
+  }
+
+  /**
+   * Every sphere in the batch against one aabb
+   */
+  template<typename T, typename Result> static void sphereAabb(const BasicSphereBatch<T> &batch, const AABB &aabb, Result &result) {
+    vector mins(aabb.getMins());
+    vector maxs(aabb.getMaxs());
+
+    run<T>(batch.size(), result, [&](auto lanes, unsigned int index) {
+      typedef decltype(lanes) Lanes;
+      return sphereAabbLanes<Lanes>(Lanes::load(batch.getX() + index), Lanes::load(batch.getY() + index), Lanes::load(batch.getZ() + index), Lanes::load(batch.getRadiuses() + index),
+          Lanes::broadcast(BatchScalar<T>::down(mins.x)), Lanes::broadcast(BatchScalar<T>::down(mins.y)), Lanes::broadcast(BatchScalar<T>::down(mins.z)),
+          Lanes::broadcast(BatchScalar<T>::up(maxs.x)), Lanes::broadcast(BatchScalar<T>::up(maxs.y)), Lanes::broadcast(BatchScalar<T>::up(maxs.z)));
+    });
+  }
+
+  /**
+   * Pair by pair - tests batch[i] against aabbs[i], up to the smallest batch size
+   */
+  template<typename T, typename Result> static void sphereAabb(const BasicSphereBatch<T> &batch, const BasicAabbBatch<T> &aabbs, Result &result) {
+    run<T>(std::min(batch.size(), aabbs.size()), result, [&](auto lanes, unsigned int index) {
+      typedef decltype(lanes) Lanes;
+      return sphereAabbLanes<Lanes>(Lanes::load(batch.getX() + index), Lanes::load(batch.getY() + index), Lanes::load(batch.getZ() + index), Lanes::load(batch.getRadiuses() + index),
+          Lanes::load(aabbs.getMinX() + index), Lanes::load(aabbs.getMinY() + index), Lanes::load(aabbs.getMinZ() + index),
+          Lanes::load(aabbs.getMaxX() + index), Lanes::load(aabbs.getMaxY() + index), Lanes::load(aabbs.getMaxZ() + index));
+    });
+  }
+
+  /**
+   * Every sphere in the batch against a height map - same test as IntersectionHelper::sphereHeightmap.
+   * GridHeightMaps are tested sphere by sphere against the closest surface point, through the min-max pyramid. Other height maps are tested against
+   * the surface point below the closest point of the height map bounds, with heights sampled a block at a time through HeightMapGeometry::heightsAt
+   * instead of a virtual heightAt call per sphere.
+   */
+  template<typename T, typename Result> static void sphereHeightmap(const BasicSphereBatch<T> &batch, const HeightMapGeometry &heightmap, Result &result) {
+    if(heightmap.getGridHeightMap() != nullptr) {
+      prepare(result, batch.size());
+      for(unsigned int index = 0; index < batch.size(); index++) {
+        append(result, index, IntersectionHelper::sphereHeightmap(batch.getOrigin(index), batch.getRadius(index), heightmap) ? 1 : 0, 1);
+      }
+      return;
+    }
+
+    constexpr unsigned int blockSize = 64;
+    real x[blockSize];
+    real z[blockSize];
+    real heights[blockSize];
+    vector mins(heightmap.getMins());
+    vector maxs(heightmap.getMaxs());
+
+    prepare(result, batch.size());
+
+    for(unsigned int begin = 0; begin < batch.size(); begin += blockSize) {
+      unsigned int size = std::min(blockSize, batch.size() - begin);
+      const T *sphereX = batch.getX() + begin;
+      const T *sphereY = batch.getY() + begin;
+      const T *sphereZ = batch.getZ() + begin;
+      const T *radius = batch.getRadiuses() + begin;
+
+      for(unsigned int index = 0; index < size; index++) {
+        x[index] = std::max(mins.x, std::min((real)sphereX[index], maxs.x));
+        z[index] = std::max(mins.z, std::min((real)sphereZ[index], maxs.z));
+      }
+
+      heightmap.heightsAt(x, z, size, heights);
+
+      for(unsigned int index = 0; index < size; index++) {
+        real deltaX = sphereX[index] - x[index];
+        real deltaY = sphereY[index] - heights[index];
+        real deltaZ = sphereZ[index] - z[index];
+        append(result, begin + index, deltaX * deltaX + deltaY * deltaY + deltaZ * deltaZ <= (real)radius[index] * (real)radius[index] ? 1 : 0, 1);
+      }
+    }
+  }
+
+  /**
+   * One ray against every aabb in the batch
+   */
+  template<typename T, typename Result> static void lineAabb(const Line &line, const BasicAabbBatch<T> &batch, Result &result) {
+    lineAabbWithEntries(line, batch, result, (T *)nullptr);
+  }
+
+  /**
+   * Same, also writing the entry t of every aabb to tEnters (resized to the batch) - for picking, the closest hit is the smallest tEnter among hits.
+   * As in IntersectionHelper::lineAabb, tEnter is negative for aabbs containing the ray origin.
+   */
+  template<typename T, typename Result> static void lineAabb(const Line &line, const BasicAabbBatch<T> &batch, Result &result, std::vector<T> &tEnters) {
+    tEnters.resize(batch.size());
+    lineAabbWithEntries(line, batch, result, tEnters.data());
+  }
+
+  /**
+   * Every ray in the batch (or packet) against one aabb
+   */
+  template<typename T, typename Result> static void lineAabb(const BasicRayBatch<T> &rays, const AABB &aabb, Result &result) {
+    vector mins(aabb.getMins());
+    vector maxs(aabb.getMaxs());
+
+    run<T>(rays.size(), result, [&](auto lanes, unsigned int index) {
+      typedef decltype(lanes) Lanes;
+      typename Lanes::Register tEnter;
+      return lineAabbLanes<Lanes>(Lanes::load(rays.getOriginX() + index), Lanes::load(rays.getOriginY() + index), Lanes::load(rays.getOriginZ() + index),
+          Lanes::load(rays.getInverseDirectionX() + index), Lanes::load(rays.getInverseDirectionY() + index), Lanes::load(rays.getInverseDirectionZ() + index),
+          Lanes::broadcast(BatchScalar<T>::down(mins.x)), Lanes::broadcast(BatchScalar<T>::down(mins.y)), Lanes::broadcast(BatchScalar<T>::down(mins.z)),
+          Lanes::broadcast(BatchScalar<T>::up(maxs.x)), Lanes::broadcast(BatchScalar<T>::up(maxs.y)), Lanes::broadcast(BatchScalar<T>::up(maxs.z)), tEnter);
+    });
+  }
+
+protected:
+  template<typename T, typename Result> static void lineAabbWithEntries(const Line &line, const BasicAabbBatch<T> &batch, Result &result, T *tEnters) {
+    const vector &origin = line.getOrigin();
+    const vector &inverseDirection = line.getInverseDirection();
+
+    run<T>(batch.size(), result, [&](auto lanes, unsigned int index) {
+      typedef decltype(lanes) Lanes;
+      typename Lanes::Register tEnter;
+      unsigned int bits = lineAabbLanes<Lanes>(Lanes::broadcast(BatchScalar<T>::nearest(origin.x)), Lanes::broadcast(BatchScalar<T>::nearest(origin.y)), Lanes::broadcast(BatchScalar<T>::nearest(origin.z)),
+          Lanes::broadcast(BatchScalar<T>::nearest(inverseDirection.x)), Lanes::broadcast(BatchScalar<T>::nearest(inverseDirection.y)), Lanes::broadcast(BatchScalar<T>::nearest(inverseDirection.z)),
+          Lanes::load(batch.getMinX() + index), Lanes::load(batch.getMinY() + index), Lanes::load(batch.getMinZ() + index),
+          Lanes::load(batch.getMaxX() + index), Lanes::load(batch.getMaxY() + index), Lanes::load(batch.getMaxZ() + index), tEnter);
+      if(tEnters != nullptr) {
+        Lanes::store(tEnters + index, tEnter);
+      }
+      return bits;
+    });
+  }
+
+  /**
+   * Same as IntersectionHelper::lineAabb slab test, operation by operation
+   */
+  template<typename Lanes> static unsigned int lineAabbLanes(typename Lanes::Register originX, typename Lanes::Register originY, typename Lanes::Register originZ,
+      typename Lanes::Register inverseDirectionX, typename Lanes::Register inverseDirectionY, typename Lanes::Register inverseDirectionZ,
+      typename Lanes::Register minX, typename Lanes::Register minY, typename Lanes::Register minZ,
+      typename Lanes::Register maxX, typename Lanes::Register maxY, typename Lanes::Register maxZ, typename Lanes::Register &tEnter) {
+    tEnter = Lanes::broadcast(-std::numeric_limits<typename Lanes::Scalar>::infinity());
+    typename Lanes::Register tExit = Lanes::broadcast(std::numeric_limits<typename Lanes::Scalar>::infinity());
+
+    clipSlab<Lanes>(originX, inverseDirectionX, minX, maxX, tEnter, tExit);
+    clipSlab<Lanes>(originY, inverseDirectionY, minY, maxY, tEnter, tExit);
+    clipSlab<Lanes>(originZ, inverseDirectionZ, minZ, maxZ, tEnter, tExit);
+
+    return Lanes::lessEqual(Lanes::max(tEnter, Lanes::broadcast(0)), tExit);
+  }
+
+  /**
+   * Same as IntersectionHelper::clipSlab - relies on min / max returning the first operand when comparing against NaN
+   */
+  template<typename Lanes> static void clipSlab(typename Lanes::Register origin, typename Lanes::Register inverseDirection,
+      typename Lanes::Register min, typename Lanes::Register max, typename Lanes::Register &tEnter, typename Lanes::Register &tExit) {
+    typename Lanes::Register t1 = Lanes::mul(Lanes::sub(min, origin), inverseDirection);
+    typename Lanes::Register t2 = Lanes::mul(Lanes::sub(max, origin), inverseDirection);
+    tEnter = Lanes::max(tEnter, Lanes::min(t1, Lanes::max(Lanes::broadcast(-std::numeric_limits<typename Lanes::Scalar>::infinity()), t2)));
+    tExit = Lanes::min(tExit, Lanes::max(t1, Lanes::min(Lanes::broadcast(std::numeric_limits<typename Lanes::Scalar>::infinity()), t2)));
+  }
+
+  /**
+   * Same as IntersectionHelper::sphereSphere: |origin - anotherOrigin|^2 <= (radius + anotherRadius)^2
+   */
+  template<typename Lanes> static unsigned int sphereSphereLanes(typename Lanes::Register x, typename Lanes::Register y, typename Lanes::Register z, typename Lanes::Register radius,
+      typename Lanes::Register anotherX, typename Lanes::Register anotherY, typename Lanes::Register anotherZ, typename Lanes::Register anotherRadius) {
+    typename Lanes::Register deltaX = Lanes::sub(x, anotherX);
+    typename Lanes::Register deltaY = Lanes::sub(y, anotherY);
+    typename Lanes::Register deltaZ = Lanes::sub(z, anotherZ);
+    typename Lanes::Register radiuses = Lanes::add(radius, anotherRadius);
+
+    return Lanes::lessEqual(squaredLength<Lanes>(deltaX, deltaY, deltaZ), Lanes::mul(radiuses, radiuses));
+  }
+
+  /**
+   * Same as IntersectionHelper::sphereAabb: the sphere contains the aabb point closest to its origin
+   */
+  template<typename Lanes> static unsigned int sphereAabbLanes(typename Lanes::Register x, typename Lanes::Register y, typename Lanes::Register z, typename Lanes::Register radius,
+      typename Lanes::Register minX, typename Lanes::Register minY, typename Lanes::Register minZ,
+      typename Lanes::Register maxX, typename Lanes::Register maxY, typename Lanes::Register maxZ) {
+    typename Lanes::Register deltaX = Lanes::sub(x, Lanes::max(minX, Lanes::min(x, maxX)));
+    typename Lanes::Register deltaY = Lanes::sub(y, Lanes::max(minY, Lanes::min(y, maxY)));
+    typename Lanes::Register deltaZ = Lanes::sub(z, Lanes::max(minZ, Lanes::min(z, maxZ)));
+
+    return Lanes::lessEqual(squaredLength<Lanes>(deltaX, deltaY, deltaZ), Lanes::mul(radius, radius));
+  }
+
+  /**
+   * Same evaluation order as vector * vector
+   */
+  template<typename Lanes> static typename Lanes::Register squaredLength(typename Lanes::Register x, typename Lanes::Register y, typename Lanes::Register z) {
+    return Lanes::add(Lanes::add(Lanes::mul(x, x), Lanes::mul(y, y)), Lanes::mul(z, z));
+  }
+
+  /**
+   * Full registers first, then the remaining shapes one by one. Full registers start at multiples of the width, which divides 64,
+   * so lane bits never straddle mask words.
+   */
+  template<typename T, typename Result, typename Block> static void run(unsigned int count, Result &result, const Block &block) {
+    typedef SimdLanes<T> Lanes;
+
+    prepare(result, count);
+
+    unsigned int index = 0;
+    for(; index + Lanes::width <= count; index += Lanes::width) {
+      append(result, index, block(Lanes(), index), Lanes::width);
+    }
+    for(; index < count; index++) {
+      append(result, index, block(ScalarLanes<T>(), index), 1);
+    }
+  }
+
+  static void prepare(std::vector<uint64_t> &mask, unsigned int count) {
+    mask.assign((count + 63) / 64, 0);
+  }
+
+  static void prepare(std::vector<unsigned int> &indices, unsigned int count) {
+  }
+
+  static void append(std::vector<uint64_t> &mask, unsigned int index, unsigned int bits, unsigned int width) {
+    mask[index / 64] |= (uint64_t)bits << (index % 64);
+  }
+
+  static void append(std::vector<unsigned int> &indices, unsigned int index, unsigned int bits, unsigned int width) {
+    for(unsigned int lane = 0; bits != 0 && lane < width; lane++, bits >>= 1) {
+      if(bits & 1) {
+        indices.push_back(index + lane);
+      }
+    }
+  }
+};
@@ -0,0 +1,250 @@
+/*
+ * CollisionStats.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: leandro
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <Geometry.h>
+
+enum class CollisionOperation {
+  INTERSECTION,
+  CONTACT
+};
+
+constexpr unsigned int COLLISION_OPERATION_COUNT = (unsigned int)CollisionOperation::CONTACT + 1;
+
+/**
+ * Counters of a single (operation, typeOp1, typeOp2) dispatch entry.
+ * Time is inclusive: nested dispatches, like the children of a hierarchy, are also accounted in the call that dispatched them.
+ */
+struct CollisionPairStats {
+  unsigned long long calls = 0;
+  unsigned long long hits = 0;         // intersections that returned true, or contact tests that added at least one contact
+  unsigned long long swapped = 0;      // calls resolved through the reverse (typeOp2, typeOp1) entry
+  unsigned long long unsupported = 0;  // calls with no test registered for the pair
+  unsigned long long nanoseconds = 0;
+
+  CollisionPairStats &operator+=(const CollisionPairStats &other) {
+    calls += other.calls;
+    hits += other.hits;
+    swapped += other.swapped;
+    unsupported += other.unsupported;
+    nanoseconds += other.nanoseconds;
+    return *this;
+  }
+
+  CollisionPairStats operator-(const CollisionPairStats &other) const {
+    CollisionPairStats result;
+    result.calls = calls - other.calls;
+    result.hits = hits - other.hits;
+    result.swapped = swapped - other.swapped;
+    result.unsupported = unsupported - other.unsupported;
+    result.nanoseconds = nanoseconds - other.nanoseconds;
+    return result;
+  }
+};
+
+/**
+ * Merged counters at a point in time. Subtracting a previous snapshot gives the activity in between, e.g. for a report dumped once per second.
+ */
+class CollisionStatsSnapshot {
+  CollisionPairStats pairs[COLLISION_OPERATION_COUNT][GEOMETRY_TYPE_COUNT][GEOMETRY_TYPE_COUNT];
+public:
+  const CollisionPairStats &get(CollisionOperation operation, GeometryType typeOp1, GeometryType typeOp2) const {
+    return pairs[(unsigned int)operation][(unsigned int)typeOp1][(unsigned int)typeOp2];
+  }
+
+  CollisionPairStats &get(CollisionOperation operation, GeometryType typeOp1, GeometryType typeOp2) {
+    return pairs[(unsigned int)operation][(unsigned int)typeOp1][(unsigned int)typeOp2];
+  }
+
+  CollisionPairStats total(CollisionOperation operation) const {
+    CollisionPairStats result;
+    for(unsigned int typeOp1 = 0; typeOp1 < GEOMETRY_TYPE_COUNT; typeOp1++) {
+      for(unsigned int typeOp2 = 0; typeOp2 < GEOMETRY_TYPE_COUNT; typeOp2++) {
+        result += pairs[(unsigned int)operation][typeOp1][typeOp2];
+      }
+    }
+    return result;
+  }
+
+  CollisionStatsSnapshot operator-(const CollisionStatsSnapshot &other) const {
+    CollisionStatsSnapshot result;
+    for(unsigned int operation = 0; operation < COLLISION_OPERATION_COUNT; operation++) {
+      for(unsigned int typeOp1 = 0; typeOp1 < GEOMETRY_TYPE_COUNT; typeOp1++) {
+        for(unsigned int typeOp2 = 0; typeOp2 < GEOMETRY_TYPE_COUNT; typeOp2++) {
+          result.pairs[operation][typeOp1][typeOp2] = pairs[operation][typeOp1][typeOp2] - other.pairs[operation][typeOp1][typeOp2];
+        }
+      }
+    }
+    return result;
+  }
+};
+
+/**
+ * Per pair dispatch counters, kept per thread so that recording never contends: each thread only writes its own block, with relaxed
+ * load / store instead of read-modify-write, and snapshot() sums every block with relaxed loads. Blocks are linked into a lock free list
+ * the first time a thread records, and live as long as the stats object so counts of finished threads are kept.
+ * Thread safe, shared by copies of a tester.
+ */
+class CollisionStats {
+  struct Counters {
+    std::atomic<unsigned long long> calls { 0 };
+    std::atomic<unsigned long long> hits { 0 };
+    std::atomic<unsigned long long> swapped { 0 };
+    std::atomic<unsigned long long> unsupported { 0 };
+    std::atomic<unsigned long long> nanoseconds { 0 };
+  };
+
+  struct Block {
+    Counters pairs[COLLISION_OPERATION_COUNT][GEOMETRY_TYPE_COUNT][GEOMETRY_TYPE_COUNT];
+    std::thread::id owner;
+    Block *next = nullptr;
+  };
+
+  /**
+   * Per thread lookup of the block of the most recently used stats objects. Keyed by a unique id rather than by address, so a stats object
+   * allocated where a destroyed one used to be never picks up its stale block.
+   */
+  struct ThreadCache {
+    static constexpr unsigned int size = 4;
+    unsigned long long ids[size] = { 0 };
+    Block *blocks[size] = { nullptr };
+    unsigned int next = 0;
+  };
+
+  static std::atomic<unsigned long long> &lastId() {
+    static std::atomic<unsigned long long> id { 0 };
+    return id;
+  }
+
+  const unsigned long long id;
+  std::atomic<Block *> blocks { nullptr };
+
+public:
+  /**
+   * Records the time of a single dispatch. Construct it before running the test and call record() once with the result.
+   */
+  class Scope {
+    CollisionStats &stats;
+    CollisionOperation operation;
+    GeometryType typeOp1;
+    GeometryType typeOp2;
+    std::chrono::steady_clock::time_point start;
+  public:
+    Scope(CollisionStats &stats, CollisionOperation operation, GeometryType typeOp1, GeometryType typeOp2) :
+        stats(stats), operation(operation), typeOp1(typeOp1), typeOp2(typeOp2), start(std::chrono::steady_clock::now()) {
+    }
+
+    void record(bool supported, bool swapped, bool hit) {
+      unsigned long long nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+      stats.record(operation, typeOp1, typeOp2, supported, swapped, hit, nanoseconds);
+    }
+  };
+
+  CollisionStats() : id(++lastId()) {
+  }
+
+  CollisionStats(const CollisionStats &) = delete;
+  CollisionStats &operator=(const CollisionStats &) = delete;
+
+  ~CollisionStats() {
+    Block *block = blocks.load(std::memory_order_acquire);
+    while(block != nullptr) {
+      Block *next = block->next;
+      delete block;
+      block = next;
+    }
+  }
+
+  void record(CollisionOperation operation, GeometryType typeOp1, GeometryType typeOp2, bool supported, bool swapped, bool hit, unsigned long long nanoseconds) {
+    Counters &counters = threadBlock().pairs[(unsigned int)operation][(unsigned int)typeOp1][(unsigned int)typeOp2];
+    increment(counters.calls, 1);
+    increment(counters.hits, hit ? 1 : 0);
+    increment(counters.swapped, swapped ? 1 : 0);
+    increment(counters.unsupported, supported ? 0 : 1);
+    increment(counters.nanoseconds, nanoseconds);
+  }
+
+  /**
+   * Sums the blocks of every thread that recorded so far. Counters written concurrently may or may not be included, but each one is read whole.
+   */
+  CollisionStatsSnapshot snapshot() const {
+    CollisionStatsSnapshot result;
+
+    for(const Block *block = blocks.load(std::memory_order_acquire); block != nullptr; block = block->next) {
+      for(unsigned int operation = 0; operation < COLLISION_OPERATION_COUNT; operation++) {
+        for(unsigned int typeOp1 = 0; typeOp1 < GEOMETRY_TYPE_COUNT; typeOp1++) {
+          for(unsigned int typeOp2 = 0; typeOp2 < GEOMETRY_TYPE_COUNT; typeOp2++) {
+            const Counters &counters = block->pairs[operation][typeOp1][typeOp2];
+            CollisionPairStats &pair = result.get((CollisionOperation)operation, (GeometryType)typeOp1, (GeometryType)typeOp2);
+            pair.calls += counters.calls.load(std::memory_order_relaxed);
+            pair.hits += counters.hits.load(std::memory_order_relaxed);
+            pair.swapped += counters.swapped.load(std::memory_order_relaxed);
+            pair.unsupported += counters.unsupported.load(std::memory_order_relaxed);
+            pair.nanoseconds += counters.nanoseconds.load(std::memory_order_relaxed);
+          }
+        }
+      }
+    }
+
+    return result;
+  }
+
+  unsigned int getThreadCount() const {
+    unsigned int count = 0;
+    for(const Block *block = blocks.load(std::memory_order_acquire); block != nullptr; block = block->next) {
+      count++;
+    }
+    return count;
+  }
+
+protected:
+  /**
+   * Only the owner thread writes a counter, so a relaxed load plus store is enough and avoids the locked instruction of fetch_add.
+   */
+  static void increment(std::atomic<unsigned long long> &counter, unsigned long long value) {
+    if(value != 0) {
+      counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+  }
+
+  Block &threadBlock() {
+    static thread_local ThreadCache cache;
+
+    for(unsigned int index = 0; index < ThreadCache::size; index++) {
+      if(cache.ids[index] == id) {
+        return *cache.blocks[index];
+      }
+    }
+
+    /**
+     * Evicted from the thread cache but possibly already registered: reuse it so that alternating between many testers does not grow the list.
+     */
+    std::thread::id thisThread = std::this_thread::get_id();
+    Block *block = blocks.load(std::memory_order_acquire);
+    while(block != nullptr && block->owner != thisThread) {
+      block = block->next;
+    }
+
+    if(block == nullptr) {
+      block = new Block();
+      block->owner = thisThread;
+      block->next = blocks.load(std::memory_order_relaxed);
+      while(!blocks.compare_exchange_weak(block->next, block, std::memory_order_release, std::memory_order_relaxed)) {
+      }
+    }
+
+    cache.ids[cache.next] = id;
+    cache.blocks[cache.next] = block;
+    cache.next = (cache.next + 1) % ThreadCache::size;
+
+    return *block;
+  }
+};
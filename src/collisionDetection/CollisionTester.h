@@ -8,20 +8,51 @@
 #pragma once
 
 #include <vector>
-#include <map>
+#include <algorithm>
 #include <Geometry.h>
+#include <LinearBvh.h>
 #include "GeometryContact.h"
+#include "ContactBuffer.h"
+#include "IntersectionHelper.h"
+#include "GjkEpa.h"
+#include "FrustumCuller.h"
+#include "CollisionStats.h"
 
 class CollisionTester {
+public:
+  typedef bool (CollisionTester::*IntersectionTest)(const Geometry &, const Geometry &) const;
+  typedef void (CollisionTester::*ContactTest)(const Geometry &, const Geometry &, ContactBuffer &) const;
+
 protected:
-  std::map<std::pair<GeometryType, GeometryType>, std::vector<GeometryContact> (CollisionTester::*)(const Geometry &, const Geometry &) const> contactTestsTable;
-  std::map<std::pair<GeometryType, GeometryType>, bool (CollisionTester::*)(const Geometry &, const Geometry &) const> intersectionTestsTable;
+  /**
+   * Dispatch table entry. Swapped entries are resolved when the test is added, so that looking up (op2, op1) for a test registered as (op1, op2)
+   * does not require a second lookup at query time. Explicitly registered entries always take precedence over swapped ones.
+   */
+  template<typename TestFunction> struct DispatchEntry {
+    TestFunction test = nullptr;
+    bool swapped = false;
+  };
+
+  DispatchEntry<ContactTest> contactTestsTable[GEOMETRY_TYPE_COUNT][GEOMETRY_TYPE_COUNT];
+  DispatchEntry<IntersectionTest> intersectionTestsTable[GEOMETRY_TYPE_COUNT][GEOMETRY_TYPE_COUNT];
+
+#ifdef GEOMETRY_COLLISION_STATS
+  /**
+   * Per pair dispatch counters, only compiled in with GEOMETRY_COLLISION_STATS. Shared by copies of this tester.
+   */
+  std::shared_ptr<CollisionStats> stats;
+#endif
 
 public:
 
+#ifdef GEOMETRY_COLLISION_STATS
+  CollisionTester() : stats(std::make_shared<CollisionStats>()) {
+#else
   CollisionTester() {
+#endif
       this->addIntersectionTests();
       this->addContactTests();
+      this->addConvexFallbackTests();
   }
 
   virtual ~CollisionTester() {
@@ -35,22 +66,24 @@ public:
 //        this->addIntersectionTest(GeometryType::LINE, GeometryType::PLANE, &CollisionTester::linePlane);
 //        this->addIntersectionTest(GeometryType::LINE, GeometryType::LINE, &CollisionTester::lineLine);
     this->addIntersectionTest(GeometryType::LINE, GeometryType::AABB, &CollisionTester::lineAabb);
-//        this->addIntersectionTest(GeometryType::LINE, GeometryType::OOBB, &CollisionTester::lineOobb);
+    this->addIntersectionTest(GeometryType::LINE, GeometryType::HEIGHTMAP, &CollisionTester::lineHeightmap);
+    this->addIntersectionTest(GeometryType::LINE, GeometryType::OOBB, &CollisionTester::lineOobb);
 
     this->addIntersectionTest(GeometryType::PLANE, GeometryType::SPHERE, &CollisionTester::planeSphere);
 //        this->addIntersectionTest(GeometryType::PLANE, GeometryType::PLANE, &CollisionTester::planePlane);
-//        this->addIntersectionTest(GeometryType::PLANE, GeometryType::AABB, &CollisionTester::planeAabb);
-//        this->addIntersectionTest(GeometryType::PLANE, GeometryType::OOBB, &CollisionTester::planeOobb);
+    this->addIntersectionTest(GeometryType::PLANE, GeometryType::AABB, &CollisionTester::planeAabb);
+    this->addIntersectionTest(GeometryType::PLANE, GeometryType::OOBB, &CollisionTester::planeOobb);
 
     this->addIntersectionTest(GeometryType::SPHERE, GeometryType::SPHERE, &CollisionTester::sphereSphere);
     this->addIntersectionTest(GeometryType::SPHERE, GeometryType::AABB, &CollisionTester::sphereAabb);
-//        this->addIntersectionTest(GeometryType::SPHERE, GeometryType::OOBB, &CollisionTester::sphereOobb);
+    this->addIntersectionTest(GeometryType::SPHERE, GeometryType::OOBB, &CollisionTester::sphereOobb);
     this->addIntersectionTest(GeometryType::SPHERE, GeometryType::HEIGHTMAP, &CollisionTester::sphereHeightmap);
 
     this->addIntersectionTest(GeometryType::AABB, GeometryType::AABB, &CollisionTester::aabbAabb);
-//        this->addIntersectionTest(GeometryType::AABB, GeometryType::OOBB, &CollisionTester::aabbOobb);
-//
-//        this->addIntersectionTest(GeometryType::OOBB, GeometryType::OOBB, &CollisionTester::oobbOobb);
+    this->addIntersectionTest(GeometryType::AABB, GeometryType::HEIGHTMAP, &CollisionTester::aabbHeightmap);
+    this->addIntersectionTest(GeometryType::AABB, GeometryType::OOBB, &CollisionTester::aabbOobb);
+
+    this->addIntersectionTest(GeometryType::OOBB, GeometryType::OOBB, &CollisionTester::oobbOobb);
   }
 
   /**
@@ -67,92 +100,279 @@ public:
     this->addContactTest(GeometryType::PLANE, GeometryType::SPHERE, &CollisionTester::planeSphereContact);
 //        this->addContactTest(GeometryType::PLANE, GeometryType::PLANE, &CollisionTester::planePlaneContact);
 //        this->addContactTest(GeometryType::PLANE, GeometryType::AABB, &CollisionTester::planeAabbContact);
-//        this->addContactTest(GeometryType::PLANE, GeometryType::OOBB, &CollisionTester::planeOobbContact);
+    this->addContactTest(GeometryType::PLANE, GeometryType::OOBB, &CollisionTester::planeOobbContact);
 
     this->addContactTest(GeometryType::SPHERE, GeometryType::SPHERE, &CollisionTester::sphereSphereContact);
     this->addContactTest(GeometryType::SPHERE, GeometryType::AABB, &CollisionTester::sphereAabbContact);
-//        this->addContactTest(GeometryType::SPHERE, GeometryType::OOBB, &CollisionTester::sphereOobbContact);
+    this->addContactTest(GeometryType::SPHERE, GeometryType::OOBB, &CollisionTester::sphereOobbContact);
     this->addContactTest(GeometryType::SPHERE, GeometryType::HEIGHTMAP, &CollisionTester::sphereHeightmapContact);
 
 //        this->addContactTest(GeometryType::AABB, GeometryType::AABB, &CollisionTester::aabbAabbContact);
-//        this->addContactTest(GeometryType::AABB, GeometryType::OOBB, &CollisionTester::aabbOobbContact);
-//
-//        this->addContactTest(GeometryType::OOBB, GeometryType::OOBB, &CollisionTester::oobbOobbContact);
+    this->addContactTest(GeometryType::AABB, GeometryType::OOBB, &CollisionTester::aabbOobbContact);
+
+    this->addContactTest(GeometryType::OOBB, GeometryType::OOBB, &CollisionTester::oobbOobbContact);
   }
 
-  virtual void addIntersectionTest(const GeometryType &typeOp1, const GeometryType &typeOp2, bool (CollisionTester::*intersectionTest)(const Geometry &, const Geometry &) const) {
-    intersectionTestsTable[std::pair<const GeometryType &, const GeometryType &>(typeOp1, typeOp2)] = intersectionTest;
+  /**
+   * Pairs of convex geometry types (those implementing getSupportPoint) without a hand written test fall back to GJK / EPA.
+   * Called after the hand written tests are added, so these are only used for pairs nobody registered.
+   */
+  void addConvexFallbackTests() {
+    const GeometryType convexTypes[] = {GeometryType::SPHERE, GeometryType::AABB, GeometryType::OOBB};
+
+    for(GeometryType typeOp1 : convexTypes) {
+      for(GeometryType typeOp2 : convexTypes) {
+        if(intersectionTestsTable[(unsigned int)typeOp1][(unsigned int)typeOp2].test == nullptr) {
+          this->addIntersectionTest(typeOp1, typeOp2, &CollisionTester::convexIntersection);
+        }
+        if(contactTestsTable[(unsigned int)typeOp1][(unsigned int)typeOp2].test == nullptr) {
+          this->addContactTest(typeOp1, typeOp2, &CollisionTester::convexContact);
+        }
+      }
+    }
+  }
+
+  virtual void addIntersectionTest(const GeometryType &typeOp1, const GeometryType &typeOp2, IntersectionTest intersectionTest) {
+    setDispatchEntry(intersectionTestsTable, typeOp1, typeOp2, intersectionTest);
 
     //TODO: check we're not adding more than desired
-    intersectionTestsTable[std::pair<const GeometryType &, const GeometryType &>(typeOp1, GeometryType::FRUSTUM)] = &CollisionTester::geometryFrustum;
-    intersectionTestsTable[std::pair<const GeometryType &, const GeometryType &>(typeOp2, GeometryType::FRUSTUM)] = &CollisionTester::geometryFrustum;
+    setDispatchEntry(intersectionTestsTable, typeOp1, GeometryType::FRUSTUM, &CollisionTester::geometryFrustum);
+    setDispatchEntry(intersectionTestsTable, typeOp2, GeometryType::FRUSTUM, &CollisionTester::geometryFrustum);
 
-    intersectionTestsTable[std::pair<const GeometryType &, const GeometryType &>(typeOp1, GeometryType::HIERARCHY)] = &CollisionTester::geometryHierarchy;
-    intersectionTestsTable[std::pair<const GeometryType &, const GeometryType &>(typeOp2, GeometryType::HIERARCHY)] = &CollisionTester::geometryHierarchy;
-    intersectionTestsTable[std::pair<const GeometryType &, const GeometryType &>(GeometryType::HIERARCHY, GeometryType::HIERARCHY)] = &CollisionTester::geometryHierarchy; // TODO: this might be a special case
+    setDispatchEntry(intersectionTestsTable, typeOp1, GeometryType::HIERARCHY, &CollisionTester::geometryHierarchy);
+    setDispatchEntry(intersectionTestsTable, typeOp2, GeometryType::HIERARCHY, &CollisionTester::geometryHierarchy);
+    setDispatchEntry(intersectionTestsTable, GeometryType::HIERARCHY, GeometryType::HIERARCHY, &CollisionTester::geometryHierarchy); // TODO: this might be a special case
 
-    intersectionTestsTable[std::pair<const GeometryType &, const GeometryType &>(GeometryType::HIERARCHY, GeometryType::FRUSTUM)] = &CollisionTester::geometryFrustum; // TODO: this might be a special case
+    setDispatchEntry(intersectionTestsTable, GeometryType::HIERARCHY, GeometryType::FRUSTUM, &CollisionTester::geometryFrustum); // TODO: this might be a special case
   }
 
-  virtual void addContactTest(const GeometryType &typeOp1, const GeometryType &typeOp2, std::vector<GeometryContact> (CollisionTester::*contactTest)(const Geometry &, const Geometry &) const) {
-    contactTestsTable[std::pair<const GeometryType &, const GeometryType &>(typeOp1, typeOp2)] = contactTest;
+  virtual void addContactTest(const GeometryType &typeOp1, const GeometryType &typeOp2, ContactTest contactTest) {
+    setDispatchEntry(contactTestsTable, typeOp1, typeOp2, contactTest);
 
     //TODO: check we're not adding more than desired
-    contactTestsTable[std::pair<const GeometryType &, const GeometryType &>(typeOp1, GeometryType::HIERARCHY)] = &CollisionTester::geometryHierarchyContact;
-    contactTestsTable[std::pair<const GeometryType &, const GeometryType &>(typeOp2, GeometryType::HIERARCHY)] = &CollisionTester::geometryHierarchyContact;
-    contactTestsTable[std::pair<const GeometryType &, const GeometryType &>(GeometryType::HIERARCHY, GeometryType::HIERARCHY)] = &CollisionTester::geometryHierarchyContact; // TODO: this might be a special case
+    setDispatchEntry(contactTestsTable, typeOp1, GeometryType::HIERARCHY, &CollisionTester::geometryHierarchyContact);
+    setDispatchEntry(contactTestsTable, typeOp2, GeometryType::HIERARCHY, &CollisionTester::geometryHierarchyContact);
+    setDispatchEntry(contactTestsTable, GeometryType::HIERARCHY, GeometryType::HIERARCHY, &CollisionTester::geometryHierarchyContact); // TODO: this might be a special case
   }
 
 
   virtual bool intersects(const Geometry &op1, const Geometry & op2) const {
-    std::pair<GeometryType, GeometryType > key(op1.getType(), op2.getType());
+    const DispatchEntry<IntersectionTest> &entry = intersectionTestsTable[(unsigned int)op1.getType()][(unsigned int)op2.getType()];
+#ifdef GEOMETRY_COLLISION_STATS
+    CollisionStats::Scope scope(*stats, CollisionOperation::INTERSECTION, op1.getType(), op2.getType());
+#endif
+    bool result = false;
+
+    if(entry.test != nullptr) {
+      result = entry.swapped ? (this->*entry.test)(op2, op1) : (this->*entry.test)(op1, op2);
+    }
 
-    if(intersectionTestsTable.count(key) > 0) {
-        bool (CollisionTester::*testFunction)(const Geometry &, const Geometry &) const;
-        testFunction = intersectionTestsTable.at(key);
-        return (this->*testFunction)(op1, op2);
+#ifdef GEOMETRY_COLLISION_STATS
+    scope.record(entry.test != nullptr, entry.swapped, result);
+#endif
+    return result;
+  }
+
+  std::vector<GeometryContact> detectCollision(const Geometry &op1, const Geometry &op2) const {
+    ContactBuffer contacts;
+    this->detectCollision(op1, op2, contacts);
+    return contacts.release();
+  }
+
+  /**
+   * Appends contacts to a caller owned buffer. Reusing the buffer across frames avoids the per call std::vector allocation of the overload above.
+   */
+  virtual void detectCollision(const Geometry &op1, const Geometry &op2, ContactBuffer &contacts) const {
+    const DispatchEntry<ContactTest> &entry = contactTestsTable[(unsigned int)op1.getType()][(unsigned int)op2.getType()];
+#ifdef GEOMETRY_COLLISION_STATS
+    CollisionStats::Scope scope(*stats, CollisionOperation::CONTACT, op1.getType(), op2.getType());
+    unsigned int contactsBefore = contacts.size();
+#endif
+
+    if(entry.test != nullptr) {
+      if(entry.swapped) {
+        (this->*entry.test)(op2, op1, contacts);
+      } else {
+        (this->*entry.test)(op1, op2, contacts);
+      }
+    }
+
+#ifdef GEOMETRY_COLLISION_STATS
+    scope.record(entry.test != nullptr, entry.swapped, contacts.size() > contactsBefore);
+#endif
+  }
+
+  /**
+   * Same as above for pairs tested by the GJK / EPA fallback, but warm started from the last simplex of the pair, kept by the caller in warmStart
+   * and updated - e.g. the one of the pair's ContactManifold. Contacts match those of a cold start within GjkEpa::tolerance. Other pairs ignore warmStart.
+   */
+  void detectCollision(const Geometry &op1, const Geometry &op2, ContactBuffer &contacts, CachedSimplex &warmStart) const {
+    const DispatchEntry<ContactTest> &entry = contactTestsTable[(unsigned int)op1.getType()][(unsigned int)op2.getType()];
+    if(entry.test != (ContactTest)&CollisionTester::convexContact) {
+      this->detectCollision(op1, op2, contacts);
+      return;
+    }
+
+#ifdef GEOMETRY_COLLISION_STATS
+    CollisionStats::Scope scope(*stats, CollisionOperation::CONTACT, op1.getType(), op2.getType());
+    unsigned int contactsBefore = contacts.size();
+#endif
+
+    if(entry.swapped) {
+      this->convexContact(op2, op1, contacts, warmStart);
     } else {
-        std::pair<GeometryType, GeometryType > inverseKey(op2.getType(), op1.getType());
+      this->convexContact(op1, op2, contacts, warmStart);
+    }
 
-        if(intersectionTestsTable.count(inverseKey) > 0) {
-            bool (CollisionTester::*testFunction)(const Geometry &, const Geometry &) const;
-            testFunction = intersectionTestsTable.at(inverseKey);
-            return (this->*testFunction)(op2, op1);
-        }
+#ifdef GEOMETRY_COLLISION_STATS
+    scope.record(true, entry.swapped, contacts.size() > contactsBefore);
+#endif
+  }
+
+  /**
+   * Same result as intersects(geometry, hierarchy) for the hierarchy the bvh was compiled from - or as testing every geometry of the set,
+   * for bvhs compiled from sets.
+   * Dispatch uses the node types, without virtual calls or recursion.
+   */
+  bool intersects(const Geometry &geometry, const LinearBvh &bvh) const {
+    const unsigned int typeOp1 = (unsigned int)geometry.getType();
+    const std::vector<LinearBvh::Node> &nodes = bvh.getNodes();
+
+    unsigned int index = 0;
+    while(index < nodes.size()) {
+      const LinearBvh::Node &node = nodes[index];
+      const DispatchEntry<IntersectionTest> &entry = intersectionTestsTable[typeOp1][(unsigned int)node.type];
+      bool hit = false;
+      if(entry.test != nullptr) {
+        const Geometry &shape = bvh.getShape(node);
+        hit = entry.swapped ? (this->*entry.test)(shape, geometry) : (this->*entry.test)(geometry, shape);
+      }
+
+      if(hit && node.leaf) {
+        return true;
+      }
+      index = hit ? index + 1 : node.escape;
     }
 
     return false;
   }
 
-  virtual std::vector<GeometryContact>  detectCollision(const Geometry &op1, const Geometry &op2) const {
-    std::pair<GeometryType, GeometryType > key(op1.getType(), op2.getType());
+  /**
+   * Same contacts, in the same order, as detectCollision(geometry, hierarchy) for the hierarchy the bvh was compiled from. Contacts reference
+   * the source geometries rather than their compiled copies, if the bvh has them.
+   */
+  void detectCollision(const Geometry &geometry, const LinearBvh &bvh, ContactBuffer &contacts) const {
+    const unsigned int typeOp1 = (unsigned int)geometry.getType();
+    const std::vector<LinearBvh::Node> &nodes = bvh.getNodes();
+
+    unsigned int index = 0;
+    while(index < nodes.size()) {
+      const LinearBvh::Node &node = nodes[index];
+      const Geometry &shape = bvh.getShape(node);
+
+      if(node.leaf) {
+        const DispatchEntry<ContactTest> &entry = contactTestsTable[typeOp1][(unsigned int)node.type];
+        if(entry.test != nullptr) {
+          unsigned int first = contacts.size();
+          if(entry.swapped) {
+            (this->*entry.test)(shape, geometry, contacts);
+          } else {
+            (this->*entry.test)(geometry, shape, contacts);
+          }
 
-    if(contactTestsTable.count(key) > 0) {
-        std::vector<GeometryContact> (CollisionTester::*testFunction)(const Geometry &, const Geometry &) const;
-        testFunction = contactTestsTable.at(key);
-        return (this->*testFunction)(op1, op2);
-    } else {
-        std::pair<GeometryType, GeometryType > inverseKey(op2.getType(), op1.getType());
+          const Geometry *source = bvh.getSource(index);
+          if(source != nullptr && source != &shape) {
+            for(unsigned int contact = first; contact < contacts.size(); contact++) {
+              contacts[contact].replaceGeometry(&shape, source);
+            }
+          }
+        }
+        index++;
+      } else {
+        const DispatchEntry<IntersectionTest> &entry = intersectionTestsTable[typeOp1][(unsigned int)node.type];
+        bool hit = entry.test != nullptr && (entry.swapped ? (this->*entry.test)(shape, geometry) : (this->*entry.test)(geometry, shape));
+        index = hit ? index + 1 : node.escape;
+      }
+    }
+  }
+
+  /**
+   * Returns the test registered for the given pair of types, or nullptr if there is none. Swapped is set if the test expects the operands in reverse order.
+   */
+  IntersectionTest getIntersectionTest(GeometryType typeOp1, GeometryType typeOp2, bool &swapped) const {
+    const DispatchEntry<IntersectionTest> &entry = intersectionTestsTable[(unsigned int)typeOp1][(unsigned int)typeOp2];
+    swapped = entry.swapped;
+    return entry.test;
+  }
+
+  ContactTest getContactTest(GeometryType typeOp1, GeometryType typeOp2, bool &swapped) const {
+    const DispatchEntry<ContactTest> &entry = contactTestsTable[(unsigned int)typeOp1][(unsigned int)typeOp2];
+    swapped = entry.swapped;
+    return entry.test;
+  }
 
-        if(contactTestsTable.count(inverseKey) > 0) {
-            std::vector<GeometryContact> (CollisionTester::*testFunction)(const Geometry &, const Geometry &) const;
-            testFunction = contactTestsTable.at(inverseKey);
-            return (this->*testFunction)(op2, op1);
+#ifdef GEOMETRY_COLLISION_STATS
+  CollisionStats &getStats() const {
+    return *stats;
+  }
+#endif
+
+  /**
+   * One line per pair that was dispatched, slowest first. Pass the difference between two snapshots to report a time window, e.g.:
+   *   CollisionStatsSnapshot current = tester.getStats().snapshot();
+   *   log(tester.toString(current - previous));
+   *   previous = current;
+   */
+  String toString(const CollisionStatsSnapshot &stats) const {
+    struct StatsRow {
+      CollisionOperation operation;
+      GeometryType typeOp1;
+      GeometryType typeOp2;
+      CollisionPairStats pair;
+    };
+    std::vector<StatsRow> rows;
+
+    for(unsigned int operation = 0; operation < COLLISION_OPERATION_COUNT; operation++) {
+      for(unsigned int typeOp1 = 0; typeOp1 < GEOMETRY_TYPE_COUNT; typeOp1++) {
+        for(unsigned int typeOp2 = 0; typeOp2 < GEOMETRY_TYPE_COUNT; typeOp2++) {
+          const CollisionPairStats &pair = stats.get((CollisionOperation)operation, (GeometryType)typeOp1, (GeometryType)typeOp2);
+          if(pair.calls > 0) {
+            rows.push_back(StatsRow { (CollisionOperation)operation, (GeometryType)typeOp1, (GeometryType)typeOp2, pair });
+          }
         }
+      }
+    }
+
+    std::stable_sort(rows.begin(), rows.end(), [](const StatsRow &a, const StatsRow &b) { return a.pair.nanoseconds > b.pair.nanoseconds; });
+
+    String report;
+    for(const StatsRow &row : rows) {
+      report += String(row.operation == CollisionOperation::INTERSECTION ? "intersects " : "contacts ") + toString(row.typeOp1) + "<->" + toString(row.typeOp2)
+          + ": calls " + std::to_string(row.pair.calls)
+          + ", hits " + std::to_string(row.pair.hits)
+          + ", swapped " + std::to_string(row.pair.swapped)
+          + ", unsupported " + std::to_string(row.pair.unsupported)
+          + ", " + std::to_string(row.pair.nanoseconds / 1000) + "us"
+          + " (" + std::to_string(row.pair.nanoseconds / row.pair.calls) + "ns/call)\n";
     }
 
-    return std::vector<GeometryContact>();
+    return report;
   }
 
   virtual String toString() const {
     String contactMappings;
-    for(auto &mapping : this->contactTestsTable) {
-      contactMappings += (contactMappings.empty() ? "" : ", ") + toString(mapping.first.first) + "<->" + toString(mapping.first.second);
-    }
-
     String intersectionMappings;
-    for(auto &mapping : this->intersectionTestsTable) {
-      intersectionMappings += (intersectionMappings.empty() ? "" : ", ") + toString(mapping.first.first) + "<->" + toString(mapping.first.second);
+
+    for(unsigned int typeOp1 = 0; typeOp1 < GEOMETRY_TYPE_COUNT; typeOp1++) {
+      for(unsigned int typeOp2 = 0; typeOp2 < GEOMETRY_TYPE_COUNT; typeOp2++) {
+        if(contactTestsTable[typeOp1][typeOp2].test != nullptr && !contactTestsTable[typeOp1][typeOp2].swapped) {
+          contactMappings += (contactMappings.empty() ? "" : ", ") + toString((GeometryType)typeOp1) + "<->" + toString((GeometryType)typeOp2);
+        }
+
+        if(intersectionTestsTable[typeOp1][typeOp2].test != nullptr && !intersectionTestsTable[typeOp1][typeOp2].swapped) {
+          intersectionMappings += (intersectionMappings.empty() ? "" : ", ") + toString((GeometryType)typeOp1) + "<->" + toString((GeometryType)typeOp2);
+        }
+      }
     }
 
     return "CollisionTester(intersectionChecks: [" + intersectionMappings + "], contactChecks: [" + contactMappings + "]";
@@ -183,6 +403,22 @@ protected:
     return "UNKNOWN";
 
   }
+
+  /**
+   * Registers test for (typeOp1, typeOp2) and, unless already explicitly registered, the swapped entry for (typeOp2, typeOp1).
+   */
+  template<typename TestFunction> void setDispatchEntry(DispatchEntry<TestFunction> (&table)[GEOMETRY_TYPE_COUNT][GEOMETRY_TYPE_COUNT], GeometryType typeOp1, GeometryType typeOp2, TestFunction test) {
+    DispatchEntry<TestFunction> &entry = table[(unsigned int)typeOp1][(unsigned int)typeOp2];
+    entry.test = test;
+    entry.swapped = false;
+
+    DispatchEntry<TestFunction> &swappedEntry = table[(unsigned int)typeOp2][(unsigned int)typeOp1];
+    if(swappedEntry.test == nullptr || swappedEntry.swapped) {
+      swappedEntry.test = test;
+      swappedEntry.swapped = true;
+    }
+  }
+
   /*****
    *
    * Intersection Tests
@@ -204,47 +440,60 @@ protected:
   }
 
 
-  std::vector<GeometryContact> geometryHierarchyContact(const Geometry &geometry, const Geometry &hierarchyGeometry) const {
+  void geometryHierarchyContact(const Geometry &geometry, const Geometry &hierarchyGeometry, ContactBuffer &contacts) const {
       const HierarchicalGeometry &hierarchy = (const HierarchicalGeometry &)hierarchyGeometry;
 
-
       if(this->intersects(geometry, hierarchy.getBoundingVolume())) {
-          std::vector<GeometryContact> response;
-
           for(auto & currentChildren: hierarchy.getChildren()) {
-              std::vector<GeometryContact> currentChildrenContacts = this->detectCollision(geometry, *currentChildren.get());
-              response.insert( response.end(), currentChildrenContacts.begin(), currentChildrenContacts.end());
+              this->detectCollision(geometry, *currentChildren.get(), contacts);
           }
-
-          return response;
       }
+  }
+
+  /**
+   * GJK / EPA fallbacks for convex pairs without a hand written test. The tester keeps no per pair state: contacts warm start from the
+   * caller's CachedSimplex, see detectCollision(op1, op2, contacts, warmStart).
+   */
+  bool convexIntersection(const Geometry &geometry, const Geometry &anotherGeometry) const {
+    return GjkEpa::intersects(geometry, anotherGeometry);
+  }
+
+  void convexContact(const Geometry &geometry, const Geometry &anotherGeometry, ContactBuffer &contacts) const {
+    GjkEpa::contact(geometry, anotherGeometry, contacts);
+  }
 
-      return std::vector<GeometryContact>();
+  void convexContact(const Geometry &geometry, const Geometry &anotherGeometry, ContactBuffer &contacts, CachedSimplex &warmStart) const {
+    GjkEpa::contact(geometry, anotherGeometry, contacts, &warmStart);
   }
 
+  /**
+   * Half space test with the same results as FrustumCuller: geometries inside the frustum intersect it, as well as those straddling its planes.
+   * Hierarchies straddling planes are descended, children only testing the planes their parent has not passed. Builds a culler per call,
+   * callers testing many geometries against the same frustum should keep a FrustumCuller instead.
+   */
   bool geometryFrustum(const Geometry &geometry, const Geometry &frustumGeometry) const {
-    const Frustum &frustum = (const Frustum &)frustumGeometry;
+    return frustumVisible(FrustumCuller((const Frustum &)frustumGeometry), geometry, 0);
+  }
 
-    for(auto plane : frustum.getHalfSpaces()) {
-      if(!this->intersects(geometry, plane)) {
-        return false;
-      }
+  bool frustumVisible(const FrustumCuller &culler, const Geometry &geometry, uint32_t passedPlanes) const {
+    CullResult result = culler.cull(geometry, passedPlanes);
+    if(result != CullResult::INTERSECTING || geometry.getType() != GeometryType::HIERARCHY) {
+      return result != CullResult::OUTSIDE;
     }
 
-    return true;
+    for(auto &child : ((const HierarchicalGeometry &)geometry).getChildren()) {
+      if(frustumVisible(culler, *child, passedPlanes)) {
+        return true;
+      }
+    }
+    return false;
   }
 
   /**
    * Line intersection test
    */
-  bool lineSphere(const Geometry &lineGeometry, const Geometry &sphereGeometry) const {
-    const Line &line = (const Line &) lineGeometry;
-    const Sphere &sphere = (const Sphere &) sphereGeometry;
-
-    real projection = (sphere.getOrigin() - line.getOrigin()) * line.getDirection();
-    vector projectedSphereCenter = line.getOrigin() + line.getDirection() * projection;
-
-    return sphere.contains(projectedSphereCenter);
+  bool lineSphere(const Geometry &line, const Geometry &sphere) const {
+    return IntersectionHelper::lineSphere((const Line &)line, (const Sphere &)sphere);
   }
 
   bool linePlane(const Geometry &line, const Geometry &plane) const {
@@ -255,124 +504,54 @@ protected:
      return false;
   }
 
-  /**
-   * From: https://research.ncl.ac.uk/game/mastersdegree/gametechnologies/physicstutorials/1raycasting/Physics%20-%20Raycasting.pdf
-   * Note: This is really a ray/aabb intersection test: negative t values are ignored. Do we need lines?
-   */
-  bool lineAabb(const Geometry &lineGeometry, const Geometry &aabbGeometry) const {
-    const Line &line = (const Line &)lineGeometry;
-    const AABB &aabb = (const AABB &)aabbGeometry;
-
-    real maxT = REAL_MIN;
-
-    vector aabbMins = aabb.getMins();
-    vector aabbMaxs = aabb.getMaxs();
-    real t;
-
-    if(line.getDirection().x > 0) { //if ray is going up, only compare to bottom of aabb
-      //Lorigin.x + Ldirection.x * t = AABBmins.x  <-- line / axis aligned plane equation
-      //t = (AABBmins.x - Lorigin.x) / Ldirection.x
-      t = aabbMins.x - line.getOrigin().x / line.getDirection().x;
-      if(t > maxT) {
-        maxT = t;
-      }
-    } else if(line.getDirection().x < 0) { //Otherwise compare to top of aabb. Skip direction == 0: divide by zero
-      t = aabbMaxs.x - line.getOrigin().x / line.getDirection().x;
-      if(t > maxT) {
-        maxT = t;
-      }
-    }
-
-    //Same checks on other axes.
-    if(line.getDirection().y > 0) { //if ray is going up, only compare to bottom of aabb
-      t = aabbMins.y - line.getOrigin().y / line.getDirection().y;
-      if(t > maxT) {
-        maxT = t;
-      }
-    } else if(line.getDirection().y < 0) { //skip direction == 0: divide by zero
-      t = aabbMaxs.y - line.getOrigin().y / line.getDirection().y;
-      if(t > maxT) {
-        maxT = t;
-      }
-    }
-
-    if(line.getDirection().z > 0) { //if ray is going up, only compare to bottom of aabb
-      t = aabbMins.z - line.getOrigin().z / line.getDirection().z;
-      if(t > maxT) {
-        maxT = t;
-      }
-    } else if(line.getDirection().z < 0) { //skip direction == 0: divide by zero
-      t = aabbMaxs.z - line.getOrigin().z / line.getDirection().z;
-      if(t > maxT) {
-        maxT = t;
-      }
-    }
-
-    if(maxT >= 0) {
-      vector intersection = line.getOrigin() + line.getDirection() * maxT; // Farthest intersection between ray and one of the 3 closer planes of the aabb. ray and aabb are intersecting if the point is inside the aabb.
-      return aabb.contains(intersection);
-    }
+  bool lineAabb(const Geometry &line, const Geometry &aabb) const {
+    return IntersectionHelper::lineAabb((const Line &)line, (const AABB &)aabb);
+  }
 
-    return false;
+  bool lineHeightmap(const Geometry &line, const Geometry &heightmap) const {
+    return IntersectionHelper::lineHeightmap((const Line &)line, (const HeightMapGeometry &)heightmap);
   }
 
   bool lineOobb(const Geometry &line, const Geometry &oobb) const {
-         return false;
+    return IntersectionHelper::lineOobb((const Line &)line, (const OOBB &)oobb);
   }
 
   /**
    * Plane intersection test - This is actually a half space / sphere test
    */
-  bool planeSphere(const Geometry &planeGeometry, const Geometry &sphereGeometry) const {
-      Plane &plane = (Plane &)planeGeometry;
-      Sphere &sphere = (Sphere &)sphereGeometry;
-      vector delta = ((sphere.getOrigin() - plane.getOrigin()) * plane.getNormal()) * plane.getNormal();
-      return (delta * delta <= sphere.getRadius() * sphere.getRadius());
+  bool planeSphere(const Geometry &plane, const Geometry &sphere) const {
+      return IntersectionHelper::planeSphere((const Plane &)plane, (const Sphere &)sphere);
   }
 
   bool planePlane(const Geometry &planeGeometry, const Geometry &anotherPlaneGeometry) const {
       return false;
   }
 
-  bool planeAabb(const Geometry &planeGeometry, const Geometry &aabbGeometry) const {
-          return false;
+  bool planeAabb(const Geometry &plane, const Geometry &aabb) const {
+      return IntersectionHelper::planeAabb((const Plane &)plane, (const AABB &)aabb);
   }
 
   bool planeOobb(const Geometry &plane, const Geometry &oobb) const {
-          return false;
+      return IntersectionHelper::planeOobb((const Plane &)plane, (const OOBB &)oobb);
   }
 
   /**
    * Sphere intersection test
    */
-  bool sphereSphere(const Geometry &sphereGeometry, const Geometry &anotherSphereGeometry) const {
-      const Sphere &sphere = (const Sphere &)sphereGeometry;
-      const Sphere &anotherSphere = (const Sphere &)anotherSphereGeometry;
-      vector delta = sphere.getOrigin() - anotherSphere.getOrigin();
-      real radiuses = sphere.getRadius() + anotherSphere.getRadius();
-
-      return (delta * delta <= radiuses * radiuses);
+  bool sphereSphere(const Geometry &sphere, const Geometry &anotherSphere) const {
+      return IntersectionHelper::sphereSphere((const Sphere &)sphere, (const Sphere &)anotherSphere);
   }
 
-  bool sphereAabb(const Geometry &sphereGeometry, const Geometry &aabbGeometry) const {
-      const Sphere &sphere = (const Sphere &)sphereGeometry;
-      const AABB &aabb = (const AABB &)aabbGeometry;
-
-      return sphere.contains(aabb.closestPoint(sphere.getOrigin()));
+  bool sphereAabb(const Geometry &sphere, const Geometry &aabb) const {
+      return IntersectionHelper::sphereAabb((const Sphere &)sphere, (const AABB &)aabb);
   }
 
   bool sphereOobb(const Geometry &sphere, const Geometry &oobb) const {
-      return false;
+      return IntersectionHelper::sphereOobb((const Sphere &)sphere, (const OOBB &)oobb);
   }
 
-  bool sphereHeightmap(const Geometry &sphereGeometry, const Geometry &heightMapGeometry) const {
-    const Sphere &sphere = (const Sphere &)sphereGeometry;
-    const HeightMapGeometry &heightmap = (const HeightMapGeometry &)heightMapGeometry;
-
-    vector aabbClosestPoint = heightmap.closestPoint(sphere.getOrigin());
-    aabbClosestPoint.y = heightmap.heightAt(aabbClosestPoint.x, aabbClosestPoint.z);
-
-    return sphere.contains(aabbClosestPoint);
+  bool sphereHeightmap(const Geometry &sphere, const Geometry &heightmap) const {
+    return IntersectionHelper::sphereHeightmap((const Sphere &)sphere, (const HeightMapGeometry &)heightmap);
   }
 
 
@@ -380,11 +559,15 @@ protected:
    * AABB intersection tests
    */
   bool aabbAabb(const Geometry &aabb, const Geometry &anotherAabb) const {
-      return ((const AABB &)aabb).minkowskiDifference((const AABB &)anotherAabb).contains(vector(0, 0, 0));
+      return IntersectionHelper::aabbAabb((const AABB &)aabb, (const AABB &)anotherAabb);
   }
 
-  bool aabbOobb(const Geometry &aabb, const Geometry &anotherObb) const {
-      return false;
+  bool aabbHeightmap(const Geometry &aabb, const Geometry &heightmap) const {
+      return IntersectionHelper::aabbHeightmap((const AABB &)aabb, (const HeightMapGeometry &)heightmap);
+  }
+
+  bool aabbOobb(const Geometry &aabb, const Geometry &oobb) const {
+      return IntersectionHelper::aabbOobb((const AABB &)aabb, (const OOBB &)oobb);
   }
 
 
@@ -392,7 +575,7 @@ protected:
    * OOBB intersection tests
    */
   bool oobbOobb(const Geometry &oobb, const Geometry &anotherOobb) const {
-      return false;
+      return IntersectionHelper::oobbOobb((const OOBB &)oobb, (const OOBB &)anotherOobb);
   }
 
 
@@ -405,172 +588,94 @@ protected:
   /**
    * Line contact Determination
    */
-  std::vector<GeometryContact> lineSphereContact(const Geometry &lineGeometry, const Geometry &sphereGeometry) const {
+  void lineSphereContact(const Geometry &lineGeometry, const Geometry &sphereGeometry, ContactBuffer &contacts) const {
       const Line &line = (const Line &)lineGeometry;
       const Sphere &sphere = (const Sphere &)sphereGeometry;
-
-      return std::vector<GeometryContact>();
   }
 
-  std::vector<GeometryContact> linePlaneContact(const Geometry &lineGeometry, const Geometry &planeGeometry) const {
+  void linePlaneContact(const Geometry &lineGeometry, const Geometry &planeGeometry, ContactBuffer &contacts) const {
       const Line &line = (const Line &)lineGeometry;
       const Plane &plane= (const Plane &)planeGeometry;
-
-      return std::vector<GeometryContact>();
   }
 
-  std::vector<GeometryContact> lineLineContact(const Geometry &lineGeometry, const Geometry &anotherLineGeometry) const {
+  void lineLineContact(const Geometry &lineGeometry, const Geometry &anotherLineGeometry, ContactBuffer &contacts) const {
       const Line &line = (const Line &)lineGeometry;
       const Line &anotherLine = (const Line &)anotherLineGeometry;
-
-      return std::vector<GeometryContact>();
   }
 
-  std::vector<GeometryContact> lineAabbContact(const Geometry &lineGeometry, const Geometry &aabbGeometry) const {
+  void lineAabbContact(const Geometry &lineGeometry, const Geometry &aabbGeometry, ContactBuffer &contacts) const {
       const Line &line = (const Line &)lineGeometry;
       const AABB &aabb = (const AABB &)aabbGeometry;
-
-      return std::vector<GeometryContact>();
   }
 
-  std::vector<GeometryContact> lineOobbContact(const Geometry &lineGeometry, const Geometry &oobbGeometry) const {
-      return std::vector<GeometryContact>();
+  void lineOobbContact(const Geometry &lineGeometry, const Geometry &oobbGeometry, ContactBuffer &contacts) const {
   }
 
 
   /**
    * Plane contact determination - This is actually a half space / sphere test
    */
-  std::vector<GeometryContact> planeSphereContact(const Geometry &planeGeometry, const Geometry &sphereGeometry) const {
-      const Plane & plane = (const Plane &)planeGeometry;
-      const Sphere & sphere= (const Sphere &)sphereGeometry;
-
-      vector normal = plane.getNormal();
-
-      real distance = (sphere.getOrigin() - plane.getOrigin()) * normal;
-
-      if(distance <= sphere.getRadius()) {
-          vector delta = distance * normal;
-          real penetration = sphere.getRadius() - distance;
-          vector intersection = sphere.getOrigin() - (normal * sphere.getRadius());
-
-          return std::vector<GeometryContact> {GeometryContact(&plane, &sphere, intersection, normal, 0.8f, penetration) };
-      }
-
-      return std::vector<GeometryContact>();
+  void planeSphereContact(const Geometry &plane, const Geometry &sphere, ContactBuffer &contacts) const {
+      IntersectionHelper::planeSphereContact((const Plane &)plane, (const Sphere &)sphere, contacts);
   }
 
-  std::vector<GeometryContact> planePlaneContact(const Geometry &planeGeometry, const Geometry &anotherPlaneGeometry) const {
+  void planePlaneContact(const Geometry &planeGeometry, const Geometry &anotherPlaneGeometry, ContactBuffer &contacts) const {
       const Plane & plane = (const Plane &)planeGeometry;
       const Plane & anotherPlane = (const Plane &)anotherPlaneGeometry;
-
-      return std::vector<GeometryContact>();
   }
 
-  std::vector<GeometryContact> planeAabbContact(const Geometry &planeGeometry, const Geometry &aabbGeometry) const {
+  void planeAabbContact(const Geometry &planeGeometry, const Geometry &aabbGeometry, ContactBuffer &contacts) const {
       const Plane & plane = (const Plane &)planeGeometry;
       const AABB & aabb = (const AABB &)aabbGeometry;
-
-      return std::vector<GeometryContact>();
   }
 
-  std::vector<GeometryContact> planeOobbContact(const Geometry &planeGeometry, const Geometry &oobbGeometry) const {
-      return std::vector<GeometryContact>();
+  void planeOobbContact(const Geometry &plane, const Geometry &oobb, ContactBuffer &contacts) const {
+      IntersectionHelper::planeOobbContact((const Plane &)plane, (const OOBB &)oobb, contacts);
   }
 
 
   /**
    * Sphere contact determination
    */
-  std::vector<GeometryContact> sphereSphereContact(const Geometry &sphereGeometry, const Geometry &anotherSphereGeometry) const {
-      const Sphere &sphere = (const Sphere &)sphereGeometry;
-      const Sphere &anotherSphere = (const Sphere &)anotherSphereGeometry;
-
-      vector delta = sphere.getOrigin() - anotherSphere.getOrigin();
-      real radiuses = sphere.getRadius() + anotherSphere.getRadius();
-
-      if(delta * delta <= radiuses * radiuses) {
-          real distance = delta.modulo();
-          vector normal = delta * (1.0 / distance);
-          real penetration = radiuses - distance;
-          vector intersection = sphere.getOrigin() + (normal * sphere.getRadius());
-          return std::vector<GeometryContact> {GeometryContact(&sphere, &anotherSphere, intersection, normal, 0.8f,  penetration) };
-      }
-
-      return std::vector<GeometryContact>();
+  void sphereSphereContact(const Geometry &sphere, const Geometry &anotherSphere, ContactBuffer &contacts) const {
+      IntersectionHelper::sphereSphereContact((const Sphere &)sphere, (const Sphere &)anotherSphere, contacts);
   }
 
-  std::vector<GeometryContact> sphereAabbContact(const Geometry &sphereGeometry, const Geometry &aabbGeometry) const {
-    const Sphere &sphere = (const Sphere &)sphereGeometry;
-    const AABB &aabb = (const AABB &)aabbGeometry;
-
-    vector aabbClosestPoint = aabb.closestPoint(sphere.getOrigin());
-
-    if(sphere.contains(aabbClosestPoint)) {
-      vector delta = sphere.getOrigin() - aabbClosestPoint;
-      if(equalsZeroAbsoluteMargin(delta * delta)) {
-        aabbClosestPoint = aabb.closestSurfacePoint(sphere.getOrigin());
-        delta = aabbClosestPoint - sphere.getOrigin();
-      }
-      real distance = delta.modulo();
-      vector normal = delta * (1.0 / distance);
-      real penetration = sphere.getRadius() - distance;
-
-      return std::vector<GeometryContact> {GeometryContact(&sphere, &aabb, aabbClosestPoint, normal, 0.8f,  penetration) };
-    }
-
-    return std::vector<GeometryContact>();
+  void sphereAabbContact(const Geometry &sphere, const Geometry &aabb, ContactBuffer &contacts) const {
+    IntersectionHelper::sphereAabbContact((const Sphere &)sphere, (const AABB &)aabb, contacts);
   }
 
-  std::vector<GeometryContact> sphereOobbContact(const Geometry &sphereGeometry, const Geometry &oobbGeometry) const {
-    return std::vector<GeometryContact>();
+  void sphereOobbContact(const Geometry &sphere, const Geometry &oobb, ContactBuffer &contacts) const {
+    IntersectionHelper::sphereOobbContact((const Sphere &)sphere, (const OOBB &)oobb, contacts);
   }
 
 
   /**
    * Non-accurate heightmap test. Returns data of the point directly below the sphere
    */
-  std::vector<GeometryContact> sphereHeightmapContact(const Geometry &sphereGeometry, const Geometry &heightMapGeometry) const {
-    const Sphere &sphere = (const Sphere &)sphereGeometry;
-    const HeightMapGeometry &heightmap = (const HeightMapGeometry &)heightMapGeometry;
-
-    vector aabbClosestPoint = heightmap.closestPoint(sphere.getOrigin());
-    aabbClosestPoint.y = heightmap.heightAt(aabbClosestPoint.x, aabbClosestPoint.z);
-
-    if(sphere.contains(aabbClosestPoint)) {
-      vector delta = sphere.getOrigin() - aabbClosestPoint;
-      real distance = delta.modulo();
-      //vector normal = delta * (1.0 / distance); // method 1 - upwards pointing normal
-      vector normal = heightmap.normalAt(aabbClosestPoint.x, aabbClosestPoint.z); // method 2 - triangle normal
-      real penetration = sphere.getRadius() - distance;
-
-      return std::vector<GeometryContact> {GeometryContact(&sphere, &heightMapGeometry, aabbClosestPoint, normal, 0.8f,  penetration) };
-    }
-
-  return std::vector<GeometryContact>();
-}
+  void sphereHeightmapContact(const Geometry &sphere, const Geometry &heightmap, ContactBuffer &contacts) const {
+    IntersectionHelper::sphereHeightmapContact((const Sphere &)sphere, (const HeightMapGeometry &)heightmap, contacts);
+  }
 
 
 
   /**
    * AABB contact determination
    */
-  std::vector<GeometryContact> aabbAabbContact(const Geometry &aabbGeometry, const Geometry &anotherAabbGeometry) const {
+  void aabbAabbContact(const Geometry &aabbGeometry, const Geometry &anotherAabbGeometry, ContactBuffer &contacts) const {
       const AABB &aabb = (const AABB &)aabbGeometry;
       const AABB &anotherAabb = (const AABB &)anotherAabbGeometry;
-
-      return std::vector<GeometryContact>();
   }
 
-  std::vector<GeometryContact> aabbOobbContact(const Geometry &aabbGeometry, const Geometry &anotherOobbGeometry) const {
-      return std::vector<GeometryContact>();
+  void aabbOobbContact(const Geometry &aabb, const Geometry &oobb, ContactBuffer &contacts) const {
+      IntersectionHelper::aabbOobbContact((const AABB &)aabb, (const OOBB &)oobb, contacts);
   }
 
 
   /**
    * OOBB contact determination
    */
-  std::vector<GeometryContact> oobbOobbContact(const Geometry &oobbGeometry, const Geometry &anotherOobbGeometry) const {
-      return std::vector<GeometryContact>();
+  void oobbOobbContact(const Geometry &oobb, const Geometry &anotherOobb, ContactBuffer &contacts) const {
+      IntersectionHelper::oobbOobbContact((const OOBB &)oobb, (const OOBB &)anotherOobb, contacts);
   }
 };
@@ -0,0 +1,127 @@
+/*
+ * ContactBuffer.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: leandro
+ */
+
+#pragma once
+
+#include <vector>
+#include <utility>
+#include "GeometryContact.h"
+
+/**
+ * Caller owned sink for contacts. Contact kernels append into it instead of returning a new std::vector per call,
+ * so a buffer reused across frames (clear() keeps its memory) makes contact generation allocation free once warmed up.
+ *
+ * Two modes:
+ *  - unbounded (default constructor): grows as needed. Steady state frames do not allocate once the buffer has grown to the largest frame.
+ *  - bounded (capacity constructor): memory is reserved up front and never grows. Contacts past capacity are dropped and the overflow flag is set,
+ *    so that callers can detect it and, for instance, process the batch and continue, or grow the buffer for next frame.
+ *
+ * ContactBuffer holds GeometryContacts; mixed precision kernels append into a BasicContactBuffer of their PairContact.
+ */
+template<typename Contact> class BasicContactBuffer {
+  std::vector<Contact> contacts;
+  unsigned int capacity = 0;
+  bool overflow = false;
+public:
+  BasicContactBuffer() {
+  }
+
+  BasicContactBuffer(unsigned int capacity) {
+    this->capacity = capacity;
+    this->contacts.reserve(capacity);
+  }
+
+  /**
+   * Returns false, setting the overflow flag, if the contact was dropped because the buffer is full
+   */
+  bool add(const Contact &contact) {
+    if(isFull()) {
+      overflow = true;
+      return false;
+    }
+
+    contacts.push_back(contact);
+    return true;
+  }
+
+  template<typename... Arguments> bool emplace(Arguments&&... arguments) {
+    if(isFull()) {
+      overflow = true;
+      return false;
+    }
+
+    contacts.emplace_back(std::forward<Arguments>(arguments)...);
+    return true;
+  }
+
+  /**
+   * Removes contacts and resets the overflow flag, keeping memory
+   */
+  void clear() {
+    contacts.clear();
+    overflow = false;
+  }
+
+  /**
+   * Bounded buffers keep at most capacity contacts. Zero for unbounded buffers.
+   */
+  unsigned int getCapacity() const {
+    return capacity;
+  }
+
+  bool isBounded() const {
+    return capacity > 0;
+  }
+
+  bool isFull() const {
+    return capacity > 0 && contacts.size() >= capacity;
+  }
+
+  bool isOverflowed() const {
+    return overflow;
+  }
+
+  unsigned int size() const {
+    return contacts.size();
+  }
+
+  bool empty() const {
+    return contacts.empty();
+  }
+
+  const Contact &operator[](unsigned int index) const {
+    return contacts[index];
+  }
+
+  Contact &operator[](unsigned int index) {
+    return contacts[index];
+  }
+
+  typename std::vector<Contact>::const_iterator begin() const {
+    return contacts.begin();
+  }
+
+  typename std::vector<Contact>::const_iterator end() const {
+    return contacts.end();
+  }
+
+  const std::vector<Contact> &getContacts() const {
+    return contacts;
+  }
+
+  /**
+   * Moves contacts out, leaving the buffer empty - used by the std::vector returning apis
+   */
+  std::vector<Contact> release() {
+    std::vector<Contact> released(std::move(contacts));
+    contacts.clear();
+    overflow = false;
+    return released;
+  }
+};
+
+typedef BasicContactBuffer<GeometryContact> ContactBuffer;
@@ -0,0 +1,416 @@
+/*
+ * ContactCache.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: leandro
+ */
+
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <Geometry.h>
+#include "GeometryContact.h"
+#include "ContactBuffer.h"
+#include "CollisionTester.h"
+
+/**
+ * Contact point kept across frames, with the data a solver needs to warm start: impulses applied last frame and how many frames in a row it was seen.
+ */
+class ManifoldPoint {
+  GeometryContact contact;
+  real normalImpulse = 0;
+  vector tangentImpulse = vector(0, 0, 0);
+  unsigned int persistence = 0;
+public:
+  ManifoldPoint() : contact(nullptr, nullptr, vector(0, 0, 0), vector(0, 0, 0), 0) {
+  }
+
+  ManifoldPoint(const GeometryContact &contact) : contact(contact) {
+  }
+
+  const GeometryContact &getContact() const {
+    return contact;
+  }
+
+  void setContact(const GeometryContact &contact) {
+    this->contact = contact;
+  }
+
+  /**
+   * Accumulated normal impulse, written back by the solver and carried over to next frame if the point is matched
+   */
+  real getNormalImpulse() const {
+    return normalImpulse;
+  }
+
+  void setNormalImpulse(real normalImpulse) {
+    this->normalImpulse = normalImpulse;
+  }
+
+  /**
+   * Accumulated friction impulse, as a vector on the contact plane so that it does not depend on a tangent basis
+   */
+  const vector &getTangentImpulse() const {
+    return tangentImpulse;
+  }
+
+  void setTangentImpulse(const vector &tangentImpulse) {
+    this->tangentImpulse = tangentImpulse;
+  }
+
+  /**
+   * Number of consecutive frames this point was matched to a contact from the previous frame. Zero for new points.
+   */
+  unsigned int getPersistence() const {
+    return persistence;
+  }
+
+  bool isWarmStarted() const {
+    return persistence > 0;
+  }
+
+  /**
+   * Takes over warm start data from the matching point of the previous frame
+   */
+  void carryOver(const ManifoldPoint &previous) {
+    this->normalImpulse = previous.normalImpulse;
+    this->tangentImpulse = previous.tangentImpulse;
+    this->persistence = previous.persistence + 1;
+  }
+};
+
+/**
+ * Contact points of a pair of geometries. Points are oriented from geometryA to geometryB, geometryA being the lower address,
+ * so a pair has the same manifold whichever operand order it was tested in.
+ */
+class ContactManifold {
+public:
+  static constexpr unsigned int MAX_POINTS = 4;
+
+private:
+  const Geometry *geometryA;
+  const Geometry *geometryB;
+  ManifoldPoint points[MAX_POINTS];
+  unsigned int matches[MAX_POINTS]; // previous point each point carried over from, MAX_POINTS if none
+  unsigned int count = 0;
+  ManifoldPoint previousPoints[MAX_POINTS];
+  unsigned int previousCount = 0;
+  unsigned long frame = 0;
+  CachedSimplex simplex;
+
+  friend class ContactCache;
+public:
+  ContactManifold(const Geometry *geometryA, const Geometry *geometryB) {
+    this->geometryA = geometryA;
+    this->geometryB = geometryB;
+  }
+
+  const Geometry *getGeometryA() const {
+    return geometryA;
+  }
+
+  const Geometry *getGeometryB() const {
+    return geometryB;
+  }
+
+  unsigned int size() const {
+    return count;
+  }
+
+  const ManifoldPoint &operator[](unsigned int index) const {
+    return points[index];
+  }
+
+  /**
+   * Mutable access for solvers to write back impulses
+   */
+  ManifoldPoint &getPoint(unsigned int index) {
+    return points[index];
+  }
+
+  /**
+   * Last GJK simplex of the pair, if its contacts come from the GJK / EPA fallback - see ContactCache::detectCollision
+   */
+  const CachedSimplex &getSimplex() const {
+    return simplex;
+  }
+
+  /**
+   * Frame this manifold was last updated in
+   */
+  unsigned long getFrame() const {
+    return frame;
+  }
+};
+
+/**
+ * Persistent cache of contact manifolds keyed by geometry identity (addresses), so results carry over from frame to frame.
+ *
+ * Usage, once per frame:
+ *    cache.beginFrame();
+ *    for each candidate pair: contacts.clear(); collisionTester.detectCollision(a, b, contacts); cache.addContacts(contacts);
+ *    cache.endFrame();          // evicts pairs that got no contacts this frame - they stopped overlapping
+ *    for each manifold: solve, warm starting from point impulses, and write impulses back with getPoint(i).setNormalImpulse(...)
+ *
+ * New contacts are matched to last frame points of the same pair by position and normal. Matched points inherit impulses and persistence.
+ * Matching is exclusive: a previous point carries over to at most one new point, the closest one, so impulses are never applied twice.
+ * A manifold keeps up to MAX_POINTS points - past that, a new contact replaces the shallowest point if it is deeper.
+ *
+ * Manifolds live in a dense vector: pointers and references to them are invalidated by addContacts and endFrame.
+ * Geometries are not owned - remove() pairs of geometries that are destroyed, or clear() the cache.
+ *
+ * detectCollision() runs the narrow phase and adds contacts in one step, warm starting GJK / EPA fallbacks from the simplex kept in the manifold
+ * of the pair. That state is per pair and owned by the caller, so contacts do not depend on other pairs nor on the order pairs are tested in.
+ */
+class ContactCache {
+  struct PairKey {
+    const Geometry *geometryA;
+    const Geometry *geometryB;
+
+    bool operator==(const PairKey &other) const {
+      return geometryA == other.geometryA && geometryB == other.geometryB;
+    }
+  };
+
+  struct PairKeyHash {
+    std::size_t operator()(const PairKey &key) const {
+      std::size_t hash = std::hash<const Geometry *>()(key.geometryA);
+      return hash ^ (std::hash<const Geometry *>()(key.geometryB) + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2));
+    }
+  };
+
+  std::vector<ContactManifold> manifolds;
+  std::unordered_map<PairKey, unsigned int, PairKeyHash> manifoldIndices;
+  unsigned long frame = 0;
+  unsigned int lastIndex = 0;
+  real matchDistance;
+  real matchCosine;
+
+public:
+  /**
+   * A new contact matches a previous one if intersection points are closer than matchDistance, and normals are within acos(matchCosine)
+   */
+  ContactCache(real matchDistance = 0.1, real matchCosine = 0.95) {
+    this->matchDistance = matchDistance;
+    this->matchCosine = matchCosine;
+  }
+
+  void beginFrame() {
+    frame++;
+  }
+
+  void addContact(const GeometryContact &contact) {
+    bool reversed = std::less<const Geometry *>()(contact.getGeometryB(), contact.getGeometryA());
+    PairKey key = reversed ? PairKey {contact.getGeometryB(), contact.getGeometryA()} : PairKey {contact.getGeometryA(), contact.getGeometryB()};
+
+    ContactManifold &manifold = getOrCreateManifold(key);
+    if(manifold.frame != frame) {
+      for(unsigned int index = 0; index < manifold.count; index++) {
+        manifold.previousPoints[index] = manifold.points[index];
+      }
+      manifold.previousCount = manifold.count;
+      manifold.count = 0;
+      manifold.frame = frame;
+    }
+
+    ManifoldPoint point(reversed ? contact.reverse() : contact);
+    unsigned int slot = manifold.count;
+    if(manifold.count < ContactManifold::MAX_POINTS) {
+      manifold.count++;
+    } else {
+      slot = 0;
+      for(unsigned int index = 1; index < manifold.count; index++) {
+        if(manifold.points[index].getContact().getPenetration() < manifold.points[slot].getContact().getPenetration()) {
+          slot = index;
+        }
+      }
+
+      if(manifold.points[slot].getContact().getPenetration() >= point.getContact().getPenetration()) {
+        return;
+      }
+    }
+
+    manifold.points[slot] = point;
+    match(manifold, slot);
+  }
+
+  /**
+   * Appends the contacts of the pair to contacts and adds them, same as collisionTester.detectCollision(a, b, contacts) then addContacts(),
+   * with GJK / EPA fallbacks warm started from the last frame of the pair. Contacts already in the buffer are not added again.
+   */
+  void detectCollision(const CollisionTester &collisionTester, const Geometry &geometryA, const Geometry &geometryB, ContactBuffer &contacts) {
+    const ContactManifold *manifold = find(&geometryA, &geometryB);
+    CachedSimplex simplex = manifold != nullptr ? manifold->simplex : CachedSimplex();
+
+    unsigned int first = contacts.size();
+    collisionTester.detectCollision(geometryA, geometryB, contacts, simplex);
+    for(unsigned int index = first; index < contacts.size(); index++) {
+      addContact(contacts[index]);
+    }
+
+    ContactManifold *updated = contacts.size() > first ? find(&geometryA, &geometryB) : nullptr;
+    if(updated != nullptr) {
+      updated->simplex = simplex;
+    }
+  }
+
+  void addContacts(const ContactBuffer &contacts) {
+    for(const GeometryContact &contact : contacts) {
+      addContact(contact);
+    }
+  }
+
+  void addContacts(const std::vector<GeometryContact> &contacts) {
+    for(const GeometryContact &contact : contacts) {
+      addContact(contact);
+    }
+  }
+
+  /**
+   * Evicts manifolds that got no contacts since beginFrame(). Returns the number of evicted pairs.
+   */
+  unsigned int endFrame() {
+    unsigned int evicted = 0;
+    unsigned int index = 0;
+    while(index < manifolds.size()) {
+      if(manifolds[index].frame != frame) {
+        removeAt(index);
+        evicted++;
+      } else {
+        index++;
+      }
+    }
+
+    return evicted;
+  }
+
+  /**
+   * Returns the manifold of the pair, in any operand order, or nullptr if the pair has no contacts
+   */
+  const ContactManifold *find(const Geometry *geometryA, const Geometry *geometryB) const {
+    auto iterator = manifoldIndices.find(makeKey(geometryA, geometryB));
+    return iterator == manifoldIndices.end() ? nullptr : &manifolds[iterator->second];
+  }
+
+  ContactManifold *find(const Geometry *geometryA, const Geometry *geometryB) {
+    auto iterator = manifoldIndices.find(makeKey(geometryA, geometryB));
+    return iterator == manifoldIndices.end() ? nullptr : &manifolds[iterator->second];
+  }
+
+  bool remove(const Geometry *geometryA, const Geometry *geometryB) {
+    auto iterator = manifoldIndices.find(makeKey(geometryA, geometryB));
+    if(iterator == manifoldIndices.end()) {
+      return false;
+    }
+
+    removeAt(iterator->second);
+    return true;
+  }
+
+  std::vector<ContactManifold> &getManifolds() {
+    return manifolds;
+  }
+
+  const std::vector<ContactManifold> &getManifolds() const {
+    return manifolds;
+  }
+
+  unsigned int size() const {
+    return manifolds.size();
+  }
+
+  void clear() {
+    manifolds.clear();
+    manifoldIndices.clear();
+  }
+
+protected:
+  static PairKey makeKey(const Geometry *geometryA, const Geometry *geometryB) {
+    return std::less<const Geometry *>()(geometryB, geometryA) ? PairKey {geometryB, geometryA} : PairKey {geometryA, geometryB};
+  }
+
+  ContactManifold &getOrCreateManifold(const PairKey &key) {
+    if(lastIndex < manifolds.size() && manifolds[lastIndex].geometryA == key.geometryA && manifolds[lastIndex].geometryB == key.geometryB) {
+      return manifolds[lastIndex]; // contacts of a pair usually come in a row
+    }
+
+    auto iterator = manifoldIndices.find(key);
+    if(iterator != manifoldIndices.end()) {
+      lastIndex = iterator->second;
+    } else {
+      lastIndex = manifolds.size();
+      manifoldIndices[key] = lastIndex;
+      manifolds.emplace_back(key.geometryA, key.geometryB);
+    }
+
+    return manifolds[lastIndex];
+  }
+
+  /**
+   * Carries over the closest previous point within matchDistance with a similar normal, unless a point of this frame is closer to it.
+   * A point of this frame that was farther loses it and is matched again, to its next closest previous point.
+   */
+  void match(ContactManifold &manifold, unsigned int index) const {
+    const GeometryContact &contact = manifold.points[index].getContact();
+    manifold.matches[index] = ContactManifold::MAX_POINTS;
+    unsigned int matched = ContactManifold::MAX_POINTS;
+    real closestDistance = matchDistance * matchDistance;
+
+    for(unsigned int previous = 0; previous < manifold.previousCount; previous++) {
+      const GeometryContact &previousContact = manifold.previousPoints[previous].getContact();
+      real distance = matchingDistance(previousContact, contact);
+      if(distance <= closestDistance && previousContact.getNormal() * contact.getNormal() >= matchCosine) {
+        unsigned int holder = findHolder(manifold, previous);
+        if(holder == ContactManifold::MAX_POINTS || distance < matchingDistance(previousContact, manifold.points[holder].getContact())) {
+          closestDistance = distance;
+          matched = previous;
+        }
+      }
+    }
+
+    if(matched == ContactManifold::MAX_POINTS) {
+      return;
+    }
+
+    unsigned int holder = findHolder(manifold, matched);
+    manifold.matches[index] = matched;
+    manifold.points[index].carryOver(manifold.previousPoints[matched]);
+    if(holder != ContactManifold::MAX_POINTS) {
+      manifold.points[holder] = ManifoldPoint(manifold.points[holder].getContact());
+      match(manifold, holder);
+    }
+  }
+
+  /**
+   * Point of this frame that carried over the previous point, or MAX_POINTS
+   */
+  static unsigned int findHolder(const ContactManifold &manifold, unsigned int previous) {
+    for(unsigned int index = 0; index < manifold.count; index++) {
+      if(manifold.matches[index] == previous) {
+        return index;
+      }
+    }
+    return ContactManifold::MAX_POINTS;
+  }
+
+  static real matchingDistance(const GeometryContact &previous, const GeometryContact &contact) {
+    vector delta = previous.getIntersection() - contact.getIntersection();
+    return delta * delta;
+  }
+
+  /**
+   * Swap and pop, keeping manifolds dense
+   */
+  void removeAt(unsigned int index) {
+    const ContactManifold &removed = manifolds[index];
+    manifoldIndices.erase(PairKey {removed.geometryA, removed.geometryB});
+
+    if(index != manifolds.size() - 1) {
+      manifolds[index] = manifolds.back();
+      manifoldIndices[PairKey {manifolds[index].geometryA, manifolds[index].geometryB}] = index;
+    }
+    manifolds.pop_back();
+  }
+};
@@ -0,0 +1,485 @@
+/*
+ * ContinuousCollisionTester.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: leandro
+ */
+
+#pragma once
+
+#include <limits>
+#include <cmath>
+#include <algorithm>
+#include <Geometry.h>
+#include "GeometryContact.h"
+#include "ContactBuffer.h"
+#include "IntersectionHelper.h"
+#include "GjkEpa.h"
+
+/**
+ * Result of a swept test. Time is the fraction of the motion, in [0, 1], at which the geometries first touch - zero if they already intersect at the start.
+ * Intersection and normal are the contact at that time, the normal pointing from the second geometry towards the first.
+ *
+ * Inconclusive results are not hits: conservative advancement ran out of iterations short of touching, or found the geometries intersecting at the
+ * start without a penetration direction. Time is then how far along the motion the geometries are known not to touch - callers should move them
+ * that far only, and sweep again. Intersection and normal are not set.
+ */
+struct TimeOfImpact {
+  bool hit = false;
+  bool inconclusive = false;
+  real time = 1;
+  vector intersection;
+  vector normal;
+  unsigned int iterations = 0;
+};
+
+/**
+ * Swept (continuous) collision tests: geometries move from their current origin to an end origin over the step, and the earliest time they touch is returned.
+ * Fast moving geometries can not tunnel through thin ones, however large the step.
+ *
+ * Motion is a translation: geometries keep their orientation along the step. Rotation is not swept - oobbs keep the axes they have at the start,
+ * so the corners of a box spinning fast over the step can still tunnel.
+ * Sphere / sphere, sphere / aabb, aabb / aabb and convex / plane pairs are solved analytically. Other convex pairs (those with getSupportPoint, see GjkEpa)
+ * use conservative advancement: geometries are moved together by their GJK distance over their closing speed until they are within tolerance.
+ *
+ * Runtime dispatch on geometry types, same as CollisionTester.
+ */
+class ContinuousCollisionTester {
+public:
+  typedef bool (ContinuousCollisionTester::*SweepTest)(const Geometry &, const vector &, const Geometry &, const vector &, TimeOfImpact &) const;
+
+  static constexpr unsigned int maxIterations = 32;
+
+protected:
+  struct DispatchEntry {
+    SweepTest test = nullptr;
+    bool swapped = false;
+  };
+
+  /**
+   * Geometry translated by offset, for GJK along the motion without copying geometries
+   */
+  struct TranslatedGeometry {
+    const Geometry &geometry;
+    vector offset;
+
+    vector getOrigin() const {
+      return geometry.getOrigin() + offset;
+    }
+
+    vector getSupportPoint(const vector &direction) const {
+      return geometry.getSupportPoint(direction) + offset;
+    }
+  };
+
+  DispatchEntry sweepTestsTable[GEOMETRY_TYPE_COUNT][GEOMETRY_TYPE_COUNT];
+  real tolerance;
+
+public:
+  /**
+   * Tolerance is the distance, in world units, at which conservative advancement considers geometries touching
+   */
+  ContinuousCollisionTester(real tolerance = 0.001) {
+    this->tolerance = tolerance;
+    this->addSweepTests();
+    this->addConvexFallbackTests();
+  }
+
+  virtual ~ContinuousCollisionTester() {
+  }
+
+  real getTolerance() const {
+    return tolerance;
+  }
+
+  void addSweepTests() {
+    this->addSweepTest(GeometryType::SPHERE, GeometryType::SPHERE, &ContinuousCollisionTester::sphereSphere);
+    this->addSweepTest(GeometryType::SPHERE, GeometryType::AABB, &ContinuousCollisionTester::sphereAabb);
+    this->addSweepTest(GeometryType::AABB, GeometryType::AABB, &ContinuousCollisionTester::aabbAabb);
+
+    this->addSweepTest(GeometryType::SPHERE, GeometryType::PLANE, &ContinuousCollisionTester::convexPlane);
+    this->addSweepTest(GeometryType::AABB, GeometryType::PLANE, &ContinuousCollisionTester::convexPlane);
+    this->addSweepTest(GeometryType::OOBB, GeometryType::PLANE, &ContinuousCollisionTester::convexPlane);
+  }
+
+  /**
+   * Convex pairs without an analytic test use conservative advancement. Called after the analytic tests are added.
+   */
+  void addConvexFallbackTests() {
+    const GeometryType convexTypes[] = {GeometryType::SPHERE, GeometryType::AABB, GeometryType::OOBB};
+
+    for(GeometryType typeOp1 : convexTypes) {
+      for(GeometryType typeOp2 : convexTypes) {
+        if(sweepTestsTable[(unsigned int)typeOp1][(unsigned int)typeOp2].test == nullptr) {
+          this->addSweepTest(typeOp1, typeOp2, &ContinuousCollisionTester::convexConvex);
+        }
+      }
+    }
+  }
+
+  /**
+   * Registers test for (typeOp1, typeOp2) and, unless already explicitly registered, the swapped entry for (typeOp2, typeOp1).
+   */
+  virtual void addSweepTest(const GeometryType &typeOp1, const GeometryType &typeOp2, SweepTest sweepTest) {
+    DispatchEntry &entry = sweepTestsTable[(unsigned int)typeOp1][(unsigned int)typeOp2];
+    entry.test = sweepTest;
+    entry.swapped = false;
+
+    DispatchEntry &swappedEntry = sweepTestsTable[(unsigned int)typeOp2][(unsigned int)typeOp1];
+    if(swappedEntry.test == nullptr || swappedEntry.swapped) {
+      swappedEntry.test = sweepTest;
+      swappedEntry.swapped = true;
+    }
+  }
+
+  /**
+   * Earliest time op1 moving to end and op2 moving to anotherEnd touch. Returns false if they do not meet along the step, or if there is no test for the pair.
+   */
+  virtual bool timeOfImpact(const Geometry &op1, const vector &end, const Geometry &op2, const vector &anotherEnd, TimeOfImpact &result) const {
+    result = TimeOfImpact();
+    const DispatchEntry &entry = sweepTestsTable[(unsigned int)op1.getType()][(unsigned int)op2.getType()];
+
+    if(entry.test == nullptr) {
+      return false;
+    }
+
+    if(!entry.swapped) {
+      return (this->*entry.test)(op1, end - op1.getOrigin(), op2, anotherEnd - op2.getOrigin(), result);
+    }
+
+    if(!(this->*entry.test)(op2, anotherEnd - op2.getOrigin(), op1, end - op1.getOrigin(), result)) {
+      return false;
+    }
+
+    result.normal = vector(0, 0, 0) - result.normal;
+    return true;
+  }
+
+  /**
+   * Appends the contact at the time of impact, if any, and returns that time - 1 if geometries do not meet along the step. Inconclusive sweeps
+   * append no contact and return how far the geometries can safely move.
+   */
+  real detectCollision(const Geometry &op1, const vector &end, const Geometry &op2, const vector &anotherEnd, ContactBuffer &contacts) const {
+    TimeOfImpact result;
+    if(!timeOfImpact(op1, end, op2, anotherEnd, result)) {
+      return result.inconclusive ? result.time : 1;
+    }
+
+    contacts.emplace(&op1, &op2, result.intersection, result.normal, 0.8f, 0.0);
+    return result.time;
+  }
+
+  bool hasSweepTest(GeometryType typeOp1, GeometryType typeOp2) const {
+    return sweepTestsTable[(unsigned int)typeOp1][(unsigned int)typeOp2].test != nullptr;
+  }
+
+  /**
+   * Analytic sweeps on concrete types. Motions are the displacements of each geometry over the step.
+   */
+  static bool sphereSphere(const Sphere &sphere, const vector &motion, const Sphere &anotherSphere, const vector &anotherMotion, TimeOfImpact &result) {
+    vector delta = sphere.getOrigin() - anotherSphere.getOrigin();
+    vector relativeMotion = motion - anotherMotion;
+    real radiuses = sphere.getRadius() + anotherSphere.getRadius();
+
+    real time = 0;
+    real c = delta * delta - radiuses * radiuses;
+    if(c > 0) {
+      real b = delta * relativeMotion;
+      real a = relativeMotion * relativeMotion;
+      real discriminant = b * b - a * c;
+      if(b >= 0 || discriminant < 0) { // moving apart, or missing
+        return false;
+      }
+
+      time = (-b - std::sqrt(discriminant)) / a;
+      if(time > 1) {
+        return false;
+      }
+    }
+
+    vector origin = sphere.getOrigin() + motion * time;
+    vector normal = delta + relativeMotion * time;
+    normal = normal * normal > 0 ? normal.normalizado() : vector(0, 1, 0);
+    return hit(result, time, origin - normal * sphere.getRadius(), normal);
+  }
+
+  /**
+   * The sphere center moving against the aabb grown by the radius, with rounded edges and corners (Ericson, Real-Time Collision Detection 5.5.7):
+   * a slab test against the grown aabb, then capsule tests if the entry point is in an edge or corner region.
+   */
+  static bool sphereAabb(const Sphere &sphere, const vector &motion, const AABB &aabb, const vector &anotherMotion, TimeOfImpact &result) {
+    const vector &center = sphere.getOrigin();
+    real radius = sphere.getRadius();
+    vector mins = aabb.getMins();
+    vector maxs = aabb.getMaxs();
+    vector closestPoint = aabb.closestPoint(center);
+    vector delta = center - closestPoint;
+
+    if(delta * delta <= radius * radius) {
+      if(equalsZeroAbsoluteMargin(delta * delta)) { // center inside, push out through the closest face
+        closestPoint = aabb.closestSurfacePoint(center);
+        delta = closestPoint - center;
+      }
+      return hit(result, 0, closestPoint, delta * delta > 0 ? delta.normalizado() : vector(0, 1, 0));
+    }
+
+    vector relativeMotion = motion - anotherMotion;
+    vector margin(radius, radius, radius);
+    vector inverseMotion((real)1 / relativeMotion.x, (real)1 / relativeMotion.y, (real)1 / relativeMotion.z);
+    real tEnter, tExit;
+    if(!IntersectionHelper::lineAabb(center, inverseMotion, mins - margin, maxs + margin, tEnter, tExit) || tEnter > 1) {
+      return false;
+    }
+
+    real time = std::max(tEnter, (real)0);
+    vector entry = center + relativeMotion * time;
+    unsigned int below = (entry.x < mins.x ? 1 : 0) | (entry.y < mins.y ? 2 : 0) | (entry.z < mins.z ? 4 : 0);
+    unsigned int above = (entry.x > maxs.x ? 1 : 0) | (entry.y > maxs.y ? 2 : 0) | (entry.z > maxs.z ? 4 : 0);
+    unsigned int outside = below | above;
+    unsigned int outsideCount = (outside & 1) + ((outside >> 1) & 1) + ((outside >> 2) & 1);
+
+    if(outsideCount == 3) { // corner region: earliest of the three edges meeting at the corner
+      real earliest = std::numeric_limits<real>::infinity();
+      for(unsigned int axis = 0; axis < 3; axis++) {
+        real edgeTime;
+        if(segmentCapsule(center, relativeMotion, boxVertex(mins, maxs, above), boxVertex(mins, maxs, above ^ (1u << axis)), radius, edgeTime)) {
+          earliest = std::min(earliest, edgeTime);
+        }
+      }
+      if(earliest > 1) {
+        return false;
+      }
+      time = earliest;
+    } else if(outsideCount == 2) { // edge region
+      unsigned int axis = 7 & ~outside;
+      if(!segmentCapsule(center, relativeMotion, boxVertex(mins, maxs, above), boxVertex(mins, maxs, above | axis), radius, time)) {
+        return false;
+      }
+    }
+
+    vector origin = center + motion * time;
+    vector aabbOffset = anotherMotion * time;
+    vector contactPoint = aabb.closestPoint(origin - aabbOffset) + aabbOffset;
+    vector normal = origin - contactPoint;
+    return hit(result, time, contactPoint, normal * normal > 0 ? normal.normalizado() : vector(0, 1, 0));
+  }
+
+  /**
+   * Slab test of the relative motion against the minkowski difference of both aabbs
+   */
+  static bool aabbAabb(const AABB &aabb, const vector &motion, const AABB &anotherAabb, const vector &anotherMotion, TimeOfImpact &result) {
+    vector halfSizes = aabb.getHalfSizes() + anotherAabb.getHalfSizes();
+    vector delta = aabb.getOrigin() - anotherAabb.getOrigin();
+    vector relativeMotion = motion - anotherMotion;
+    vector inverseMotion((real)1 / relativeMotion.x, (real)1 / relativeMotion.y, (real)1 / relativeMotion.z);
+
+    real tEnter, tExit;
+    bool overlapping = std::fabs(delta.x) <= halfSizes.x && std::fabs(delta.y) <= halfSizes.y && std::fabs(delta.z) <= halfSizes.z;
+    if(!overlapping && (!IntersectionHelper::lineAabb(delta, inverseMotion, vector(0, 0, 0) - halfSizes, halfSizes, tEnter, tExit) || tEnter > 1)) {
+      return false;
+    }
+
+    real time = overlapping ? 0 : tEnter;
+    delta = delta + relativeMotion * time;
+
+    vector normal(0, 1, 0); // touching face: smallest overlap for starting intersections, the face entered otherwise - both are the axis closest to separating
+    real separation = -std::numeric_limits<real>::infinity();
+    const real distances[3] = {std::fabs(delta.x) - halfSizes.x, std::fabs(delta.y) - halfSizes.y, std::fabs(delta.z) - halfSizes.z};
+    const real signs[3] = {delta.x < 0 ? (real)-1 : (real)1, delta.y < 0 ? (real)-1 : (real)1, delta.z < 0 ? (real)-1 : (real)1};
+    for(unsigned int axis = 0; axis < 3; axis++) {
+      if(distances[axis] > separation) {
+        separation = distances[axis];
+        normal = vector(axis == 0 ? signs[0] : 0, axis == 1 ? signs[1] : 0, axis == 2 ? signs[2] : 0);
+      }
+    }
+
+    vector origin = aabb.getOrigin() + motion * time;
+    vector anotherOrigin = anotherAabb.getOrigin() + anotherMotion * time;
+    vector overlapMins = vector(std::max(origin.x - aabb.getHalfSizes().x, anotherOrigin.x - anotherAabb.getHalfSizes().x),
+        std::max(origin.y - aabb.getHalfSizes().y, anotherOrigin.y - anotherAabb.getHalfSizes().y),
+        std::max(origin.z - aabb.getHalfSizes().z, anotherOrigin.z - anotherAabb.getHalfSizes().z));
+    vector overlapMaxs = vector(std::min(origin.x + aabb.getHalfSizes().x, anotherOrigin.x + anotherAabb.getHalfSizes().x),
+        std::min(origin.y + aabb.getHalfSizes().y, anotherOrigin.y + anotherAabb.getHalfSizes().y),
+        std::min(origin.z + aabb.getHalfSizes().z, anotherOrigin.z + anotherAabb.getHalfSizes().z));
+
+    return hit(result, time, (overlapMins + overlapMaxs) * 0.5, normal);
+  }
+
+  /**
+   * Plane as a half space, same as planeSphereContact. The deepest point of a convex geometry along the plane normal moves linearly, so the sweep is exact.
+   */
+  static bool convexPlane(const Geometry &geometry, const vector &motion, const Plane &plane, const vector &anotherMotion, TimeOfImpact &result) {
+    const vector &normal = plane.getNormal();
+    vector deepest = geometry.getSupportPoint(vector(0, 0, 0) - normal);
+    real distance = (deepest - plane.getOrigin()) * normal;
+
+    real time = 0;
+    if(distance > 0) {
+      real approach = (motion - anotherMotion) * normal;
+      if(distance + approach > 0) {
+        return false;
+      }
+      time = distance / -approach;
+    }
+
+    return hit(result, time, deepest + motion * time, normal);
+  }
+
+  /**
+   * Conservative advancement: the GJK distance over the closing speed along the closest points direction is a safe step, as no point of either
+   * geometry closes faster than that. Converges in a few iterations, stops within tolerance of touching - or reports an inconclusive result
+   * (see TimeOfImpact) if it does not within iterationLimit.
+   */
+  static bool conservativeAdvancement(const Geometry &a, const vector &motion, const Geometry &b, const vector &anotherMotion, real tolerance, TimeOfImpact &result,
+      unsigned int iterationLimit = maxIterations) {
+    vector relativeMotion = motion - anotherMotion;
+    real time = 0;
+    Simplex simplex; // each step starts from the features closest in the previous one
+    vector previousPointA, previousPointB; // closest points of the last step, at previousTime
+    real previousTime = 0;
+
+    for(result.iterations = 1; result.iterations <= iterationLimit; result.iterations++) {
+      TranslatedGeometry movedA = {a, motion * time};
+      TranslatedGeometry movedB = {b, anotherMotion * time};
+      GjkResult closest;
+      GjkEpa::gjk(movedA, movedB, simplex, false, closest, nullptr);
+
+      if(closest.intersecting) { // at the start, or once the last step closed the gap to within GJK tolerance
+        vector normal, pointA, pointB;
+        real depth;
+        if(GjkEpa::penetration(movedA, movedB, normal, depth, pointA, pointB)) {
+          return hit(result, time, (pointA + pointB) * 0.5, normal);
+        }
+        if(result.iterations == 1) { // touching at the start, without a penetration direction
+          return inconclusive(result, time);
+        }
+        // the contact is where the last closest points moved to
+        return hit(result, time, (previousPointA + previousPointB + (motion + anotherMotion) * (time - previousTime)) * 0.5,
+            (previousPointA - previousPointB).normalizado());
+      }
+
+      vector normal = (closest.pointA - closest.pointB) * ((real)1 / closest.distance);
+      if(closest.distance <= tolerance) {
+        return hit(result, time, (closest.pointA + closest.pointB) * 0.5, normal);
+      }
+      previousPointA = closest.pointA;
+      previousPointB = closest.pointB;
+      previousTime = time;
+
+      real closingSpeed = -(relativeMotion * normal);
+      if(closingSpeed <= 0) { // the separating plane through the closest points keeps separating them
+        return false;
+      }
+
+      time += (closest.distance - tolerance * 0.5) / closingSpeed;
+      if(time > 1) {
+        return false;
+      }
+    }
+
+    result.iterations = iterationLimit;
+    return inconclusive(result, time); // out of iterations, still short of touching
+  }
+
+protected:
+  static bool hit(TimeOfImpact &result, real time, const vector &intersection, const vector &normal) {
+    result.hit = true;
+    result.time = time;
+    result.intersection = intersection;
+    result.normal = normal;
+    return true;
+  }
+
+  static bool inconclusive(TimeOfImpact &result, real time) {
+    result.hit = false;
+    result.inconclusive = true;
+    result.time = time;
+    return false;
+  }
+
+  /**
+   * Box vertex selecting maxs for the axes set in bits (x = 1, y = 2, z = 4)
+   */
+  static vector boxVertex(const vector &mins, const vector &maxs, unsigned int bits) {
+    return vector(bits & 1 ? maxs.x : mins.x, bits & 2 ? maxs.y : mins.y, bits & 4 ? maxs.z : mins.z);
+  }
+
+  /**
+   * Earliest t in [0, 1] at which origin + direction * t is within radius of segment [start, end]: the cylinder body, then the spherical end caps.
+   */
+  static bool segmentCapsule(const vector &origin, const vector &direction, const vector &start, const vector &end, real radius, real &t) {
+    vector axis = end - start;
+    vector offset = origin - start;
+    real axisLengthSquared = axis * axis;
+    t = std::numeric_limits<real>::infinity();
+
+    vector perpendicularDirection = direction - axis * ((direction * axis) / axisLengthSquared);
+    vector perpendicularOffset = offset - axis * ((offset * axis) / axisLengthSquared);
+    real a = perpendicularDirection * perpendicularDirection;
+    real b = perpendicularOffset * perpendicularDirection;
+    real c = perpendicularOffset * perpendicularOffset - radius * radius;
+    real discriminant = b * b - a * c;
+    if(a > 0 && c > 0 && b < 0 && discriminant >= 0) {
+      real bodyTime = (-b - std::sqrt(discriminant)) / a;
+      real along = ((offset + direction * bodyTime) * axis) / axisLengthSquared;
+      if(along >= 0 && along <= 1) {
+        t = bodyTime;
+      }
+    }
+
+    real capTime;
+    if(segmentSphere(origin, direction, start, radius, capTime)) {
+      t = std::min(t, capTime);
+    }
+    if(segmentSphere(origin, direction, end, radius, capTime)) {
+      t = std::min(t, capTime);
+    }
+
+    return t <= 1;
+  }
+
+  static bool segmentSphere(const vector &origin, const vector &direction, const vector &center, real radius, real &t) {
+    vector offset = origin - center;
+    real a = direction * direction;
+    real b = offset * direction;
+    real c = offset * offset - radius * radius;
+    if(c <= 0) {
+      t = 0;
+      return true;
+    }
+
+    real discriminant = b * b - a * c;
+    if(b >= 0 || discriminant < 0) {
+      return false;
+    }
+
+    t = (-b - std::sqrt(discriminant)) / a;
+    return t <= 1;
+  }
+
+  /*****
+   *
+   * Sweep tests
+   *
+   *****/
+
+  bool sphereSphere(const Geometry &sphere, const vector &motion, const Geometry &anotherSphere, const vector &anotherMotion, TimeOfImpact &result) const {
+    return sphereSphere((const Sphere &)sphere, motion, (const Sphere &)anotherSphere, anotherMotion, result);
+  }
+
+  bool sphereAabb(const Geometry &sphere, const vector &motion, const Geometry &aabb, const vector &anotherMotion, TimeOfImpact &result) const {
+    return sphereAabb((const Sphere &)sphere, motion, (const AABB &)aabb, anotherMotion, result);
+  }
+
+  bool aabbAabb(const Geometry &aabb, const vector &motion, const Geometry &anotherAabb, const vector &anotherMotion, TimeOfImpact &result) const {
+    return aabbAabb((const AABB &)aabb, motion, (const AABB &)anotherAabb, anotherMotion, result);
+  }
+
+  bool convexPlane(const Geometry &geometry, const vector &motion, const Geometry &plane, const vector &anotherMotion, TimeOfImpact &result) const {
+    return convexPlane(geometry, motion, (const Plane &)plane, anotherMotion, result);
+  }
+
+  bool convexConvex(const Geometry &geometry, const vector &motion, const Geometry &anotherGeometry, const vector &anotherMotion, TimeOfImpact &result) const {
+    return conservativeAdvancement(geometry, motion, anotherGeometry, anotherMotion, tolerance, result);
+  }
+};
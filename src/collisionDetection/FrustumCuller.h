@@ -0,0 +1,299 @@
+/*
+ * FrustumCuller.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: leandro
+ */
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <Geometry.h>
+#include <GeometryBatch.h>
+#include "SimdLanes.h"
+
+enum class CullResult {
+  OUTSIDE,
+  INTERSECTING,
+  INSIDE
+};
+
+/**
+ * Visibility culling against the half spaces of a frustum.
+ *
+ * Half spaces follow the planeSphereContact convention: the solid side of a plane is behind its normal, that is, normals point out of the frustum.
+ * A geometry is INSIDE when it is behind every plane, OUTSIDE when it is completely in front of any plane, INTERSECTING otherwise. Touching a plane from outside
+ * counts as intersecting.
+ *
+ * Planes are copied to a structure of arrays (normals, absolute normals and plane distances) on construction, so culling never touches Plane objects.
+ * At most MAX_PLANES planes are used, so that plane sets fit in a 32 bit mask:
+ *  - single geometry tests take a mask of planes already passed (the geometry is known to be behind them) and skip those planes,
+ *    adding the planes the geometry turns out to be fully behind. collectVisible() passes this mask down HierarchicalGeometry children,
+ *    and stops testing altogether below INSIDE bounding volumes.
+ *  - batch tests cull SimdLanes<real>::width spheres or aabbs at a time against every plane.
+ */
+class FrustumCuller {
+public:
+  static constexpr unsigned int MAX_PLANES = 32;
+private:
+  std::vector<real> normalX;
+  std::vector<real> normalY;
+  std::vector<real> normalZ;
+  std::vector<real> absoluteNormalX;
+  std::vector<real> absoluteNormalY;
+  std::vector<real> absoluteNormalZ;
+  std::vector<real> distance;
+  uint32_t allPlanes = 0;
+public:
+  FrustumCuller(const Frustum &frustum) : FrustumCuller(frustum.getHalfSpaces()) {
+  }
+
+  FrustumCuller(const std::vector<Plane> &planes) {
+    setPlanes(planes);
+  }
+
+  void setPlanes(const std::vector<Plane> &planes) {
+    normalX.clear();
+    normalY.clear();
+    normalZ.clear();
+    absoluteNormalX.clear();
+    absoluteNormalY.clear();
+    absoluteNormalZ.clear();
+    distance.clear();
+
+    for(unsigned int index = 0; index < planes.size() && index < MAX_PLANES; index++) {
+      const vector &normal = planes[index].getNormal();
+      normalX.push_back(normal.x);
+      normalY.push_back(normal.y);
+      normalZ.push_back(normal.z);
+      absoluteNormalX.push_back(std::fabs(normal.x));
+      absoluteNormalY.push_back(std::fabs(normal.y));
+      absoluteNormalZ.push_back(std::fabs(normal.z));
+      distance.push_back(normal * planes[index].getOrigin());
+    }
+
+    allPlanes = normalX.size() == 32 ? 0xFFFFFFFFu : ((uint32_t)1 << normalX.size()) - 1;
+  }
+
+  unsigned int getPlaneCount() const {
+    return normalX.size();
+  }
+
+  /**
+   * Mask with one bit set per plane
+   */
+  uint32_t getAllPlanesMask() const {
+    return allPlanes;
+  }
+
+  CullResult cullSphere(const vector &center, real radius, uint32_t &passedPlanes) const {
+    for(unsigned int plane = 0; plane < normalX.size(); plane++) {
+      if(passedPlanes & ((uint32_t)1 << plane)) {
+        continue;
+      }
+
+      real signedDistance = signedDistanceTo(plane, center.x, center.y, center.z);
+      if(!(signedDistance <= radius)) {
+        return CullResult::OUTSIDE;
+      }
+      if(signedDistance <= -radius) {
+        passedPlanes |= (uint32_t)1 << plane;
+      }
+    }
+
+    return passedPlanes == allPlanes ? CullResult::INSIDE : CullResult::INTERSECTING;
+  }
+
+  /**
+   * Aabbs are given by mins and maxs - same data as AabbBatch, so that batch and single results match
+   */
+  CullResult cullAabb(const vector &mins, const vector &maxs, uint32_t &passedPlanes) const {
+    vector center = (mins + maxs) * 0.5;
+    vector halfSizes = (maxs - mins) * 0.5;
+
+    for(unsigned int plane = 0; plane < normalX.size(); plane++) {
+      if(passedPlanes & ((uint32_t)1 << plane)) {
+        continue;
+      }
+
+      real signedDistance = signedDistanceTo(plane, center.x, center.y, center.z);
+      real projectedRadius = absoluteNormalX[plane] * halfSizes.x + absoluteNormalY[plane] * halfSizes.y + absoluteNormalZ[plane] * halfSizes.z;
+      if(!(signedDistance <= projectedRadius)) {
+        return CullResult::OUTSIDE;
+      }
+      if(signedDistance <= -projectedRadius) {
+        passedPlanes |= (uint32_t)1 << plane;
+      }
+    }
+
+    return passedPlanes == allPlanes ? CullResult::INSIDE : CullResult::INTERSECTING;
+  }
+
+  /**
+   * Spheres and aabbs are tested as such, hierarchies by their bounding volume, and any other geometry by its bounds. Unbounded geometries are never culled.
+   */
+  CullResult cull(const Geometry &geometry, uint32_t &passedPlanes) const {
+    switch(geometry.getType()) {
+      case GeometryType::SPHERE: {
+        const Sphere &sphere = (const Sphere &)geometry;
+        return cullSphere(sphere.getOrigin(), sphere.getRadius(), passedPlanes);
+      }
+      case GeometryType::AABB: {
+        const AABB &aabb = (const AABB &)geometry;
+        return cullAabb(aabb.getMins(), aabb.getMaxs(), passedPlanes);
+      }
+      case GeometryType::HIERARCHY:
+        return cull(((const HierarchicalGeometry &)geometry).getBoundingVolume(), passedPlanes);
+      default: {
+        Bounds bounds = geometry.getBounds();
+        if(bounds.mins.x <= -REAL_MAX || bounds.maxs.x >= REAL_MAX) {
+          return CullResult::INTERSECTING;
+        }
+        return cullAabb(bounds.mins, bounds.maxs, passedPlanes);
+      }
+    }
+  }
+
+  CullResult cull(const Geometry &geometry) const {
+    uint32_t passedPlanes = 0;
+    return cull(geometry, passedPlanes);
+  }
+
+  /**
+   * Appends visible geometries. Hierarchies are descended, appending visible leaves: children only test planes their parent bounding volume straddles.
+   */
+  void collectVisible(const Geometry &geometry, std::vector<const Geometry *> &visible, uint32_t passedPlanes = 0) const {
+    CullResult result = cull(geometry, passedPlanes);
+
+    if(result == CullResult::OUTSIDE) {
+      return;
+    }
+
+    if(geometry.getType() == GeometryType::HIERARCHY) {
+      for(auto &child : ((const HierarchicalGeometry &)geometry).getChildren()) {
+        if(result == CullResult::INSIDE) {
+          collectAll(*child, visible);
+        } else {
+          collectVisible(*child, visible, passedPlanes);
+        }
+      }
+    } else {
+      visible.push_back(&geometry);
+    }
+  }
+
+  /**
+   * Culls every sphere in the batch - results are resized to the batch
+   */
+  void cull(const SphereBatch &batch, std::vector<CullResult> &results) const {
+    run(batch.size(), results, [&](auto lanes, unsigned int index, unsigned int &outside, unsigned int &inside) {
+      typedef decltype(lanes) Lanes;
+      typename Lanes::Register x = Lanes::load(batch.getX() + index);
+      typename Lanes::Register y = Lanes::load(batch.getY() + index);
+      typename Lanes::Register z = Lanes::load(batch.getZ() + index);
+      typename Lanes::Register radius = Lanes::load(batch.getRadiuses() + index);
+      typename Lanes::Register negativeRadius = Lanes::sub(Lanes::broadcast(0), radius);
+
+      for(unsigned int plane = 0; plane < normalX.size() && outside != laneMask<Lanes>(); plane++) {
+        typename Lanes::Register signedDistance = signedDistanceTo<Lanes>(plane, x, y, z);
+        outside |= ~Lanes::lessEqual(signedDistance, radius) & laneMask<Lanes>();
+        inside &= Lanes::lessEqual(signedDistance, negativeRadius);
+      }
+    });
+  }
+
+  /**
+   * Culls every aabb in the batch - results are resized to the batch
+   */
+  void cull(const AabbBatch &batch, std::vector<CullResult> &results) const {
+    run(batch.size(), results, [&](auto lanes, unsigned int index, unsigned int &outside, unsigned int &inside) {
+      typedef decltype(lanes) Lanes;
+      typename Lanes::Register minX = Lanes::load(batch.getMinX() + index);
+      typename Lanes::Register minY = Lanes::load(batch.getMinY() + index);
+      typename Lanes::Register minZ = Lanes::load(batch.getMinZ() + index);
+      typename Lanes::Register maxX = Lanes::load(batch.getMaxX() + index);
+      typename Lanes::Register maxY = Lanes::load(batch.getMaxY() + index);
+      typename Lanes::Register maxZ = Lanes::load(batch.getMaxZ() + index);
+
+      typename Lanes::Register half = Lanes::broadcast(0.5);
+      typename Lanes::Register centerX = Lanes::mul(Lanes::add(minX, maxX), half);
+      typename Lanes::Register centerY = Lanes::mul(Lanes::add(minY, maxY), half);
+      typename Lanes::Register centerZ = Lanes::mul(Lanes::add(minZ, maxZ), half);
+      typename Lanes::Register halfSizeX = Lanes::mul(Lanes::sub(maxX, minX), half);
+      typename Lanes::Register halfSizeY = Lanes::mul(Lanes::sub(maxY, minY), half);
+      typename Lanes::Register halfSizeZ = Lanes::mul(Lanes::sub(maxZ, minZ), half);
+
+      for(unsigned int plane = 0; plane < normalX.size() && outside != laneMask<Lanes>(); plane++) {
+        typename Lanes::Register signedDistance = signedDistanceTo<Lanes>(plane, centerX, centerY, centerZ);
+        typename Lanes::Register projectedRadius = Lanes::add(Lanes::add(
+            Lanes::mul(Lanes::broadcast(absoluteNormalX[plane]), halfSizeX),
+            Lanes::mul(Lanes::broadcast(absoluteNormalY[plane]), halfSizeY)),
+            Lanes::mul(Lanes::broadcast(absoluteNormalZ[plane]), halfSizeZ));
+
+        outside |= ~Lanes::lessEqual(signedDistance, projectedRadius) & laneMask<Lanes>();
+        inside &= Lanes::lessEqual(signedDistance, Lanes::sub(Lanes::broadcast(0), projectedRadius));
+      }
+    });
+  }
+
+protected:
+  void collectAll(const Geometry &geometry, std::vector<const Geometry *> &visible) const {
+    if(geometry.getType() == GeometryType::HIERARCHY) {
+      for(auto &child : ((const HierarchicalGeometry &)geometry).getChildren()) {
+        collectAll(*child, visible);
+      }
+    } else {
+      visible.push_back(&geometry);
+    }
+  }
+
+  real signedDistanceTo(unsigned int plane, real x, real y, real z) const {
+    return normalX[plane] * x + normalY[plane] * y + normalZ[plane] * z - distance[plane];
+  }
+
+  /**
+   * Same evaluation order as the scalar version, so that batch and single results match
+   */
+  template<typename Lanes> typename Lanes::Register signedDistanceTo(unsigned int plane, typename Lanes::Register x, typename Lanes::Register y, typename Lanes::Register z) const {
+    return Lanes::sub(Lanes::add(Lanes::add(
+        Lanes::mul(Lanes::broadcast(normalX[plane]), x),
+        Lanes::mul(Lanes::broadcast(normalY[plane]), y)),
+        Lanes::mul(Lanes::broadcast(normalZ[plane]), z)),
+        Lanes::broadcast(distance[plane]));
+  }
+
+  template<typename Lanes> static constexpr unsigned int laneMask() {
+    return (1u << Lanes::width) - 1;
+  }
+
+  /**
+   * Full registers first, then the remaining geometries one by one. Blocks start with every lane inside and none outside, and narrow these per plane.
+   */
+  template<typename Block> void run(unsigned int count, std::vector<CullResult> &results, const Block &block) const {
+    typedef SimdLanes<real> Lanes;
+
+    results.resize(count);
+
+    unsigned int index = 0;
+    for(; index + Lanes::width <= count; index += Lanes::width) {
+      unsigned int outside = 0;
+      unsigned int inside = laneMask<Lanes>();
+      block(Lanes(), index, outside, inside);
+      store(results, index, Lanes::width, outside, inside);
+    }
+    for(; index < count; index++) {
+      unsigned int outside = 0;
+      unsigned int inside = 1;
+      block(ScalarLanes<real>(), index, outside, inside);
+      store(results, index, 1, outside, inside);
+    }
+  }
+
+  static void store(std::vector<CullResult> &results, unsigned int index, unsigned int width, unsigned int outside, unsigned int inside) {
+    for(unsigned int lane = 0; lane < width; lane++) {
+      results[index + lane] = (outside >> lane) & 1 ? CullResult::OUTSIDE : ((inside >> lane) & 1 ? CullResult::INSIDE : CullResult::INTERSECTING);
+    }
+  }
+};
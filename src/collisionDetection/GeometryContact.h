@@ -10,28 +10,49 @@
 #include<Geometry.h>
 #include "BaseContact.h"
 
-class Geometry;
+/**
+ * Contact between a geometry of type GeometryA and one of type GeometryB, on scalar T. GeometryContact is the contact of real geometries,
+ * PairContact<T, U> the one mixed precision kernels return for geometries on scalars T and U.
+ */
+template<typename T, typename GeometryA = BasicGeometry<T>, typename GeometryB = GeometryA> class BasicGeometryContact : public BasicContact<T> {
+public:
+  typedef typename BasicContact<T>::vector vector;
 
-class GeometryContact : public BaseContact {
 private:
-  const Geometry *geometryA;
-  const Geometry *geometryB;
+  const GeometryA *geometryA;
+  const GeometryB *geometryB;
 
 public:
-  GeometryContact(const Geometry *geometryA, const Geometry *geometryB, const vector &intersection, const vector &normal, real restitution, real penetration = 0.0) : BaseContact (intersection, normal, restitution, penetration){
+  BasicGeometryContact(const GeometryA *geometryA, const GeometryB *geometryB, const vector &intersection, const vector &normal, T restitution, T penetration = 0.0) : BasicContact<T> (intersection, normal, restitution, penetration){
       this->geometryA = geometryA;
       this->geometryB = geometryB;
   }
 
-  const Geometry *getGeometryA() const {
+  const GeometryA *getGeometryA() const {
       return this->geometryA;
   }
 
-  const Geometry *getGeometryB() const {
+  const GeometryB *getGeometryB() const {
       return this->geometryB;
   }
 
-  GeometryContact reverse() const {
-      return GeometryContact(this->geometryB, this->geometryA, intersection, normal * -1, restitution, penetration);
+  /**
+   * Points a contact generated against a copy of a geometry (e.g. compiled into a LinearBvh) back to the original
+   */
+  void replaceGeometry(const GeometryA *geometry, const GeometryA *replacement) {
+      if(this->geometryA == geometry) {
+        this->geometryA = replacement;
+      }
+      if(this->geometryB == geometry) {
+        this->geometryB = replacement;
+      }
+  }
+
+  BasicGeometryContact<T, GeometryB, GeometryA> reverse() const {
+      return BasicGeometryContact<T, GeometryB, GeometryA>(this->geometryB, this->geometryA, this->intersection, this->normal * -1, this->restitution, this->penetration);
   }
 };
+
+typedef BasicGeometryContact<real> GeometryContact;
+
+template<typename T, typename U> using PairContact = BasicGeometryContact<WiderScalar<T, U>, BasicGeometry<T>, BasicGeometry<U>>;
@@ -0,0 +1,752 @@
+/*
+ * GjkEpa.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: leandro
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <functional>
+#include <cmath>
+#include <algorithm>
+#include <type_traits>
+#include <Geometry.h>
+#include "GeometryContact.h"
+#include "ContactBuffer.h"
+
+/**
+ * Point of the Minkowski difference a - b, with the support points of a and b it comes from and the direction it was searched in
+ */
+struct SupportVertex {
+  vector point;
+  vector pointA;
+  vector pointB;
+  vector direction;
+};
+
+struct Simplex {
+  SupportVertex vertices[4];
+  unsigned int count = 0;
+};
+
+/**
+ * Result of a GJK query. Distance and closest points are only set for separated pairs.
+ */
+struct GjkResult {
+  bool intersecting = false;
+  real distance = 0;
+  vector pointA;
+  vector pointB;
+  unsigned int iterations = 0;
+};
+
+/**
+ * Last simplex of a single pair, owned by the caller - e.g. by the ContactManifold of the pair, or next to the pair in a broad phase list.
+ * A query only warm starts from the previous query on the same pair, so results do not depend on what else was queried, nor on how threads interleave.
+ *
+ * Stored as search directions, like SimplexCache entries, with the operands they were searched for: directions stored for (b, a) are used
+ * reversed, and those of another pair are ignored.
+ */
+class CachedSimplex {
+  const void *geometryA = nullptr;
+  const void *geometryB = nullptr;
+  float directions[4][3];
+  unsigned int count = 0;
+  unsigned int iterations = 0;
+public:
+  /**
+   * Sets the directions of the vertices of simplex to the stored ones, for GjkEpa::gjk() to evaluate at the new positions. Empty on a miss.
+   */
+  void load(const void *geometryA, const void *geometryB, Simplex &simplex) const {
+    simplex.count = 0;
+    if((geometryA != this->geometryA || geometryB != this->geometryB) && (geometryA != this->geometryB || geometryB != this->geometryA)) {
+      return;
+    }
+
+    real sign = geometryA == this->geometryA ? 1 : -1; // support directions of b - a are the opposite of those of a - b
+    for(unsigned int index = 0; index < count; index++) {
+      simplex.vertices[simplex.count++].direction = vector(directions[index][0], directions[index][1], directions[index][2]) * sign;
+    }
+  }
+
+  void store(const void *geometryA, const void *geometryB, const Simplex &simplex, unsigned int iterations) {
+    this->geometryA = geometryA;
+    this->geometryB = geometryB;
+    this->count = simplex.count;
+    this->iterations = iterations;
+    for(unsigned int index = 0; index < simplex.count; index++) {
+      const vector &direction = simplex.vertices[index].direction;
+      directions[index][0] = (float)direction.x;
+      directions[index][1] = (float)direction.y;
+      directions[index][2] = (float)direction.z;
+    }
+  }
+
+  unsigned int getCount() const {
+    return count;
+  }
+
+  /**
+   * GJK iterations of the last query stored - zero if its first direction already separated the pair
+   */
+  unsigned int getIterations() const {
+    return iterations;
+  }
+
+  void clear() {
+    geometryA = nullptr;
+    geometryB = nullptr;
+    count = 0;
+    iterations = 0;
+  }
+};
+
+/**
+ * Last simplex of each pair of geometries, so that GJK on coherent frames starts next to the answer and converges in 1 or 2 iterations.
+ *
+ * Simplices are stored as the search directions of their vertices - support points are evaluated again at the new positions, so directions are
+ * kept in single precision and an entry fits a cache line: a lookup costs about one miss, which is what a cold GJK iteration costs.
+ * Direct mapped and lossy: pairs hash to a slot and evict whoever was there, so memory is fixed and lookups do not allocate.
+ * Thread safe: a slot busy in another thread is treated as a miss instead of waiting, so a cache can be shared by ParallelCollisionTester workers.
+ * Keys are geometry addresses - clear() the cache if geometries are destroyed and their addresses reused.
+ * Only intersection and distance queries are warm started: GJK either finds a separating axis or encloses the origin, whatever it starts from.
+ * Penetration and contacts never read this cache, as slots shared by all pairs would make them depend on earlier queries and on how threads
+ * interleave - they warm start from a CachedSimplex of the pair instead.
+ */
+class SimplexCache {
+  struct alignas(64) Entry {
+    const void *geometryA = nullptr;
+    const void *geometryB = nullptr;
+    float directions[4][3];
+    unsigned int count = 0;
+    std::atomic_flag busy = ATOMIC_FLAG_INIT;
+  };
+
+  std::unique_ptr<Entry[]> entries;
+  unsigned int size;
+public:
+  /**
+   * Size is rounded up to a power of two
+   */
+  SimplexCache(unsigned int size = 1024) {
+    this->size = 1;
+    while(this->size < size) {
+      this->size <<= 1;
+    }
+    entries.reset(new Entry[this->size]);
+  }
+
+  unsigned int getSize() const {
+    return size;
+  }
+
+  /**
+   * Copies the cached search directions of the pair, returning their count - zero on a miss
+   */
+  unsigned int load(const void *geometryA, const void *geometryB, vector *directions) {
+    Entry &entry = entries[slot(geometryA, geometryB)];
+    if(entry.busy.test_and_set(std::memory_order_acquire)) {
+      return 0;
+    }
+
+    unsigned int count = 0;
+    if(entry.geometryA == geometryA && entry.geometryB == geometryB) {
+      count = entry.count;
+      for(unsigned int index = 0; index < count; index++) {
+        directions[index] = vector(entry.directions[index][0], entry.directions[index][1], entry.directions[index][2]);
+      }
+    }
+
+    entry.busy.clear(std::memory_order_release);
+    return count;
+  }
+
+  void store(const void *geometryA, const void *geometryB, const Simplex &simplex) {
+    Entry &entry = entries[slot(geometryA, geometryB)];
+    if(entry.busy.test_and_set(std::memory_order_acquire)) {
+      return;
+    }
+
+    entry.geometryA = geometryA;
+    entry.geometryB = geometryB;
+    entry.count = simplex.count;
+    for(unsigned int index = 0; index < simplex.count; index++) {
+      const vector &direction = simplex.vertices[index].direction;
+      entry.directions[index][0] = (float)direction.x;
+      entry.directions[index][1] = (float)direction.y;
+      entry.directions[index][2] = (float)direction.z;
+    }
+
+    entry.busy.clear(std::memory_order_release);
+  }
+
+  /**
+   * Not thread safe
+   */
+  void clear() {
+    for(unsigned int index = 0; index < size; index++) {
+      entries[index].geometryA = nullptr;
+      entries[index].geometryB = nullptr;
+      entries[index].count = 0;
+    }
+  }
+
+protected:
+  unsigned int slot(const void *geometryA, const void *geometryB) const {
+    std::size_t hash = std::hash<const void *>()(geometryA);
+    hash ^= std::hash<const void *>()(geometryB) + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+    return (unsigned int)(hash ^ (hash >> 17)) & (size - 1);
+  }
+};
+
+/**
+ * Convex shapes GjkEpa can test through static calls - their getSupportPoint is final, so calls on the concrete type are direct.
+ * Other geometries go through Geometry::getSupportPoint virtual calls.
+ */
+template<typename T> struct IsConvexShape : std::false_type {};
+template<> struct IsConvexShape<Sphere> : std::true_type {};
+template<> struct IsConvexShape<AABB> : std::true_type {};
+template<> struct IsConvexShape<OOBB> : std::true_type {};
+
+/**
+ * Generic convex collision detection on support mappings: GJK (Gilbert-Johnson-Keerthi) for intersection and distance, and EPA (expanding polytope)
+ * for penetration depth. Works on any pair of geometries implementing getSupportPoint(), so it backs pairs without a hand written kernel
+ * (see CollisionTester::addConvexFallbackTests).
+ *
+ * Hand written kernels are faster and give richer manifolds (e.g. 4 points for boxes), EPA gives a single deepest point.
+ */
+class GjkEpa {
+public:
+  static constexpr unsigned int maxIterations = 32;
+  static constexpr unsigned int maxPolytopeVertices = 128;
+  static constexpr unsigned int maxPolytopeFaces = 256;
+
+  /**
+   * Relative tolerance on distances - GJK and EPA stop when the next support point improves less than this
+   */
+  static constexpr real tolerance = 1e-6;
+
+  template<typename A, typename B> static bool intersects(const A &a, const B &b, SimplexCache *cache = nullptr) {
+    Simplex simplex;
+    GjkResult result;
+    gjk(a, b, simplex, true, result, cache);
+    return result.intersecting;
+  }
+
+  /**
+   * Distance and closest points of separated pairs
+   */
+  template<typename A, typename B> static GjkResult distance(const A &a, const B &b, SimplexCache *cache = nullptr) {
+    Simplex simplex;
+    GjkResult result;
+    gjk(a, b, simplex, false, result, cache);
+    return result;
+  }
+
+  /**
+   * Penetration of intersecting pairs: moving a by normal * depth separates them. Points are the deepest points of a and b. Returns false if separated.
+   * EPA grows the polytope from the GJK simplex, so results depend on where GJK started, within tolerance. Only warm started from the per pair
+   * warmStart, if given, which is updated: coherent frames of a resting pair usually enclose the origin in a single GJK iteration.
+   */
+  template<typename A, typename B> static bool penetration(const A &a, const B &b, vector &normal, real &depth, vector &pointA, vector &pointB,
+      CachedSimplex *warmStart = nullptr) {
+    Simplex simplex;
+    GjkResult result;
+    if(warmStart != nullptr) {
+      warmStart->load(&a, &b, simplex);
+    }
+    gjk(a, b, simplex, true, result, nullptr);
+    if(warmStart != nullptr) {
+      warmStart->store(&a, &b, simplex, result.iterations);
+    }
+    if(!result.intersecting) {
+      return false;
+    }
+
+    return epa(a, b, simplex, normal, depth, pointA, pointB);
+  }
+
+  /**
+   * Single contact at the deepest point, midway between both surfaces, with the normal from b to a
+   */
+  template<typename A, typename B> static void contact(const A &a, const B &b, ContactBuffer &contacts, CachedSimplex *warmStart = nullptr) {
+    vector normal, pointA, pointB;
+    real depth;
+    if(penetration(a, b, normal, depth, pointA, pointB, warmStart)) {
+      contacts.emplace(&a, &b, (pointA + pointB) * 0.5, normal, 0.8f, depth);
+    }
+  }
+
+  template<typename A, typename B> static SupportVertex support(const A &a, const B &b, const vector &direction) {
+    SupportVertex vertex;
+    vertex.pointA = a.getSupportPoint(direction);
+    vertex.pointB = b.getSupportPoint(vector(0, 0, 0) - direction);
+    vertex.point = vertex.pointA - vertex.pointB;
+    vertex.direction = direction;
+    return vertex;
+  }
+
+  /**
+   * GJK loop. Starts from the directions of the vertices already in simplex (e.g. the last simplex of a previous query on the same pair, moved),
+   * or else from the cached simplex of the pair, if any. Leaves the last simplex in simplex - a tetrahedron containing the origin,
+   * or a face, edge or vertex touching it, if the pair intersects. With stopAtSeparation, returns as soon as a separating axis is found,
+   * without refining distance and closest points, and caches just that axis: next frame a single support call usually confirms it.
+   */
+  template<typename A, typename B> static void gjk(const A &a, const B &b, Simplex &simplex, bool stopAtSeparation, GjkResult &result, SimplexCache *cache) {
+    for(unsigned int index = 0; index < simplex.count; index++) {
+      simplex.vertices[index] = support(a, b, vector(simplex.vertices[index].direction));
+    }
+
+    unsigned int cachedCount = 0;
+    if(simplex.count == 0 && cache != nullptr) {
+      vector directions[4];
+      cachedCount = cache->load(&a, &b, directions);
+      for(unsigned int index = 0; index < cachedCount; index++) {
+        simplex.vertices[simplex.count++] = support(a, b, directions[index]);
+      }
+    }
+    if(simplex.count == 0) {
+      vector direction = b.getOrigin() - a.getOrigin(); // towards the origin of the minkowski difference, a separating axis if far apart
+      simplex.vertices[simplex.count++] = support(a, b, direction * direction > 0 ? direction : vector(1, 0, 0));
+    }
+
+    result.intersecting = false;
+    result.iterations = 0;
+    const SupportVertex &first = simplex.vertices[0];
+    if(stopAtSeparation && first.point * first.direction < 0) { // first direction is a separating axis - the usual case for cached separated pairs
+      simplex.count = 1;
+      if(cache != nullptr && cachedCount != 1) { // a cached axis that still separates is left untouched - no write to a shared line
+        cache->store(&a, &b, simplex);
+      }
+      return;
+    }
+
+    real weights[4];
+    real scale = 0;
+    bool grown = false;
+    for(result.iterations = 1; result.iterations <= maxIterations; result.iterations++) {
+      vector closest = closestPoint(simplex, weights);
+      real distanceSquared = closest * closest;
+      for(unsigned int index = 0; index < simplex.count; index++) {
+        scale = std::max(scale, (real)(simplex.vertices[index].point * simplex.vertices[index].point));
+      }
+
+      if(simplex.count == 4 || distanceSquared <= tolerance * tolerance * scale) {
+        result.intersecting = true;
+        break;
+      }
+
+      SupportVertex vertex = support(a, b, vector(0, 0, 0) - closest);
+      real projection = closest * vertex.point;
+      if(stopAtSeparation && projection > 0) { // vertex is the farthest point towards the origin and does not reach it - cache just that axis
+        simplex.vertices[0] = vertex;
+        simplex.count = 1;
+        grown = true;
+        break;
+      }
+
+      bool repeated = false;
+      for(unsigned int index = 0; index < simplex.count; index++) {
+        vector delta = simplex.vertices[index].point - vertex.point;
+        repeated = repeated || delta * delta <= tolerance * tolerance * scale;
+      }
+
+      if(repeated || distanceSquared - projection <= tolerance * distanceSquared + tolerance * tolerance * scale) { // relative, absolute for touching pairs
+        closestPoints(simplex, weights, closest, result);
+        break;
+      }
+
+      simplex.vertices[simplex.count++] = vertex;
+      grown = true;
+    }
+
+    if(result.iterations > maxIterations) { // slow convergence on curved shapes: best simplex so far
+      result.iterations = maxIterations;
+      vector closest = closestPoint(simplex, weights);
+      result.intersecting = simplex.count == 4;
+      if(!result.intersecting) {
+        closestPoints(simplex, weights, closest, result);
+      }
+    }
+
+    if(cache != nullptr && (grown || simplex.count != cachedCount)) { // the cached simplex as is (e.g. still enclosing the origin) is not written back
+      cache->store(&a, &b, simplex);
+    }
+  }
+
+  /**
+   * EPA: grows a polytope inside the Minkowski difference from the GJK simplex, towards its face closest to the origin, until the boundary is reached.
+   */
+  template<typename A, typename B> static bool epa(const A &a, const B &b, const Simplex &simplex, vector &normal, real &depth, vector &pointA, vector &pointB) {
+    SupportVertex vertices[maxPolytopeVertices];
+    unsigned int vertexCount = simplex.count;
+    std::copy(simplex.vertices, simplex.vertices + simplex.count, vertices);
+    if(!completeTetrahedron(a, b, vertices, vertexCount)) {
+      return false;
+    }
+
+    vector interior = (vertices[0].point + vertices[1].point + vertices[2].point + vertices[3].point) * 0.25;
+    PolytopeFace faces[maxPolytopeFaces];
+    unsigned int faceCount = 0;
+    addFace(vertices, 0, 1, 2, interior, faces, faceCount);
+    addFace(vertices, 0, 3, 1, interior, faces, faceCount);
+    addFace(vertices, 0, 2, 3, interior, faces, faceCount);
+    addFace(vertices, 1, 3, 2, interior, faces, faceCount);
+
+    real scale = 0;
+    for(unsigned int index = 0; index < vertexCount; index++) {
+      scale = std::max(scale, (real)vertices[index].point.modulo());
+    }
+
+    for(unsigned int iteration = 0; iteration < maxPolytopeVertices; iteration++) {
+      const PolytopeFace &face = faces[closestFace(faces, faceCount)];
+      SupportVertex vertex = support(a, b, face.normal);
+      if(vertex.point * face.normal - face.distance <= tolerance * std::max(scale, (real)1) || vertexCount == maxPolytopeVertices) {
+        break;
+      }
+
+      PolytopeEdge horizon[maxPolytopeFaces];
+      unsigned int edgeCount = 0;
+      unsigned int index = 0;
+      while(index < faceCount) {
+        const PolytopeFace &current = faces[index];
+        if(current.normal * (vertex.point - vertices[current.vertices[0]].point) > 0) {
+          for(unsigned int edge = 0; edge < 3; edge++) {
+            addHorizonEdge(current.vertices[edge], current.vertices[(edge + 1) % 3], horizon, edgeCount);
+          }
+          faces[index] = faces[--faceCount];
+        } else {
+          index++;
+        }
+      }
+
+      if(faceCount + edgeCount > maxPolytopeFaces) {
+        break;
+      }
+
+      vertices[vertexCount] = vertex;
+      for(unsigned int edge = 0; edge < edgeCount; edge++) {
+        addFace(vertices, horizon[edge].from, horizon[edge].to, vertexCount, interior, faces, faceCount);
+      }
+      vertexCount++;
+      scale = std::max(scale, (real)vertex.point.modulo());
+
+      if(faceCount == 0) {
+        return false;
+      }
+    }
+
+    const PolytopeFace &face = faces[closestFace(faces, faceCount)];
+    real weights[3];
+    barycentric(face.normal * face.distance, vertices[face.vertices[0]].point, vertices[face.vertices[1]].point, vertices[face.vertices[2]].point, weights);
+
+    normal = vector(0, 0, 0) - face.normal;
+    depth = face.distance;
+    pointA = vector(0, 0, 0);
+    pointB = vector(0, 0, 0);
+    for(unsigned int index = 0; index < 3; index++) {
+      pointA = pointA + vertices[face.vertices[index]].pointA * weights[index];
+      pointB = pointB + vertices[face.vertices[index]].pointB * weights[index];
+    }
+    return true;
+  }
+
+protected:
+  struct PolytopeFace {
+    unsigned int vertices[3];
+    vector normal;
+    real distance;
+  };
+
+  struct PolytopeEdge {
+    unsigned int from;
+    unsigned int to;
+  };
+
+  /**
+   * Point of the simplex closest to the origin. Drops vertices not needed to express it, and leaves their barycentric weights in weights.
+   */
+  static vector closestPoint(Simplex &simplex, real *weights) {
+    switch(simplex.count) {
+      case 1:
+        weights[0] = 1;
+        return simplex.vertices[0].point;
+      case 2:
+        return closestSegmentPoint(simplex, weights);
+      case 3:
+        return closestTrianglePoint(simplex, weights);
+      default:
+        return closestTetrahedronPoint(simplex, weights);
+    }
+  }
+
+  static void closestPoints(const Simplex &simplex, const real *weights, const vector &closest, GjkResult &result) {
+    result.distance = closest.modulo();
+    result.pointA = vector(0, 0, 0);
+    result.pointB = vector(0, 0, 0);
+    for(unsigned int index = 0; index < simplex.count; index++) {
+      result.pointA = result.pointA + simplex.vertices[index].pointA * weights[index];
+      result.pointB = result.pointB + simplex.vertices[index].pointB * weights[index];
+    }
+  }
+
+  /**
+   * Keeps the vertices at indices (ascending) with a positive weight, in place, and their weights
+   */
+  static void keep(Simplex &simplex, const unsigned int *indices, const real *vertexWeights, unsigned int count, real *weights) {
+    unsigned int kept = 0;
+    for(unsigned int index = 0; index < count; index++) {
+      if(vertexWeights[index] > 0) {
+        if(kept != indices[index]) {
+          simplex.vertices[kept] = simplex.vertices[indices[index]];
+        }
+        weights[kept++] = vertexWeights[index];
+      }
+    }
+    simplex.count = kept;
+  }
+
+  static vector closestSegmentPoint(Simplex &simplex, real *weights) {
+    static const unsigned int indices[2] = {0, 1};
+    const vector &a = simplex.vertices[0].point;
+    vector ab = simplex.vertices[1].point - a;
+    real length = ab * ab;
+    real t = length > 0 ? std::min(std::max(-(a * ab) / length, (real)0), (real)1) : 0;
+
+    const real segmentWeights[2] = {1 - t, t};
+    vector closest = a + ab * t;
+    keep(simplex, indices, segmentWeights, 2, weights);
+    return closest;
+  }
+
+  /**
+   * Ericson, Real-Time Collision Detection 5.1.5 - same as IntersectionHelper::closestTrianglePoint, with the weights of each vertex (zero for
+   * vertices off the closest feature)
+   */
+  static vector closestTriangleWeights(const vector &a, const vector &b, const vector &c, real *weights) {
+    vector ab = b - a;
+    vector ac = c - a;
+    weights[0] = weights[1] = weights[2] = 0;
+
+    real d1 = -(ab * a), d2 = -(ac * a);
+    if(d1 <= 0 && d2 <= 0) {
+      weights[0] = 1;
+      return a;
+    }
+
+    real d3 = -(ab * b), d4 = -(ac * b);
+    if(d3 >= 0 && d4 <= d3) {
+      weights[1] = 1;
+      return b;
+    }
+
+    real vc = d1 * d4 - d3 * d2;
+    if(vc <= 0 && d1 >= 0 && d3 <= 0) {
+      real v = d1 / (d1 - d3);
+      weights[0] = 1 - v;
+      weights[1] = v;
+      return a + ab * v;
+    }
+
+    real d5 = -(ab * c), d6 = -(ac * c);
+    if(d6 >= 0 && d5 <= d6) {
+      weights[2] = 1;
+      return c;
+    }
+
+    real vb = d5 * d2 - d1 * d6;
+    if(vb <= 0 && d2 >= 0 && d6 <= 0) {
+      real w = d2 / (d2 - d6);
+      weights[0] = 1 - w;
+      weights[2] = w;
+      return a + ac * w;
+    }
+
+    real va = d3 * d6 - d5 * d4;
+    if(va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0) {
+      real w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+      weights[1] = 1 - w;
+      weights[2] = w;
+      return b + (c - b) * w;
+    }
+
+    real denominator = 1.0 / (va + vb + vc);
+    weights[1] = vb * denominator;
+    weights[2] = vc * denominator;
+    weights[0] = 1 - weights[1] - weights[2];
+    return a + ab * weights[1] + ac * weights[2];
+  }
+
+  static vector closestTrianglePoint(Simplex &simplex, real *weights) {
+    static const unsigned int indices[3] = {0, 1, 2};
+    real triangleWeights[3];
+    vector closest = closestTriangleWeights(simplex.vertices[0].point, simplex.vertices[1].point, simplex.vertices[2].point, triangleWeights);
+    keep(simplex, indices, triangleWeights, 3, weights);
+    return closest;
+  }
+
+  /**
+   * Origin inside: keeps the tetrahedron. Otherwise the closest point of the faces the origin is in front of.
+   */
+  static vector closestTetrahedronPoint(Simplex &simplex, real *weights) {
+    static const unsigned int faces[4][4] = {{0, 1, 2, 3}, {0, 1, 3, 2}, {0, 2, 3, 1}, {1, 2, 3, 0}}; // three face vertices (ascending) and the opposite one
+
+    vector closest;
+    real closestDistance = REAL_MAX;
+    const unsigned int *closestFace = nullptr;
+    real closestWeights[3];
+
+    for(const unsigned int *face : faces) {
+      const vector &a = simplex.vertices[face[0]].point;
+      const vector &b = simplex.vertices[face[1]].point;
+      const vector &c = simplex.vertices[face[2]].point;
+      vector normal = (b - a) ^ (c - a);
+      real originSide = -(normal * a);
+      real oppositeSide = normal * (simplex.vertices[face[3]].point - a);
+      if(originSide * oppositeSide > 0) {
+        continue;
+      }
+
+      real faceWeights[3];
+      vector point = closestTriangleWeights(a, b, c, faceWeights);
+      if(point * point < closestDistance) {
+        closestDistance = point * point;
+        closest = point;
+        closestFace = face;
+        std::copy(faceWeights, faceWeights + 3, closestWeights);
+      }
+    }
+
+    if(closestFace == nullptr) {
+      return vector(0, 0, 0);
+    }
+
+    keep(simplex, closestFace, closestWeights, 3, weights);
+    return closest;
+  }
+
+  /**
+   * GJK may stop with fewer than 4 vertices when the origin is on the boundary, or inside a lower dimensional simplex. Adds support points
+   * in directions off the current simplex until it is a tetrahedron. Returns false if the Minkowski difference is flat.
+   */
+  template<typename A, typename B> static bool completeTetrahedron(const A &a, const B &b, SupportVertex *vertices, unsigned int &count) {
+    static const vector axes[6] = {vector(1, 0, 0), vector(-1, 0, 0), vector(0, 1, 0), vector(0, -1, 0), vector(0, 0, 1), vector(0, 0, -1)};
+
+    real scale = 1;
+    for(unsigned int index = 0; index < count; index++) {
+      scale = std::max(scale, (real)vertices[index].point.modulo());
+    }
+    real epsilon = tolerance * scale;
+
+    if(count == 1) {
+      for(const vector &axis : axes) {
+        SupportVertex vertex = support(a, b, axis);
+        if((vertex.point - vertices[0].point).modulo() > epsilon) {
+          vertices[count++] = vertex;
+          break;
+        }
+      }
+    }
+
+    if(count == 2) {
+      vector edge = vertices[1].point - vertices[0].point;
+      for(const vector &axis : axes) {
+        vector direction = edge ^ axis;
+        if(direction * direction <= epsilon * epsilon) {
+          continue;
+        }
+
+        SupportVertex vertex = support(a, b, direction);
+        if(((vertex.point - vertices[0].point) ^ edge).modulo() > epsilon * edge.modulo()) {
+          vertices[count++] = vertex;
+          break;
+        }
+      }
+    }
+
+    if(count == 3) {
+      vector normal = (vertices[1].point - vertices[0].point) ^ (vertices[2].point - vertices[0].point);
+      real length = normal.modulo();
+      if(length <= epsilon * epsilon) {
+        return false;
+      }
+
+      normal = normal * (1.0 / length);
+      SupportVertex vertex = support(a, b, normal);
+      if(std::fabs((vertex.point - vertices[0].point) * normal) <= epsilon) {
+        vertex = support(a, b, vector(0, 0, 0) - normal);
+        if(std::fabs((vertex.point - vertices[0].point) * normal) <= epsilon) {
+          return false;
+        }
+      }
+      vertices[count++] = vertex;
+    }
+
+    return count == 4;
+  }
+
+  /**
+   * Adds face (first, second, third) facing away from the interior point. Degenerate faces are skipped.
+   */
+  static void addFace(const SupportVertex *vertices, unsigned int first, unsigned int second, unsigned int third, const vector &interior,
+      PolytopeFace *faces, unsigned int &faceCount) {
+    const vector &a = vertices[first].point;
+    vector normal = (vertices[second].point - a) ^ (vertices[third].point - a);
+    real length = normal.modulo();
+    if(length <= 0 || faceCount == maxPolytopeFaces) {
+      return;
+    }
+
+    normal = normal * (1.0 / length);
+    PolytopeFace &face = faces[faceCount++];
+    if(normal * (a - interior) < 0) {
+      face = PolytopeFace {{first, third, second}, vector(0, 0, 0) - normal, -(normal * a)};
+    } else {
+      face = PolytopeFace {{first, second, third}, normal, normal * a};
+    }
+  }
+
+  static unsigned int closestFace(const PolytopeFace *faces, unsigned int faceCount) {
+    unsigned int closest = 0;
+    for(unsigned int index = 1; index < faceCount; index++) {
+      if(faces[index].distance < faces[closest].distance) {
+        closest = index;
+      }
+    }
+    return closest;
+  }
+
+  /**
+   * Edges shared by two removed faces are inside the hole - the horizon is made of the edges seen once
+   */
+  static void addHorizonEdge(unsigned int from, unsigned int to, PolytopeEdge *edges, unsigned int &edgeCount) {
+    for(unsigned int index = 0; index < edgeCount; index++) {
+      if(edges[index].from == to && edges[index].to == from) {
+        edges[index] = edges[--edgeCount];
+        return;
+      }
+    }
+
+    if(edgeCount < maxPolytopeFaces) {
+      edges[edgeCount++] = PolytopeEdge {from, to};
+    }
+  }
+
+  static void barycentric(const vector &point, const vector &a, const vector &b, const vector &c, real *weights) {
+    vector ab = b - a, ac = c - a, ap = point - a;
+    real d00 = ab * ab, d01 = ab * ac, d11 = ac * ac, d20 = ap * ab, d21 = ap * ac;
+    real denominator = d00 * d11 - d01 * d01;
+    if(denominator <= 0) {
+      weights[0] = 1;
+      weights[1] = weights[2] = 0;
+      return;
+    }
+
+    weights[1] = (d11 * d20 - d01 * d21) / denominator;
+    weights[2] = (d00 * d21 - d01 * d20) / denominator;
+    weights[0] = 1 - weights[1] - weights[2];
+  }
+};
@@ -8,21 +8,38 @@
 #pragma once
 
 #include <vector>
+#include <limits>
+#include <cmath>
+#include <algorithm>
+#include <type_traits>
 #include <Geometry.h>
 #include "GeometryContact.h"
+#include "ContactBuffer.h"
 
 
+/**
+ * Collision kernels on concrete geometry types. These are shared by CollisionTester (runtime dispatch) and StaticCollisionTester (compile time dispatch),
+ * so both always produce the same results.
+ *
+ * Kernels between spheres, aabbs, planes and lines are templated on the scalar of each operand, so that e.g. a world stored in double can be tested
+ * against float proxies. Operands are converted to the wider scalar (see WiderScalar) and tested as operands of that scalar; operands already
+ * on it are used as they are, so kernels on a single scalar compute as they always did. Contacts reference the operands, not their converted copies.
+ */
 class IntersectionHelper {
 public:
   /**
    * Line intersection test
    */
-  static bool lineSphere(const Line &line, const Sphere &sphere) {
-     real projection = (sphere.getOrigin() - line.getOrigin()) * line.getDirection();
-     vector projectedSphereCenter = line.getOrigin() + line.getDirection() * projection;
-     vector lineToSphere = sphere.getOrigin() - projectedSphereCenter;
+  template<typename T, typename U> static bool lineSphere(const BasicLine<T> &line, const BasicSphere<U> &sphere) {
+     typedef WiderScalar<T, U> scalar;
+     typedef typename ScalarVector<scalar>::type vector;
+     const auto &wideLine = onScalar<scalar>(line);
+     const auto &wideSphere = onScalar<scalar>(sphere);
+
+     scalar projection = (wideSphere.getOrigin() - wideLine.getOrigin()) * wideLine.getDirection();
+     vector projectedSphereCenter = wideLine.getOrigin() + wideLine.getDirection() * projection;
 
-     return (lineToSphere * lineToSphere <= sphere.getRadius() * sphere.getRadius());
+     return wideSphere.contains(projectedSphereCenter);
   }
 
   static bool linePlane(const Line &line, const Plane &plane) {
@@ -33,8 +50,200 @@ public:
      return false;
   }
 
-  static bool lineAabb(const Line &line, const AABB &aabb) {
-         return false;
+  /**
+   * Slab test: clips the line against the three pairs of axis aligned planes of the aabb, using the precomputed inverse direction instead of divisions,
+   * and min / max instead of branches on direction signs.
+   * tEnter and tExit are the line parameters where the line enters and leaves the aabb - tEnter is negative if the origin is inside.
+   *
+   * Note: This is really a ray/aabb intersection test: it returns true only if the intersection is at t >= 0. Touching counts as intersecting.
+   */
+  template<typename S> static bool lineAabb(const typename ScalarVector<S>::type &origin, const typename ScalarVector<S>::type &inverseDirection,
+      const typename ScalarVector<S>::type &mins, const typename ScalarVector<S>::type &maxs, S &tEnter, S &tExit) {
+    tEnter = -std::numeric_limits<S>::infinity();
+    tExit = std::numeric_limits<S>::infinity();
+
+    clipSlab(origin.x, inverseDirection.x, mins.x, maxs.x, tEnter, tExit);
+    clipSlab(origin.y, inverseDirection.y, mins.y, maxs.y, tEnter, tExit);
+    clipSlab(origin.z, inverseDirection.z, mins.z, maxs.z, tEnter, tExit);
+
+    return std::max(tEnter, (S)0) <= tExit;
+  }
+
+  /**
+   * Narrows [tEnter, tExit] to the slab between min and max on one axis.
+   *
+   * When the direction is zero on this axis, t values are infinite, or NaN (0 * infinity) if the origin lies exactly on a slab plane.
+   * std::min / std::max return their first operand when comparing against NaN, so operands are ordered for NaN to never narrow the interval:
+   * std::max(-infinity, NaN) is -infinity, std::min(infinity, NaN) is infinity, and NaN near / far values leave tEnter / tExit as they are.
+   * The origin is within the slab in that case - touching.
+   */
+  template<typename S> static void clipSlab(S origin, S inverseDirection, S min, S max, S &tEnter, S &tExit) {
+    S t1 = (min - origin) * inverseDirection;
+    S t2 = (max - origin) * inverseDirection;
+    tEnter = std::max(tEnter, std::min(t1, std::max(-std::numeric_limits<S>::infinity(), t2)));
+    tExit = std::min(tExit, std::max(t1, std::min(std::numeric_limits<S>::infinity(), t2)));
+  }
+
+  template<typename T, typename U> static bool lineAabb(const BasicLine<T> &line, const BasicAABB<U> &aabb, WiderScalar<T, U> &tEnter, WiderScalar<T, U> &tExit) {
+    typedef WiderScalar<T, U> scalar;
+    const auto &wideLine = onScalar<scalar>(line);
+    const auto &wideAabb = onScalar<scalar>(aabb);
+    return lineAabb<scalar>(wideLine.getOrigin(), wideLine.getInverseDirection(), wideAabb.getMins(), wideAabb.getMaxs(), tEnter, tExit);
+  }
+
+  template<typename T, typename U> static bool lineAabb(const BasicLine<T> &line, const BasicAABB<U> &aabb) {
+    WiderScalar<T, U> tEnter, tExit;
+    return lineAabb(line, aabb, tEnter, tExit);
+  }
+
+  static bool lineHeightmap(const Line &line, const HeightMapGeometry &heightmap) {
+    real t;
+    vector normal;
+    return lineHeightmap(line, heightmap, t, normal);
+  }
+
+  /**
+   * Ray against the surface of a height map. t is the line parameter of the hit and normal the surface normal there.
+   *
+   * On a GridHeightMap, descends the min-max pyramid front to back, slab testing tiles against their height range: empty space is skipped a tile
+   * at a time, and the first cell hit holds the closest hit. Children are visited in the order the ray crosses them (by direction signs), so no
+   * sorting is needed. Other height maps are marched through heightAt, see lineHeightmapMarch.
+   */
+  static bool lineHeightmap(const Line &line, const HeightMapGeometry &heightmap, real &t, vector &normal) {
+    const GridHeightMap *grid = heightmap.getGridHeightMap();
+    if(grid == nullptr) {
+      return lineHeightmapMarch(line, heightmap, t, normal);
+    }
+
+    const MinMaxPyramid &pyramid = grid->getPyramid();
+    vector origin = line.getOrigin() - heightmap.getPosition();
+    const vector &direction = line.getDirection();
+
+    TerrainNode stack[terrainStackSize];
+    unsigned int count = 0;
+    stack[count++] = TerrainNode {pyramid.getLevelCount() - 1, 0, 0};
+
+    while(count > 0) {
+      TerrainNode node = stack[--count];
+      vector mins, maxs;
+      terrainNodeBounds(*grid, node, mins, maxs);
+
+      real tEnter, tExit;
+      if(!lineAabb(origin, line.getInverseDirection(), mins, maxs, tEnter, tExit)) {
+        continue;
+      }
+
+      if(node.level == 0) {
+        if(lineTerrainCell(*grid, node.column, node.row, origin, direction, t, normal)) {
+          return true;
+        }
+        continue;
+      }
+
+      unsigned int nearColumn = node.column * 2 + (direction.x < 0 ? 1 : 0);
+      unsigned int farColumn = node.column * 2 + (direction.x < 0 ? 0 : 1);
+      unsigned int nearRow = node.row * 2 + (direction.z < 0 ? 1 : 0);
+      unsigned int farRow = node.row * 2 + (direction.z < 0 ? 0 : 1);
+      pushTerrainNode(pyramid, TerrainNode {node.level - 1, farColumn, farRow}, stack, count);
+      pushTerrainNode(pyramid, TerrainNode {node.level - 1, nearColumn, farRow}, stack, count);
+      pushTerrainNode(pyramid, TerrainNode {node.level - 1, farColumn, nearRow}, stack, count);
+      pushTerrainNode(pyramid, TerrainNode {node.level - 1, nearColumn, nearRow}, stack, count);
+    }
+
+    return false;
+  }
+
+  /**
+   * Ray against any height map, through heightAt. Samples the part of the ray over the height map bounds wherever it crosses a cell border or
+   * a cell diagonal (cells of HeightMap::getCellSize, split like GridHeightMap cells), and interpolates the first crossing of the surface,
+   * from either side. Exact on height maps triangulated like GridHeightMap, as heights are linear in between - features narrower than a cell
+   * can be missed on others.
+   */
+  static bool lineHeightmapMarch(const Line &line, const HeightMapGeometry &heightmap, real &t, vector &normal) {
+    real tEnter, tExit;
+    if(!lineAabb(line, heightmap, tEnter, tExit)) {
+      return false;
+    }
+
+    const vector &origin = line.getOrigin();
+    const vector &direction = line.getDirection();
+    auto heightAbove = [&heightmap, &origin, &direction](real at) {
+      vector point = origin + direction * at;
+      return point.y - heightmap.heightAt(point.x, point.z);
+    };
+
+    // cell borders along x and z, and diagonals (x + z constant), in cells from the height map position
+    real inverseCellSize = 1.0 / heightmap.getHeightMap().getCellSize();
+    vector local = (origin - heightmap.getPosition()) * inverseCellSize;
+    const real starts[3] = {local.x, local.z, local.x + local.z};
+    const real slopes[3] = {direction.x * inverseCellSize, direction.z * inverseCellSize, (direction.x + direction.z) * inverseCellSize};
+
+    real near = std::max(tEnter, (real)0);
+    real crossings[3];
+    real borders[3];
+    for(unsigned int family = 0; family < 3; family++) {
+      real position = starts[family] + slopes[family] * near;
+      borders[family] = slopes[family] > 0 ? std::floor(position) + 1 : std::ceil(position) - 1;
+      crossings[family] = slopes[family] != 0 ? (borders[family] - starts[family]) / slopes[family] : REAL_MAX;
+    }
+
+    real nearHeight = heightAbove(near);
+    while(nearHeight != 0) {
+      if(near >= tExit) {
+        return false;
+      }
+
+      real far = std::min(std::min(std::min(crossings[0], crossings[1]), crossings[2]), tExit);
+      for(unsigned int family = 0; family < 3; family++) {
+        while(crossings[family] <= far) {
+          borders[family] += slopes[family] > 0 ? 1 : -1;
+          crossings[family] = (borders[family] - starts[family]) / slopes[family];
+        }
+      }
+
+      real farHeight = heightAbove(far);
+      if((nearHeight > 0) != (farHeight > 0)) {
+        near = farHeight == 0 ? far : near + (far - near) * (nearHeight / (nearHeight - farHeight));
+        break;
+      }
+
+      near = far;
+      nearHeight = farHeight;
+    }
+
+    t = near;
+    vector point = origin + direction * t;
+    normal = heightmap.normalAt(point.x, point.z);
+    return true;
+  }
+
+  /**
+   * Moller-Trumbore ray / triangle test, t >= 0. Triangles are two sided.
+   */
+  static bool lineTriangle(const vector &origin, const vector &direction, const vector &a, const vector &b, const vector &c, real &t) {
+    vector ab = b - a;
+    vector ac = c - a;
+    vector p = direction ^ ac;
+    real determinant = ab * p;
+    if(determinant == 0) {
+      return false;
+    }
+
+    real inverseDeterminant = 1.0 / determinant;
+    vector s = origin - a;
+    real u = (s * p) * inverseDeterminant;
+    if(u < 0 || u > 1) {
+      return false;
+    }
+
+    vector q = s ^ ab;
+    real v = (direction * q) * inverseDeterminant;
+    if(v < 0 || u + v > 1) {
+      return false;
+    }
+
+    t = (ac * q) * inverseDeterminant;
+    return t >= 0;
   }
 
   static bool lineHierarchy(const Line &line, const HierarchicalGeometry &hierarchy) {
@@ -42,19 +251,37 @@ public:
   }
 
   /**
-   * Plane intersection test
+   * Plane intersection test - This is actually a half space / sphere test
    */
-  static bool planeSphere(const Plane &plane, const Sphere &sphere) {
-      vector delta = ((sphere.getOrigin() - plane.getOrigin()) * plane.getNormal()) * plane.getNormal();
-      return (delta * delta <= sphere.getRadius() * sphere.getRadius());
+  template<typename T, typename U> static bool planeSphere(const BasicPlane<T> &plane, const BasicSphere<U> &sphere) {
+      typedef WiderScalar<T, U> scalar;
+      typedef typename ScalarVector<scalar>::type vector;
+      const auto &widePlane = onScalar<scalar>(plane);
+      const auto &wideSphere = onScalar<scalar>(sphere);
+
+      vector delta = ((wideSphere.getOrigin() - widePlane.getOrigin()) * widePlane.getNormal()) * widePlane.getNormal();
+      return (delta * delta <= wideSphere.getRadius() * wideSphere.getRadius());
   }
 
   static bool planePlane(const Plane &plane, const Plane &anotherPlane) {
       return false;
   }
 
-  static bool planeAabb(const Plane &plane, const AABB &aabb) {
-          return false;
+  /**
+   * Same as planeSphere, with the aabb projected radius on the plane normal: true if the plane crosses (or touches) the aabb
+   */
+  template<typename T, typename U> static bool planeAabb(const BasicPlane<T> &plane, const BasicAABB<U> &aabb) {
+      typedef WiderScalar<T, U> scalar;
+      typedef typename ScalarVector<scalar>::type vector;
+      const auto &widePlane = onScalar<scalar>(plane);
+      const auto &wideAabb = onScalar<scalar>(aabb);
+
+      const vector &normal = widePlane.getNormal();
+      const vector &halfSizes = wideAabb.getHalfSizes();
+
+      scalar distance = (wideAabb.getOrigin() - widePlane.getOrigin()) * normal;
+      scalar projectedRadius = std::fabs(normal.x) * halfSizes.x + std::fabs(normal.y) * halfSizes.y + std::fabs(normal.z) * halfSizes.z;
+      return std::fabs(distance) <= projectedRadius;
   }
 
   static bool planeHierarchy(const Plane &plane, const HierarchicalGeometry &hierarchy) {
@@ -64,29 +291,50 @@ public:
   /**
    * Sphere intersection test
    */
-  static bool sphereSphere(const Sphere &sphere, const Sphere &anotherSphere) {
-      vector delta = sphere.getOrigin() - anotherSphere.getOrigin();
-      real radiuses = sphere.getRadius() + anotherSphere.getRadius();
+  template<typename T, typename U> static bool sphereSphere(const BasicSphere<T> &sphere, const BasicSphere<U> &anotherSphere) {
+      typedef WiderScalar<T, U> scalar;
+      const auto &wideSphere = onScalar<scalar>(sphere);
+      const auto &wideAnotherSphere = onScalar<scalar>(anotherSphere);
+      return sphereSphere<scalar>(wideSphere.getOrigin(), wideSphere.getRadius(), wideAnotherSphere.getOrigin(), wideAnotherSphere.getRadius());
+  }
+
+  /**
+   * Same test on plain values, for callers keeping spheres in flat arrays (see SpatialHashGrid)
+   */
+  template<typename S> static bool sphereSphere(const typename ScalarVector<S>::type &origin, S radius, const typename ScalarVector<S>::type &anotherOrigin, S anotherRadius) {
+      typename ScalarVector<S>::type delta = origin - anotherOrigin;
+      S radiuses = radius + anotherRadius;
 
       return (delta * delta <= radiuses * radiuses);
   }
 
-  static bool sphereAabb(const Sphere &sphere, const AABB &aabb) {
-      //printf("Checking intersection for %s and %s \n", sphere.toString().c_str(), aabb.toString().c_str());
-      vector mins = aabb.getOrigin() - aabb.getHalfSizes();
-      vector maxs = aabb.getOrigin() + aabb.getHalfSizes();
-
-      //printf("mins: %s - maxs: %s\n", mins.toString().c_str(), maxs.toString().c_str());
+  template<typename T, typename U> static bool sphereAabb(const BasicSphere<T> &sphere, const BasicAABB<U> &aabb) {
+      typedef WiderScalar<T, U> scalar;
+      const auto &wideSphere = onScalar<scalar>(sphere);
+      const auto &wideAabb = onScalar<scalar>(aabb);
+      return wideSphere.contains(wideAabb.closestPoint(wideSphere.getOrigin()));
+  }
 
+  static bool sphereHeightmap(const Sphere &sphere, const HeightMapGeometry &heightmap) {
+    return sphereHeightmap(sphere.getOrigin(), sphere.getRadius(), heightmap);
+  }
 
-      vector aabbClosestPoint = vector(std::max(mins.x, std::min(sphere.getOrigin().x, maxs.x)),
-              std::max(mins.y, std::min(sphere.getOrigin().y, maxs.y)),
-              std::max(mins.z, std::min(sphere.getOrigin().z, maxs.z))
-              );
+  /**
+   * GridHeightMaps are tested against the closest point of the surface (see closestTerrainPoint). Other height maps only against the point
+   * of the surface below the sphere - non accurate on slopes.
+   */
+  static bool sphereHeightmap(const vector &origin, real radius, const HeightMapGeometry &heightmap) {
+    const GridHeightMap *grid = heightmap.getGridHeightMap();
+    if(grid != nullptr) {
+      vector closestPoint, triangleNormal;
+      return closestTerrainPoint(*grid, origin - heightmap.getPosition(), radius, closestPoint, triangleNormal);
+    }
 
-      //printf("closest point: %s\n", aabbClosestPoint.toString().c_str());
+    vector aabbClosestPoint = heightmap.closestPoint(origin);
+    aabbClosestPoint.y = heightmap.heightAt(aabbClosestPoint.x, aabbClosestPoint.z);
 
-      return sphere.contains(aabbClosestPoint);
+    vector delta = origin - aabbClosestPoint;
+    return delta * delta <= radius * radius;
   }
 
   static bool sphereHierarchy(const Sphere &sphere, const HierarchicalGeometry &hierarchy) {
@@ -97,14 +345,120 @@ public:
   /**
    * AABB intersection tests
    */
-  static bool aabbAabb(const AABB &aabb, const AABB &anotherAabb) {
+  template<typename T, typename U> static bool aabbAabb(const BasicAABB<T> &aabb, const BasicAABB<U> &anotherAabb) {
+      typedef WiderScalar<T, U> scalar;
+      typedef typename ScalarVector<scalar>::type vector;
+      return onScalar<scalar>(aabb).minkowskiDifference(onScalar<scalar>(anotherAabb)).contains(vector(0, 0, 0));
+  }
+
+  /**
+   * True if the height map surface crosses the aabb. The surface is continuous, so heights over the aabb footprint span a range, which must overlap
+   * the aabb height range.
+   *
+   * GridHeightMaps descend the min-max pyramid: tiles off the footprint or out of the height range are skipped, tiles within the footprint are decided
+   * by their min and max alone, and only cells on the footprint border look at samples. Other height maps are sampled at the footprint corners and
+   * center - non accurate.
+   */
+  static bool aabbHeightmap(const AABB &aabb, const HeightMapGeometry &heightmap) {
+    vector position(heightmap.getPosition());
+    const HeightMap &heightMap = heightmap.getHeightMap();
+    vector mins = aabb.getMins() - position;
+    vector maxs = aabb.getMaxs() - position;
+    real footprintMinX = std::max(mins.x, (real)0);
+    real footprintMaxX = std::min(maxs.x, heightMap.getWidth());
+    real footprintMinZ = std::max(mins.z, (real)0);
+    real footprintMaxZ = std::min(maxs.z, heightMap.getDepth());
+    if(footprintMinX > footprintMaxX || footprintMinZ > footprintMaxZ) {
       return false;
+    }
+
+    const GridHeightMap *grid = heightmap.getGridHeightMap();
+    if(grid == nullptr) {
+      real heights[5] = {
+          heightMap.heightAt(footprintMinX, footprintMinZ), heightMap.heightAt(footprintMaxX, footprintMinZ),
+          heightMap.heightAt(footprintMinX, footprintMaxZ), heightMap.heightAt(footprintMaxX, footprintMaxZ),
+          heightMap.heightAt((footprintMinX + footprintMaxX) * 0.5, (footprintMinZ + footprintMaxZ) * 0.5)};
+      return *std::max_element(heights, heights + 5) >= mins.y && *std::min_element(heights, heights + 5) <= maxs.y;
+    }
+
+    const MinMaxPyramid &pyramid = grid->getPyramid();
+    TerrainNode stack[terrainStackSize];
+    unsigned int count = 0;
+    stack[count++] = TerrainNode {pyramid.getLevelCount() - 1, 0, 0};
+
+    while(count > 0) {
+      TerrainNode node = stack[--count];
+      vector nodeMins, nodeMaxs;
+      terrainNodeBounds(*grid, node, nodeMins, nodeMaxs);
+
+      if(nodeMaxs.x < footprintMinX || nodeMins.x > footprintMaxX || nodeMaxs.z < footprintMinZ || nodeMins.z > footprintMaxZ ||
+          nodeMaxs.y < mins.y || nodeMins.y > maxs.y) {
+        continue;
+      }
+
+      if(footprintMinX <= nodeMins.x && nodeMaxs.x <= footprintMaxX && footprintMinZ <= nodeMins.z && nodeMaxs.z <= footprintMaxZ) {
+        return true;
+      }
+
+      if(node.level == 0) {
+        real minHeight, maxHeight;
+        terrainCellHeightRange(*grid, std::max(nodeMins.x, footprintMinX), std::min(nodeMaxs.x, footprintMaxX),
+            std::max(nodeMins.z, footprintMinZ), std::min(nodeMaxs.z, footprintMaxZ), nodeMins.x + nodeMins.z + grid->getCellSize(), minHeight, maxHeight);
+        if(maxHeight >= mins.y && minHeight <= maxs.y) {
+          return true;
+        }
+        continue;
+      }
+
+      for(unsigned int child = 0; child < 4; child++) {
+        pushTerrainNode(pyramid, TerrainNode {node.level - 1, node.column * 2 + (child & 1), node.row * 2 + (child >> 1)}, stack, count);
+      }
+    }
+
+    return false;
   }
 
   static bool aabbHierarchy(const AABB &aabb, const HierarchicalGeometry &hierarchy) {
      return false;
   }
 
+  static bool aabbOobb(const AABB &aabb, const OOBB &oobb) {
+    return boxBox(boxFrame(aabb), boxFrame(oobb));
+  }
+
+  /**
+   * OOBB intersection tests
+   */
+
+  /**
+   * Slab test in box coordinates - a ray test, same as lineAabb
+   */
+  static bool lineOobb(const Line &line, const OOBB &oobb) {
+    vector origin = oobb.toLocal(line.getOrigin());
+    vector direction = oobb.toLocalDirection(line.getDirection());
+    vector inverseDirection((real)1 / direction.x, (real)1 / direction.y, (real)1 / direction.z);
+    const vector &halfSizes = oobb.getHalfSizes();
+
+    real tEnter, tExit;
+    return lineAabb(origin, inverseDirection, vector(0, 0, 0) - halfSizes, halfSizes, tEnter, tExit);
+  }
+
+  /**
+   * Same as planeAabb, projecting the half sizes on the plane normal along the box axes
+   */
+  static bool planeOobb(const Plane &plane, const OOBB &oobb) {
+    real distance = (oobb.getOrigin() - plane.getOrigin()) * plane.getNormal();
+    return std::fabs(distance) <= projectedRadius(oobb, plane.getNormal());
+  }
+
+  static bool sphereOobb(const Sphere &sphere, const OOBB &oobb) {
+    return sphere.contains(oobb.closestPoint(sphere.getOrigin()));
+  }
+
+  static bool oobbOobb(const OOBB &oobb, const OOBB &anotherOobb) {
+    return boxBox(boxFrame(oobb), boxFrame(anotherOobb));
+  }
+
   /**
    * Hierarchy intersection tests
    */
@@ -118,105 +472,162 @@ public:
   /**
    * Line contact Determination
    */
-  static std::vector<GeometryContact> lineSphereContact(const Line &line, const Sphere &sphere) {
-      return std::vector<GeometryContact>();
+  static void lineSphereContact(const Line &line, const Sphere &sphere, ContactBuffer &contacts) {
   }
 
-  static std::vector<GeometryContact> linePlaneContact(const Line &line, const Plane &plane) {
-      return std::vector<GeometryContact>();
+  static void linePlaneContact(const Line &line, const Plane &plane, ContactBuffer &contacts) {
   }
 
-  static std::vector<GeometryContact> lineLineContact(const Line &line, const Line &anotherLine) {
-      return std::vector<GeometryContact>();
+  static void lineLineContact(const Line &line, const Line &anotherLine, ContactBuffer &contacts) {
   }
 
-  static std::vector<GeometryContact> lineAabbContact(const Line &line, const AABB &aabb) {
-      return std::vector<GeometryContact>();
+  static void lineAabbContact(const Line &line, const AABB &aabb, ContactBuffer &contacts) {
   }
-  static std::vector<GeometryContact> lineHierarchyContact(const Line &line, const HierarchicalGeometry &hierarchy) {
-      return std::vector<GeometryContact>();
+  static void lineHierarchyContact(const Line &line, const HierarchicalGeometry &hierarchy, ContactBuffer &contacts) {
   }
 
 
 
   /**
-   * Plane contact determination
+   * Plane contact determination - This is actually a half space / sphere test
    */
-  static std::vector<GeometryContact> planeSphereContact(const Plane &plane, const Sphere &sphere) {
-      vector normal = plane.getNormal();
+  template<typename T, typename U> static void planeSphereContact(const BasicPlane<T> &plane, const BasicSphere<U> &sphere, BasicContactBuffer<PairContact<T, U>> &contacts) {
+      typedef WiderScalar<T, U> scalar;
+      typedef typename ScalarVector<scalar>::type vector;
+      const auto &widePlane = onScalar<scalar>(plane);
+      const auto &wideSphere = onScalar<scalar>(sphere);
+
+      vector normal = widePlane.getNormal();
 
-      real distance = (sphere.getOrigin() - plane.getOrigin()) * normal;
+      scalar distance = (wideSphere.getOrigin() - widePlane.getOrigin()) * normal;
 
-      if(distance <= sphere.getRadius()) {
-          vector delta = distance * normal;
-          real penetration = sphere.getRadius() - distance;
-          vector intersection = sphere.getOrigin() - (normal * sphere.getRadius());
+      if(distance <= wideSphere.getRadius()) {
+          scalar penetration = wideSphere.getRadius() - distance;
+          vector intersection = wideSphere.getOrigin() - (normal * wideSphere.getRadius());
 
-          return std::vector<GeometryContact> {GeometryContact(&plane, &sphere, intersection, normal, 0.8f, penetration) };
+          contacts.emplace(&plane, &sphere, intersection, normal, 0.8f, penetration);
       }
+  }
 
-      return std::vector<GeometryContact>();
+  template<typename T, typename U> static std::vector<PairContact<T, U>> planeSphereContact(const BasicPlane<T> &plane, const BasicSphere<U> &sphere) {
+      BasicContactBuffer<PairContact<T, U>> contacts;
+      planeSphereContact(plane, sphere, contacts);
+      return contacts.release();
   }
 
-  static std::vector<GeometryContact> planePlaneContact(const Plane &plane, const Plane &anotherPlane) {
-      return std::vector<GeometryContact>();
+  static void planePlaneContact(const Plane &plane, const Plane &anotherPlane, ContactBuffer &contacts) {
   }
 
-  static std::vector<GeometryContact> planeAabbContact(const Plane &plane, const AABB &aabb) {
-      return std::vector<GeometryContact>();
+  static void planeAabbContact(const Plane &plane, const AABB &aabb, ContactBuffer &contacts) {
   }
 
-  static std::vector<GeometryContact> planeHierarchyContact(const Plane &plane, const HierarchicalGeometry &hierarchy) {
-      return std::vector<GeometryContact>();
+  static void planeHierarchyContact(const Plane &plane, const HierarchicalGeometry &hierarchy, ContactBuffer &contacts) {
   }
 
 
   /**
    * Sphere contact determination
    */
-  static std::vector<GeometryContact> sphereSphereContact(const Sphere &sphereA, const Sphere &sphereB) {
-      vector delta = sphereB.getOrigin() - sphereA.getOrigin();
-      real radiuses = sphereA.getRadius() + sphereB.getRadius();
+  template<typename T, typename U> static void sphereSphereContact(const BasicSphere<T> &sphere, const BasicSphere<U> &anotherSphere, BasicContactBuffer<PairContact<T, U>> &contacts) {
+      typedef WiderScalar<T, U> scalar;
+      typedef typename ScalarVector<scalar>::type vector;
+      const auto &wideSphere = onScalar<scalar>(sphere);
+      const auto &wideAnotherSphere = onScalar<scalar>(anotherSphere);
+
+      vector delta = wideSphere.getOrigin() - wideAnotherSphere.getOrigin();
+      scalar radiuses = wideSphere.getRadius() + wideAnotherSphere.getRadius();
 
       if(delta * delta <= radiuses * radiuses) {
-          real distance = delta.modulo();
+          scalar distance = delta.modulo();
           vector normal = delta * (1.0 / distance);
-          real penetration = radiuses - distance;
-          vector intersection = sphereA.getOrigin() + (normal * sphereA.getRadius());
-          return std::vector<GeometryContact> {GeometryContact(&sphereA, &sphereB, intersection, normal, 0.8f,  penetration) };
+          scalar penetration = radiuses - distance;
+          vector intersection = wideSphere.getOrigin() + (normal * wideSphere.getRadius());
+          contacts.emplace(&sphere, &anotherSphere, intersection, normal, 0.8f,  penetration);
       }
+  }
 
-      return std::vector<GeometryContact>();
+  template<typename T, typename U> static std::vector<PairContact<T, U>> sphereSphereContact(const BasicSphere<T> &sphere, const BasicSphere<U> &anotherSphere) {
+      BasicContactBuffer<PairContact<T, U>> contacts;
+      sphereSphereContact(sphere, anotherSphere, contacts);
+      return contacts.release();
   }
 
-  static std::vector<GeometryContact> sphereAabbContact(const Sphere &sphere, const AABB &aabb) {
-      //printf("Checking intersection for %s and %s \n", sphere.toString().c_str(), aabb.toString().c_str());
-      vector mins = aabb.getOrigin() - aabb.getHalfSizes();
-      vector maxs = aabb.getOrigin() + aabb.getHalfSizes();
+  template<typename T, typename U> static void sphereAabbContact(const BasicSphere<T> &sphere, const BasicAABB<U> &aabb, BasicContactBuffer<PairContact<T, U>> &contacts) {
+    typedef WiderScalar<T, U> scalar;
+    typedef typename ScalarVector<scalar>::type vector;
+    const auto &wideSphere = onScalar<scalar>(sphere);
+    const auto &wideAabb = onScalar<scalar>(aabb);
 
-      //printf("mins: %s - maxs: %s\n", mins.toString().c_str(), maxs.toString().c_str());
+    vector aabbClosestPoint = wideAabb.closestPoint(wideSphere.getOrigin());
 
-      vector aabbClosestPoint = vector(std::max(mins.x, std::min(sphere.getOrigin().x, maxs.x)),
-              std::max(mins.y, std::min(sphere.getOrigin().y, maxs.y)),
-              std::max(mins.z, std::min(sphere.getOrigin().z, maxs.z))
-              );
+    if(wideSphere.contains(aabbClosestPoint)) {
+      vector delta = wideSphere.getOrigin() - aabbClosestPoint;
+      if(equalsZeroAbsoluteMargin(delta * delta)) {
+        aabbClosestPoint = wideAabb.closestSurfacePoint(wideSphere.getOrigin());
+        delta = aabbClosestPoint - wideSphere.getOrigin();
+      }
+      scalar distance = delta.modulo();
+      vector normal = delta * (1.0 / distance);
+      scalar penetration = wideSphere.getRadius() - distance;
 
-      //printf("closest point: %s\n", aabbClosestPoint.toString().c_str());
+      contacts.emplace(&sphere, &aabb, aabbClosestPoint, normal, 0.8f,  penetration);
+    }
+  }
 
-      if(sphere.contains(aabbClosestPoint)) {
-          vector delta = sphere.getOrigin() - aabbClosestPoint;
-          real distance = delta.modulo();
-          vector normal = delta * (1.0 / distance);
-          real penetration = sphere.getRadius() - distance;
+  template<typename T, typename U> static std::vector<PairContact<T, U>> sphereAabbContact(const BasicSphere<T> &sphere, const BasicAABB<U> &aabb) {
+    BasicContactBuffer<PairContact<T, U>> contacts;
+    sphereAabbContact(sphere, aabb, contacts);
+    return contacts.release();
+  }
+
+  /**
+   * GridHeightMaps return data of the closest point of the surface: the normal points from the surface to the sphere center, or away from it if
+   * the center is below the surface. Other height maps return non accurate data of the point directly below the sphere.
+   */
+  static void sphereHeightmapContact(const Sphere &sphere, const HeightMapGeometry &heightmap, ContactBuffer &contacts) {
+    const GridHeightMap *grid = heightmap.getGridHeightMap();
+    if(grid != nullptr) {
+      vector position(heightmap.getPosition());
+      vector center = sphere.getOrigin() - position;
+      vector closestPoint, triangleNormal;
+
+      if(closestTerrainPoint(*grid, center, sphere.getRadius(), closestPoint, triangleNormal)) {
+        vector delta = center - closestPoint;
+        real distance = delta.modulo();
+        bool below = center.y < grid->heightAt(center.x, center.z);
 
-          return std::vector<GeometryContact> {GeometryContact(&sphere, &aabb, aabbClosestPoint, normal, 0.8f,  penetration) };
+        vector normal = triangleNormal;
+        if(!equalsZeroAbsoluteMargin(distance)) {
+          normal = delta * ((below ? -1.0 : 1.0) / distance);
+        }
+        real penetration = below ? sphere.getRadius() + distance : sphere.getRadius() - distance;
+
+        contacts.emplace(&sphere, &heightmap, closestPoint + position, normal, 0.8f,  penetration);
       }
+      return;
+    }
+
+    vector aabbClosestPoint = heightmap.closestPoint(sphere.getOrigin());
+    aabbClosestPoint.y = heightmap.heightAt(aabbClosestPoint.x, aabbClosestPoint.z);
+
+    if(sphere.contains(aabbClosestPoint)) {
+      vector delta = sphere.getOrigin() - aabbClosestPoint;
+      real distance = delta.modulo();
+      //vector normal = delta * (1.0 / distance); // method 1 - upwards pointing normal
+      vector normal = heightmap.normalAt(aabbClosestPoint.x, aabbClosestPoint.z); // method 2 - triangle normal
+      real penetration = sphere.getRadius() - distance;
+
+      contacts.emplace(&sphere, &heightmap, aabbClosestPoint, normal, 0.8f,  penetration);
+    }
+  }
 
-      return std::vector<GeometryContact>();
+  static std::vector<GeometryContact> sphereHeightmapContact(const Sphere &sphere, const HeightMapGeometry &heightmap) {
+    ContactBuffer contacts;
+    sphereHeightmapContact(sphere, heightmap, contacts);
+    return contacts.release();
   }
 
-  static std::vector<GeometryContact> sphereHierarchyContact(const Sphere &sphere, const HierarchicalGeometry &hierarchy) {
-      return std::vector<GeometryContact>();
+  static void sphereHierarchyContact(const Sphere &sphere, const HierarchicalGeometry &hierarchy, ContactBuffer &contacts) {
   }
 
 
@@ -224,18 +635,620 @@ public:
   /**
    * AABB contact determination
    */
-  static std::vector<GeometryContact> aabbAabbContact(const AABB &aabb, const AABB &anotherAabb) {
-      return std::vector<GeometryContact>();
+  static void aabbAabbContact(const AABB &aabb, const AABB &anotherAabb, ContactBuffer &contacts) {
+  }
+
+  static void aabbHierarchyContact(const AABB &aabb, const HierarchicalGeometry &hierarchy, ContactBuffer &contacts) {
+  }
+
+  /**
+   * Box contacts (see boxBoxContact): up to 4 points, normal from the oobb to the aabb
+   */
+  static void aabbOobbContact(const AABB &aabb, const OOBB &oobb, ContactBuffer &contacts) {
+    boxBoxContact(aabb, boxFrame(aabb), oobb, boxFrame(oobb), contacts);
+  }
+
+  /**
+   * OOBB contact determination
+   */
+
+  /**
+   * Box vertices behind the plane, reduced to at most 4. Same as planeSphereContact, normal is the plane normal.
+   */
+  static void planeOobbContact(const Plane &plane, const OOBB &oobb, ContactBuffer &contacts) {
+    const vector &normal = plane.getNormal();
+    real distance = (oobb.getOrigin() - plane.getOrigin()) * normal;
+    if(distance > projectedRadius(oobb, normal)) {
+      return;
+    }
+
+    vector points[8];
+    real depths[8];
+    unsigned int count = 0;
+    for(unsigned int index = 0; index < 8; index++) {
+      vector vertex = oobb.getVertex(index);
+      real vertexDistance = (vertex - plane.getOrigin()) * normal;
+      if(vertexDistance <= 0) {
+        points[count] = vertex;
+        depths[count++] = -vertexDistance;
+      }
+    }
+
+    count = reduceManifold(points, depths, count, normal);
+    for(unsigned int index = 0; index < count; index++) {
+      contacts.emplace(&plane, &oobb, points[index], normal, 0.8f, depths[index]);
+    }
   }
 
-  static std::vector<GeometryContact> aabbHierarchyContact(const AABB &aabb, const HierarchicalGeometry &hierarchy) {
-      return std::vector<GeometryContact>();
+  /**
+   * Same as sphereAabbContact, in box coordinates. If the sphere center is inside the box, the contact is on the closest face.
+   */
+  static void sphereOobbContact(const Sphere &sphere, const OOBB &oobb, ContactBuffer &contacts) {
+    vector local = oobb.toLocal(sphere.getOrigin());
+    const vector &halfSizes = oobb.getHalfSizes();
+    vector closestLocal(std::max(-halfSizes.x, std::min(local.x, halfSizes.x)),
+        std::max(-halfSizes.y, std::min(local.y, halfSizes.y)),
+        std::max(-halfSizes.z, std::min(local.z, halfSizes.z)));
+
+    vector delta = local - closestLocal;
+    real distanceSquared = delta * delta;
+    if(distanceSquared > sphere.getRadius() * sphere.getRadius()) {
+      return;
+    }
+
+    if(!equalsZeroAbsoluteMargin(distanceSquared)) {
+      real distance = std::sqrt(distanceSquared);
+      vector normal = oobb.toWorldDirection(delta * (1.0 / distance));
+      contacts.emplace(&sphere, &oobb, oobb.toWorld(closestLocal), normal, 0.8f, sphere.getRadius() - distance);
+      return;
+    }
+
+    real faceDistances[3] = {halfSizes.x - std::fabs(local.x), halfSizes.y - std::fabs(local.y), halfSizes.z - std::fabs(local.z)};
+    real localCoordinates[3] = {local.x, local.y, local.z};
+    unsigned int face = faceDistances[0] <= faceDistances[1] && faceDistances[0] <= faceDistances[2] ? 0 : (faceDistances[1] <= faceDistances[2] ? 1 : 2);
+    vector normal = oobb.getAxis(face) * (localCoordinates[face] < 0 ? -1 : 1);
+    vector intersection = sphere.getOrigin() + normal * faceDistances[face];
+    contacts.emplace(&sphere, &oobb, intersection, normal, 0.8f, sphere.getRadius() + faceDistances[face]);
+  }
+
+  /**
+   * Box contacts (see boxBoxContact): up to 4 points, normal from anotherOobb to oobb
+   */
+  static void oobbOobbContact(const OOBB &oobb, const OOBB &anotherOobb, ContactBuffer &contacts) {
+    boxBoxContact(oobb, boxFrame(oobb), anotherOobb, boxFrame(anotherOobb), contacts);
+  }
+
+  static std::vector<GeometryContact> oobbOobbContact(const OOBB &oobb, const OOBB &anotherOobb) {
+    ContactBuffer contacts;
+    oobbOobbContact(oobb, anotherOobb, contacts);
+    return contacts.release();
   }
 
   /**
    * Hierarchy contact determination
    */
-  static std::vector<GeometryContact> hierarchyHierarchyContact(const HierarchicalGeometry &hierarchy, const HierarchicalGeometry &anotherHierarchy) {
-      return std::vector<GeometryContact>();
+  static void hierarchyHierarchyContact(const HierarchicalGeometry &hierarchy, const HierarchicalGeometry &anotherHierarchy, ContactBuffer &contacts) {
+  }
+
+  /**
+   * Closest point to center (height map coordinates) of a GridHeightMap surface, if within radius. Descends the min-max pyramid skipping tiles
+   * whose bounds are farther than the closest point found so far - starting at radius - so only cells close to the sphere look at samples.
+   */
+  static bool closestTerrainPoint(const GridHeightMap &grid, const vector &center, real radius, vector &closestPoint, vector &triangleNormal) {
+    const MinMaxPyramid &pyramid = grid.getPyramid();
+    real closestDistance = radius * radius;
+    bool found = false;
+
+    TerrainNode stack[terrainStackSize];
+    unsigned int count = 0;
+    stack[count++] = TerrainNode {pyramid.getLevelCount() - 1, 0, 0};
+
+    while(count > 0) {
+      TerrainNode node = stack[--count];
+      vector mins, maxs;
+      terrainNodeBounds(grid, node, mins, maxs);
+
+      vector delta = center - vector(std::max(mins.x, std::min(center.x, maxs.x)), std::max(mins.y, std::min(center.y, maxs.y)), std::max(mins.z, std::min(center.z, maxs.z)));
+      if(delta * delta > closestDistance) {
+        continue;
+      }
+
+      if(node.level == 0) {
+        real cellSize = grid.getCellSize();
+        vector a(mins.x, grid.getSample(node.column, node.row), mins.z);
+        vector b(mins.x + cellSize, grid.getSample(node.column + 1, node.row), mins.z);
+        vector c(mins.x, grid.getSample(node.column, node.row + 1), mins.z + cellSize);
+        vector d(mins.x + cellSize, grid.getSample(node.column + 1, node.row + 1), mins.z + cellSize);
+
+        vector point = closestTrianglePoint(center, a, b, c);
+        delta = center - point;
+        if(delta * delta <= closestDistance) {
+          closestDistance = delta * delta;
+          closestPoint = point;
+          triangleNormal = vector(a.y - b.y, cellSize, a.y - c.y).normalizado();
+          found = true;
+        }
+
+        point = closestTrianglePoint(center, d, c, b);
+        delta = center - point;
+        if(delta * delta <= closestDistance) {
+          closestDistance = delta * delta;
+          closestPoint = point;
+          triangleNormal = vector(c.y - d.y, cellSize, b.y - d.y).normalizado();
+          found = true;
+        }
+        continue;
+      }
+
+      for(unsigned int child = 0; child < 4; child++) {
+        pushTerrainNode(pyramid, TerrainNode {node.level - 1, node.column * 2 + (child & 1), node.row * 2 + (child >> 1)}, stack, count);
+      }
+    }
+
+    return found;
+  }
+
+  /**
+   * Closest point of triangle abc to point - Ericson, Real-Time Collision Detection 5.1.5
+   */
+  static vector closestTrianglePoint(const vector &point, const vector &a, const vector &b, const vector &c) {
+    vector ab = b - a;
+    vector ac = c - a;
+    vector ap = point - a;
+    real d1 = ab * ap;
+    real d2 = ac * ap;
+    if(d1 <= 0 && d2 <= 0) {
+      return a;
+    }
+
+    vector bp = point - b;
+    real d3 = ab * bp;
+    real d4 = ac * bp;
+    if(d3 >= 0 && d4 <= d3) {
+      return b;
+    }
+
+    real vc = d1 * d4 - d3 * d2;
+    if(vc <= 0 && d1 >= 0 && d3 <= 0) {
+      return a + ab * (d1 / (d1 - d3));
+    }
+
+    vector cp = point - c;
+    real d5 = ab * cp;
+    real d6 = ac * cp;
+    if(d6 >= 0 && d5 <= d6) {
+      return c;
+    }
+
+    real vb = d5 * d2 - d1 * d6;
+    if(vb <= 0 && d2 >= 0 && d6 <= 0) {
+      return a + ac * (d2 / (d2 - d6));
+    }
+
+    real va = d3 * d6 - d5 * d4;
+    if(va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0) {
+      return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+    }
+
+    real denominator = 1.0 / (va + vb + vc);
+    return a + ab * (vb * denominator) + ac * (vc * denominator);
+  }
+
+
+protected:
+  /**
+   * Operand on scalar S, for kernels templated on the scalar of their operands: the operand itself if it is already on S, else a copy converted to S
+   */
+  template<typename S, typename T> static decltype(auto) onScalar(const BasicSphere<T> &sphere) {
+    if constexpr (std::is_same<S, T>::value) {
+      return sphere;
+    } else {
+      return BasicSphere<S>(vectorCast<typename ScalarVector<S>::type>(sphere.getOrigin()), (S)sphere.getRadius());
+    }
+  }
+
+  template<typename S, typename T> static decltype(auto) onScalar(const BasicAABB<T> &aabb) {
+    if constexpr (std::is_same<S, T>::value) {
+      return aabb;
+    } else {
+      return BasicAABB<S>(vectorCast<typename ScalarVector<S>::type>(aabb.getOrigin()), vectorCast<typename ScalarVector<S>::type>(aabb.getHalfSizes()));
+    }
+  }
+
+  template<typename S, typename T> static decltype(auto) onScalar(const BasicPlane<T> &plane) {
+    if constexpr (std::is_same<S, T>::value) {
+      return plane;
+    } else {
+      return BasicPlane<S>(vectorCast<typename ScalarVector<S>::type>(plane.getOrigin()), vectorCast<typename ScalarVector<S>::type>(plane.getNormal()));
+    }
+  }
+
+  template<typename S, typename T> static decltype(auto) onScalar(const BasicLine<T> &line) {
+    if constexpr (std::is_same<S, T>::value) {
+      return line;
+    } else {
+      return BasicLine<S>(vectorCast<typename ScalarVector<S>::type>(line.getOrigin()), vectorCast<typename ScalarVector<S>::type>(line.getDirection()));
+    }
+  }
+
+  /**
+   * Box as center, half sizes and axes (rotation matrix columns) - shared by aabb and oobb kernels, aabbs using the world axes
+   */
+  struct BoxFrame {
+    vector center;
+    real halfSizes[3];
+    const vector *axes;
+  };
+
+  static const vector *worldAxes() {
+    static const vector axes[3] = {vector(1, 0, 0), vector(0, 1, 0), vector(0, 0, 1)};
+    return axes;
+  }
+
+  static BoxFrame boxFrame(const AABB &aabb) {
+    const vector &halfSizes = aabb.getHalfSizes();
+    return BoxFrame {aabb.getOrigin(), {halfSizes.x, halfSizes.y, halfSizes.z}, worldAxes()};
+  }
+
+  static BoxFrame boxFrame(const OOBB &oobb) {
+    const vector &halfSizes = oobb.getHalfSizes();
+    return BoxFrame {oobb.getOrigin(), {halfSizes.x, halfSizes.y, halfSizes.z}, oobb.getAxes()};
+  }
+
+  static real projectedRadius(const OOBB &oobb, const vector &direction) {
+    const vector &halfSizes = oobb.getHalfSizes();
+    return halfSizes.x * std::fabs(oobb.getAxis(0) * direction) + halfSizes.y * std::fabs(oobb.getAxis(1) * direction) + halfSizes.z * std::fabs(oobb.getAxis(2) * direction);
+  }
+
+  static real projectedRadius(const BoxFrame &box, const vector &direction) {
+    return box.halfSizes[0] * std::fabs(box.axes[0] * direction) + box.halfSizes[1] * std::fabs(box.axes[1] * direction) + box.halfSizes[2] * std::fabs(box.axes[2] * direction);
+  }
+
+  /**
+   * Added to absolute rotation terms so that cross products of near parallel edges (close to zero vectors) do not report a separation
+   */
+  static constexpr real boxEpsilon = 1e-5;
+
+  /**
+   * Separating axis test (Ericson, Real-Time Collision Detection 4.4.1) over the 15 candidate axes: face normals of both boxes first, as they
+   * separate most pairs, then the 9 edge cross products. Computed in a's frame with the rotation matrix between boxes, exits at the first separating axis.
+   */
+  static bool boxBox(const BoxFrame &a, const BoxFrame &b) {
+    real rotation[3][3];
+    real absoluteRotation[3][3];
+    for(unsigned int i = 0; i < 3; i++) {
+      for(unsigned int j = 0; j < 3; j++) {
+        rotation[i][j] = a.axes[i] * b.axes[j];
+        absoluteRotation[i][j] = std::fabs(rotation[i][j]) + boxEpsilon;
+      }
+    }
+
+    vector delta = b.center - a.center;
+    real translation[3] = {delta * a.axes[0], delta * a.axes[1], delta * a.axes[2]};
+
+    for(unsigned int i = 0; i < 3; i++) {
+      real radiusB = b.halfSizes[0] * absoluteRotation[i][0] + b.halfSizes[1] * absoluteRotation[i][1] + b.halfSizes[2] * absoluteRotation[i][2];
+      if(std::fabs(translation[i]) > a.halfSizes[i] + radiusB) {
+        return false;
+      }
+    }
+
+    for(unsigned int j = 0; j < 3; j++) {
+      real radiusA = a.halfSizes[0] * absoluteRotation[0][j] + a.halfSizes[1] * absoluteRotation[1][j] + a.halfSizes[2] * absoluteRotation[2][j];
+      real distance = translation[0] * rotation[0][j] + translation[1] * rotation[1][j] + translation[2] * rotation[2][j];
+      if(std::fabs(distance) > radiusA + b.halfSizes[j]) {
+        return false;
+      }
+    }
+
+    for(unsigned int i = 0; i < 3; i++) {
+      unsigned int i1 = (i + 1) % 3, i2 = (i + 2) % 3;
+      for(unsigned int j = 0; j < 3; j++) {
+        unsigned int j1 = (j + 1) % 3, j2 = (j + 2) % 3;
+        real radiusA = a.halfSizes[i1] * absoluteRotation[i2][j] + a.halfSizes[i2] * absoluteRotation[i1][j];
+        real radiusB = b.halfSizes[j1] * absoluteRotation[i][j2] + b.halfSizes[j2] * absoluteRotation[i][j1];
+        real distance = translation[i2] * rotation[i1][j] - translation[i1] * rotation[i2][j];
+        if(std::fabs(distance) > radiusA + radiusB) {
+          return false;
+        }
+      }
+    }
+
+    return true;
+  }
+
+  /**
+   * Box contacts, normal from b to a. The axis of least penetration over the 15 separating axis candidates - faces preferred over edges, and a faces
+   * over b faces, unless clearly shallower, so manifolds do not flip between frames - gives the normal:
+   *  - face axis: the face of the other box most facing the reference face is clipped against the reference face side planes, and points behind the
+   *    reference face become contacts (midway between both surfaces), reduced to at most 4.
+   *  - edge axis: a single contact between the closest points of the two edges.
+   */
+  static void boxBoxContact(const Geometry &geometryA, const BoxFrame &a, const Geometry &geometryB, const BoxFrame &b, ContactBuffer &contacts) {
+    constexpr real preferenceTolerance = 1.05;
+    vector delta = a.center - b.center;
+
+    real bestPenetration = REAL_MAX;
+    vector normal;
+    unsigned int bestAxis = 0;
+
+    for(unsigned int axis = 0; axis < 6; axis++) {
+      const vector &direction = axis < 3 ? a.axes[axis] : b.axes[axis - 3];
+      real distance = delta * direction;
+      real penetration = projectedRadius(a, direction) + projectedRadius(b, direction) - std::fabs(distance);
+      if(penetration < 0) {
+        return;
+      }
+
+      if(penetration * (axis < 3 ? 1 : preferenceTolerance) < bestPenetration) {
+        bestPenetration = penetration;
+        bestAxis = axis;
+        normal = distance < 0 ? vector(0, 0, 0) - direction : direction;
+      }
+    }
+
+    for(unsigned int i = 0; i < 3; i++) {
+      for(unsigned int j = 0; j < 3; j++) {
+        vector direction = a.axes[i] ^ b.axes[j];
+        real length = direction.modulo();
+        if(length < 1e-3) { // near parallel edges, face axes already cover them
+          continue;
+        }
+
+        direction = direction * (1.0 / length);
+        real distance = delta * direction;
+        real penetration = projectedRadius(a, direction) + projectedRadius(b, direction) - std::fabs(distance);
+        if(penetration < 0) {
+          return;
+        }
+
+        if(penetration * preferenceTolerance < bestPenetration) {
+          bestPenetration = penetration;
+          bestAxis = 6 + i * 3 + j;
+          normal = distance < 0 ? vector(0, 0, 0) - direction : direction;
+        }
+      }
+    }
+
+    if(bestAxis >= 6) {
+      unsigned int i = (bestAxis - 6) / 3;
+      unsigned int j = (bestAxis - 6) % 3;
+      vector edgeA = a.center;
+      vector edgeB = b.center;
+      for(unsigned int k = 0; k < 3; k++) {
+        if(k != i) {
+          edgeA = edgeA + a.axes[k] * (a.axes[k] * normal > 0 ? -a.halfSizes[k] : a.halfSizes[k]);
+        }
+        if(k != j) {
+          edgeB = edgeB + b.axes[k] * (b.axes[k] * normal > 0 ? b.halfSizes[k] : -b.halfSizes[k]);
+        }
+      }
+
+      vector offset = edgeA - edgeB;
+      real cosine = a.axes[i] * b.axes[j];
+      real projectionA = a.axes[i] * offset;
+      real projectionB = b.axes[j] * offset;
+      real s = (cosine * projectionB - projectionA) / (1 - cosine * cosine);
+      s = std::max(-a.halfSizes[i], std::min(s, a.halfSizes[i]));
+      real u = std::max(-b.halfSizes[j], std::min(projectionB + s * cosine, b.halfSizes[j]));
+
+      vector intersection = (edgeA + a.axes[i] * s + edgeB + b.axes[j] * u) * 0.5;
+      contacts.emplace(&geometryA, &geometryB, intersection, normal, 0.8f, bestPenetration);
+      return;
+    }
+
+    bool referenceIsA = bestAxis < 3;
+    const BoxFrame &reference = referenceIsA ? a : b;
+    const BoxFrame &incident = referenceIsA ? b : a;
+    unsigned int referenceAxis = bestAxis % 3;
+    vector referenceNormal = referenceIsA ? vector(0, 0, 0) - normal : normal; // from reference towards incident box
+    vector referenceCenter = reference.center + referenceNormal * reference.halfSizes[referenceAxis];
+
+    unsigned int incidentAxis = 0;
+    real mostFacing = -1;
+    for(unsigned int axis = 0; axis < 3; axis++) {
+      real facing = std::fabs(incident.axes[axis] * referenceNormal);
+      if(facing > mostFacing) {
+        mostFacing = facing;
+        incidentAxis = axis;
+      }
+    }
+
+    vector incidentNormal = incident.axes[incidentAxis] * (incident.axes[incidentAxis] * referenceNormal > 0 ? -1 : 1);
+    vector incidentCenter = incident.center + incidentNormal * incident.halfSizes[incidentAxis];
+    vector side1 = incident.axes[(incidentAxis + 1) % 3] * incident.halfSizes[(incidentAxis + 1) % 3];
+    vector side2 = incident.axes[(incidentAxis + 2) % 3] * incident.halfSizes[(incidentAxis + 2) % 3];
+
+    vector polygon[8] = {incidentCenter + side1 + side2, incidentCenter - side1 + side2, incidentCenter - side1 - side2, incidentCenter + side1 - side2};
+    vector clipped[8];
+    unsigned int count = 4;
+    for(unsigned int side = 1; side < 3; side++) {
+      const vector &sideAxis = reference.axes[(referenceAxis + side) % 3];
+      real center = sideAxis * referenceCenter;
+      real halfSize = reference.halfSizes[(referenceAxis + side) % 3];
+      count = clipPolygon(polygon, count, sideAxis, center + halfSize, clipped);
+      count = clipPolygon(clipped, count, vector(0, 0, 0) - sideAxis, halfSize - center, polygon);
+    }
+
+    vector points[8];
+    real depths[8];
+    unsigned int contactCount = 0;
+    for(unsigned int index = 0; index < count; index++) {
+      real depth = (referenceCenter - polygon[index]) * referenceNormal;
+      if(depth >= 0) {
+        points[contactCount] = polygon[index] + referenceNormal * (depth * 0.5);
+        depths[contactCount++] = depth;
+      }
+    }
+
+    contactCount = reduceManifold(points, depths, contactCount, referenceNormal);
+    for(unsigned int index = 0; index < contactCount; index++) {
+      contacts.emplace(&geometryA, &geometryB, points[index], normal, 0.8f, depths[index]);
+    }
+  }
+
+  /**
+   * Sutherland-Hodgman step: keeps the part of the polygon where point * planeNormal <= planeOffset. Clipping a quad by 4 planes needs up to 8 vertices.
+   */
+  static unsigned int clipPolygon(const vector *polygon, unsigned int count, const vector &planeNormal, real planeOffset, vector *clipped) {
+    unsigned int clippedCount = 0;
+    for(unsigned int index = 0; index < count; index++) {
+      const vector &current = polygon[index];
+      const vector &next = polygon[(index + 1) % count];
+      real currentDistance = current * planeNormal - planeOffset;
+      real nextDistance = next * planeNormal - planeOffset;
+
+      if(currentDistance <= 0) {
+        clipped[clippedCount++] = current;
+      }
+      if((currentDistance < 0 && nextDistance > 0) || (currentDistance > 0 && nextDistance < 0)) {
+        clipped[clippedCount++] = current + (next - current) * (currentDistance / (currentDistance - nextDistance));
+      }
+    }
+
+    return clippedCount;
+  }
+
+  /**
+   * Keeps at most 4 of count points (in place): the deepest, the farthest from it, then the two points spanning the largest triangles with those
+   * on either side - the subset keeping most of the contact area, which is what keeps boxes stable. Returns the new count.
+   */
+  static unsigned int reduceManifold(vector *points, real *depths, unsigned int count, const vector &normal) {
+    if(count <= 4) {
+      return count;
+    }
+
+    unsigned int deepest = 0;
+    for(unsigned int index = 1; index < count; index++) {
+      if(depths[index] > depths[deepest]) {
+        deepest = index;
+      }
+    }
+
+    unsigned int farthest = deepest;
+    real farthestDistance = -1;
+    for(unsigned int index = 0; index < count; index++) {
+      vector offset = points[index] - points[deepest];
+      if(offset * offset > farthestDistance) {
+        farthestDistance = offset * offset;
+        farthest = index;
+      }
+    }
+
+    unsigned int positive = deepest, negative = deepest;
+    real maximumArea = 0, minimumArea = 0;
+    for(unsigned int index = 0; index < count; index++) {
+      real area = ((points[deepest] - points[index]) ^ (points[farthest] - points[index])) * normal;
+      if(area > maximumArea) {
+        maximumArea = area;
+        positive = index;
+      }
+      if(area < minimumArea) {
+        minimumArea = area;
+        negative = index;
+      }
+    }
+
+    unsigned int kept[4] = {deepest, farthest, positive, negative};
+    vector keptPoints[4];
+    real keptDepths[4];
+    unsigned int keptCount = 0;
+    for(unsigned int index = 0; index < 4; index++) {
+      bool duplicate = false;
+      for(unsigned int previous = 0; previous < index; previous++) {
+        duplicate = duplicate || kept[previous] == kept[index];
+      }
+      if(!duplicate) {
+        keptPoints[keptCount] = points[kept[index]];
+        keptDepths[keptCount++] = depths[kept[index]];
+      }
+    }
+
+    for(unsigned int index = 0; index < keptCount; index++) {
+      points[index] = keptPoints[index];
+      depths[index] = keptDepths[index];
+    }
+    return keptCount;
+  }
+
+  /**
+   * Min-max pyramid node. Traversals push at most 3 nodes more than they pop per level, so a small fixed stack is enough for any grid size.
+   */
+  struct TerrainNode {
+    unsigned int level;
+    unsigned int column;
+    unsigned int row;
+  };
+
+  static constexpr unsigned int terrainStackSize = 4 * 32;
+
+  static void pushTerrainNode(const MinMaxPyramid &pyramid, const TerrainNode &node, TerrainNode *stack, unsigned int &count) {
+    if(node.column < pyramid.getColumns(node.level) && node.row < pyramid.getRows(node.level)) {
+      stack[count++] = node;
+    }
+  }
+
+  /**
+   * Node cells footprint and height range, in height map coordinates
+   */
+  static void terrainNodeBounds(const GridHeightMap &grid, const TerrainNode &node, vector &mins, vector &maxs) {
+    const MinMaxPyramid &pyramid = grid.getPyramid();
+    real cellSize = grid.getCellSize();
+    unsigned long endColumn = std::min((unsigned long)(node.column + 1) << node.level, (unsigned long)pyramid.getColumns(0));
+    unsigned long endRow = std::min((unsigned long)(node.row + 1) << node.level, (unsigned long)pyramid.getRows(0));
+
+    mins = vector(((unsigned long)node.column << node.level) * cellSize, pyramid.getMin(node.level, node.column, node.row), ((unsigned long)node.row << node.level) * cellSize);
+    maxs = vector(endColumn * cellSize, pyramid.getMax(node.level, node.column, node.row), endRow * cellSize);
+  }
+
+  /**
+   * Closest hit of the ray with the two triangles of a cell - same split as GridHeightMap::heightAt
+   */
+  static bool lineTerrainCell(const GridHeightMap &grid, unsigned int column, unsigned int row, const vector &origin, const vector &direction, real &t, vector &normal) {
+    real cellSize = grid.getCellSize();
+    vector a(column * cellSize, grid.getSample(column, row), row * cellSize);
+    vector b((column + 1) * cellSize, grid.getSample(column + 1, row), row * cellSize);
+    vector c(column * cellSize, grid.getSample(column, row + 1), (row + 1) * cellSize);
+    vector d((column + 1) * cellSize, grid.getSample(column + 1, row + 1), (row + 1) * cellSize);
+
+    real lowerT, upperT;
+    bool lower = lineTriangle(origin, direction, a, b, c, lowerT);
+    bool upper = lineTriangle(origin, direction, d, c, b, upperT);
+
+    if(lower && (!upper || lowerT <= upperT)) {
+      t = lowerT;
+      normal = vector(a.y - b.y, cellSize, a.y - c.y).normalizado();
+      return true;
+    }
+
+    if(upper) {
+      t = upperT;
+      normal = vector(c.y - d.y, cellSize, b.y - d.y).normalizado();
+      return true;
+    }
+
+    return false;
+  }
+
+  /**
+   * Height range of the surface over [minX, maxX] x [minZ, maxZ], within a single cell. Heights are linear on each triangle, so extremes are on the
+   * vertices of the rectangle clipped by the cell diagonal (x + z = diagonal): the rectangle corners and the diagonal crossings of its sides.
+   */
+  static void terrainCellHeightRange(const GridHeightMap &grid, real minX, real maxX, real minZ, real maxZ, real diagonal, real &minHeight, real &maxHeight) {
+    real candidates[8][2] = {
+        {minX, minZ}, {maxX, minZ}, {minX, maxZ}, {maxX, maxZ},
+        {minX, diagonal - minX}, {maxX, diagonal - maxX}, {diagonal - minZ, minZ}, {diagonal - maxZ, maxZ}};
+
+    minHeight = REAL_MAX;
+    maxHeight = -REAL_MAX;
+    for(unsigned int index = 0; index < 8; index++) {
+      real x = candidates[index][0];
+      real z = candidates[index][1];
+      if(minX <= x && x <= maxX && minZ <= z && z <= maxZ) {
+        real height = grid.heightAt(x, z);
+        minHeight = std::min(minHeight, height);
+        maxHeight = std::max(maxHeight, height);
+      }
+    }
   }
 };
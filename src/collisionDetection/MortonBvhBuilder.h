@@ -0,0 +1,484 @@
+/*
+ * MortonBvhBuilder.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: leandro
+ */
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <LinearBvh.h>
+#include "WorkStealingThreadPool.h"
+
+/**
+ * Parallel builder of LinearBvh for large static sets of geometries, e.g. every static collider of a level, in linear bvh (LBVH) fashion:
+ *
+ *  1. Morton codes of geometry centers, quantized in the bounds of all centers: 10 bits per axis (30 bit codes) or 21 (63 bit codes).
+ *  2. Parallel least significant digit radix sort of (code, geometry) pairs, 8 bits per pass: per chunk histograms, prefix sums, stable scatter.
+ *  3. Karras split: each internal node finds its range of sorted leaves and its split independently of the others, so all of them are emitted
+ *     in parallel. Equal codes are told apart by their position, so duplicate centers still give a valid tree.
+ *  4. Bottom up refit in parallel: every leaf walks up, and the second child to reach a node merges both bounds and goes on. The first one stops.
+ *
+ * Nodes are then written straight in depth first order - the position of each node follows from its leaf range and its path to the root -
+ * so the result is the same LinearBvh CollisionTester already queries, with no serial pass besides prefix sums.
+ * Unbounded geometries are emitted first as top level leaves, same as LinearBvh::add(geometries). Hierarchies and other types are kept as
+ * single leaves referencing the source geometry.
+ *
+ * Output only depends on the input, never on the thread count or on how chunks were stolen. Scratch buffers are kept across builds.
+ * Tree quality is below the median split of LinearBvh, in exchange for a build that is linear and parallel: meant for hundreds of thousands
+ * of geometries, where build time matters.
+ */
+class MortonBvhBuilder {
+  static constexpr unsigned int radixBits = 8;
+  static constexpr unsigned int radixSize = 1 << radixBits;
+  static constexpr unsigned int shapeTypes = 6; // spheres, aabbs, oobbs, planes, lines, others
+  static constexpr unsigned int none = (unsigned int)-1;
+  static constexpr unsigned int maximumDepth = 64 + 32 + 1; // each level below the root extends the common prefix of codes and positions
+
+  /**
+   * Children ids below leafBase are internal nodes, leafBase + k is the k-th sorted leaf
+   */
+  struct InternalNode {
+    unsigned int first = 0;
+    unsigned int last = 0;
+    unsigned int left = 0;
+    unsigned int right = 0;
+  };
+
+  WorkStealingThreadPool &threadPool;
+  unsigned int bitsPerAxis;
+  unsigned int chunkSize;
+
+  const std::vector<const Geometry *> *geometries = nullptr;
+  unsigned int leafCount = 0;
+  unsigned int leafBase = 0;
+
+  std::vector<Bounds> bounds; // per input geometry
+  std::vector<GeometryType> types; // per input geometry, read along with bounds so that sorted leaves touch geometries once
+  std::vector<Bounds> chunkCenters;
+  std::vector<uint64_t> codes;
+  std::vector<uint64_t> sortedCodes;
+  std::vector<unsigned int> order; // input geometry of each leaf
+  std::vector<unsigned int> sortedOrder;
+  std::vector<unsigned int> histograms; // radixSize per chunk
+  std::vector<unsigned int> typeOffsets; // shapeTypes per chunk
+  std::vector<InternalNode> internalNodes;
+  std::vector<unsigned int> parents; // per node id, internal nodes then leaves
+  std::vector<Bounds> nodeBounds; // per node id
+  std::vector<unsigned int> depthFirst; // per node id
+  std::vector<unsigned int> subtrees;
+  std::unique_ptr<std::atomic<unsigned int>[]> visits;
+  unsigned int visitsCapacity = 0;
+
+public:
+  /**
+   * Wide codes (63 bits) tell apart centers 2^21 cells per axis apart instead of 2^10, at twice the sort passes.
+   */
+  MortonBvhBuilder(WorkStealingThreadPool &threadPool, bool wideCodes = true, unsigned int chunkSize = 1024) : threadPool(threadPool) {
+    this->bitsPerAxis = wideCodes ? 21 : 10;
+    this->chunkSize = std::max(1u, chunkSize);
+  }
+
+  unsigned int getCodeBits() const {
+    return bitsPerAxis * 3;
+  }
+
+  /**
+   * Replaces the contents of bvh with a tree over geometries. Geometries are not owned and must outlive the bvh if contacts are used.
+   */
+  void build(const std::vector<const Geometry *> &geometries, LinearBvh &bvh) {
+    bvh.clear();
+    this->geometries = &geometries;
+
+    bounds.resize(geometries.size());
+    types.resize(geometries.size());
+    forEachChunk(geometries.size(), [this](unsigned int chunk, unsigned int begin, unsigned int end) {
+      for(unsigned int index = begin; index < end; index++) {
+        bounds[index] = (*this->geometries)[index]->getBounds();
+        types[index] = (*this->geometries)[index]->getType();
+      }
+    });
+
+    order.clear();
+    for(unsigned int index = 0; index < geometries.size(); index++) {
+      if(bounds[index].maxs.x >= REAL_MAX) {
+        bvh.add(*geometries[index]);
+      } else {
+        order.push_back(index);
+      }
+    }
+
+    leafCount = order.size();
+    leafBase = leafCount > 0 ? leafCount - 1 : 0;
+    if(leafCount == 0) {
+      return;
+    }
+
+    computeCodes();
+    sortCodes();
+    emitInternalNodes();
+    refit();
+    computeDepthFirstIndices();
+    write(bvh);
+  }
+
+protected:
+  unsigned int chunkCount(unsigned int count) const {
+    return (count + chunkSize - 1) / chunkSize;
+  }
+
+  template<typename Task> void forEachChunk(unsigned int count, const Task &task) {
+    unsigned int size = chunkSize;
+    threadPool.parallelFor(chunkCount(count), [&task, size, count](unsigned int chunk, unsigned int worker) {
+      task(chunk, chunk * size, std::min(count, (chunk + 1) * size));
+    });
+  }
+
+  /**
+   * Spreads the lower 21 bits of value so that there are two zero bits between each of them
+   */
+  static uint64_t expandBits(uint64_t value) {
+    value &= 0x1fffff;
+    value = (value | value << 32) & 0x1f00000000ffffull;
+    value = (value | value << 16) & 0x1f0000ff0000ffull;
+    value = (value | value << 8) & 0x100f00f00f00f00full;
+    value = (value | value << 4) & 0x10c30c30c30c30c3ull;
+    value = (value | value << 2) & 0x1249249249249249ull;
+    return value;
+  }
+
+  static unsigned int leadingZeros(uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_clzll(value);
+#else
+    unsigned int count = 0;
+    for(uint64_t bit = 1ull << 63; (value & bit) == 0; bit >>= 1) {
+      count++;
+    }
+    return count;
+#endif
+  }
+
+  static unsigned int quantize(real value, real minimum, real scale, unsigned int maximum) {
+    real cell = (value - minimum) * scale;
+    return cell <= 0 ? 0 : std::min(maximum, (unsigned int)cell);
+  }
+
+  void computeCodes() {
+    chunkCenters.resize(chunkCount(leafCount));
+    forEachChunk(leafCount, [this](unsigned int chunk, unsigned int begin, unsigned int end) {
+      vector center = bounds[order[begin]].getCenter();
+      Bounds centers(center, center);
+      for(unsigned int leaf = begin + 1; leaf < end; leaf++) {
+        center = bounds[order[leaf]].getCenter();
+        centers = centers.merge(Bounds(center, center));
+      }
+      chunkCenters[chunk] = centers;
+    });
+
+    Bounds centers = chunkCenters[0];
+    for(const Bounds &chunkBounds : chunkCenters) {
+      centers = centers.merge(chunkBounds);
+    }
+
+    unsigned int maximum = (1u << bitsPerAxis) - 1;
+    vector extents = centers.maxs - centers.mins;
+    vector scale(extents.x > 0 ? maximum / extents.x : 0, extents.y > 0 ? maximum / extents.y : 0, extents.z > 0 ? maximum / extents.z : 0);
+
+    codes.resize(leafCount);
+    forEachChunk(leafCount, [this, &centers, &scale, maximum](unsigned int chunk, unsigned int begin, unsigned int end) {
+      for(unsigned int leaf = begin; leaf < end; leaf++) {
+        vector center = bounds[order[leaf]].getCenter();
+        codes[leaf] = expandBits(quantize(center.x, centers.mins.x, scale.x, maximum)) << 2
+            | expandBits(quantize(center.y, centers.mins.y, scale.y, maximum)) << 1
+            | expandBits(quantize(center.z, centers.mins.z, scale.z, maximum));
+      }
+    });
+  }
+
+  /**
+   * Stable, so equal codes keep input order and the tree does not depend on the thread count
+   */
+  void sortCodes() {
+    unsigned int chunks = chunkCount(leafCount);
+    histograms.resize(chunks * radixSize);
+    sortedCodes.resize(leafCount);
+    sortedOrder.resize(leafCount);
+
+    for(unsigned int shift = 0; shift < getCodeBits(); shift += radixBits) {
+      forEachChunk(leafCount, [this, shift](unsigned int chunk, unsigned int begin, unsigned int end) {
+        unsigned int *histogram = &histograms[chunk * radixSize];
+        std::fill(histogram, histogram + radixSize, 0);
+        for(unsigned int leaf = begin; leaf < end; leaf++) {
+          histogram[(codes[leaf] >> shift) & (radixSize - 1)]++;
+        }
+      });
+
+      unsigned int offset = 0;
+      for(unsigned int digit = 0; digit < radixSize; digit++) {
+        for(unsigned int chunk = 0; chunk < chunks; chunk++) {
+          unsigned int count = histograms[chunk * radixSize + digit];
+          histograms[chunk * radixSize + digit] = offset;
+          offset += count;
+        }
+      }
+
+      forEachChunk(leafCount, [this, shift](unsigned int chunk, unsigned int begin, unsigned int end) {
+        unsigned int *offsets = &histograms[chunk * radixSize];
+        for(unsigned int leaf = begin; leaf < end; leaf++) {
+          unsigned int position = offsets[(codes[leaf] >> shift) & (radixSize - 1)]++;
+          sortedCodes[position] = codes[leaf];
+          sortedOrder[position] = order[leaf];
+        }
+      });
+
+      codes.swap(sortedCodes);
+      order.swap(sortedOrder);
+    }
+  }
+
+  /**
+   * Length of the common prefix of sorted leaves a and b, -1 out of range. Equal codes extend the prefix with the leaf positions.
+   */
+  int commonPrefix(int a, int b) const {
+    if(b < 0 || b >= (int)leafCount) {
+      return -1;
+    }
+    uint64_t difference = codes[a] ^ codes[b];
+    return difference != 0 ? leadingZeros(difference) : 64 + leadingZeros((uint64_t)(a ^ b));
+  }
+
+  unsigned int child(unsigned int split, unsigned int rangeEnd) const {
+    return split == rangeEnd ? leafBase + split : split;
+  }
+
+  void emitInternalNodes() {
+    internalNodes.resize(leafBase);
+    parents.resize(leafBase + leafCount);
+    parents[0] = none;
+
+    forEachChunk(leafBase, [this](unsigned int chunk, unsigned int begin, unsigned int end) {
+      for(unsigned int node = begin; node < end; node++) {
+        int index = node;
+        int direction = commonPrefix(index, index + 1) > commonPrefix(index, index - 1) ? 1 : -1;
+
+        int minimumPrefix = commonPrefix(index, index - direction);
+        int maximumLength = 2;
+        while(commonPrefix(index, index + maximumLength * direction) > minimumPrefix) {
+          maximumLength *= 2;
+        }
+        int length = 0;
+        for(int step = maximumLength / 2; step >= 1; step /= 2) {
+          if(commonPrefix(index, index + (length + step) * direction) > minimumPrefix) {
+            length += step;
+          }
+        }
+        int other = index + length * direction;
+
+        int nodePrefix = commonPrefix(index, other);
+        int split = 0;
+        for(int divisor = 2, step = (length + 1) / 2; ; divisor *= 2, step = (length + divisor - 1) / divisor) {
+          if(commonPrefix(index, index + (split + step) * direction) > nodePrefix) {
+            split += step;
+          }
+          if(step <= 1) {
+            break;
+          }
+        }
+        unsigned int splitLeaf = index + split * direction + std::min(direction, 0);
+
+        InternalNode &internalNode = internalNodes[node];
+        internalNode.first = std::min(index, other);
+        internalNode.last = std::max(index, other);
+        internalNode.left = child(splitLeaf, internalNode.first);
+        internalNode.right = child(splitLeaf + 1, internalNode.last);
+        parents[internalNode.left] = node;
+        parents[internalNode.right] = node;
+      }
+    });
+
+    if(leafCount == 1) {
+      parents[leafBase] = none;
+    }
+  }
+
+  void refit() {
+    nodeBounds.resize(leafBase + leafCount);
+    if(visitsCapacity < leafBase) {
+      visits.reset(new std::atomic<unsigned int>[leafBase]);
+      visitsCapacity = leafBase;
+    }
+
+    forEachChunk(leafCount, [this](unsigned int chunk, unsigned int begin, unsigned int end) {
+      for(unsigned int leaf = begin; leaf < end; leaf++) {
+        nodeBounds[leafBase + leaf] = bounds[order[leaf]];
+        if(leaf < leafBase) {
+          visits[leaf].store(0, std::memory_order_relaxed);
+        }
+      }
+    });
+
+    forEachChunk(leafCount, [this](unsigned int chunk, unsigned int begin, unsigned int end) {
+      for(unsigned int leaf = begin; leaf < end; leaf++) {
+        unsigned int node = parents[leafBase + leaf];
+        while(node != none && visits[node].fetch_add(1, std::memory_order_acq_rel) == 1) { // second child to arrive, both bounds are set
+          const InternalNode &internalNode = internalNodes[node];
+          nodeBounds[node] = nodeBounds[internalNode.left].merge(nodeBounds[internalNode.right]);
+          node = parents[node];
+        }
+      }
+    });
+  }
+
+  unsigned int leaves(unsigned int node) const {
+    return node >= leafBase ? 1 : internalNodes[node].last - internalNodes[node].first + 1;
+  }
+
+  /**
+   * Depth first position of every node, relative to the root: the left child follows its parent, the right child follows the left subtree,
+   * which holds 2 * leaves - 1 nodes. The top of the tree is split serially into subtrees, then subtrees are numbered in parallel.
+   */
+  void computeDepthFirstIndices() {
+    depthFirst.resize(leafBase + leafCount);
+    subtrees.assign(1, leafCount > 1 ? 0 : leafBase);
+    depthFirst[subtrees[0]] = 0;
+
+    unsigned int subtreeCount = threadPool.getThreadCount() * 16;
+    for(unsigned int position = 0; position < subtrees.size() && subtrees.size() < subtreeCount; position++) {
+      unsigned int node = subtrees[position];
+      if(node < leafBase) {
+        const InternalNode &internalNode = internalNodes[node];
+        depthFirst[internalNode.left] = depthFirst[node] + 1;
+        depthFirst[internalNode.right] = depthFirst[node] + 2 * leaves(internalNode.left);
+        subtrees.push_back(internalNode.left);
+        subtrees.push_back(internalNode.right);
+        subtrees[position] = none;
+      }
+    }
+
+    threadPool.parallelFor(subtrees.size(), [this](unsigned int subtree, unsigned int worker) {
+      unsigned int stack[maximumDepth];
+      unsigned int top = 0;
+      if(subtrees[subtree] != none) {
+        stack[top++] = subtrees[subtree];
+      }
+      while(top > 0) {
+        unsigned int node = stack[--top];
+        if(node < leafBase) {
+          const InternalNode &internalNode = internalNodes[node];
+          depthFirst[internalNode.left] = depthFirst[node] + 1;
+          depthFirst[internalNode.right] = depthFirst[node] + 2 * leaves(internalNode.left);
+          stack[top++] = internalNode.right;
+          stack[top++] = internalNode.left;
+        }
+      }
+    });
+  }
+
+  static unsigned int shapeType(GeometryType type) {
+    switch(type) {
+      case GeometryType::SPHERE:
+        return 0;
+      case GeometryType::AABB:
+        return 1;
+      case GeometryType::OOBB:
+        return 2;
+      case GeometryType::PLANE:
+        return 3;
+      case GeometryType::LINE:
+        return 4;
+      default:
+        return 5;
+    }
+  }
+
+  void write(LinearBvh &bvh) {
+    unsigned int chunks = chunkCount(leafCount);
+    typeOffsets.resize(chunks * shapeTypes);
+    forEachChunk(leafCount, [this](unsigned int chunk, unsigned int begin, unsigned int end) {
+      unsigned int *counts = &typeOffsets[chunk * shapeTypes];
+      std::fill(counts, counts + shapeTypes, 0);
+      for(unsigned int leaf = begin; leaf < end; leaf++) {
+        counts[shapeType(types[order[leaf]])]++;
+      }
+    });
+
+    unsigned int typeBases[shapeTypes] = { (unsigned int)bvh.spheres.size(), (unsigned int)bvh.aabbs.size() + leafBase, (unsigned int)bvh.oobbs.size(),
+        (unsigned int)bvh.planes.size(), (unsigned int)bvh.lines.size(), (unsigned int)bvh.others.size() };
+    unsigned int typeEnds[shapeTypes];
+    for(unsigned int type = 0; type < shapeTypes; type++) {
+      unsigned int offset = typeBases[type];
+      for(unsigned int chunk = 0; chunk < chunks; chunk++) {
+        unsigned int count = typeOffsets[chunk * shapeTypes + type];
+        typeOffsets[chunk * shapeTypes + type] = offset;
+        offset += count;
+      }
+      typeEnds[type] = offset;
+    }
+
+    unsigned int nodeBase = bvh.nodes.size();
+    unsigned int aabbBase = bvh.aabbs.size();
+    bvh.nodes.resize(nodeBase + leafBase + leafCount, LinearBvh::Node(GeometryType::AABB, 0));
+    bvh.sources.resize(nodeBase + leafBase + leafCount, nullptr);
+    bvh.spheres.resize(typeEnds[0], Sphere(vector(0, 0, 0), 0));
+    bvh.aabbs.resize(typeEnds[1], AABB(vector(0, 0, 0), vector(0, 0, 0)));
+    bvh.oobbs.resize(typeEnds[2], OOBB(vector(0, 0, 0), vector(0, 0, 0)));
+    bvh.planes.resize(typeEnds[3], Plane(vector(0, 0, 0), vector(0, 1, 0)));
+    bvh.lines.resize(typeEnds[4], Line(vector(0, 0, 0), vector(1, 0, 0)));
+    bvh.others.resize(typeEnds[5], nullptr);
+
+    forEachChunk(leafBase, [this, &bvh, nodeBase, aabbBase](unsigned int chunk, unsigned int begin, unsigned int end) {
+      for(unsigned int node = begin; node < end; node++) {
+        unsigned int index = nodeBase + depthFirst[node];
+        LinearBvh::Node &bvhNode = bvh.nodes[index];
+        bvhNode.type = GeometryType::AABB;
+        bvhNode.shape = aabbBase + node;
+        bvhNode.escape = index + 2 * leaves(node) - 1;
+        bvhNode.leaf = false;
+        bvh.aabbs[aabbBase + node] = LinearBvh::enclosing(nodeBounds[node]);
+      }
+    });
+
+    forEachChunk(leafCount, [this, &bvh, nodeBase](unsigned int chunk, unsigned int begin, unsigned int end) {
+      unsigned int *offsets = &typeOffsets[chunk * shapeTypes];
+      for(unsigned int leaf = begin; leaf < end; leaf++) {
+        const Geometry *geometry = (*geometries)[order[leaf]];
+        unsigned int index = nodeBase + depthFirst[leafBase + leaf];
+        unsigned int type = shapeType(types[order[leaf]]);
+        unsigned int shape = offsets[type]++;
+
+        switch(type) {
+          case 0:
+            bvh.spheres[shape] = (const Sphere &)*geometry;
+            break;
+          case 1:
+            bvh.aabbs[shape] = (const AABB &)*geometry;
+            break;
+          case 2:
+            bvh.oobbs[shape] = (const OOBB &)*geometry;
+            break;
+          case 3:
+            bvh.planes[shape] = (const Plane &)*geometry;
+            break;
+          case 4:
+            bvh.lines[shape] = (const Line &)*geometry;
+            break;
+          default:
+            bvh.others[shape] = geometry;
+        }
+
+        LinearBvh::Node &bvhNode = bvh.nodes[index];
+        bvhNode.type = types[order[leaf]];
+        bvhNode.shape = shape;
+        bvhNode.escape = index + 1;
+        bvhNode.leaf = true;
+        bvh.sources[index] = geometry;
+      }
+    });
+  }
+};
@@ -0,0 +1,116 @@
+/*
+ * ParallelCollisionTester.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: leandro
+ */
+
+#pragma once
+
+#include <vector>
+#include "CollisionTester.h"
+#include "ContactBuffer.h"
+#include "WorkStealingThreadPool.h"
+#include "BroadPhasePair.h"
+
+/**
+ * Runs the narrow phase for a list of candidate pairs (e.g. from a broad phase) on a thread pool.
+ *
+ * Pairs are split in fixed size chunks. Workers append contacts to their own buffer and record which part of it each chunk wrote,
+ * then chunks are merged in chunk order. Chunks do not depend on the thread count, so output is the same as testing pairs one by one,
+ * in order, whatever the number of threads and however chunks were stolen - replays and tests are deterministic.
+ *
+ * CollisionTester is const once built and keeps no per pair state, so one tester is shared by all workers. GJK / EPA fallbacks can be warm
+ * started from a caller owned CachedSimplex per pair: each one is only read and written by the chunk of its pair, so contacts do not depend
+ * on how workers interleave either. Buffers are kept across calls: steady state frames do not allocate once buffers have grown.
+ */
+class ParallelCollisionTester {
+  struct ChunkContacts {
+    unsigned int worker = 0;
+    unsigned int begin = 0;
+    unsigned int end = 0;
+  };
+
+  struct alignas(64) WorkerContacts { // own cache line, workers keep appending to their buffer
+    ContactBuffer contacts;
+  };
+
+  const CollisionTester &collisionTester;
+  WorkStealingThreadPool &threadPool;
+  unsigned int chunkSize;
+  std::vector<WorkerContacts> workerContacts;
+  std::vector<ChunkContacts> chunkContacts;
+  const BroadPhasePair *pairs = nullptr;
+  CachedSimplex *simplices = nullptr;
+  unsigned int pairCount = 0;
+
+public:
+  ParallelCollisionTester(const CollisionTester &collisionTester, WorkStealingThreadPool &threadPool, unsigned int chunkSize = 256) :
+    collisionTester(collisionTester), threadPool(threadPool), workerContacts(threadPool.getThreadCount()) {
+    this->chunkSize = std::max(1u, chunkSize);
+  }
+
+  unsigned int getChunkSize() const {
+    return chunkSize;
+  }
+
+  /**
+   * Appends contacts of count pairs to contacts, in pairs order. Bounded buffers keep the first contacts and flag overflow, same as serial calls.
+   * If simplices is given, simplices[index] is the warm start of pairs[index] and is updated, see CollisionTester::detectCollision.
+   */
+  void detectCollisions(const BroadPhasePair *pairs, unsigned int count, ContactBuffer &contacts, CachedSimplex *simplices = nullptr) {
+    unsigned int chunkCount = (count + chunkSize - 1) / chunkSize;
+    if(chunkContacts.size() < chunkCount) {
+      chunkContacts.resize(chunkCount);
+    }
+    for(WorkerContacts &buffer : workerContacts) {
+      buffer.contacts.clear();
+    }
+    this->pairs = pairs;
+    this->simplices = simplices;
+    this->pairCount = count;
+
+    threadPool.parallelFor(chunkCount, [this](unsigned int chunk, unsigned int worker) { // only captures this, fitting std::function inline storage
+      this->detectChunk(chunk, worker);
+    });
+
+    for(unsigned int chunk = 0; chunk < chunkCount; chunk++) {
+      const ChunkContacts &chunkRange = chunkContacts[chunk];
+      const ContactBuffer &buffer = workerContacts[chunkRange.worker].contacts;
+      for(unsigned int index = chunkRange.begin; index < chunkRange.end; index++) {
+        contacts.add(buffer[index]);
+      }
+    }
+  }
+
+  void detectCollisions(const std::vector<BroadPhasePair> &pairs, ContactBuffer &contacts) {
+    detectCollisions(pairs.data(), pairs.size(), contacts);
+  }
+
+  /**
+   * Simplices are resized to the pair count, so that a list of pairs that stays the same from frame to frame keeps its warm starts
+   */
+  void detectCollisions(const std::vector<BroadPhasePair> &pairs, ContactBuffer &contacts, std::vector<CachedSimplex> &simplices) {
+    simplices.resize(pairs.size());
+    detectCollisions(pairs.data(), pairs.size(), contacts, simplices.data());
+  }
+
+protected:
+  void detectChunk(unsigned int chunk, unsigned int worker) {
+    ContactBuffer &buffer = workerContacts[worker].contacts;
+    ChunkContacts &chunkRange = chunkContacts[chunk];
+    chunkRange.worker = worker;
+    chunkRange.begin = buffer.size();
+
+    unsigned int end = std::min(pairCount, (chunk + 1) * chunkSize);
+    for(unsigned int index = chunk * chunkSize; index < end; index++) {
+      if(simplices != nullptr) {
+        collisionTester.detectCollision(*pairs[index].getGeometryA(), *pairs[index].getGeometryB(), buffer, simplices[index]);
+      } else {
+        collisionTester.detectCollision(*pairs[index].getGeometryA(), *pairs[index].getGeometryB(), buffer);
+      }
+    }
+
+    chunkRange.end = buffer.size();
+  }
+};
@@ -0,0 +1,370 @@
+/*
+ * SeparationCache.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: leandro
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <Geometry.h>
+#include "CollisionTester.h"
+#include "GjkEpa.h"
+
+/**
+ * Skips the narrow phase of pairs that cannot have closed their gap since they were last tested separated.
+ *
+ * Each entry keeps the axis a pair was last found separated along. Later queries measure the gap along that axis again, with the support
+ * extent of each geometry around its origin: while it is still open the pair is separated, whatever moved, rotated or grew, and intersects /
+ * detectCollision return without calling the tester. Once it closes the pair is tested again and, if still separated, a new axis is found:
+ * the axis between centers when it separates, GJK closest points otherwise. Pairs whose bounding spheres are apart, most of those a loose
+ * broad phase reports, are separated before reading their entry. Only pairs whose test costs more than a query are cached, see isCacheable():
+ * other pairs go straight to the tester.
+ *
+ * Entries are a quarter of a cache line - a tag of the pair and the axis as floats - so that the table of a few thousand pairs stays in cache.
+ * Results never depend on what an entry holds: projections on any direction that do not overlap separate the pair, so the axis of another
+ * pair sharing the tag, of a geometry destroyed and replaced at the same address, or mixing the axes of two updates racing on the entry, at
+ * worst leaves the gap closed and the pair is tested as usual. Hence no locks either: entries are read and written with relaxed atomics.
+ *
+ * Direct mapped and lossy, like SimplexCache: pairs hash to a slot and evict whoever was there - unless it is a separated pair still being
+ * queried, so that two pairs sharing a slot do not evict each other every frame. Queries and skips are counted per thread, apart from the
+ * entries, so counting does not contend either.
+ */
+class SeparationCache {
+  struct alignas(16) Entry {
+    std::atomic<uint32_t> key {0}; // tag of the pair, separatedFlag if the axis is set and queries of other pairs since its last one
+    std::atomic<float> axis[3] = {{0}, {0}, {0}}; // from geometryA towards geometryB
+  };
+
+  static_assert(sizeof(Entry) == 16, "four entries per cache line");
+
+  /**
+   * What a query read from an entry
+   */
+  struct Lookup {
+    uint32_t tag;
+    uint32_t key;
+
+    bool owned() const {
+      return (key & tagMask) == tag;
+    }
+
+    bool separated() const {
+      return (key & (tagMask | separatedFlag)) == (tag | separatedFlag);
+    }
+  };
+
+  /**
+   * Each thread counts in its own block, threads past maximumThreads share the last one
+   */
+  struct alignas(64) Counters {
+    std::atomic<unsigned long long> queries {0};
+    std::atomic<unsigned long long> skips {0};
+  };
+
+  const CollisionTester &collisionTester;
+  std::unique_ptr<Entry[]> entries;
+  unsigned int size;
+  std::unique_ptr<Counters[]> counters;
+  static constexpr uint32_t tagMask = ~0xffu;
+  static constexpr uint32_t separatedFlag = 0x80;
+  static constexpr uint32_t contestedMask = 0x7f;
+  static constexpr unsigned int maximumContested = 4;
+  static constexpr unsigned int maximumThreads = 64;
+
+  static constexpr uint64_t pairBit(GeometryType typeA, GeometryType typeB) {
+    return 1ull << ((unsigned int)typeA * GEOMETRY_TYPE_COUNT + (unsigned int)typeB);
+  }
+
+public:
+  /**
+   * Size is rounded up to a power of two
+   */
+  SeparationCache(const CollisionTester &collisionTester, unsigned int size = 4096) : collisionTester(collisionTester) {
+    this->size = 1;
+    while(this->size < size) {
+      this->size <<= 1;
+    }
+    entries.reset(new Entry[this->size]);
+    counters.reset(new Counters[maximumThreads + 1]);
+  }
+
+  SeparationCache(const SeparationCache &) = delete;
+  SeparationCache &operator=(const SeparationCache &) = delete;
+
+  unsigned int getSize() const {
+    return size;
+  }
+
+  bool intersects(const Geometry &geometryA, const Geometry &geometryB) {
+    GeometryType typeA = geometryA.getType();
+    GeometryType typeB = geometryB.getType();
+    if(!isCacheable(typeA, typeB)) {
+      return collisionTester.intersects(geometryA, geometryB);
+    }
+    return cachedIntersects(geometryA, typeA, geometryB, typeB);
+  }
+
+  void detectCollision(const Geometry &geometryA, const Geometry &geometryB, ContactBuffer &contacts) {
+    GeometryType typeA = geometryA.getType();
+    GeometryType typeB = geometryB.getType();
+    if(!isCacheable(typeA, typeB)) {
+      collisionTester.detectCollision(geometryA, geometryB, contacts);
+      return;
+    }
+    cachedDetectCollision(geometryA, typeA, geometryB, typeB, contacts);
+  }
+
+  /**
+   * Queries of cacheable pairs
+   */
+  unsigned long long getQueryCount() const {
+    unsigned long long count = 0;
+    for(unsigned int index = 0; index <= maximumThreads; index++) {
+      count += counters[index].queries.load(std::memory_order_relaxed);
+    }
+    return count;
+  }
+
+  /**
+   * Queries answered without calling the tester
+   */
+  unsigned long long getSkipCount() const {
+    unsigned long long count = 0;
+    for(unsigned int index = 0; index <= maximumThreads; index++) {
+      count += counters[index].skips.load(std::memory_order_relaxed);
+    }
+    return count;
+  }
+
+  real getSkipRate() const {
+    unsigned long long queries = getQueryCount();
+    return queries > 0 ? (real)getSkipCount() / queries : 0;
+  }
+
+  /**
+   * Not thread safe
+   */
+  void resetCounters() {
+    for(unsigned int index = 0; index <= maximumThreads; index++) {
+      counters[index].queries.store(0, std::memory_order_relaxed);
+      counters[index].skips.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  /**
+   * Not thread safe
+   */
+  void clear() {
+    for(unsigned int index = 0; index < size; index++) {
+      entries[index].key.store(0, std::memory_order_relaxed);
+      setAxis(entries[index], vector(0, 0, 0));
+    }
+  }
+
+  /**
+   * Oobbs against spheres, aabbs or oobbs, whose tests work in the frame of the oobb. Other tests between spheres and aabbs are closed forms about
+   * as cheap as a query, so caching them would only slow them down. A single bit lookup rather than comparisons, since in a mixed scene every
+   * branch on the types is a coin flip, and this check is all that uncached pairs pay for.
+   */
+  static bool isCacheable(GeometryType typeA, GeometryType typeB) {
+    static_assert(GEOMETRY_TYPE_COUNT * GEOMETRY_TYPE_COUNT <= 64, "cacheable pairs are a 64 bit mask");
+    constexpr uint64_t cacheablePairs = pairBit(GeometryType::OOBB, GeometryType::SPHERE) | pairBit(GeometryType::OOBB, GeometryType::AABB) |
+        pairBit(GeometryType::OOBB, GeometryType::OOBB) | pairBit(GeometryType::SPHERE, GeometryType::OOBB) | pairBit(GeometryType::AABB, GeometryType::OOBB);
+    return (cacheablePairs & pairBit(typeA, typeB)) != 0;
+  }
+
+  /**
+   * Lower bound of the distance between separated convex geometries, zero if they intersect or touch
+   */
+  static real separation(const Geometry &geometryA, const Geometry &geometryB, SimplexCache *cache = nullptr) {
+    vector axis;
+    return separation(geometryA, geometryB, axis, cache);
+  }
+
+  /**
+   * Same as above, also setting the separating axis, from geometryA towards geometryB
+   */
+  static real separation(const Geometry &geometryA, const Geometry &geometryB, vector &axis, SimplexCache *cache = nullptr) {
+    GjkResult result = GjkEpa::distance(geometryA, geometryB, cache);
+    axis = result.pointB - result.pointA;
+    real length = axis.modulo();
+    if(result.intersecting || !(length > 0)) {
+      return 0;
+    }
+
+    axis = axis * ((real)1 / length);
+    return gap(geometryA, geometryB, axis);
+  }
+
+  /**
+   * Lower bound of the distance between convex geometries along a unit axis, from geometryA towards geometryB. Zero if their projections overlap.
+   * Measured between origins, so that rounding only depends on how far apart and how large the geometries are, not on where they are.
+   */
+  static real gap(const Geometry &geometryA, const Geometry &geometryB, const vector &axis) {
+    return gap(axis, geometryB.getOrigin() - geometryA.getOrigin(), geometryA.getSupportExtent(axis), geometryB.getSupportExtent(vector(0, 0, 0) - axis));
+  }
+
+protected:
+  /**
+   * Cached paths are kept apart so that pairs going straight to the tester do not pay for setting them up
+   */
+  bool cachedIntersects(const Geometry &geometryA, GeometryType typeA, const Geometry &geometryB, GeometryType typeB) {
+    uint64_t hash = pairHash(&geometryA, &geometryB);
+    Entry &entry = entries[hash & (size - 1)];
+    Lookup lookup;
+    if(separated(entry, hash, lookup, geometryA, typeA, geometryB, typeB)) {
+      return false;
+    }
+
+    bool hit = collisionTester.intersects(geometryA, geometryB);
+    update(entry, lookup, geometryA, geometryB, !hit);
+    return hit;
+  }
+
+  void cachedDetectCollision(const Geometry &geometryA, GeometryType typeA, const Geometry &geometryB, GeometryType typeB, ContactBuffer &contacts) {
+    uint64_t hash = pairHash(&geometryA, &geometryB);
+    Entry &entry = entries[hash & (size - 1)];
+    Lookup lookup;
+    if(separated(entry, hash, lookup, geometryA, typeA, geometryB, typeB)) {
+      return;
+    }
+
+    unsigned int first = contacts.size();
+    collisionTester.detectCollision(geometryA, geometryB, contacts);
+    update(entry, lookup, geometryA, geometryB, contacts.size() == first && !contacts.isOverflowed());
+  }
+
+  /**
+   * Axis components are at most one, even mixed from two axes, so the rounding of the projection of between is bounded by its own size
+   */
+  static real gap(const vector &axis, const vector &between, real extentA, real extentB) {
+    real scale = std::abs(between.x) + std::abs(between.y) + std::abs(between.z) + extentA + extentB;
+    real gap = axis * between - extentA - extentB - scale * std::numeric_limits<real>::epsilon() * 16; // rounding of the projections
+    return std::max((real)0, gap);
+  }
+
+  /**
+   * Same as getSupportExtent(), resolved on the type so that queries make no virtual call
+   */
+  static real extent(const Geometry &geometry, GeometryType type, const vector &direction) {
+    return type == GeometryType::OOBB ? ((const OOBB &)geometry).getSupportExtent(direction) :
+        type == GeometryType::SPHERE ? ((const Sphere &)geometry).getSupportExtent(direction) : ((const AABB &)geometry).getSupportExtent(direction);
+  }
+
+  static real boundingRadius(const Geometry &geometry, GeometryType type) {
+    return type == GeometryType::OOBB ? ((const OOBB &)geometry).getHalfSizes().modulo() :
+        type == GeometryType::SPHERE ? ((const Sphere &)geometry).getRadius() : ((const AABB &)geometry).getHalfSizes().modulo();
+  }
+
+  /**
+   * Pairs whose bounding spheres are apart are separated without reading the entry: that only takes origins and sizes, which share a cache
+   * line with the type. Otherwise the gap is measured along the axis in the entry, and lookup is set for update()
+   */
+  bool separated(Entry &entry, uint64_t hash, Lookup &lookup, const Geometry &geometryA, GeometryType typeA, const Geometry &geometryB, GeometryType typeB) {
+    unsigned int thread = threadIndex();
+    increment(counters[thread].queries, thread);
+
+    vector between = geometryB.Geometry::getOrigin() - geometryA.Geometry::getOrigin();
+    real radii = boundingRadius(geometryA, typeA) + boundingRadius(geometryB, typeB);
+    if(!(between * between > radii * radii * (1 + std::numeric_limits<real>::epsilon() * 16))) { // rounding of both sides
+      lookup.tag = (uint32_t)(hash >> 32) & tagMask;
+      lookup.key = entry.key.load(std::memory_order_relaxed);
+      if(lookup.owned() && (lookup.key & contestedMask) != 0) {
+        entry.key.store(lookup.key & ~contestedMask, std::memory_order_relaxed); // no longer contested
+      }
+      if(!lookup.separated()) {
+        return false;
+      }
+
+      vector axis(entry.axis[0].load(std::memory_order_relaxed), entry.axis[1].load(std::memory_order_relaxed), entry.axis[2].load(std::memory_order_relaxed));
+      if(!(gap(axis, between, extent(geometryA, typeA, axis), extent(geometryB, typeB, vector(0, 0, 0) - axis)) > 0)) {
+        return false;
+      }
+    }
+
+    increment(counters[thread].skips, thread);
+    return true;
+  }
+
+  void update(Entry &entry, const Lookup &lookup, const Geometry &geometryA, const Geometry &geometryB, bool separatedPair) {
+    if(!lookup.owned() && (lookup.key & separatedFlag) != 0 && (lookup.key & contestedMask) + 1 < maximumContested) {
+      entry.key.store(lookup.key + 1, std::memory_order_relaxed);
+      return; // keep the separated pair holding the slot
+    }
+
+    vector axis(0, 0, 0);
+    if(separatedPair) {
+      // the axis between centers is often enough, and much cheaper than GJK
+      axis = geometryB.getOrigin() - geometryA.getOrigin();
+      real length = axis.modulo();
+      if(length > 0) {
+        axis = axis * ((real)1 / length);
+      }
+      if(!(length > 0) || !(gap(geometryA, geometryB, axis) > 0)) {
+        if(!(separation(geometryA, geometryB, axis) > 0)) {
+          axis = vector(0, 0, 0);
+        }
+      }
+    }
+
+    if(lookup.owned() && (lookup.key & separatedFlag) == 0 && !hasAxis(axis)) {
+      return; // nothing new to record, as for pairs that keep intersecting
+    }
+
+    setAxis(entry, axis);
+    entry.key.store(lookup.tag | (hasAxis(axis) ? separatedFlag : 0), std::memory_order_relaxed);
+  }
+
+  /**
+   * Stored as floats: projections on any direction that do not overlap separate the pair, so rounding the axis only makes the gap along it a little smaller
+   */
+  static void setAxis(Entry &entry, const vector &axis) {
+    entry.axis[0].store((float)axis.x, std::memory_order_relaxed);
+    entry.axis[1].store((float)axis.y, std::memory_order_relaxed);
+    entry.axis[2].store((float)axis.z, std::memory_order_relaxed);
+  }
+
+  static bool hasAxis(const vector &axis) {
+    return axis.x != 0 || axis.y != 0 || axis.z != 0;
+  }
+
+  /**
+   * Threads get consecutive indices on their first query, shared by every cache. Constant initialized, so reading it needs no guard
+   */
+  static unsigned int threadIndex() {
+    static std::atomic<unsigned int> threads {0};
+    static thread_local unsigned int index = maximumThreads + 1;
+    if(index > maximumThreads) {
+      index = std::min(threads.fetch_add(1, std::memory_order_relaxed), maximumThreads);
+    }
+    return index;
+  }
+
+  /**
+   * Blocks of the first threads are only written by their thread, so a relaxed load plus store is enough. The shared last block needs fetch_add.
+   */
+  static void increment(std::atomic<unsigned long long> &counter, unsigned int thread) {
+    if(thread < maximumThreads) {
+      counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    } else {
+      counter.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  /**
+   * The low bits pick the slot and the high ones make the tag, so both need mixing: heap addresses mostly differ in their middle bits
+   */
+  static uint64_t pairHash(const void *geometryA, const void *geometryB) {
+    uint64_t hash = (uint64_t)(uintptr_t)geometryA * 0x9e3779b97f4a7c15ull ^ (uint64_t)(uintptr_t)geometryB * 0xc2b2ae3d27d4eb4full;
+    hash ^= hash >> 29;
+    hash *= 0xbf58476d1ce4e5b9ull;
+    return hash ^ (hash >> 32);
+  }
+};
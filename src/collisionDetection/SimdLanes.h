@@ -0,0 +1,159 @@
+/*
+ * SimdLanes.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: leandro
+ */
+
+#pragma once
+
+#include <algorithm>
+
+#if defined(__AVX__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define GEOMETRY_SIMD_X86
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define GEOMETRY_SIMD_NEON
+#endif
+
+/**
+ * Thin wrapper over the widest vector registers available at compile time, so that batch kernels are written once for floats and doubles:
+ *    AVX (compile with GEOMETRY_AVX2): 8 floats or 4 doubles
+ *    SSE2 (any x86-64):                4 floats or 2 doubles
+ *    NEON (aarch64):                   4 floats or 2 doubles
+ *    otherwise:                        1 value, plain scalar code
+ *
+ * Only what batch kernels need is wrapped: unaligned loads and stores, broadcast, add, sub, mul, min, max and a less or equal comparison returning one bit per lane.
+ * Operations map one to one to IEEE operations, so results match scalar code evaluating the same expression in the same order.
+ * min and max select the same operand as std::min and std::max when values compare equal or either is NaN (the first one).
+ * NEON vminq / vmaxq propagate NaN instead, so they are built from a comparison and a select.
+ */
+template<typename T> struct ScalarLanes {
+  typedef T Scalar;
+  typedef T Register;
+  static constexpr unsigned int width = 1;
+
+  static Register load(const T *values) { return *values; }
+  static void store(T *values, Register value) { *values = value; }
+  static Register broadcast(T value) { return value; }
+  static Register add(Register a, Register b) { return a + b; }
+  static Register sub(Register a, Register b) { return a - b; }
+  static Register mul(Register a, Register b) { return a * b; }
+  static Register min(Register a, Register b) { return std::min(a, b); }
+  static Register max(Register a, Register b) { return std::max(a, b); }
+  static unsigned int lessEqual(Register a, Register b) { return a <= b ? 1 : 0; }
+};
+
+template<typename T> struct SimdLanes : public ScalarLanes<T> {
+};
+
+#if defined(GEOMETRY_SIMD_X86) && defined(__AVX__)
+
+template<> struct SimdLanes<float> {
+  typedef float Scalar;
+  typedef __m256 Register;
+  static constexpr unsigned int width = 8;
+
+  static Register load(const float *values) { return _mm256_loadu_ps(values); }
+  static void store(float *values, Register value) { _mm256_storeu_ps(values, value); }
+  static Register broadcast(float value) { return _mm256_set1_ps(value); }
+  static Register add(Register a, Register b) { return _mm256_add_ps(a, b); }
+  static Register sub(Register a, Register b) { return _mm256_sub_ps(a, b); }
+  static Register mul(Register a, Register b) { return _mm256_mul_ps(a, b); }
+  static Register min(Register a, Register b) { return _mm256_min_ps(b, a); }
+  static Register max(Register a, Register b) { return _mm256_max_ps(b, a); }
+  static unsigned int lessEqual(Register a, Register b) { return (unsigned int)_mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_LE_OQ)); }
+};
+
+template<> struct SimdLanes<double> {
+  typedef double Scalar;
+  typedef __m256d Register;
+  static constexpr unsigned int width = 4;
+
+  static Register load(const double *values) { return _mm256_loadu_pd(values); }
+  static void store(double *values, Register value) { _mm256_storeu_pd(values, value); }
+  static Register broadcast(double value) { return _mm256_set1_pd(value); }
+  static Register add(Register a, Register b) { return _mm256_add_pd(a, b); }
+  static Register sub(Register a, Register b) { return _mm256_sub_pd(a, b); }
+  static Register mul(Register a, Register b) { return _mm256_mul_pd(a, b); }
+  static Register min(Register a, Register b) { return _mm256_min_pd(b, a); }
+  static Register max(Register a, Register b) { return _mm256_max_pd(b, a); }
+  static unsigned int lessEqual(Register a, Register b) { return (unsigned int)_mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_LE_OQ)); }
+};
+
+#elif defined(GEOMETRY_SIMD_X86)
+
+template<> struct SimdLanes<float> {
+  typedef float Scalar;
+  typedef __m128 Register;
+  static constexpr unsigned int width = 4;
+
+  static Register load(const float *values) { return _mm_loadu_ps(values); }
+  static void store(float *values, Register value) { _mm_storeu_ps(values, value); }
+  static Register broadcast(float value) { return _mm_set1_ps(value); }
+  static Register add(Register a, Register b) { return _mm_add_ps(a, b); }
+  static Register sub(Register a, Register b) { return _mm_sub_ps(a, b); }
+  static Register mul(Register a, Register b) { return _mm_mul_ps(a, b); }
+  static Register min(Register a, Register b) { return _mm_min_ps(b, a); }
+  static Register max(Register a, Register b) { return _mm_max_ps(b, a); }
+  static unsigned int lessEqual(Register a, Register b) { return (unsigned int)_mm_movemask_ps(_mm_cmple_ps(a, b)); }
+};
+
+template<> struct SimdLanes<double> {
+  typedef double Scalar;
+  typedef __m128d Register;
+  static constexpr unsigned int width = 2;
+
+  static Register load(const double *values) { return _mm_loadu_pd(values); }
+  static void store(double *values, Register value) { _mm_storeu_pd(values, value); }
+  static Register broadcast(double value) { return _mm_set1_pd(value); }
+  static Register add(Register a, Register b) { return _mm_add_pd(a, b); }
+  static Register sub(Register a, Register b) { return _mm_sub_pd(a, b); }
+  static Register mul(Register a, Register b) { return _mm_mul_pd(a, b); }
+  static Register min(Register a, Register b) { return _mm_min_pd(b, a); }
+  static Register max(Register a, Register b) { return _mm_max_pd(b, a); }
+  static unsigned int lessEqual(Register a, Register b) { return (unsigned int)_mm_movemask_pd(_mm_cmple_pd(a, b)); }
+};
+
+#elif defined(GEOMETRY_SIMD_NEON)
+
+template<> struct SimdLanes<float> {
+  typedef float Scalar;
+  typedef float32x4_t Register;
+  static constexpr unsigned int width = 4;
+
+  static Register load(const float *values) { return vld1q_f32(values); }
+  static void store(float *values, Register value) { vst1q_f32(values, value); }
+  static Register broadcast(float value) { return vdupq_n_f32(value); }
+  static Register add(Register a, Register b) { return vaddq_f32(a, b); }
+  static Register sub(Register a, Register b) { return vsubq_f32(a, b); }
+  static Register mul(Register a, Register b) { return vmulq_f32(a, b); }
+  static Register min(Register a, Register b) { return vbslq_f32(vcltq_f32(b, a), b, a); }
+  static Register max(Register a, Register b) { return vbslq_f32(vcltq_f32(a, b), b, a); }
+  static unsigned int lessEqual(Register a, Register b) {
+    static const uint32_t laneBits[4] = {1, 2, 4, 8};
+    return vaddvq_u32(vandq_u32(vcleq_f32(a, b), vld1q_u32(laneBits)));
+  }
+};
+
+template<> struct SimdLanes<double> {
+  typedef double Scalar;
+  typedef float64x2_t Register;
+  static constexpr unsigned int width = 2;
+
+  static Register load(const double *values) { return vld1q_f64(values); }
+  static void store(double *values, Register value) { vst1q_f64(values, value); }
+  static Register broadcast(double value) { return vdupq_n_f64(value); }
+  static Register add(Register a, Register b) { return vaddq_f64(a, b); }
+  static Register sub(Register a, Register b) { return vsubq_f64(a, b); }
+  static Register mul(Register a, Register b) { return vmulq_f64(a, b); }
+  static Register min(Register a, Register b) { return vbslq_f64(vcltq_f64(b, a), b, a); }
+  static Register max(Register a, Register b) { return vbslq_f64(vcltq_f64(a, b), b, a); }
+  static unsigned int lessEqual(Register a, Register b) {
+    uint64x2_t mask = vcleq_f64(a, b);
+    return (unsigned int)((vgetq_lane_u64(mask, 0) & 1) | ((vgetq_lane_u64(mask, 1) & 1) << 1));
+  }
+};
+
+#endif
@@ -0,0 +1,189 @@
+/*
+ * StaticCollisionTester.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: leandro
+ */
+
+#pragma once
+
+#include <vector>
+#include <variant>
+#include <type_traits>
+#include <Geometry.h>
+#include "GeometryContact.h"
+#include "ContactBuffer.h"
+#include "IntersectionHelper.h"
+#include "GjkEpa.h"
+
+/**
+ * Maps a pair of concrete geometry types to its intersection kernel in IntersectionHelper.
+ * Specializations only exist for supported pairs, in the same operand order CollisionTester registers them.
+ */
+template<typename A, typename B> struct IntersectionKernel {
+  static constexpr bool supported = false;
+};
+
+/**
+ * Maps a pair of concrete geometry types to its contact kernel in IntersectionHelper.
+ */
+template<typename A, typename B> struct ContactKernel {
+  static constexpr bool supported = false;
+};
+
+#define GEOMETRY_INTERSECTION_KERNEL(TypeA, TypeB, kernel) \
+  template<> struct IntersectionKernel<TypeA, TypeB> { \
+    static constexpr bool supported = true; \
+    static bool test(const TypeA &a, const TypeB &b) { return IntersectionHelper::kernel(a, b); } \
+  };
+
+#define GEOMETRY_CONTACT_KERNEL(TypeA, TypeB, kernel) \
+  template<> struct ContactKernel<TypeA, TypeB> { \
+    static constexpr bool supported = true; \
+    static void test(const TypeA &a, const TypeB &b, ContactBuffer &contacts) { IntersectionHelper::kernel(a, b, contacts); } \
+  };
+
+GEOMETRY_INTERSECTION_KERNEL(Line, Sphere, lineSphere)
+GEOMETRY_INTERSECTION_KERNEL(Line, AABB, lineAabb)
+GEOMETRY_INTERSECTION_KERNEL(Line, HeightMapGeometry, lineHeightmap)
+GEOMETRY_INTERSECTION_KERNEL(Line, OOBB, lineOobb)
+GEOMETRY_INTERSECTION_KERNEL(Plane, Sphere, planeSphere)
+GEOMETRY_INTERSECTION_KERNEL(Plane, AABB, planeAabb)
+GEOMETRY_INTERSECTION_KERNEL(Plane, OOBB, planeOobb)
+GEOMETRY_INTERSECTION_KERNEL(Sphere, Sphere, sphereSphere)
+GEOMETRY_INTERSECTION_KERNEL(Sphere, AABB, sphereAabb)
+GEOMETRY_INTERSECTION_KERNEL(Sphere, OOBB, sphereOobb)
+GEOMETRY_INTERSECTION_KERNEL(Sphere, HeightMapGeometry, sphereHeightmap)
+GEOMETRY_INTERSECTION_KERNEL(AABB, AABB, aabbAabb)
+GEOMETRY_INTERSECTION_KERNEL(AABB, HeightMapGeometry, aabbHeightmap)
+GEOMETRY_INTERSECTION_KERNEL(AABB, OOBB, aabbOobb)
+GEOMETRY_INTERSECTION_KERNEL(OOBB, OOBB, oobbOobb)
+
+GEOMETRY_CONTACT_KERNEL(Plane, Sphere, planeSphereContact)
+GEOMETRY_CONTACT_KERNEL(Plane, OOBB, planeOobbContact)
+GEOMETRY_CONTACT_KERNEL(Sphere, Sphere, sphereSphereContact)
+GEOMETRY_CONTACT_KERNEL(Sphere, AABB, sphereAabbContact)
+GEOMETRY_CONTACT_KERNEL(Sphere, OOBB, sphereOobbContact)
+GEOMETRY_CONTACT_KERNEL(Sphere, HeightMapGeometry, sphereHeightmapContact)
+GEOMETRY_CONTACT_KERNEL(AABB, OOBB, aabbOobbContact)
+GEOMETRY_CONTACT_KERNEL(OOBB, OOBB, oobbOobbContact)
+
+/**
+ * Compile time counterpart of CollisionTester: when the concrete geometry types are known, the kernel is selected at compile time and can be inlined,
+ * without virtual getType() calls, table lookups or member function pointers.
+ *
+ * Usage:
+ *    StaticCollisionTester::intersects(sphere, aabb);                  // types deduced - fails to compile for unsupported pairs
+ *    StaticCollisionTester::detectCollision<Sphere, AABB>(sphere, aabb);
+ *    StaticCollisionTester::detectCollision(sphere, aabb, contacts);   // appends to a caller owned ContactBuffer
+ *    StaticCollisionTester::intersects(variantA, variantB);             // std::variant of geometries - unsupported pairs return false
+ *
+ * Same as CollisionTester, pairs registered as (A, B) are also available as (B, A), calling the kernel with swapped operands, and convex pairs
+ * without a kernel (see IsConvexShape) fall back to GjkEpa - without a simplex cache, as this tester is stateless.
+ */
+class StaticCollisionTester {
+public:
+  template<typename A, typename B> static constexpr bool supportsIntersection() {
+    return IntersectionKernel<A, B>::supported || IntersectionKernel<B, A>::supported || (IsConvexShape<A>::value && IsConvexShape<B>::value);
+  }
+
+  template<typename A, typename B> static constexpr bool supportsContact() {
+    return ContactKernel<A, B>::supported || ContactKernel<B, A>::supported || (IsConvexShape<A>::value && IsConvexShape<B>::value);
+  }
+
+  template<typename A, typename B> static bool intersects(const A &op1, const B &op2) {
+    static_assert(supportsIntersection<A, B>(), "No intersection kernel for this pair of geometry types");
+    return intersectsIfSupported(op1, op2);
+  }
+
+  template<typename A, typename B> static std::vector<GeometryContact> detectCollision(const A &op1, const B &op2) {
+    ContactBuffer contacts;
+    detectCollision(op1, op2, contacts);
+    return contacts.release();
+  }
+
+  template<typename A, typename B> static void detectCollision(const A &op1, const B &op2, ContactBuffer &contacts) {
+    static_assert(supportsContact<A, B>(), "No contact kernel for this pair of geometry types");
+    detectCollisionIfSupported(op1, op2, contacts);
+  }
+
+  /**
+   * Visits both variants - the compiler generates (and can inline) one kernel call per combination of alternatives.
+   */
+  template<typename... TypesA, typename... TypesB> static bool intersects(const std::variant<TypesA...> &op1, const std::variant<TypesB...> &op2) {
+    return std::visit([](const auto &a, const auto &b) {
+      return intersectsIfSupported(a, b);
+    }, op1, op2);
+  }
+
+  template<typename... TypesA, typename... TypesB> static std::vector<GeometryContact> detectCollision(const std::variant<TypesA...> &op1, const std::variant<TypesB...> &op2) {
+    ContactBuffer contacts;
+    detectCollision(op1, op2, contacts);
+    return contacts.release();
+  }
+
+  template<typename... TypesA, typename... TypesB> static void detectCollision(const std::variant<TypesA...> &op1, const std::variant<TypesB...> &op2, ContactBuffer &contacts) {
+    std::visit([&contacts](const auto &a, const auto &b) {
+      detectCollisionIfSupported(a, b, contacts);
+    }, op1, op2);
+  }
+
+  template<typename A, typename... TypesB> static bool intersects(const A &op1, const std::variant<TypesB...> &op2) {
+    return std::visit([&op1](const auto &b) {
+      return intersectsIfSupported(op1, b);
+    }, op2);
+  }
+
+  template<typename A, typename... TypesB> static std::vector<GeometryContact> detectCollision(const A &op1, const std::variant<TypesB...> &op2) {
+    ContactBuffer contacts;
+    detectCollision(op1, op2, contacts);
+    return contacts.release();
+  }
+
+  template<typename A, typename... TypesB> static void detectCollision(const A &op1, const std::variant<TypesB...> &op2, ContactBuffer &contacts) {
+    std::visit([&op1, &contacts](const auto &b) {
+      detectCollisionIfSupported(op1, b, contacts);
+    }, op2);
+  }
+
+  template<typename... TypesA, typename B> static bool intersects(const std::variant<TypesA...> &op1, const B &op2) {
+    return std::visit([&op2](const auto &a) {
+      return intersectsIfSupported(a, op2);
+    }, op1);
+  }
+
+  template<typename... TypesA, typename B> static std::vector<GeometryContact> detectCollision(const std::variant<TypesA...> &op1, const B &op2) {
+    ContactBuffer contacts;
+    detectCollision(op1, op2, contacts);
+    return contacts.release();
+  }
+
+  template<typename... TypesA, typename B> static void detectCollision(const std::variant<TypesA...> &op1, const B &op2, ContactBuffer &contacts) {
+    std::visit([&op2, &contacts](const auto &a) {
+      detectCollisionIfSupported(a, op2, contacts);
+    }, op1);
+  }
+
+protected:
+  template<typename A, typename B> static bool intersectsIfSupported(const A &op1, const B &op2) {
+    if constexpr (IntersectionKernel<A, B>::supported) {
+      return IntersectionKernel<A, B>::test(op1, op2);
+    } else if constexpr (IntersectionKernel<B, A>::supported) {
+      return IntersectionKernel<B, A>::test(op2, op1);
+    } else if constexpr (IsConvexShape<A>::value && IsConvexShape<B>::value) {
+      return GjkEpa::intersects(op1, op2);
+    } else {
+      return false;
+    }
+  }
+
+  template<typename A, typename B> static void detectCollisionIfSupported(const A &op1, const B &op2, ContactBuffer &contacts) {
+    if constexpr (ContactKernel<A, B>::supported) {
+      ContactKernel<A, B>::test(op1, op2, contacts);
+    } else if constexpr (ContactKernel<B, A>::supported) {
+      ContactKernel<B, A>::test(op2, op1, contacts);
+    } else if constexpr (IsConvexShape<A>::value && IsConvexShape<B>::value) {
+      GjkEpa::contact(op1, op2, contacts);
+    }
+  }
+};
@@ -0,0 +1,195 @@
+/*
+ * WorkStealingThreadPool.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: leandro
+ */
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <functional>
+#include <cstdint>
+
+/**
+ * Fixed set of worker threads running parallel for loops over chunk indices.
+ *
+ * Each worker starts with a contiguous range of chunks and pops them from the front. Workers running out of chunks steal the back half of
+ * another worker range, so uneven chunks (e.g. pairs with hierarchies next to sphere pairs) do not leave threads idle.
+ * Ranges are packed as (begin, end) in a single 64 bit atomic, so popping and stealing are lock free compare and swaps.
+ *
+ * The calling thread works as worker 0: a pool of N threads spawns N - 1. Chunks are run exactly once, in no particular order, and the
+ * worker index passed to the task is stable for the duration of the call - use it to pick per thread scratch data.
+ */
+class WorkStealingThreadPool {
+  struct alignas(64) WorkerRange { // own cache line, workers hammer their range
+    std::atomic<uint64_t> range {0};
+  };
+
+  unsigned int threadCount;
+  std::vector<std::thread> threads;
+  std::unique_ptr<WorkerRange[]> ranges;
+
+  std::mutex mutex;
+  std::condition_variable workAvailable;
+  std::condition_variable workFinished;
+  unsigned long generation = 0;
+  unsigned int pendingWorkers = 0;
+  bool stopping = false;
+  const std::function<void(unsigned int, unsigned int)> *task = nullptr;
+
+public:
+  /**
+   * Zero means one thread per hardware thread
+   */
+  WorkStealingThreadPool(unsigned int threadCount = 0) {
+    if(threadCount == 0) {
+      threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    this->threadCount = threadCount;
+    this->ranges.reset(new WorkerRange[threadCount]);
+    for(unsigned int worker = 1; worker < threadCount; worker++) {
+      threads.emplace_back(&WorkStealingThreadPool::workerLoop, this, worker);
+    }
+  }
+
+  WorkStealingThreadPool(const WorkStealingThreadPool &) = delete;
+  WorkStealingThreadPool &operator=(const WorkStealingThreadPool &) = delete;
+
+  ~WorkStealingThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    workAvailable.notify_all();
+
+    for(std::thread &thread : threads) {
+      thread.join();
+    }
+  }
+
+  unsigned int getThreadCount() const {
+    return threadCount;
+  }
+
+  /**
+   * Runs task(chunk, worker) for every chunk in [0, chunkCount), blocking until all chunks are done. Not reentrant.
+   */
+  void parallelFor(unsigned int chunkCount, const std::function<void(unsigned int chunk, unsigned int worker)> &task) {
+    if(threadCount == 1 || chunkCount <= 1) {
+      for(unsigned int chunk = 0; chunk < chunkCount; chunk++) {
+        task(chunk, 0);
+      }
+      return;
+    }
+
+    for(unsigned int worker = 0; worker < threadCount; worker++) {
+      ranges[worker].range.store(pack((unsigned long)chunkCount * worker / threadCount, (unsigned long)chunkCount * (worker + 1) / threadCount));
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      this->task = &task;
+      this->pendingWorkers = threadCount - 1;
+      this->generation++;
+    }
+    workAvailable.notify_all();
+
+    work(0, task);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    workFinished.wait(lock, [this]() { return pendingWorkers == 0; });
+    this->task = nullptr;
+  }
+
+protected:
+  static uint64_t pack(uint32_t begin, uint32_t end) {
+    return ((uint64_t)begin << 32) | end;
+  }
+
+  static uint32_t begin(uint64_t range) {
+    return (uint32_t)(range >> 32);
+  }
+
+  static uint32_t end(uint64_t range) {
+    return (uint32_t)range;
+  }
+
+  void workerLoop(unsigned int worker) {
+    unsigned long lastGeneration = 0;
+
+    while(true) {
+      const std::function<void(unsigned int, unsigned int)> *currentTask;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        workAvailable.wait(lock, [this, lastGeneration]() { return stopping || generation != lastGeneration; });
+        if(stopping) {
+          return;
+        }
+        lastGeneration = generation;
+        currentTask = task;
+      }
+
+      work(worker, *currentTask);
+
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        pendingWorkers--;
+      }
+      workFinished.notify_one();
+    }
+  }
+
+  void work(unsigned int worker, const std::function<void(unsigned int, unsigned int)> &task) {
+    unsigned int chunk;
+    do {
+      while(pop(worker, chunk)) {
+        task(chunk, worker);
+      }
+    } while(steal(worker));
+  }
+
+  /**
+   * Takes the first chunk of the worker range
+   */
+  bool pop(unsigned int worker, unsigned int &chunk) {
+    std::atomic<uint64_t> &range = ranges[worker].range;
+    uint64_t current = range.load();
+
+    while(begin(current) < end(current)) {
+      if(range.compare_exchange_weak(current, pack(begin(current) + 1, end(current)))) {
+        chunk = begin(current);
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  /**
+   * Moves the back half of some other worker range into this worker range. Returns false if every range is empty.
+   */
+  bool steal(unsigned int worker) {
+    for(unsigned int offset = 1; offset < threadCount; offset++) {
+      std::atomic<uint64_t> &victim = ranges[(worker + offset) % threadCount].range;
+      uint64_t current = victim.load();
+
+      while(begin(current) < end(current)) {
+        uint32_t stolen = (end(current) - begin(current) + 1) / 2;
+        if(victim.compare_exchange_weak(current, pack(begin(current), end(current) - stolen))) {
+          ranges[worker].range.store(pack(end(current) - stolen, end(current)));
+          return true;
+        }
+      }
+    }
+
+    return false;
+  }
+};
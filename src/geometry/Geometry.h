@@ -7,7 +7,11 @@
 
 #pragma once
 
+#include <atomic>
+#include <mutex>
+#include <limits>
 #include "Math3d.h"
+#include "Vector3.h"
 
 enum class GeometryType {
     SPHERE,
@@ -20,16 +24,94 @@ enum class GeometryType {
 		FRUSTUM
 };
 
+/**
+ * Number of geometry types - used to size dispatch tables indexed by GeometryType
+ */
+constexpr unsigned int GEOMETRY_TYPE_COUNT = (unsigned int)GeometryType::FRUSTUM + 1;
+
+/**
+ * Axis aligned bounds as plain mins and maxs, cheap to copy and compare - used by broad phase structures.
+ * Unbounded geometries (planes, lines, frustums) report infinite bounds.
+ */
+class Bounds {
+public:
+  vector mins;
+  vector maxs;
+
+  Bounds() {
+  }
+
+  Bounds(const vector &mins, const vector &maxs) {
+    this->mins = mins;
+    this->maxs = maxs;
+  }
+
+  static Bounds infinite() {
+    return Bounds(vector(-REAL_MAX, -REAL_MAX, -REAL_MAX), vector(REAL_MAX, REAL_MAX, REAL_MAX));
+  }
+
+  /**
+   * Touching bounds are considered overlapping, same as the intersection tests.
+   */
+  bool overlaps(const Bounds &other) const {
+    return mins.x <= other.maxs.x && other.mins.x <= maxs.x &&
+        mins.y <= other.maxs.y && other.mins.y <= maxs.y &&
+        mins.z <= other.maxs.z && other.mins.z <= maxs.z;
+  }
+
+  bool contains(const Bounds &other) const {
+    return mins.x <= other.mins.x && other.maxs.x <= maxs.x &&
+        mins.y <= other.mins.y && other.maxs.y <= maxs.y &&
+        mins.z <= other.mins.z && other.maxs.z <= maxs.z;
+  }
+
+  Bounds merge(const Bounds &other) const {
+    return Bounds(vector(std::min(mins.x, other.mins.x), std::min(mins.y, other.mins.y), std::min(mins.z, other.mins.z)),
+        vector(std::max(maxs.x, other.maxs.x), std::max(maxs.y, other.maxs.y), std::max(maxs.z, other.maxs.z)));
+  }
+
+  Bounds expand(real margin) const {
+    return Bounds(mins - vector(margin, margin, margin), maxs + vector(margin, margin, margin));
+  }
+
+  vector getCenter() const {
+    return (mins + maxs) * 0.5;
+  }
+
+  real getSurfaceArea() const {
+    vector extents = maxs - mins;
+    return 2.0 * (extents.x * extents.y + extents.y * extents.z + extents.z * extents.x);
+  }
+
+  String toString() const {
+    return "Bounds(mins: " + mins.toString() + ", maxs: " + maxs.toString() + ")";
+  }
+};
 
-class Geometry {
+
+/**
+ * Base of every geometry, on scalar T. Geometry is BasicGeometry<real>, the base CollisionTester dispatches on; Sphere, Plane, Line and AABB
+ * also exist on other scalars (e.g. BasicSphere<float>) for IntersectionHelper kernels, mixing precisions if needed. Bounds stay in real.
+ */
+template<typename T> class BasicGeometry {
+public:
+  /**
+   * Vector of scalar T - the vector of the math dependency for real geometries, see ScalarVector
+   */
+  typedef typename ScalarVector<T>::type vector;
+
+private:
   vector origin; //keep this property private and use getOrigin instead.
 public:
-  Geometry(const vector &origin) {
+  BasicGeometry(const vector &origin) {
       this->origin = origin;
   }
 
-  virtual ~Geometry() {}
+  virtual ~BasicGeometry() {}
 
+  /**
+   * Leaf geometries override this as final, so that calls on a concrete type are resolved statically (see StaticCollisionTester)
+   */
   virtual const vector& getOrigin() const {
       return this->origin;
   }
@@ -42,26 +124,63 @@ public:
       return "Geometry(origin: " + origin.toString() + ")";
   }
 
+  /**
+   * Axis aligned bounds enclosing the geometry. Defaults to infinite bounds for unbounded geometries.
+   */
+  virtual Bounds getBounds() const {
+      return Bounds::infinite();
+  }
+
+  /**
+   * Bounded convex geometries implement getSupportPoint, so that any pair of them can be tested with GJK / EPA (see GjkEpa)
+   */
+  virtual bool isConvex() const {
+      return false;
+  }
+
+  /**
+   * Farthest point of the geometry along direction (support mapping). Only meaningful if isConvex().
+   */
+  virtual vector getSupportPoint(const vector &direction) const {
+      return this->getOrigin();
+  }
+
+  /**
+   * Largest projection on direction of a point of the geometry relative to its origin, that is direction * (getSupportPoint(direction) - getOrigin())
+   * without building the point. The largest T (REAL_MAX for real geometries) if not isConvex().
+   */
+  virtual T getSupportExtent(const vector &direction) const {
+      return isConvex() ? direction * (getSupportPoint(direction) - getOrigin()) : std::numeric_limits<T>::max();
+  }
+
   virtual GeometryType getType() const = 0;
 };
 
-class Sphere: public Geometry {
-  real radius;
+typedef BasicGeometry<real> Geometry;
+
+template<typename T> class BasicSphere: public BasicGeometry<T> {
+  T radius;
 public:
-  Sphere(const vector &origin, real radius) : Geometry(origin) {
+  typedef typename BasicGeometry<T>::vector vector;
+
+  BasicSphere(const vector &origin, T radius) : BasicGeometry<T>(origin) {
       this->radius = radius;
   }
 
-  real getRadius() const {
+  const vector& getOrigin() const final {
+      return BasicGeometry<T>::getOrigin();
+  }
+
+  T getRadius() const {
       return this->radius;
   }
 
-  void setRadius(real radius) {
+  void setRadius(T radius) {
       this->radius = radius;
   }
 
   bool contains(const vector &point) const {
-    vector delta = getOrigin() - point;
+    vector delta = this->getOrigin() - point;
     return delta * delta <= radius * radius;
   }
 
@@ -69,18 +188,45 @@ public:
       return "Sphere(origin: " + this->getOrigin().toString() + ", radius: " + std::to_string(this->radius) + ")";
   }
 
+  Bounds getBounds() const override {
+      return Bounds(vectorCast<::vector>(this->getOrigin() - vector(radius, radius, radius)), vectorCast<::vector>(this->getOrigin() + vector(radius, radius, radius)));
+  }
+
+  bool isConvex() const override {
+      return true;
+  }
+
+  vector getSupportPoint(const vector &direction) const final {
+      T length = direction.modulo();
+      return length > 0 ? this->getOrigin() + direction * (radius / length) : this->getOrigin() + vector(radius, 0, 0);
+  }
+
+  T getSupportExtent(const vector &direction) const final {
+      return radius * direction.modulo();
+  }
+
   GeometryType getType() const override {
       return GeometryType::SPHERE;
   }
 };
 
-class Plane: public Geometry {
+typedef BasicSphere<real> Sphere;
+
+template<typename T> class BasicPlane: public BasicGeometry<T> {
+public:
+  typedef typename BasicGeometry<T>::vector vector;
+
+private:
   vector normal;
 public:
-  Plane(const vector &origin, const vector &normal) : Geometry(origin) {
+  BasicPlane(const vector &origin, const vector &normal) : BasicGeometry<T>(origin) {
       this->normal = normal.normalizado();
   }
 
+  const vector& getOrigin() const final {
+      return BasicGeometry<T>::getOrigin();
+  }
+
   const vector &getNormal() const {
       return this->normal;
   }
@@ -98,19 +244,38 @@ public:
   }
 };
 
-class Line: public Geometry { //Do we need lines or should this really be rays (meaning we ignore negative t in parametric ecuation)
+typedef BasicPlane<real> Plane;
+
+template<typename T> class BasicLine: public BasicGeometry<T> { //Do we need lines or should this really be rays (meaning we ignore negative t in parametric ecuation)
+public:
+  typedef typename BasicGeometry<T>::vector vector;
+
+private:
   vector direction;
+  vector inverseDirection;
 public:
-  Line(const vector &origin, const vector &direction) : Geometry(origin){
+  BasicLine(const vector &origin, const vector &direction) : BasicGeometry<T>(origin){
       setDirection(direction);
   }
 
+  const vector& getOrigin() const final {
+      return BasicGeometry<T>::getOrigin();
+  }
+
   const vector& getDirection() const {
       return this->direction;
   }
 
+  /**
+   * Component wise reciprocal of the direction, for slab tests. Zero components map to infinity of the same sign.
+   */
+  const vector& getInverseDirection() const {
+      return this->inverseDirection;
+  }
+
   void setDirection(const vector &direction) {
     this->direction = direction.normalizado();
+    this->inverseDirection = vector((T)1 / this->direction.x, (T)1 / this->direction.y, (T)1 / this->direction.z);
   }
 
   String toString() const override {
@@ -122,13 +287,23 @@ public:
   }
 };
 
-class AABB : public Geometry {
+typedef BasicLine<real> Line;
+
+template<typename T> class BasicAABB : public BasicGeometry<T> {
+public:
+  typedef typename BasicGeometry<T>::vector vector;
+
+private:
   vector halfSizes;
 public:
-  AABB(const vector &origin, const vector &halfSizes) : Geometry(origin) {
+  BasicAABB(const vector &origin, const vector &halfSizes) : BasicGeometry<T>(origin) {
       this->halfSizes = halfSizes;
   }
 
+  const vector& getOrigin() const final {
+      return BasicGeometry<T>::getOrigin();
+  }
+
   const vector &getHalfSizes() const {
       return this->halfSizes;
   }
@@ -163,6 +338,22 @@ public:
       return "AABB(origin: " + this->getOrigin().toString() + ", halfSizes: " + this->halfSizes.toString() + ")";
   }
 
+  Bounds getBounds() const override {
+      return Bounds(vectorCast<::vector>(getMins()), vectorCast<::vector>(getMaxs()));
+  }
+
+  bool isConvex() const override {
+      return true;
+  }
+
+  vector getSupportPoint(const vector &direction) const final {
+      return this->getOrigin() + vector(direction.x < 0 ? -halfSizes.x : halfSizes.x, direction.y < 0 ? -halfSizes.y : halfSizes.y, direction.z < 0 ? -halfSizes.z : halfSizes.z);
+  }
+
+  T getSupportExtent(const vector &direction) const final {
+      return std::fabs(direction.x) * halfSizes.x + std::fabs(direction.y) * halfSizes.y + std::fabs(direction.z) * halfSizes.z;
+  }
+
   GeometryType getType() const override {
       return GeometryType::AABB;
   }
@@ -176,14 +367,14 @@ public:
         mins.z <= point.z && point.z <= maxs.z;
   }
 
-  AABB minkowskiDifference(const AABB &right) const {
+  BasicAABB minkowskiDifference(const BasicAABB &right) const {
     vector minA(this->getMins());
     vector maxB(right.getMaxs());
 
     vector minMD = minA - maxB;
     vector halfSizesMD = this->halfSizes + right.halfSizes;
 
-    return AABB(minMD + halfSizesMD, halfSizesMD);
+    return BasicAABB(minMD + halfSizesMD, halfSizesMD);
   }
 
   vector closestPoint(const vector &target) const {
@@ -199,10 +390,10 @@ public:
 
   vector closestSurfacePoint(const vector &target) const {
     vector surfacePoint;
-    real minDistance = REAL_MAX;
+    T minDistance = std::numeric_limits<T>::max();
 
-    real faceCoord = this->getOrigin().y + this->halfSizes.y;
-    real faceDistanceSq = (faceCoord - target.y) * (faceCoord - target.y);
+    T faceCoord = this->getOrigin().y + this->halfSizes.y;
+    T faceDistanceSq = (faceCoord - target.y) * (faceCoord - target.y);
     //if(faceDistanceSq < minDistance) {
       minDistance = faceDistanceSq;
       surfacePoint = vector(target.x, faceCoord, target.z);
@@ -247,15 +438,167 @@ public:
 	}
 };
 
+typedef BasicAABB<real> AABB;
+
 /**
- * Loose ends: the bounding volume should be refreshed upon children transformations
+ * Oriented box: center (origin), half sizes along its local axes, and the three local axes in world coordinates - the columns of its rotation matrix.
+ * Axes are kept orthonormal and cached, so that intersection tests use them as they are instead of rebuilding a rotation on every call.
+ */
+class OOBB : public Geometry {
+  vector halfSizes;
+  vector axes[3];
+public:
+  OOBB(const vector &origin, const vector &halfSizes) : Geometry(origin) {
+    this->halfSizes = halfSizes;
+    this->axes[0] = vector(1, 0, 0);
+    this->axes[1] = vector(0, 1, 0);
+    this->axes[2] = vector(0, 0, 1);
+  }
+
+  /**
+   * xAxis and yAxis need not be unit or exactly orthogonal: they are orthonormalized, keeping the xAxis direction, and zAxis = xAxis ^ yAxis.
+   */
+  OOBB(const vector &origin, const vector &halfSizes, const vector &xAxis, const vector &yAxis) : Geometry(origin) {
+    this->halfSizes = halfSizes;
+    setAxes(xAxis, yAxis);
+  }
+
+  const vector& getOrigin() const final {
+      return Geometry::getOrigin();
+  }
+
+  const vector &getHalfSizes() const {
+      return this->halfSizes;
+  }
+
+  void setHalfSizes(const vector &halfSizes) {
+      this->halfSizes = halfSizes;
+  }
+
+  /**
+   * Local axis (0: x, 1: y, 2: z) in world coordinates
+   */
+  const vector &getAxis(unsigned int index) const {
+    return this->axes[index];
+  }
+
+  const vector *getAxes() const {
+    return this->axes;
+  }
+
+  void setAxes(const vector &xAxis, const vector &yAxis) {
+    this->axes[0] = xAxis.normalizado();
+    this->axes[2] = (this->axes[0] ^ yAxis).normalizado();
+    this->axes[1] = this->axes[2] ^ this->axes[0];
+  }
+
+  /**
+   * World point to box coordinates (origin at the center, along box axes)
+   */
+  vector toLocal(const vector &point) const {
+    vector delta = point - this->getOrigin();
+    return vector(delta * axes[0], delta * axes[1], delta * axes[2]);
+  }
+
+  vector toWorld(const vector &localPoint) const {
+    return this->getOrigin() + axes[0] * localPoint.x + axes[1] * localPoint.y + axes[2] * localPoint.z;
+  }
+
+  /**
+   * World vector to box coordinates - direction only, no translation
+   */
+  vector toLocalDirection(const vector &direction) const {
+    return vector(direction * axes[0], direction * axes[1], direction * axes[2]);
+  }
+
+  vector toWorldDirection(const vector &localDirection) const {
+    return axes[0] * localDirection.x + axes[1] * localDirection.y + axes[2] * localDirection.z;
+  }
+
+  bool contains(const vector &point) const {
+    vector local = toLocal(point);
+    return std::fabs(local.x) <= halfSizes.x && std::fabs(local.y) <= halfSizes.y && std::fabs(local.z) <= halfSizes.z;
+  }
+
+  vector closestPoint(const vector &target) const {
+    vector local = toLocal(target);
+    return toWorld(vector(std::max(-halfSizes.x, std::min(local.x, halfSizes.x)),
+        std::max(-halfSizes.y, std::min(local.y, halfSizes.y)),
+        std::max(-halfSizes.z, std::min(local.z, halfSizes.z))));
+  }
+
+  /**
+   * Corner (sign of x, y and z half sizes given by bits 0, 1 and 2 of index) in world coordinates
+   */
+  vector getVertex(unsigned int index) const {
+    return toWorld(vector(index & 1 ? halfSizes.x : -halfSizes.x, index & 2 ? halfSizes.y : -halfSizes.y, index & 4 ? halfSizes.z : -halfSizes.z));
+  }
+
+  String toString() const override {
+      return "OOBB(origin: " + this->getOrigin().toString() + ", halfSizes: " + this->halfSizes.toString() +
+          ", axes: [" + axes[0].toString() + ", " + axes[1].toString() + ", " + axes[2].toString() + "])";
+  }
+
+  /**
+   * World extents are the half sizes projected on the world axes, through the absolute rotation matrix
+   */
+  Bounds getBounds() const override {
+      vector extents(std::fabs(axes[0].x) * halfSizes.x + std::fabs(axes[1].x) * halfSizes.y + std::fabs(axes[2].x) * halfSizes.z,
+          std::fabs(axes[0].y) * halfSizes.x + std::fabs(axes[1].y) * halfSizes.y + std::fabs(axes[2].y) * halfSizes.z,
+          std::fabs(axes[0].z) * halfSizes.x + std::fabs(axes[1].z) * halfSizes.y + std::fabs(axes[2].z) * halfSizes.z);
+      return Bounds(this->getOrigin() - extents, this->getOrigin() + extents);
+  }
+
+  bool isConvex() const override {
+      return true;
+  }
+
+  vector getSupportPoint(const vector &direction) const final {
+      return this->getOrigin() + axes[0] * (axes[0] * direction < 0 ? -halfSizes.x : halfSizes.x) +
+          axes[1] * (axes[1] * direction < 0 ? -halfSizes.y : halfSizes.y) +
+          axes[2] * (axes[2] * direction < 0 ? -halfSizes.z : halfSizes.z);
+  }
+
+  real getSupportExtent(const vector &direction) const final {
+      return std::fabs(axes[0] * direction) * halfSizes.x + std::fabs(axes[1] * direction) * halfSizes.y + std::fabs(axes[2] * direction) * halfSizes.z;
+  }
+
+  GeometryType getType() const override {
+      return GeometryType::OOBB;
+  }
+};
+
+/**
+ * Children are kept relative to the hierarchy origin (the bounding volume origin), so moving a hierarchy is O(1): world positions of children are
+ * only written back the next time a query reads them, through getChildren, getBoundingVolume or getBounds. Children (nested hierarchies included)
+ * are moved through setChildOffset - moving them directly is overwritten on the next update.
+ *
+ * Sphere and AABB bounding volumes are refit bottom up to enclose every child, lazily as well, whenever children are added or moved. They keep the
+ * bounding volume origin and never shrink below the volume given at construction.
+ *
+ * Updates are thread safe against concurrent queries (double checked under a per hierarchy mutex, clean hierarchies only pay an atomic load),
+ * but not against concurrent modifications - which is also why flags are set with plain load / store rather than read-modify-write.
  */
 class HierarchicalGeometry : public Geometry {
+  static constexpr unsigned int worldDirty = 1;
+  static constexpr unsigned int boundsDirty = 2;
+
   std::unique_ptr<Geometry> boundingVolume;
   std::vector<std::unique_ptr<Geometry>> children;
+  std::vector<vector> offsets;
+  HierarchicalGeometry *parent = nullptr;
+  real minimumRadius = 0;
+  vector minimumHalfSizes = vector(0, 0, 0);
+  mutable std::atomic<unsigned int> dirty { 0 };
+  mutable std::mutex updateMutex;
 public:
   HierarchicalGeometry(std::unique_ptr<Geometry> boundingVolume) :
     Geometry(boundingVolume->getOrigin()), boundingVolume(std::move(boundingVolume)) {
+    if(this->boundingVolume->getType() == GeometryType::SPHERE) {
+      this->minimumRadius = ((const Sphere &)*this->boundingVolume).getRadius();
+    } else if(this->boundingVolume->getType() == GeometryType::AABB) {
+      this->minimumHalfSizes = ((const AABB &)*this->boundingVolume).getHalfSizes();
+    }
   }
   HierarchicalGeometry(std::unique_ptr<Geometry> boundingVolume, std::unique_ptr<Geometry> child) :
     HierarchicalGeometry(std::move(boundingVolume)) {
@@ -266,18 +609,34 @@ public:
   }
 
   void setOrigin(const vector &origin) override {
-      vector delta = origin - this->getOrigin();
-
       this->boundingVolume->setOrigin(origin);
 
-      for(auto &child : children) {
-          child->setOrigin(child->getOrigin() + delta);
+      if(!children.empty()) {
+        dirty.store(dirty.load(std::memory_order_relaxed) | worldDirty, std::memory_order_release);
       }
   }
 
+  /**
+   * Children are given in world space, and kept at their current offset from the hierarchy origin
+   */
   void addChildren(std::unique_ptr<Geometry> children) {
+      if(children->getType() == GeometryType::HIERARCHY) {
+        ((HierarchicalGeometry &)*children).parent = this;
+      }
+
+      this->offsets.push_back(children->getOrigin() - this->getOrigin());
       this->children.push_back(std::move(children));
+      markBoundsDirty();
+  }
 
+  const vector &getChildOffset(unsigned int index) const {
+      return this->offsets[index];
+  }
+
+  void setChildOffset(unsigned int index, const vector &offset) {
+      this->offsets[index] = offset;
+      this->children[index]->setOrigin(this->getOrigin() + offset);
+      markBoundsDirty();
   }
 
   String toString() const override {
@@ -288,13 +647,96 @@ public:
       return GeometryType::HIERARCHY;
   }
 
+  Bounds getBounds() const override {
+      update();
+      return this->boundingVolume->getBounds();
+  }
+
   const Geometry &getBoundingVolume() const {
+      update();
       return *this->boundingVolume.get();
   }
 
   const std::vector<std::unique_ptr<Geometry>> &getChildren() const {
+      update();
       return this->children;
   }
+
+protected:
+  void markBoundsDirty() {
+      for(HierarchicalGeometry *node = this; node != nullptr; node = node->parent) {
+        node->dirty.store(node->dirty.load(std::memory_order_relaxed) | boundsDirty, std::memory_order_release);
+      }
+  }
+
+  void update() const {
+      if(dirty.load(std::memory_order_acquire) == 0) {
+        return;
+      }
+
+      std::lock_guard<std::mutex> lock(updateMutex);
+      unsigned int flags = dirty.load(std::memory_order_acquire);
+
+      if(flags & boundsDirty) {
+        refit();
+      }
+
+      if(flags & worldDirty) {
+        for(unsigned int index = 0; index < children.size(); index++) {
+          children[index]->setOrigin(this->getOrigin() + offsets[index]);
+        }
+      }
+
+      dirty.store(0, std::memory_order_release);
+  }
+
+  /**
+   * Only needs offsets and the extents of children around their own origins, so it does not depend on children world positions being up to date.
+   */
+  void refit() const {
+      if(boundingVolume->getType() == GeometryType::SPHERE) {
+        real radius = minimumRadius;
+        for(unsigned int index = 0; index < children.size(); index++) {
+          radius = std::max(radius, farthestDistance(*children[index], offsets[index]));
+        }
+        ((Sphere &)*boundingVolume).setRadius(radius);
+      } else if(boundingVolume->getType() == GeometryType::AABB) {
+        vector halfSizes = minimumHalfSizes;
+        for(unsigned int index = 0; index < children.size(); index++) {
+          Bounds bounds = children[index]->getBounds();
+          if(bounds.maxs.x >= REAL_MAX) {
+            continue;
+          }
+          vector mins = offsets[index] + (bounds.mins - children[index]->getOrigin());
+          vector maxs = offsets[index] + (bounds.maxs - children[index]->getOrigin());
+          halfSizes = vector(std::max(halfSizes.x, std::max(-mins.x, maxs.x)),
+              std::max(halfSizes.y, std::max(-mins.y, maxs.y)),
+              std::max(halfSizes.z, std::max(-mins.z, maxs.z)));
+        }
+        ((AABB &)*boundingVolume).setHalfSizes(halfSizes);
+      }
+  }
+
+  /**
+   * Distance from the hierarchy origin to the farthest point of child, placed at offset: exact for spheres, the farthest bounds corner otherwise
+   */
+  static real farthestDistance(const Geometry &child, const vector &offset) {
+      if(child.getType() == GeometryType::SPHERE) {
+        return offset.modulo() + ((const Sphere &)child).getRadius();
+      }
+      if(child.getType() == GeometryType::HIERARCHY) {
+        return farthestDistance(((const HierarchicalGeometry &)child).getBoundingVolume(), offset);
+      }
+
+      Bounds bounds = child.getBounds();
+      if(bounds.maxs.x >= REAL_MAX) {
+        return 0;
+      }
+      vector mins = offset + (bounds.mins - child.getOrigin());
+      vector maxs = offset + (bounds.maxs - child.getOrigin());
+      vector farthest(std::max(-mins.x, maxs.x), std::max(-mins.y, maxs.y), std::max(-mins.z, maxs.z));
+      return farthest.modulo();
+  }
 };
 
 
@@ -330,17 +772,234 @@ public:
     return vector(x, heightAt(x, z), z);
   }
 
+  /**
+   * Spacing of the surface features along x and z, e.g. the sample spacing of sampled maps - ray casts over maps without a faster path
+   * sample heights once per cell (see IntersectionHelper::lineHeightmapMarch). Defaults to 1/256 of the smallest side.
+   */
+  virtual real getCellSize() const {
+    return std::min(getWidth(), getDepth()) / 256;
+  }
+
+  /**
+   * Heights at count (x, z) points, same as calling heightAt on each. Implementations override it to sample without a virtual call per point.
+   */
+  virtual void heightsAt(const real *x, const real *z, unsigned int count, real *heights) const {
+    for(unsigned int index = 0; index < count; index++) {
+      heights[index] = heightAt(x[index], z[index]);
+    }
+  }
+
   virtual String toString() const {
     return String("HeightMap");
   }
 };
 
+/**
+ * Min-max mip pyramid over the cells of a sample grid. Level 0 has the min and max sample of each cell, and each level above merges 2x2 nodes
+ * of the level below (rounding up), up to a single root node. Node (column, row) of level l covers cells [column << l, (column + 1) << l) along x,
+ * same along z, clipped to the grid.
+ *
+ * Queries descend from the root and skip whole tiles whose height range cannot be hit, without touching the samples (see IntersectionHelper).
+ */
+class MinMaxPyramid {
+  struct Level {
+    unsigned int columns;
+    unsigned int rows;
+    unsigned int offset;
+  };
+
+  std::vector<Level> levels;
+  std::vector<real> mins;
+  std::vector<real> maxs;
+public:
+  /**
+   * samples is a row major grid of columns x rows samples, at least 2 x 2
+   */
+  MinMaxPyramid(const std::vector<real> &samples, unsigned int columns, unsigned int rows) {
+    Level level {columns - 1, rows - 1, 0};
+    levels.push_back(level);
+    mins.resize(level.columns * level.rows);
+    maxs.resize(level.columns * level.rows);
+
+    for(unsigned int row = 0; row < level.rows; row++) {
+      for(unsigned int column = 0; column < level.columns; column++) {
+        const real *cell = &samples[row * columns + column];
+        mins[row * level.columns + column] = std::min(std::min(cell[0], cell[1]), std::min(cell[columns], cell[columns + 1]));
+        maxs[row * level.columns + column] = std::max(std::max(cell[0], cell[1]), std::max(cell[columns], cell[columns + 1]));
+      }
+    }
+
+    while(level.columns > 1 || level.rows > 1) {
+      Level parent {(level.columns + 1) / 2, (level.rows + 1) / 2, (unsigned int)mins.size()};
+      mins.resize(parent.offset + parent.columns * parent.rows);
+      maxs.resize(parent.offset + parent.columns * parent.rows);
+
+      for(unsigned int row = 0; row < parent.rows; row++) {
+        for(unsigned int column = 0; column < parent.columns; column++) {
+          real minimum = REAL_MAX;
+          real maximum = -REAL_MAX;
+          for(unsigned int childRow = row * 2; childRow < std::min(row * 2 + 2, level.rows); childRow++) {
+            for(unsigned int childColumn = column * 2; childColumn < std::min(column * 2 + 2, level.columns); childColumn++) {
+              minimum = std::min(minimum, mins[level.offset + childRow * level.columns + childColumn]);
+              maximum = std::max(maximum, maxs[level.offset + childRow * level.columns + childColumn]);
+            }
+          }
+          mins[parent.offset + row * parent.columns + column] = minimum;
+          maxs[parent.offset + row * parent.columns + column] = maximum;
+        }
+      }
+
+      levels.push_back(parent);
+      level = parent;
+    }
+  }
+
+  unsigned int getLevelCount() const {
+    return levels.size();
+  }
+
+  unsigned int getColumns(unsigned int level) const {
+    return levels[level].columns;
+  }
+
+  unsigned int getRows(unsigned int level) const {
+    return levels[level].rows;
+  }
+
+  real getMin(unsigned int level, unsigned int column, unsigned int row) const {
+    return mins[levels[level].offset + row * levels[level].columns + column];
+  }
+
+  real getMax(unsigned int level, unsigned int column, unsigned int row) const {
+    return maxs[levels[level].offset + row * levels[level].columns + column];
+  }
+};
+
+/**
+ * Height map sampled on a regular grid, with samples in a contiguous row major array (rows along z, columns along x).
+ *
+ * Each cell is split in two triangles along its (column + 1, row) - (column, row + 1) diagonal and heights are interpolated on the triangle,
+ * so the surface is continuous and normals are the flat triangle normals - derived from the same three samples, no normals are stored.
+ * Points outside the grid are clamped to its border. A MinMaxPyramid over the cells is built along, for ray casts and terrain queries.
+ *
+ * Final, so that calls through a GridHeightMap pointer or reference are direct calls (see HeightMapGeometry).
+ */
+class GridHeightMap final : public HeightMap {
+  unsigned int columns;
+  unsigned int rows;
+  real cellSize;
+  real inverseCellSize;
+  std::vector<real> samples;
+  real maxHeight = 0;
+  MinMaxPyramid pyramid;
+public:
+  /**
+   * At least 2 columns and 2 rows. Samples are expected to be non negative - height map bounds span from 0 to the highest sample.
+   */
+  GridHeightMap(unsigned int columns, unsigned int rows, real cellSize, const std::vector<real> &samples) : samples(samples), pyramid(samples, columns, rows) {
+    this->columns = columns;
+    this->rows = rows;
+    this->cellSize = cellSize;
+    this->inverseCellSize = 1.0 / cellSize;
+
+    for(real sample : samples) {
+      maxHeight = std::max(maxHeight, sample);
+    }
+  }
+
+  real getWidth() const override {
+    return (columns - 1) * cellSize;
+  }
+
+  real getHeight() const override {
+    return maxHeight;
+  }
+
+  real getDepth() const override {
+    return (rows - 1) * cellSize;
+  }
+
+  unsigned int getColumns() const {
+    return columns;
+  }
+
+  unsigned int getRows() const {
+    return rows;
+  }
+
+  real getCellSize() const override {
+    return cellSize;
+  }
+
+  real getSample(unsigned int column, unsigned int row) const {
+    return samples[row * columns + column];
+  }
+
+  const MinMaxPyramid &getPyramid() const {
+    return pyramid;
+  }
+
+  real heightAt(real x, real z) const override {
+    unsigned int column, row;
+    real u, v;
+    const real *cell = locate(x, z, column, row, u, v);
+
+    if(u + v <= 1) {
+      return cell[0] + (cell[1] - cell[0]) * u + (cell[columns] - cell[0]) * v;
+    }
+    return cell[columns + 1] + (cell[columns] - cell[columns + 1]) * (1 - u) + (cell[1] - cell[columns + 1]) * (1 - v);
+  }
+
+  vector normalAt(real x, real z) const override {
+    unsigned int column, row;
+    real u, v;
+    const real *cell = locate(x, z, column, row, u, v);
+
+    if(u + v <= 1) {
+      return vector(cell[0] - cell[1], cellSize, cell[0] - cell[columns]).normalizado();
+    }
+    return vector(cell[columns] - cell[columns + 1], cellSize, cell[1] - cell[columns + 1]).normalizado();
+  }
+
+  void heightsAt(const real *x, const real *z, unsigned int count, real *heights) const override {
+    for(unsigned int index = 0; index < count; index++) {
+      heights[index] = heightAt(x[index], z[index]);
+    }
+  }
+
+  String toString() const override {
+    return "GridHeightMap(columns: " + std::to_string(columns) + ", rows: " + std::to_string(rows) + ", cellSize: " + std::to_string(cellSize) + ")";
+  }
+
+protected:
+  /**
+   * Returns the lower left sample of the cell containing (x, z), and the position within the cell in [0, 1]
+   */
+  const real *locate(real x, real z, unsigned int &column, unsigned int &row, real &u, real &v) const {
+    real gridX = std::max((real)0, std::min(x * inverseCellSize, (real)(columns - 1)));
+    real gridZ = std::max((real)0, std::min(z * inverseCellSize, (real)(rows - 1)));
+
+    column = std::min((unsigned int)gridX, columns - 2);
+    row = std::min((unsigned int)gridZ, rows - 2);
+    u = gridX - column;
+    v = gridZ - row;
+
+    return &samples[row * columns + column];
+  }
+};
+
+/**
+ * Height map placed in the world at position (its bounds mins).
+ * When the height map is a GridHeightMap, sampling calls it directly instead of through HeightMap virtual calls.
+ */
 class HeightMapGeometry : public AABB {
   const HeightMap &heightMap;
+  const GridHeightMap *gridHeightMap;
 public:
   HeightMapGeometry(const vector &position, const HeightMap &heightMap) :
     AABB(position + vector(heightMap.getWidth() * 0.5, heightMap.getHeight() * 0.5, heightMap.getDepth() * 0.5),
       vector(heightMap.getWidth() * 0.5, heightMap.getHeight() * 0.5, heightMap.getDepth() * 0.5)), heightMap(heightMap) {
+    this->gridHeightMap = dynamic_cast<const GridHeightMap *>(&heightMap);
   }
 
   const HeightMap &getHeightMap() const {
@@ -351,13 +1010,56 @@ public:
       return GeometryType::HEIGHTMAP;
   }
 
+  bool isConvex() const override {
+      return false;
+  }
+
+
+  /**
+   * Null if the height map is not a GridHeightMap
+   */
+  const GridHeightMap *getGridHeightMap() const {
+    return this->gridHeightMap;
+  }
 
   real heightAt(real x, real z) const {
-    return this->heightMap.heightAt(x - this->getPosition().x, z - this->getPosition().z);
+    vector position(this->getPosition());
+    if(this->gridHeightMap != nullptr) {
+      return this->gridHeightMap->heightAt(x - position.x, z - position.z);
+    }
+    return this->heightMap.heightAt(x - position.x, z - position.z);
   }
 
   vector normalAt(real x, real z) const {
-    return this->heightMap.normalAt(x - this->getPosition().x, z - this->getPosition().z);
+    vector position(this->getPosition());
+    if(this->gridHeightMap != nullptr) {
+      return this->gridHeightMap->normalAt(x - position.x, z - position.z);
+    }
+    return this->heightMap.normalAt(x - position.x, z - position.z);
+  }
+
+  /**
+   * Heights at count world (x, z) points, same as calling heightAt on each. One height map call per block of points.
+   */
+  void heightsAt(const real *x, const real *z, unsigned int count, real *heights) const {
+    constexpr unsigned int blockSize = 64;
+    real localX[blockSize];
+    real localZ[blockSize];
+    vector position(this->getPosition());
+
+    for(unsigned int begin = 0; begin < count; begin += blockSize) {
+      unsigned int size = std::min(blockSize, count - begin);
+      for(unsigned int index = 0; index < size; index++) {
+        localX[index] = x[begin + index] - position.x;
+        localZ[index] = z[begin + index] - position.z;
+      }
+
+      if(this->gridHeightMap != nullptr) {
+        this->gridHeightMap->heightsAt(localX, localZ, size, heights + begin);
+      } else {
+        this->heightMap.heightsAt(localX, localZ, size, heights + begin);
+      }
+    }
   }
 };
 
@@ -0,0 +1,317 @@
+/*
+ * GeometryBatch.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: leandro
+ */
+
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <limits>
+#include "Geometry.h"
+
+/**
+ * Conversion from real into the scalar type of a batch. When T is narrower than real, values are rounded to nearest or outwards, so that
+ * batch proxies built from real shapes contain them. Float proxies may then report a few more intersections than their shapes, and beyond that
+ * results only differ by the rounding of float arithmetic in the kernels. When T is real every conversion is exact and proxies are the same as their shapes.
+ */
+template<typename T> struct BatchScalar {
+  static T nearest(real value) {
+    return (T)value;
+  }
+
+  static T down(real value) {
+    T result = (T)value;
+    return (real)result > value ? std::nextafter(result, -std::numeric_limits<T>::infinity()) : result;
+  }
+
+  static T up(real value) {
+    T result = (T)value;
+    return (real)result < value ? std::nextafter(result, std::numeric_limits<T>::infinity()) : result;
+  }
+
+  /**
+   * Origin rounded to nearest, radius grown by the rounding error of the origin
+   */
+  static void sphere(const vector &origin, real radius, T &x, T &y, T &z, T &batchRadius) {
+    x = nearest(origin.x);
+    y = nearest(origin.y);
+    z = nearest(origin.z);
+    real error = std::abs((real)x - origin.x) + std::abs((real)y - origin.y) + std::abs((real)z - origin.z);
+    batchRadius = up(radius + error);
+  }
+};
+
+/**
+ * Structure of arrays copy of many spheres, for batch kernels (see BatchIntersectionHelper). Stored as T - SphereBatch stores reals, FloatSphereBatch
+ * stores floats: half the memory and twice the lanes per register, for crowds and particles that do not need more precision (see BatchScalar).
+ * real is the scalar of the math dependency: when it is double, float batches are the narrower ones; when it is float, FloatSphereBatch is the
+ * same type as SphereBatch, and likewise for aabb and ray batches. Shapes are templated the same way (see BasicGeometry).
+ * Each coordinate lives in its own contiguous array, so that consecutive spheres load straight into vector registers -
+ * no vtable pointers, no pointer chasing.
+ *
+ * Batches are snapshots: changes to source spheres are not seen until set() is called again.
+ */
+template<typename T> class BasicSphereBatch {
+  std::vector<T> x;
+  std::vector<T> y;
+  std::vector<T> z;
+  std::vector<T> radius;
+public:
+  typedef T Scalar;
+
+  /**
+   * Returns the index of the sphere in this batch
+   */
+  unsigned int add(const vector &origin, real radius) {
+    this->x.emplace_back();
+    this->y.emplace_back();
+    this->z.emplace_back();
+    this->radius.emplace_back();
+    set(this->x.size() - 1, origin, radius);
+    return this->x.size() - 1;
+  }
+
+  unsigned int add(const Sphere &sphere) {
+    return add(sphere.getOrigin(), sphere.getRadius());
+  }
+
+  void set(unsigned int index, const vector &origin, real radius) {
+    BatchScalar<T>::sphere(origin, radius, this->x[index], this->y[index], this->z[index], this->radius[index]);
+  }
+
+  void set(unsigned int index, const Sphere &sphere) {
+    set(index, sphere.getOrigin(), sphere.getRadius());
+  }
+
+  void reserve(unsigned int capacity) {
+    x.reserve(capacity);
+    y.reserve(capacity);
+    z.reserve(capacity);
+    radius.reserve(capacity);
+  }
+
+  void clear() {
+    x.clear();
+    y.clear();
+    z.clear();
+    radius.clear();
+  }
+
+  unsigned int size() const {
+    return x.size();
+  }
+
+  vector getOrigin(unsigned int index) const {
+    return vector(x[index], y[index], z[index]);
+  }
+
+  T getRadius(unsigned int index) const {
+    return radius[index];
+  }
+
+  const T *getX() const {
+    return x.data();
+  }
+
+  const T *getY() const {
+    return y.data();
+  }
+
+  const T *getZ() const {
+    return z.data();
+  }
+
+  const T *getRadiuses() const {
+    return radius.data();
+  }
+};
+
+typedef BasicSphereBatch<real> SphereBatch;
+typedef BasicSphereBatch<float> FloatSphereBatch;
+
+/**
+ * Structure of arrays copy of many aabbs. Mins and maxs are stored rather than origin and half sizes: they are computed once here,
+ * the same way AABB::getMins() and AABB::getMaxs() do, instead of once per test. Narrower scalars round mins down and maxs up.
+ */
+template<typename T> class BasicAabbBatch {
+  std::vector<T> minX;
+  std::vector<T> minY;
+  std::vector<T> minZ;
+  std::vector<T> maxX;
+  std::vector<T> maxY;
+  std::vector<T> maxZ;
+public:
+  typedef T Scalar;
+
+  /**
+   * Returns the index of the aabb in this batch
+   */
+  unsigned int add(const AABB &aabb) {
+    minX.emplace_back();
+    minY.emplace_back();
+    minZ.emplace_back();
+    maxX.emplace_back();
+    maxY.emplace_back();
+    maxZ.emplace_back();
+    set(minX.size() - 1, aabb);
+    return minX.size() - 1;
+  }
+
+  void set(unsigned int index, const AABB &aabb) {
+    vector mins(aabb.getMins());
+    vector maxs(aabb.getMaxs());
+
+    minX[index] = BatchScalar<T>::down(mins.x);
+    minY[index] = BatchScalar<T>::down(mins.y);
+    minZ[index] = BatchScalar<T>::down(mins.z);
+    maxX[index] = BatchScalar<T>::up(maxs.x);
+    maxY[index] = BatchScalar<T>::up(maxs.y);
+    maxZ[index] = BatchScalar<T>::up(maxs.z);
+  }
+
+  void reserve(unsigned int capacity) {
+    minX.reserve(capacity);
+    minY.reserve(capacity);
+    minZ.reserve(capacity);
+    maxX.reserve(capacity);
+    maxY.reserve(capacity);
+    maxZ.reserve(capacity);
+  }
+
+  void clear() {
+    minX.clear();
+    minY.clear();
+    minZ.clear();
+    maxX.clear();
+    maxY.clear();
+    maxZ.clear();
+  }
+
+  unsigned int size() const {
+    return minX.size();
+  }
+
+  vector getMins(unsigned int index) const {
+    return vector(minX[index], minY[index], minZ[index]);
+  }
+
+  vector getMaxs(unsigned int index) const {
+    return vector(maxX[index], maxY[index], maxZ[index]);
+  }
+
+  const T *getMinX() const {
+    return minX.data();
+  }
+
+  const T *getMinY() const {
+    return minY.data();
+  }
+
+  const T *getMinZ() const {
+    return minZ.data();
+  }
+
+  const T *getMaxX() const {
+    return maxX.data();
+  }
+
+  const T *getMaxY() const {
+    return maxY.data();
+  }
+
+  const T *getMaxZ() const {
+    return maxZ.data();
+  }
+};
+
+typedef BasicAabbBatch<real> AabbBatch;
+typedef BasicAabbBatch<float> FloatAabbBatch;
+
+/**
+ * Structure of arrays copy of many rays (lines tested for t >= 0), as origins and inverse directions - what slab tests need.
+ * A packet of rays is just a small batch, e.g. 4 or 8 picking rays through neighbouring pixels. Narrower scalars round to nearest.
+ */
+template<typename T> class BasicRayBatch {
+  std::vector<T> originX;
+  std::vector<T> originY;
+  std::vector<T> originZ;
+  std::vector<T> inverseDirectionX;
+  std::vector<T> inverseDirectionY;
+  std::vector<T> inverseDirectionZ;
+public:
+  typedef T Scalar;
+
+  /**
+   * Returns the index of the ray in this batch
+   */
+  unsigned int add(const Line &line) {
+    originX.push_back(BatchScalar<T>::nearest(line.getOrigin().x));
+    originY.push_back(BatchScalar<T>::nearest(line.getOrigin().y));
+    originZ.push_back(BatchScalar<T>::nearest(line.getOrigin().z));
+    inverseDirectionX.push_back(BatchScalar<T>::nearest(line.getInverseDirection().x));
+    inverseDirectionY.push_back(BatchScalar<T>::nearest(line.getInverseDirection().y));
+    inverseDirectionZ.push_back(BatchScalar<T>::nearest(line.getInverseDirection().z));
+    return originX.size() - 1;
+  }
+
+  void set(unsigned int index, const Line &line) {
+    originX[index] = BatchScalar<T>::nearest(line.getOrigin().x);
+    originY[index] = BatchScalar<T>::nearest(line.getOrigin().y);
+    originZ[index] = BatchScalar<T>::nearest(line.getOrigin().z);
+    inverseDirectionX[index] = BatchScalar<T>::nearest(line.getInverseDirection().x);
+    inverseDirectionY[index] = BatchScalar<T>::nearest(line.getInverseDirection().y);
+    inverseDirectionZ[index] = BatchScalar<T>::nearest(line.getInverseDirection().z);
+  }
+
+  void reserve(unsigned int capacity) {
+    originX.reserve(capacity);
+    originY.reserve(capacity);
+    originZ.reserve(capacity);
+    inverseDirectionX.reserve(capacity);
+    inverseDirectionY.reserve(capacity);
+    inverseDirectionZ.reserve(capacity);
+  }
+
+  void clear() {
+    originX.clear();
+    originY.clear();
+    originZ.clear();
+    inverseDirectionX.clear();
+    inverseDirectionY.clear();
+    inverseDirectionZ.clear();
+  }
+
+  unsigned int size() const {
+    return originX.size();
+  }
+
+  const T *getOriginX() const {
+    return originX.data();
+  }
+
+  const T *getOriginY() const {
+    return originY.data();
+  }
+
+  const T *getOriginZ() const {
+    return originZ.data();
+  }
+
+  const T *getInverseDirectionX() const {
+    return inverseDirectionX.data();
+  }
+
+  const T *getInverseDirectionY() const {
+    return inverseDirectionY.data();
+  }
+
+  const T *getInverseDirectionZ() const {
+    return inverseDirectionZ.data();
+  }
+};
+
+typedef BasicRayBatch<real> RayBatch;
+typedef BasicRayBatch<float> FloatRayBatch;
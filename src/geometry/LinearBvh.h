@@ -0,0 +1,260 @@
+/*
+ * LinearBvh.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: leandro
+ */
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "Geometry.h"
+
+/**
+ * Flattened, pointer free copy of a HierarchicalGeometry, or of any set of geometries, meant to be queried through CollisionTester.
+ *
+ *  - Nodes live in one contiguous array, laid out depth first: the first child of an internal node is the node right after it, and every node
+ *    keeps the escape index of the node following its subtree. Traversal is a single forward loop - descend by incrementing, skip a subtree by
+ *    jumping to its escape - with no recursion and no stack.
+ *  - Shapes, bounding volumes of internal nodes included, are copied by value into one array per type (spheres, aabbs, oobbs, planes, lines).
+ *    Nodes keep the type and the index into that array, so no virtual getType() is called while traversing. Other types (height maps,
+ *    frustums, ...) are not copied and referenced through their source pointer instead.
+ *  - Top level nodes form a forest: compiling a set of geometries emits unbounded ones (planes, lines) as top level leaves, and bounded ones
+ *    under a binary tree of aabbs split at the median along the widest axis. Queries then match testing every geometry, except for lines:
+ *    lines are tested as rays against aabbs but as whole lines against spheres, so hits behind the line origin are not reported.
+ *
+ * Compiled bvhs are snapshots: changes to source geometries are not seen until compiled again. Sources are not owned, but are kept per node
+ * so that contacts report the source geometry instead of its copy - they must outlive the bvh if contacts are used. Bvhs loaded from a
+ * SceneCache have no sources, and contacts report their shapes.
+ */
+class LinearBvh {
+  friend class MortonBvhBuilder;
+  friend class SceneCache;
+public:
+  class Node {
+  public:
+    GeometryType type; // of the leaf shape, or of the bounding volume of internal nodes
+    unsigned int shape = 0; // index into the array of its type
+    unsigned int escape = 0; // next node once this subtree is skipped or done. index + 1 for leaves
+    bool leaf = true;
+
+    Node(GeometryType type, unsigned int shape) : type(type), shape(shape) {
+    }
+  };
+
+private:
+  std::vector<Node> nodes;
+  std::vector<const Geometry *> sources;
+  std::vector<Sphere> spheres;
+  std::vector<AABB> aabbs;
+  std::vector<OOBB> oobbs;
+  std::vector<Plane> planes;
+  std::vector<Line> lines;
+  std::vector<const Geometry *> others;
+
+public:
+  LinearBvh() {
+  }
+
+  /**
+   * Hierarchies are compiled node by node, anything else as a single leaf
+   */
+  LinearBvh(const Geometry &geometry) {
+    add(geometry);
+  }
+
+  LinearBvh(const std::vector<const Geometry *> &geometries) {
+    add(geometries);
+  }
+
+  void add(const Geometry &geometry) {
+    if(geometry.getType() == GeometryType::HIERARCHY) {
+      addHierarchy((const HierarchicalGeometry &)geometry);
+    } else {
+      addLeaf(geometry);
+    }
+  }
+
+  void add(const std::vector<const Geometry *> &geometries) {
+    std::vector<const Geometry *> bounded;
+    std::vector<Bounds> bounds;
+
+    for(const Geometry *geometry : geometries) {
+      Bounds geometryBounds = geometry->getBounds();
+      if(geometryBounds.maxs.x >= REAL_MAX) {
+        add(*geometry);
+      } else {
+        bounded.push_back(geometry);
+        bounds.push_back(geometryBounds);
+      }
+    }
+
+    std::vector<unsigned int> order(bounded.size());
+    for(unsigned int index = 0; index < order.size(); index++) {
+      order[index] = index;
+    }
+    addMedianSplit(bounded, bounds, order, 0, order.size());
+  }
+
+  void clear() {
+    nodes.clear();
+    sources.clear();
+    spheres.clear();
+    aabbs.clear();
+    oobbs.clear();
+    planes.clear();
+    lines.clear();
+    others.clear();
+  }
+
+  unsigned int size() const {
+    return nodes.size();
+  }
+
+  bool empty() const {
+    return nodes.empty();
+  }
+
+  const Node &getNode(unsigned int index) const {
+    return nodes[index];
+  }
+
+  const std::vector<Node> &getNodes() const {
+    return nodes;
+  }
+
+  /**
+   * Shape of the node (leaf shape, or bounding volume of internal nodes), through a switch on the node type rather than a virtual call
+   */
+  const Geometry &getShape(const Node &node) const {
+    switch(node.type) {
+      case GeometryType::SPHERE:
+        return spheres[node.shape];
+      case GeometryType::AABB:
+        return aabbs[node.shape];
+      case GeometryType::OOBB:
+        return oobbs[node.shape];
+      case GeometryType::PLANE:
+        return planes[node.shape];
+      case GeometryType::LINE:
+        return lines[node.shape];
+      default:
+        return *others[node.shape];
+    }
+  }
+
+  /**
+   * Geometry the node shape was copied from - nullptr for bounding volumes created when compiling a set of geometries, and for bvhs loaded from a SceneCache
+   */
+  const Geometry *getSource(unsigned int index) const {
+    return index < sources.size() ? sources[index] : nullptr;
+  }
+
+  String toString() const {
+    return "LinearBvh(nodes: " + std::to_string(nodes.size()) + ", spheres: " + std::to_string(spheres.size()) + ", aabbs: " + std::to_string(aabbs.size())
+        + ", oobbs: " + std::to_string(oobbs.size()) + ", planes: " + std::to_string(planes.size()) + ", lines: " + std::to_string(lines.size())
+        + ", others: " + std::to_string(others.size()) + ")";
+  }
+
+protected:
+  void addHierarchy(const HierarchicalGeometry &hierarchy) {
+    unsigned int index = addNode(hierarchy.getBoundingVolume(), &hierarchy.getBoundingVolume());
+    nodes[index].leaf = false;
+
+    for(auto &child : hierarchy.getChildren()) {
+      add(*child);
+    }
+
+    nodes[index].escape = nodes.size();
+  }
+
+  void addLeaf(const Geometry &geometry) {
+    unsigned int index = addNode(geometry, &geometry);
+    nodes[index].escape = index + 1;
+  }
+
+  /**
+   * Binary tree over [begin, end) of order, with single geometry leaves
+   */
+  void addMedianSplit(const std::vector<const Geometry *> &geometries, const std::vector<Bounds> &bounds, std::vector<unsigned int> &order, unsigned int begin, unsigned int end) {
+    if(begin == end) {
+      return;
+    }
+
+    if(end - begin == 1) {
+      add(*geometries[order[begin]]);
+      return;
+    }
+
+    Bounds nodeBounds = bounds[order[begin]];
+    Bounds centers(nodeBounds.getCenter(), nodeBounds.getCenter());
+    for(unsigned int position = begin + 1; position < end; position++) {
+      nodeBounds = nodeBounds.merge(bounds[order[position]]);
+      vector center = bounds[order[position]].getCenter();
+      centers = centers.merge(Bounds(center, center));
+    }
+
+    vector extents = centers.maxs - centers.mins;
+    unsigned int axis = extents.x >= extents.y && extents.x >= extents.z ? 0 : (extents.y >= extents.z ? 1 : 2);
+    unsigned int middle = begin + (end - begin) / 2;
+    std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end, [&bounds, axis](unsigned int a, unsigned int b) {
+      return component(bounds[a].getCenter(), axis) < component(bounds[b].getCenter(), axis);
+    });
+
+    unsigned int index = addNode(enclosing(nodeBounds), nullptr);
+    nodes[index].leaf = false;
+
+    addMedianSplit(geometries, bounds, order, begin, middle);
+    addMedianSplit(geometries, bounds, order, middle, end);
+
+    nodes[index].escape = nodes.size();
+  }
+
+  unsigned int addNode(const Geometry &shape, const Geometry *source) {
+    switch(shape.getType()) {
+      case GeometryType::SPHERE:
+        nodes.emplace_back(GeometryType::SPHERE, spheres.size());
+        spheres.push_back((const Sphere &)shape);
+        break;
+      case GeometryType::AABB:
+        nodes.emplace_back(GeometryType::AABB, aabbs.size());
+        aabbs.push_back((const AABB &)shape);
+        break;
+      case GeometryType::OOBB:
+        nodes.emplace_back(GeometryType::OOBB, oobbs.size());
+        oobbs.push_back((const OOBB &)shape);
+        break;
+      case GeometryType::PLANE:
+        nodes.emplace_back(GeometryType::PLANE, planes.size());
+        planes.push_back((const Plane &)shape);
+        break;
+      case GeometryType::LINE:
+        nodes.emplace_back(GeometryType::LINE, lines.size());
+        lines.push_back((const Line &)shape);
+        break;
+      default:
+        nodes.emplace_back(shape.getType(), others.size());
+        others.push_back(source);
+    }
+
+    sources.push_back(source);
+    return nodes.size() - 1;
+  }
+
+  /**
+   * Bounding volume of internal nodes. Center and half sizes round, so the aabb is padded by a few ulps of its largest coordinate to keep enclosing every child
+   */
+  static AABB enclosing(const Bounds &bounds) {
+    real largest = std::max(std::max(std::max(std::abs(bounds.mins.x), std::abs(bounds.mins.y)), std::abs(bounds.mins.z)),
+        std::max(std::max(std::abs(bounds.maxs.x), std::abs(bounds.maxs.y)), std::abs(bounds.maxs.z)));
+    Bounds padded = bounds.expand(largest * std::numeric_limits<real>::epsilon() * 4);
+    return AABB(padded.getCenter(), (padded.maxs - padded.mins) * 0.5);
+  }
+
+  static real component(const vector &value, unsigned int axis) {
+    return axis == 0 ? value.x : (axis == 1 ? value.y : value.z);
+  }
+};
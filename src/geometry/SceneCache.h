@@ -0,0 +1,439 @@
+/*
+ * SceneCache.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: leandro
+ */
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "LinearBvh.h"
+
+/**
+ * Header of scene cache files. Native endianness, and real as the writer was built - float and double builds do not share caches.
+ *
+ * Sections follow the header at 64 byte aligned offsets from the start of the file, one per array of LinearBvh: nodes as SceneCacheNode,
+ * then spheres (origin, radius), aabbs (origin, half sizes), oobbs (origin, half sizes, three axes), planes (origin, normal) and lines
+ * (origin, direction) as consecutive reals. Nodes reference shapes by index, so the file holds no pointers.
+ * The checksum covers the whole file, the header hashed with its checksum field zeroed, so that corrupted offsets and counts are detected too.
+ */
+struct SceneCacheHeader {
+  static constexpr uint32_t MAGIC = 0x43534847; // "GHSC"
+  static constexpr uint32_t VERSION = 2;
+  static constexpr uint32_t ALIGNMENT = 64;
+
+  enum Section {
+    NODES,
+    SPHERES,
+    AABBS,
+    OOBBS,
+    PLANES,
+    LINES,
+    SECTION_COUNT
+  };
+
+  uint32_t magic;
+  uint32_t version;
+  uint32_t realSize;
+  uint32_t reserved;
+  uint64_t checksum;
+  uint64_t offsets[SECTION_COUNT];
+  uint32_t counts[SECTION_COUNT];
+};
+
+static_assert(sizeof(SceneCacheHeader) == 96, "Scene cache headers are hashed byte by byte and must not have padding");
+
+struct SceneCacheNode {
+  uint32_t type;
+  uint32_t shape;
+  uint32_t escape;
+  uint32_t leaf;
+};
+
+/**
+ * Binary cache of a compiled LinearBvh - the copied shapes of a level and the tree over them - so that startup maps a file instead of
+ * constructing every geometry and building the tree again.
+ *
+ * The file is memory mapped and checked once (header, section bounds, checksum). Loading then goes array by array straight from the mapping:
+ * one allocation per array of the bvh and no per object allocation or parsing. Shapes are polymorphic and cannot be used from the mapping as
+ * they are, so they are constructed in place from their reals. Loaded leaves have no source geometry: contacts reference the bvh shapes.
+ *
+ * Bvhs with shapes kept by reference (hierarchies as leaves, height maps, frustums) cannot be cached. POSIX only (mmap).
+ */
+class SceneCache {
+  int file = -1;
+  const unsigned char *mapping = nullptr;
+  std::size_t mappingSize = 0;
+  SceneCacheHeader header {};
+
+public:
+  /**
+   * Opens, maps and checks the file. Check isOpen() for errors, including a checksum mismatch.
+   */
+  SceneCache(const String &path) {
+    if(!open(path)) {
+      close();
+    }
+  }
+
+  SceneCache(const SceneCache &) = delete;
+  SceneCache &operator=(const SceneCache &) = delete;
+
+  ~SceneCache() {
+    close();
+  }
+
+  /**
+   * Returns false on io errors, or if the bvh references shapes it does not own.
+   */
+  static bool write(const String &path, const LinearBvh &bvh) {
+    if(!bvh.others.empty()) {
+      return false;
+    }
+
+    SceneCacheHeader header {SceneCacheHeader::MAGIC, SceneCacheHeader::VERSION, (uint32_t)sizeof(real), 0, 0, {}, {}};
+    header.counts[SceneCacheHeader::NODES] = bvh.nodes.size();
+    header.counts[SceneCacheHeader::SPHERES] = bvh.spheres.size();
+    header.counts[SceneCacheHeader::AABBS] = bvh.aabbs.size();
+    header.counts[SceneCacheHeader::OOBBS] = bvh.oobbs.size();
+    header.counts[SceneCacheHeader::PLANES] = bvh.planes.size();
+    header.counts[SceneCacheHeader::LINES] = bvh.lines.size();
+
+    std::size_t size = sizeof(SceneCacheHeader);
+    for(unsigned int section = 0; section < SceneCacheHeader::SECTION_COUNT; section++) {
+      size = align(size);
+      header.offsets[section] = size;
+      size += (std::size_t)header.counts[section] * recordSize(section);
+    }
+
+    std::vector<unsigned char> contents(size, 0);
+    SceneCacheNode *nodes = (SceneCacheNode *)(contents.data() + header.offsets[SceneCacheHeader::NODES]);
+    for(unsigned int index = 0; index < bvh.nodes.size(); index++) {
+      const LinearBvh::Node &node = bvh.nodes[index];
+      nodes[index] = SceneCacheNode {(uint32_t)node.type, node.shape, node.escape, node.leaf ? 1u : 0u};
+    }
+
+    real *spheres = records(contents.data(), header, SceneCacheHeader::SPHERES);
+    for(const Sphere &sphere : bvh.spheres) {
+      spheres = store(store(spheres, sphere.getOrigin()), sphere.getRadius());
+    }
+    real *aabbs = records(contents.data(), header, SceneCacheHeader::AABBS);
+    for(const AABB &aabb : bvh.aabbs) {
+      aabbs = store(store(aabbs, aabb.getOrigin()), aabb.getHalfSizes());
+    }
+    real *oobbs = records(contents.data(), header, SceneCacheHeader::OOBBS);
+    for(const OOBB &oobb : bvh.oobbs) {
+      oobbs = store(store(store(store(store(oobbs, oobb.getOrigin()), oobb.getHalfSizes()), oobb.getAxis(0)), oobb.getAxis(1)), oobb.getAxis(2));
+    }
+    real *planes = records(contents.data(), header, SceneCacheHeader::PLANES);
+    for(const Plane &plane : bvh.planes) {
+      planes = store(store(planes, plane.getOrigin()), plane.getNormal());
+    }
+    real *lines = records(contents.data(), header, SceneCacheHeader::LINES);
+    for(const Line &line : bvh.lines) {
+      lines = store(store(lines, line.getOrigin()), line.getDirection());
+    }
+
+    memcpy(contents.data(), &header, sizeof(header));
+    header.checksum = fileChecksum(contents.data(), size);
+    memcpy(contents.data(), &header, sizeof(header));
+
+    FILE *output = fopen(path.c_str(), "wb");
+    if(output == nullptr) {
+      return false;
+    }
+    bool written = fwrite(contents.data(), 1, size, output) == size;
+    return fclose(output) == 0 && written;
+  }
+
+  bool isOpen() const {
+    return mapping != nullptr;
+  }
+
+  unsigned int getNodeCount() const {
+    return header.counts[SceneCacheHeader::NODES];
+  }
+
+  uint64_t getChecksum() const {
+    return header.checksum;
+  }
+
+  std::size_t getFileSize() const {
+    return mappingSize;
+  }
+
+  /**
+   * Replaces the contents of bvh with the cached one. Returns false if the cache is not open or nodes reference shapes out of range.
+   */
+  bool load(LinearBvh &bvh) const {
+    bvh.clear();
+    if(!isOpen()) {
+      return false;
+    }
+
+    const SceneCacheNode *nodes = (const SceneCacheNode *)(mapping + header.offsets[SceneCacheHeader::NODES]);
+    unsigned int nodeCount = header.counts[SceneCacheHeader::NODES];
+    bvh.nodes.reserve(nodeCount);
+    for(unsigned int index = 0; index < nodeCount; index++) {
+      const SceneCacheNode &node = nodes[index];
+      int section = shapeSection(node.type);
+      if(section < 0 || node.shape >= header.counts[section] || node.escape <= index || node.escape > nodeCount) {
+        bvh.clear();
+        return false;
+      }
+
+      bvh.nodes.emplace_back((GeometryType)node.type, node.shape);
+      bvh.nodes.back().escape = node.escape;
+      bvh.nodes.back().leaf = node.leaf != 0;
+    }
+
+    const real *spheres = records(mapping, header, SceneCacheHeader::SPHERES);
+    bvh.spheres.reserve(header.counts[SceneCacheHeader::SPHERES]);
+    for(unsigned int index = 0; index < header.counts[SceneCacheHeader::SPHERES]; index++, spheres += 4) {
+      bvh.spheres.emplace_back(vector(spheres[0], spheres[1], spheres[2]), spheres[3]);
+    }
+
+    const real *aabbs = records(mapping, header, SceneCacheHeader::AABBS);
+    bvh.aabbs.reserve(header.counts[SceneCacheHeader::AABBS]);
+    for(unsigned int index = 0; index < header.counts[SceneCacheHeader::AABBS]; index++, aabbs += 6) {
+      bvh.aabbs.emplace_back(vector(aabbs[0], aabbs[1], aabbs[2]), vector(aabbs[3], aabbs[4], aabbs[5]));
+    }
+
+    const real *oobbs = records(mapping, header, SceneCacheHeader::OOBBS);
+    bvh.oobbs.reserve(header.counts[SceneCacheHeader::OOBBS]);
+    for(unsigned int index = 0; index < header.counts[SceneCacheHeader::OOBBS]; index++, oobbs += 15) {
+      bvh.oobbs.emplace_back(vector(oobbs[0], oobbs[1], oobbs[2]), vector(oobbs[3], oobbs[4], oobbs[5]), vector(oobbs[6], oobbs[7], oobbs[8]),
+          vector(oobbs[9], oobbs[10], oobbs[11]));
+    }
+
+    const real *planes = records(mapping, header, SceneCacheHeader::PLANES);
+    bvh.planes.reserve(header.counts[SceneCacheHeader::PLANES]);
+    for(unsigned int index = 0; index < header.counts[SceneCacheHeader::PLANES]; index++, planes += 6) {
+      bvh.planes.emplace_back(vector(planes[0], planes[1], planes[2]), vector(planes[3], planes[4], planes[5]));
+      bvh.planes.back().setNormal(vector(planes[3], planes[4], planes[5])); // as written, without normalizing again
+    }
+
+    const real *lines = records(mapping, header, SceneCacheHeader::LINES);
+    bvh.lines.reserve(header.counts[SceneCacheHeader::LINES]);
+    for(unsigned int index = 0; index < header.counts[SceneCacheHeader::LINES]; index++, lines += 6) {
+      bvh.lines.emplace_back(vector(lines[0], lines[1], lines[2]), vector(lines[3], lines[4], lines[5]));
+    }
+
+    return true;
+  }
+
+  /**
+   * Validation pass: same nodes, and same shapes up to a few ulps - oobb axes and line directions are orthonormalized again when loaded.
+   */
+  static bool validate(const LinearBvh &loaded, const LinearBvh &original) {
+    if(loaded.nodes.size() != original.nodes.size() || loaded.spheres.size() != original.spheres.size() || loaded.aabbs.size() != original.aabbs.size()
+        || loaded.oobbs.size() != original.oobbs.size() || loaded.planes.size() != original.planes.size() || loaded.lines.size() != original.lines.size()) {
+      return false;
+    }
+
+    for(unsigned int index = 0; index < loaded.nodes.size(); index++) {
+      const LinearBvh::Node &node = loaded.nodes[index];
+      const LinearBvh::Node &originalNode = original.nodes[index];
+      if(node.type != originalNode.type || node.shape != originalNode.shape || node.escape != originalNode.escape || node.leaf != originalNode.leaf) {
+        return false;
+      }
+    }
+
+    for(unsigned int index = 0; index < loaded.spheres.size(); index++) {
+      if(!same(loaded.spheres[index].getOrigin(), original.spheres[index].getOrigin()) || !same(loaded.spheres[index].getRadius(), original.spheres[index].getRadius())) {
+        return false;
+      }
+    }
+    for(unsigned int index = 0; index < loaded.aabbs.size(); index++) {
+      if(!same(loaded.aabbs[index].getOrigin(), original.aabbs[index].getOrigin()) || !same(loaded.aabbs[index].getHalfSizes(), original.aabbs[index].getHalfSizes())) {
+        return false;
+      }
+    }
+    for(unsigned int index = 0; index < loaded.oobbs.size(); index++) {
+      const OOBB &oobb = loaded.oobbs[index];
+      const OOBB &originalOobb = original.oobbs[index];
+      if(!same(oobb.getOrigin(), originalOobb.getOrigin()) || !same(oobb.getHalfSizes(), originalOobb.getHalfSizes()) || !same(oobb.getAxis(0), originalOobb.getAxis(0))
+          || !same(oobb.getAxis(1), originalOobb.getAxis(1)) || !same(oobb.getAxis(2), originalOobb.getAxis(2))) {
+        return false;
+      }
+    }
+    for(unsigned int index = 0; index < loaded.planes.size(); index++) {
+      if(!same(loaded.planes[index].getOrigin(), original.planes[index].getOrigin()) || !same(loaded.planes[index].getNormal(), original.planes[index].getNormal())) {
+        return false;
+      }
+    }
+    for(unsigned int index = 0; index < loaded.lines.size(); index++) {
+      if(!same(loaded.lines[index].getOrigin(), original.lines[index].getOrigin()) || !same(loaded.lines[index].getDirection(), original.lines[index].getDirection())) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  /**
+   * 64 bit hash of data: four interleaved multiply / xor-shift lanes over 8 byte words, then the remaining bytes. Detects truncated and
+   * corrupted files at memory bandwidth rather than byte by byte.
+   */
+  static uint64_t checksum(const unsigned char *data, std::size_t size) {
+    const uint64_t prime = 0x100000001b3ull;
+    uint64_t lanes[4] = {0xcbf29ce484222325ull, 0x84222325cbf29ce4ull, 0x9ce484222325cbf2ull, 0x2325cbf29ce48422ull};
+
+    std::size_t index = 0;
+    for(; index + 32 <= size; index += 32) {
+      for(unsigned int lane = 0; lane < 4; lane++) {
+        uint64_t word;
+        memcpy(&word, data + index + lane * 8, 8);
+        lanes[lane] = mix(lanes[lane], word, prime);
+      }
+    }
+
+    uint64_t hash = lanes[0];
+    for(unsigned int lane = 1; lane < 4; lane++) {
+      hash = mix(hash, lanes[lane], prime);
+    }
+    for(; index < size; index++) {
+      hash = mix(hash, data[index], prime);
+    }
+    return mix(hash, size, prime);
+  }
+
+protected:
+  /**
+   * Checksum of a whole file, hashing its header with the checksum field zeroed
+   */
+  static uint64_t fileChecksum(const unsigned char *contents, std::size_t size) {
+    SceneCacheHeader header;
+    memcpy(&header, contents, sizeof(header));
+    header.checksum = 0;
+    return mix(checksum((const unsigned char *)&header, sizeof(header)), checksum(contents + sizeof(header), size - sizeof(header)), 0x100000001b3ull);
+  }
+
+  bool open(const String &path) {
+    file = ::open(path.c_str(), O_RDONLY);
+    struct stat status;
+    if(file < 0 || fstat(file, &status) != 0 || (std::size_t)status.st_size < sizeof(SceneCacheHeader)) {
+      return false;
+    }
+
+    mappingSize = status.st_size;
+#ifdef MAP_POPULATE
+    int flags = MAP_SHARED | MAP_POPULATE; // every page is read by the checksum, map them all at once rather than fault them one by one
+#else
+    int flags = MAP_SHARED;
+#endif
+    void *address = mmap(nullptr, mappingSize, PROT_READ, flags, file, 0);
+    if(address == MAP_FAILED) {
+      return false;
+    }
+    mapping = (const unsigned char *)address;
+    madvise((void *)mapping, mappingSize, MADV_SEQUENTIAL); // checked and loaded front to back
+
+    memcpy(&header, mapping, sizeof(header));
+    if(header.magic != SceneCacheHeader::MAGIC || header.version != SceneCacheHeader::VERSION || header.realSize != sizeof(real)) {
+      return false;
+    }
+
+    for(unsigned int section = 0; section < SceneCacheHeader::SECTION_COUNT; section++) {
+      if(header.offsets[section] % SceneCacheHeader::ALIGNMENT != 0 || header.offsets[section] < sizeof(SceneCacheHeader)
+          || header.offsets[section] > mappingSize || (mappingSize - header.offsets[section]) / recordSize(section) < header.counts[section]) {
+        return false;
+      }
+    }
+
+    return fileChecksum(mapping, mappingSize) == header.checksum;
+  }
+
+  void close() {
+    if(mapping != nullptr) {
+      munmap((void *)mapping, mappingSize);
+      mapping = nullptr;
+    }
+    if(file >= 0) {
+      ::close(file);
+      file = -1;
+    }
+    header = SceneCacheHeader {};
+  }
+
+  static std::size_t align(std::size_t offset) {
+    return (offset + SceneCacheHeader::ALIGNMENT - 1) / SceneCacheHeader::ALIGNMENT * SceneCacheHeader::ALIGNMENT;
+  }
+
+  static std::size_t recordSize(unsigned int section) {
+    switch(section) {
+      case SceneCacheHeader::NODES:
+        return sizeof(SceneCacheNode);
+      case SceneCacheHeader::SPHERES:
+        return 4 * sizeof(real);
+      case SceneCacheHeader::OOBBS:
+        return 15 * sizeof(real);
+      default:
+        return 6 * sizeof(real);
+    }
+  }
+
+  /**
+   * Section holding shapes of the given node type, -1 for types that cannot be cached
+   */
+  static int shapeSection(uint32_t type) {
+    switch((GeometryType)type) {
+      case GeometryType::SPHERE:
+        return SceneCacheHeader::SPHERES;
+      case GeometryType::AABB:
+        return SceneCacheHeader::AABBS;
+      case GeometryType::OOBB:
+        return SceneCacheHeader::OOBBS;
+      case GeometryType::PLANE:
+        return SceneCacheHeader::PLANES;
+      case GeometryType::LINE:
+        return SceneCacheHeader::LINES;
+      default:
+        return -1;
+    }
+  }
+
+  static real *records(unsigned char *contents, const SceneCacheHeader &header, unsigned int section) {
+    return (real *)(contents + header.offsets[section]);
+  }
+
+  static const real *records(const unsigned char *contents, const SceneCacheHeader &header, unsigned int section) {
+    return (const real *)(contents + header.offsets[section]);
+  }
+
+  static real *store(real *output, const vector &value) {
+    output[0] = value.x;
+    output[1] = value.y;
+    output[2] = value.z;
+    return output + 3;
+  }
+
+  static real *store(real *output, real value) {
+    output[0] = value;
+    return output + 1;
+  }
+
+  static uint64_t mix(uint64_t hash, uint64_t value, uint64_t prime) {
+    hash = (hash ^ value) * prime;
+    return hash ^ (hash >> 29);
+  }
+
+  static bool same(real value, real other) {
+    return std::abs(value - other) <= std::max((real)1, std::max(std::abs(value), std::abs(other))) * std::numeric_limits<real>::epsilon() * 8;
+  }
+
+  static bool same(const vector &value, const vector &other) {
+    return same(value.x, other.x) && same(value.y, other.y) && same(value.z, other.z);
+  }
+};
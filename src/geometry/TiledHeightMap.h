@@ -0,0 +1,591 @@
+/*
+ * TiledHeightMap.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: leandro
+ */
+
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "Geometry.h"
+
+/**
+ * Header of tiled height map files, followed by the tiles in row major order (rows of tiles along z). Native endianness.
+ *
+ * Tiles cover tileCells x tileCells cells and store the (tileCells + 1) x (tileCells + 1) samples around them as 32 bit floats, row major -
+ * samples on tile borders are repeated in both tiles, so a cell never spans two tiles. Tiles past the grid border are padded with the border samples.
+ */
+struct TiledHeightMapHeader {
+  static constexpr uint32_t MAGIC = 0x544d4847; // "GHMT"
+  static constexpr uint32_t VERSION = 1;
+
+  uint32_t magic;
+  uint32_t version;
+  uint32_t columns;
+  uint32_t rows;
+  uint32_t tileCells;
+  float cellSize;
+  float maxHeight;
+  uint32_t reserved;
+};
+
+/**
+ * Height map streamed from a tiled file (see TiledHeightMapHeader), for terrains larger than we want resident.
+ *
+ * The file is memory mapped and tiles are decoded to real on first use into an LRU cache bounded by a memory budget. Pages of the mapping are
+ * released back to the OS once their tile is decoded, so resident memory stays around the budget however large the file is.
+ * A background thread loads tiles ahead of queries: neighbours of every tile loaded on demand, plus tiles requested with prefetch(),
+ * e.g. around a vehicle or camera, so that queries rarely wait for a load. Prefetched tiles have their own share of the budget until a query
+ * reads them: speculative loads evict older speculative loads rather than the tiles queries are using, and a full cache keeps prefetching.
+ *
+ * Surface and normals are the same as GridHeightMap over the same samples, and it can be used anywhere a HeightMap is.
+ * Thread safe: queries from ParallelCollisionTester workers share the cache. Through a HeightMapGeometry, this height map gets the generic
+ * height map tests: ray casts march cell by cell over heightAt instead of descending a min-max pyramid, with the same hits.
+ *
+ * POSIX only (mmap).
+ */
+class TiledHeightMap final : public HeightMap {
+  typedef std::shared_ptr<const std::vector<real>> Tile;
+  static constexpr unsigned int NONE = (unsigned int)-1;
+
+  int file = -1;
+  const unsigned char *mapping = nullptr;
+  std::size_t mappingSize = 0;
+  TiledHeightMapHeader header {};
+  unsigned int tileColumns = 0;
+  unsigned int tileRows = 0;
+  unsigned int tileStride = 0;
+  real cellSize = 1;
+  real inverseCellSize = 1;
+  std::size_t budget;
+  std::size_t prefetchBudget = 0;
+
+  struct LruList {
+    unsigned int newest = NONE;
+    unsigned int oldest = NONE;
+    unsigned int size = 0;
+  };
+
+  /**
+   * Residency cache: decoded tiles and intrusive LRU lists over tile indices - tiles queries read, and prefetched tiles not read yet
+   */
+  mutable std::mutex mutex;
+  mutable std::vector<Tile> tiles;
+  mutable std::vector<unsigned int> newer;
+  mutable std::vector<unsigned int> older;
+  mutable std::vector<bool> unread;
+  mutable LruList used;
+  mutable LruList prefetched;
+  mutable unsigned long misses = 0;
+  mutable unsigned long prefetches = 0;
+
+  mutable std::deque<unsigned int> prefetchQueue;
+  mutable std::vector<bool> queued;
+  mutable std::condition_variable prefetchAvailable;
+  mutable bool loading = false;
+  bool stopping = false;
+  std::thread prefetchThread;
+
+public:
+  /**
+   * Opens and maps the file. budget is the memory, in bytes, allowed for decoded tiles - at least one tile is kept. prefetchBudget is the
+   * part of it prefetched tiles may hold until read, a quarter by default - at most all but one tile, and prefetching is off below one tile.
+   * Check isOpen() for errors.
+   */
+  TiledHeightMap(const String &path, std::size_t budget = 64 << 20, std::size_t prefetchBudget = (std::size_t)-1) {
+    this->budget = budget;
+
+    if(!open(path)) {
+      close();
+      return;
+    }
+
+    std::size_t maximumPrefetchBudget = budget > getTileBytes() ? budget - getTileBytes() : 0;
+    this->prefetchBudget = std::min(prefetchBudget == (std::size_t)-1 ? budget / 4 : prefetchBudget, maximumPrefetchBudget);
+
+    unsigned int tileCount = tileColumns * tileRows;
+    tiles.resize(tileCount);
+    newer.resize(tileCount, NONE);
+    older.resize(tileCount, NONE);
+    unread.resize(tileCount, false);
+    queued.resize(tileCount, false);
+    prefetchThread = std::thread(&TiledHeightMap::prefetchLoop, this);
+  }
+
+  TiledHeightMap(const TiledHeightMap &) = delete;
+  TiledHeightMap &operator=(const TiledHeightMap &) = delete;
+
+  ~TiledHeightMap() {
+    if(prefetchThread.joinable()) {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+      }
+      prefetchAvailable.notify_all();
+      prefetchThread.join();
+    }
+
+    close();
+  }
+
+  /**
+   * Writes samples (row major grid of columns x rows, at least 2 x 2) to a tiled height map file. Returns false on io errors, on grids
+   * smaller than 2 x 2, with fewer samples than columns x rows, or with empty tiles.
+   */
+  static bool write(const String &path, unsigned int columns, unsigned int rows, real cellSize, const std::vector<real> &samples, unsigned int tileCells = 64) {
+    if(columns < 2 || rows < 2 || tileCells == 0 || samples.size() < (std::size_t)columns * rows) {
+      return false;
+    }
+
+    FILE *output = fopen(path.c_str(), "wb");
+    if(output == nullptr) {
+      return false;
+    }
+
+    TiledHeightMapHeader header {TiledHeightMapHeader::MAGIC, TiledHeightMapHeader::VERSION, columns, rows, tileCells, (float)cellSize, 0, 0};
+    for(real sample : samples) {
+      header.maxHeight = std::max(header.maxHeight, (float)sample);
+    }
+    bool written = fwrite(&header, sizeof(header), 1, output) == 1;
+
+    unsigned int tileColumns = (columns - 2) / tileCells + 1;
+    unsigned int tileRows = (rows - 2) / tileCells + 1;
+    std::vector<float> tile((tileCells + 1) * (tileCells + 1));
+    for(unsigned int tileRow = 0; tileRow < tileRows && written; tileRow++) {
+      for(unsigned int tileColumn = 0; tileColumn < tileColumns && written; tileColumn++) {
+        for(unsigned int row = 0; row <= tileCells; row++) {
+          for(unsigned int column = 0; column <= tileCells; column++) {
+            unsigned int sampleColumn = std::min(tileColumn * tileCells + column, columns - 1);
+            unsigned int sampleRow = std::min(tileRow * tileCells + row, rows - 1);
+            tile[row * (tileCells + 1) + column] = (float)samples[sampleRow * columns + sampleColumn];
+          }
+        }
+        written = fwrite(tile.data(), sizeof(float), tile.size(), output) == tile.size();
+      }
+    }
+
+    return fclose(output) == 0 && written;
+  }
+
+  bool isOpen() const {
+    return mapping != nullptr;
+  }
+
+  real getWidth() const override {
+    return (header.columns - 1) * cellSize;
+  }
+
+  real getHeight() const override {
+    return header.maxHeight;
+  }
+
+  real getDepth() const override {
+    return (header.rows - 1) * cellSize;
+  }
+
+  unsigned int getColumns() const {
+    return header.columns;
+  }
+
+  unsigned int getRows() const {
+    return header.rows;
+  }
+
+  real getCellSize() const override {
+    return cellSize;
+  }
+
+  unsigned int getTileCells() const {
+    return header.tileCells;
+  }
+
+  unsigned int getTileCount() const {
+    return tileColumns * tileRows;
+  }
+
+  std::size_t getTileBytes() const {
+    return tileStride * tileStride * sizeof(real);
+  }
+
+  std::size_t getBudget() const {
+    return budget;
+  }
+
+  std::size_t getPrefetchBudget() const {
+    return prefetchBudget;
+  }
+
+  unsigned int getResidentTileCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return used.size + prefetched.size;
+  }
+
+  bool isResident(unsigned int tileColumn, unsigned int tileRow) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return tiles[tileRow * tileColumns + tileColumn] != nullptr;
+  }
+
+  /**
+   * Number of tiles a query had to load itself
+   */
+  unsigned long getMissCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return misses;
+  }
+
+  /**
+   * Number of tiles loaded by the prefetch thread
+   */
+  unsigned long getPrefetchCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return prefetches;
+  }
+
+  real heightAt(real x, real z) const override {
+    if(!isOpen()) {
+      return 0;
+    }
+
+    unsigned int tileIndex, sample;
+    real u, v;
+    locate(x, z, tileIndex, sample, u, v);
+    Tile tile = acquire(tileIndex);
+    return interpolate(tile->data() + sample, u, v);
+  }
+
+  vector normalAt(real x, real z) const override {
+    if(!isOpen()) {
+      return vector(0, 1, 0);
+    }
+
+    unsigned int tileIndex, sample;
+    real u, v;
+    locate(x, z, tileIndex, sample, u, v);
+    Tile tile = acquire(tileIndex);
+    const real *cell = tile->data() + sample;
+
+    if(u + v <= 1) {
+      return vector(cell[0] - cell[1], cellSize, cell[0] - cell[tileStride]).normalizado();
+    }
+    return vector(cell[tileStride] - cell[tileStride + 1], cellSize, cell[1] - cell[tileStride + 1]).normalizado();
+  }
+
+  /**
+   * Takes the cache lock once per run of points in the same tile instead of once per point
+   */
+  void heightsAt(const real *x, const real *z, unsigned int count, real *heights) const override {
+    if(!isOpen()) {
+      std::fill(heights, heights + count, 0);
+      return;
+    }
+
+    Tile tile;
+    unsigned int currentTile = NONE;
+    for(unsigned int index = 0; index < count; index++) {
+      unsigned int tileIndex, sample;
+      real u, v;
+      locate(x[index], z[index], tileIndex, sample, u, v);
+      if(tileIndex != currentTile) {
+        tile = acquire(tileIndex);
+        currentTile = tileIndex;
+      }
+      heights[index] = interpolate(tile->data() + sample, u, v);
+    }
+  }
+
+  /**
+   * Queues loading, in the background, of tiles within radius of local point (x, z) that are not resident yet
+   */
+  void prefetch(real x, real z, real radius) const {
+    if(!isOpen()) {
+      return;
+    }
+
+    real tileSize = header.tileCells * cellSize;
+    int minColumn = std::max(0, (int)std::floor((x - radius) / tileSize));
+    int maxColumn = std::min((int)tileColumns - 1, (int)std::floor((x + radius) / tileSize));
+    int minRow = std::max(0, (int)std::floor((z - radius) / tileSize));
+    int maxRow = std::min((int)tileRows - 1, (int)std::floor((z + radius) / tileSize));
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      for(int row = minRow; row <= maxRow; row++) {
+        for(int column = minColumn; column <= maxColumn; column++) {
+          enqueue(row * tileColumns + column);
+        }
+      }
+    }
+    prefetchAvailable.notify_one();
+  }
+
+  /**
+   * Blocks until the prefetch queue is empty - mostly for tests and loading screens
+   */
+  void waitForPrefetch() const {
+    while(true) {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if(prefetchQueue.empty() && !loading) {
+          return;
+        }
+      }
+      std::this_thread::yield();
+    }
+  }
+
+  String toString() const override {
+    return "TiledHeightMap(columns: " + std::to_string(header.columns) + ", rows: " + std::to_string(header.rows) + ", tileCells: " + std::to_string(header.tileCells) + ")";
+  }
+
+protected:
+  bool open(const String &path) {
+    file = ::open(path.c_str(), O_RDONLY);
+    struct stat status;
+    if(file < 0 || fstat(file, &status) != 0 || (std::size_t)status.st_size < sizeof(TiledHeightMapHeader)) {
+      return false;
+    }
+
+    mappingSize = status.st_size;
+    void *address = mmap(nullptr, mappingSize, PROT_READ, MAP_SHARED, file, 0);
+    if(address == MAP_FAILED) {
+      return false;
+    }
+    mapping = (const unsigned char *)address;
+
+    memcpy(&header, mapping, sizeof(header));
+    if(header.magic != TiledHeightMapHeader::MAGIC || header.version != TiledHeightMapHeader::VERSION || header.columns < 2 || header.rows < 2 ||
+        header.tileCells == 0 || !(header.cellSize > 0)) {
+      return false;
+    }
+
+    tileColumns = (header.columns - 2) / header.tileCells + 1;
+    tileRows = (header.rows - 2) / header.tileCells + 1;
+    tileStride = header.tileCells + 1;
+    if(mappingSize < sizeof(header) + (std::size_t)tileColumns * tileRows * tileStride * tileStride * sizeof(float)) {
+      return false;
+    }
+
+    cellSize = header.cellSize;
+    inverseCellSize = 1.0 / cellSize;
+    madvise((void *)mapping, mappingSize, MADV_RANDOM); // tiles are read in query order, not file order
+    return true;
+  }
+
+  void close() {
+    if(mapping != nullptr) {
+      munmap((void *)mapping, mappingSize);
+      mapping = nullptr;
+    }
+    if(file >= 0) {
+      ::close(file);
+      file = -1;
+    }
+    header = TiledHeightMapHeader {};
+    tileColumns = tileRows = 0;
+  }
+
+  /**
+   * Tile and first sample of the cell containing local point (x, z), clamped to the grid, and the position within the cell in [0, 1]
+   */
+  void locate(real x, real z, unsigned int &tileIndex, unsigned int &sample, real &u, real &v) const {
+    real gridX = std::max((real)0, std::min(x * inverseCellSize, (real)(header.columns - 1)));
+    real gridZ = std::max((real)0, std::min(z * inverseCellSize, (real)(header.rows - 1)));
+
+    unsigned int column = std::min((unsigned int)gridX, header.columns - 2);
+    unsigned int row = std::min((unsigned int)gridZ, header.rows - 2);
+    u = gridX - column;
+    v = gridZ - row;
+
+    tileIndex = (row / header.tileCells) * tileColumns + column / header.tileCells;
+    sample = (row % header.tileCells) * tileStride + column % header.tileCells;
+  }
+
+  real interpolate(const real *cell, real u, real v) const {
+    if(u + v <= 1) {
+      return cell[0] + (cell[1] - cell[0]) * u + (cell[tileStride] - cell[0]) * v;
+    }
+    return cell[tileStride + 1] + (cell[tileStride] - cell[tileStride + 1]) * (1 - u) + (cell[1] - cell[tileStride + 1]) * (1 - v);
+  }
+
+  /**
+   * Returns the tile, loading it on a miss. The shared pointer keeps it alive while in use, even if it is evicted meanwhile.
+   */
+  Tile acquire(unsigned int tileIndex) const {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if(tiles[tileIndex] != nullptr) {
+        touch(tileIndex);
+        return tiles[tileIndex];
+      }
+      misses++;
+    }
+
+    Tile tile = decode(tileIndex); // outside the lock, other threads keep querying resident tiles
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      tile = insert(tileIndex, tile);
+
+      unsigned int tileColumn = tileIndex % tileColumns;
+      unsigned int tileRow = tileIndex / tileColumns;
+      for(unsigned int row = tileRow == 0 ? 0 : tileRow - 1; row <= std::min(tileRow + 1, tileRows - 1); row++) {
+        for(unsigned int column = tileColumn == 0 ? 0 : tileColumn - 1; column <= std::min(tileColumn + 1, tileColumns - 1); column++) {
+          enqueue(row * tileColumns + column);
+        }
+      }
+    }
+    prefetchAvailable.notify_one();
+
+    return tile;
+  }
+
+  Tile decode(unsigned int tileIndex) const {
+    std::size_t tileSize = tileStride * tileStride * sizeof(float);
+    const unsigned char *source = mapping + sizeof(TiledHeightMapHeader) + tileIndex * tileSize;
+
+    std::shared_ptr<std::vector<real>> tile = std::make_shared<std::vector<real>>(tileStride * tileStride);
+    const float *samples = (const float *)source;
+    for(unsigned int index = 0; index < tile->size(); index++) {
+      (*tile)[index] = samples[index];
+    }
+
+    // pages fully inside the tile go back to the OS, they are read again from the file if the tile is ever reloaded
+    std::size_t pageSize = sysconf(_SC_PAGESIZE);
+    std::size_t begin = ((source - mapping) + pageSize - 1) / pageSize * pageSize;
+    std::size_t end = (source - mapping + tileSize) / pageSize * pageSize;
+    if(begin < end) {
+      madvise((void *)(mapping + begin), end - begin, MADV_DONTNEED);
+    }
+
+    return tile;
+  }
+
+  /**
+   * Adds a decoded tile, unless another thread got it first, and evicts least recently used tiles past the budget. Called with the lock held.
+   *
+   * Prefetched tiles stay in their own list, within the prefetch budget, until a query reads them: past that budget a prefetch evicts the
+   * oldest unread prefetch. Past the whole budget, read tiles are evicted first - unread prefetches only when no other read tile is left.
+   */
+  Tile insert(unsigned int tileIndex, const Tile &tile, bool prefetch = false) const {
+    if(tiles[tileIndex] != nullptr) {
+      if(!prefetch) {
+        touch(tileIndex);
+      }
+      return tiles[tileIndex];
+    }
+
+    tiles[tileIndex] = tile;
+    unread[tileIndex] = prefetch;
+    link(prefetch ? prefetched : used, tileIndex);
+
+    while(prefetched.size > 1 && prefetched.size * getTileBytes() > prefetchBudget) {
+      evict(prefetched, prefetched.oldest); // the newest is the tile just loaded, if it was prefetched
+    }
+    while(used.size + prefetched.size > 1 && (used.size + prefetched.size) * getTileBytes() > budget) {
+      LruList &list = used.size > (prefetch ? 0 : 1) ? used : prefetched; // not the tile just loaded: newest of its list, which has others
+      evict(list, list.oldest);
+    }
+
+    return tile;
+  }
+
+  void evict(LruList &list, unsigned int tileIndex) const {
+    unlink(list, tileIndex);
+    tiles[tileIndex].reset();
+    unread[tileIndex] = false;
+  }
+
+  void enqueue(unsigned int tileIndex) const {
+    if(tiles[tileIndex] == nullptr && !queued[tileIndex]) {
+      queued[tileIndex] = true;
+      prefetchQueue.push_back(tileIndex);
+    }
+  }
+
+  void link(LruList &list, unsigned int tileIndex) const {
+    older[tileIndex] = list.newest;
+    newer[tileIndex] = NONE;
+    if(list.newest != NONE) {
+      newer[list.newest] = tileIndex;
+    }
+    list.newest = tileIndex;
+    if(list.oldest == NONE) {
+      list.oldest = tileIndex;
+    }
+    list.size++;
+  }
+
+  void unlink(LruList &list, unsigned int tileIndex) const {
+    if(newer[tileIndex] != NONE) {
+      older[newer[tileIndex]] = older[tileIndex];
+    } else {
+      list.newest = older[tileIndex];
+    }
+    if(older[tileIndex] != NONE) {
+      newer[older[tileIndex]] = newer[tileIndex];
+    } else {
+      list.oldest = newer[tileIndex];
+    }
+    list.size--;
+  }
+
+  /**
+   * Marks a tile as read by a query, moving prefetched tiles to the list of read tiles
+   */
+  void touch(unsigned int tileIndex) const {
+    if(unread[tileIndex]) {
+      unlink(prefetched, tileIndex);
+      unread[tileIndex] = false;
+      link(used, tileIndex);
+    } else if(used.newest != tileIndex) {
+      unlink(used, tileIndex);
+      link(used, tileIndex);
+    }
+  }
+
+  void prefetchLoop() {
+    while(true) {
+      unsigned int tileIndex;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        prefetchAvailable.wait(lock, [this]() { return stopping || !prefetchQueue.empty(); });
+        if(stopping) {
+          return;
+        }
+        tileIndex = prefetchQueue.front();
+        prefetchQueue.pop_front();
+        queued[tileIndex] = false;
+        if(tiles[tileIndex] != nullptr || prefetchBudget < getTileBytes()) {
+          continue;
+        }
+        loading = true;
+      }
+
+      Tile tile = decode(tileIndex);
+
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if(tiles[tileIndex] == nullptr) {
+          prefetches++;
+        }
+        insert(tileIndex, tile, true);
+        loading = false;
+      }
+    }
+  }
+};
@@ -0,0 +1,113 @@
+/*
+ * Vector3.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: leandro
+ */
+
+#pragma once
+
+#include <cmath>
+#include <cstdio>
+#include <type_traits>
+#include "Math3d.h"
+
+/**
+ * Minimal 3d vector on scalar T, for geometries and kernels in a precision other than real (see ScalarVector). Same operators as the vector of
+ * the math dependency: + and - component wise, * dot product or scaling, ^ cross product.
+ */
+template<typename T> class Vector3 {
+public:
+  T x;
+  T y;
+  T z;
+
+  Vector3() : x(0), y(0), z(0) {
+  }
+
+  Vector3(T x, T y, T z) : x(x), y(y), z(z) {
+  }
+
+  Vector3 operator+(const Vector3 &other) const {
+    return Vector3(x + other.x, y + other.y, z + other.z);
+  }
+
+  Vector3 operator-(const Vector3 &other) const {
+    return Vector3(x - other.x, y - other.y, z - other.z);
+  }
+
+  T operator*(const Vector3 &other) const {
+    return x * other.x + y * other.y + z * other.z;
+  }
+
+  Vector3 operator*(T scale) const {
+    return Vector3(x * scale, y * scale, z * scale);
+  }
+
+  friend Vector3 operator*(T scale, const Vector3 &vector) {
+    return vector * scale;
+  }
+
+  Vector3 operator^(const Vector3 &other) const {
+    return Vector3(y * other.z - z * other.y, z * other.x - x * other.z, x * other.y - y * other.x);
+  }
+
+  bool operator==(const Vector3 &other) const {
+    return x == other.x && y == other.y && z == other.z;
+  }
+
+  T modulo() const {
+    return std::sqrt(x * x + y * y + z * z);
+  }
+
+  /**
+   * Unit vector in the same direction - zero vectors are returned as they are
+   */
+  Vector3 normalizado() const {
+    T length = modulo();
+    return length > 0 ? *this * ((T)1 / length) : *this;
+  }
+
+  String toString(const String &format = "%.2f") const {
+    char buffer[128];
+    String vectorFormat = "<" + format + ", " + format + ", " + format + ">";
+    snprintf(buffer, sizeof(buffer), vectorFormat.c_str(), (double)x, (double)y, (double)z);
+    return buffer;
+  }
+};
+
+/**
+ * Vector type of scalar T: the vector of the math dependency for real, so that real geometries keep using it, and Vector3<T> for other scalars
+ */
+template<typename T> struct ScalarVector {
+  typedef Vector3<T> type;
+};
+
+template<> struct ScalarVector<real> {
+  typedef vector type;
+};
+
+/**
+ * Scalar mixed precision kernels compute in: double for a double and a float operand
+ */
+template<typename T, typename U> using WiderScalar = typename std::common_type<T, U>::type;
+
+template<typename To, typename From> struct VectorCast {
+  static To cast(const From &from) {
+    return To(from.x, from.y, from.z);
+  }
+};
+
+template<typename To> struct VectorCast<To, To> {
+  static const To &cast(const To &from) {
+    return from;
+  }
+};
+
+/**
+ * Converts a vector into the vector type To, component by component. Vectors already of type To are returned as they are, without a copy,
+ * so kernels on operands of the same scalar compute exactly as they did before being templated.
+ */
+template<typename To, typename From> decltype(auto) vectorCast(const From &from) {
+  return VectorCast<To, From>::cast(from);
+}
@@ -1,6 +1,60 @@
 #include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+#include <random>
+#include <set>
+#include <functional>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <cstdio>
+#include <filesystem>
+#include <unistd.h>
 #include "Geometry.h"
 #include "CollisionTester.h"
+#include "StaticCollisionTester.h"
+#include "SweepAndPrune.h"
+#include "DynamicAabbTree.h"
+#include "SpatialHashGrid.h"
+#include "BatchIntersectionHelper.h"
+#include "FrustumCuller.h"
+#include "ContactBuffer.h"
+#include "ContactCache.h"
+#include "ParallelCollisionTester.h"
+#include "TiledHeightMap.h"
+#include "GjkEpa.h"
+#include "ContinuousCollisionTester.h"
+#include "MortonBvhBuilder.h"
+#include "SceneCache.h"
+#include "SeparationCache.h"
+
+/**
+ * Counts heap allocations, so tests can assert that a code path does not allocate.
+ * Allocates with malloc, same as the default operator new, so the default operator delete still releases this memory.
+ */
+static std::atomic<unsigned long> allocationCount(0);
+
+void *operator new(std::size_t size) {
+  allocationCount++;
+  void *memory = std::malloc(size == 0 ? 1 : size);
+  if(memory == nullptr) {
+    throw std::bad_alloc();
+  }
+  return memory;
+}
+
+/**
+ * File in the temporary directory, removed when the test case ends - including when a REQUIRE fails
+ */
+struct TemporaryFile {
+  String path;
+
+  TemporaryFile(const String &name) : path((std::filesystem::temp_directory_path() / (std::to_string(getpid()) + "_" + name)).string()) {
+  }
+
+  ~TemporaryFile() {
+    std::remove(path.c_str());
+  }
+};
 
 TEST_CASE("Geometry Test case")
 {
@@ -224,3 +278,2420 @@ TEST_CASE("Sphere Contacts")
   contacts = intersectionTester.detectCollision((Geometry&) sphere, (Geometry&) anotherSphere);
   REQUIRE(contacts.empty());
 }
+
+TEST_CASE("CollisionTester dispatch table")
+{
+  CollisionTester intersectionTester;
+  bool swapped;
+
+  CHECK(intersectionTester.getIntersectionTest(GeometryType::SPHERE, GeometryType::AABB, swapped) != nullptr);
+  CHECK(!swapped);
+  CHECK(intersectionTester.getIntersectionTest(GeometryType::AABB, GeometryType::SPHERE, swapped) != nullptr);
+  CHECK(swapped);
+  CHECK(intersectionTester.getIntersectionTest(GeometryType::SPHERE, GeometryType::SPHERE, swapped) != nullptr);
+  CHECK(!swapped);
+  CHECK(intersectionTester.getIntersectionTest(GeometryType::LINE, GeometryType::LINE, swapped) == nullptr);
+
+  CHECK(intersectionTester.getContactTest(GeometryType::HEIGHTMAP, GeometryType::SPHERE, swapped) != nullptr);
+  CHECK(swapped);
+
+  String description = intersectionTester.toString();
+  CHECK(description.find("SPHERE<->AABB") != String::npos);
+  CHECK(description.find("AABB<->SPHERE") == String::npos);
+
+  Line line(vector(0, 0, 0), vector(1, 0, 0));
+  CHECK(!intersectionTester.intersects(line, line));
+  CHECK(intersectionTester.detectCollision(line, line).empty());
+}
+
+TEST_CASE("Static dispatch matches CollisionTester")
+{
+  CollisionTester intersectionTester;
+
+  Sphere sphere(vector(-1, 0, 0), 2);
+  Sphere anotherSphere(vector(2, 1, 1), 2);
+  AABB aabb(vector(1, 0, 0), vector(1, 1, 1));
+  Plane plane(vector(0, 0, 0), vector(0, 1, 0));
+  Line line(vector(-5, 0, 0), vector(1, 0, 0));
+
+  CHECK(StaticCollisionTester::intersects(sphere, anotherSphere) == intersectionTester.intersects(sphere, anotherSphere));
+  CHECK(StaticCollisionTester::intersects<Sphere, AABB>(sphere, aabb));
+  CHECK(StaticCollisionTester::intersects(aabb, sphere));
+  CHECK(StaticCollisionTester::intersects(plane, sphere));
+  CHECK(StaticCollisionTester::intersects(sphere, plane));
+  CHECK(StaticCollisionTester::intersects(line, sphere) == intersectionTester.intersects(line, sphere));
+
+  std::vector<GeometryContact> staticContacts = StaticCollisionTester::detectCollision(sphere, anotherSphere);
+  std::vector<GeometryContact> runtimeContacts = intersectionTester.detectCollision(sphere, anotherSphere);
+  REQUIRE(staticContacts.size() == 1);
+  REQUIRE(runtimeContacts.size() == 1);
+  CHECK(staticContacts[0].getNormal() == runtimeContacts[0].getNormal());
+  CHECK(staticContacts[0].getPenetration() == runtimeContacts[0].getPenetration());
+  CHECK(staticContacts[0].getGeometryA() == runtimeContacts[0].getGeometryA());
+
+  CHECK(!StaticCollisionTester::supportsIntersection<Line, Line>());
+  CHECK(StaticCollisionTester::supportsContact<AABB, Sphere>());
+
+  typedef std::variant<Sphere, AABB, Line> Shape;
+  std::vector<Shape> shapes {sphere, aabb, line};
+  for(const Shape &shape : shapes) {
+    for(const Shape &anotherShape : shapes) {
+      const Geometry &geometry = std::visit([](const auto &g) -> const Geometry & { return g; }, shape);
+      const Geometry &anotherGeometry = std::visit([](const auto &g) -> const Geometry & { return g; }, anotherShape);
+      CHECK(StaticCollisionTester::intersects(shape, anotherShape) == intersectionTester.intersects(geometry, anotherGeometry));
+      CHECK(StaticCollisionTester::detectCollision(shape, anotherShape).size() == intersectionTester.detectCollision(geometry, anotherGeometry).size());
+    }
+  }
+  CHECK(StaticCollisionTester::intersects(sphere, shapes[1]));
+  CHECK(StaticCollisionTester::intersects(shapes[0], aabb));
+}
+
+TEST_CASE("Geometry bounds")
+{
+  Sphere sphere(vector(1, 2, 3), 2);
+  CHECK(sphere.getBounds().mins == vector(-1, 0, 1));
+  CHECK(sphere.getBounds().maxs == vector(3, 4, 5));
+
+  AABB aabb(vector(0, 0, 0), vector(1, 2, 3));
+  CHECK(aabb.getBounds().mins == vector(-1, -2, -3));
+  CHECK(aabb.getBounds().maxs == vector(1, 2, 3));
+
+  Plane plane(vector(0, 0, 0), vector(0, 1, 0));
+  CHECK(plane.getBounds().overlaps(sphere.getBounds()));
+  CHECK(sphere.getBounds().overlaps(aabb.getBounds()));
+  CHECK(!Bounds(vector(2, 2, 2), vector(3, 3, 3)).overlaps(aabb.getBounds()));
+  CHECK(Bounds(vector(1, 2, 3), vector(3, 3, 3)).overlaps(aabb.getBounds())); // touching
+}
+
+/**
+ * Brute force reference for broad phase tests: every pair of live geometries with overlapping bounds, ordered by index.
+ */
+static std::set<std::pair<const Geometry *, const Geometry *>> bruteForcePairs(const std::vector<std::unique_ptr<Geometry>> &geometries, const std::vector<bool> &alive) {
+  std::set<std::pair<const Geometry *, const Geometry *>> pairs;
+  for(unsigned int i = 0; i < geometries.size(); i++) {
+    for(unsigned int j = i + 1; j < geometries.size(); j++) {
+      if(alive[i] && alive[j] && geometries[i]->getBounds().overlaps(geometries[j]->getBounds())) {
+        pairs.insert(std::minmax(geometries[i].get(), geometries[j].get()));
+      }
+    }
+  }
+  return pairs;
+}
+
+TEST_CASE("Sweep and prune matches brute force")
+{
+  std::mt19937 random(1234);
+  std::uniform_real_distribution<real> position(-50, 50);
+  std::uniform_real_distribution<real> size(0.5, 3);
+  std::uniform_real_distribution<real> step(-2, 2);
+
+  std::vector<std::unique_ptr<Geometry>> geometries;
+  std::vector<unsigned int> proxies;
+  std::vector<bool> alive;
+  SweepAndPrune sweepAndPrune;
+
+  for(unsigned int index = 0; index < 400; index++) {
+    if(index % 2 == 0) {
+      geometries.emplace_back(new Sphere(vector(position(random), position(random), position(random)), size(random)));
+    } else {
+      geometries.emplace_back(new AABB(vector(position(random), position(random), position(random)), vector(size(random), size(random), size(random))));
+    }
+    proxies.push_back(sweepAndPrune.addGeometry(geometries.back().get()));
+    alive.push_back(true);
+  }
+  geometries.emplace_back(new Plane(vector(0, 0, 0), vector(0, 1, 0)));
+  proxies.push_back(sweepAndPrune.addGeometry(geometries.back().get()));
+  alive.push_back(true);
+
+  for(unsigned int frame = 0; frame < 30; frame++) {
+    sweepAndPrune.update();
+
+    std::set<std::pair<const Geometry *, const Geometry *>> pairs;
+    for(const BroadPhasePair &pair : sweepAndPrune.getPairs()) {
+      CHECK(pairs.insert(std::minmax(pair.getGeometryA(), pair.getGeometryB())).second);
+    }
+    CHECK(pairs == bruteForcePairs(geometries, alive));
+    CHECK(sweepAndPrune.getPairs().size() == sweepAndPrune.getPairCount());
+
+    for(unsigned int index = 0; index < 40; index++) {
+      unsigned int moved = random() % 400;
+      if(alive[moved]) {
+        geometries[moved]->setOrigin(geometries[moved]->getOrigin() + vector(step(random), step(random), step(random)));
+        sweepAndPrune.updateGeometry(proxies[moved]);
+      }
+    }
+
+    if(frame % 5 == 1) {
+      unsigned int removed = random() % 400;
+      if(alive[removed]) {
+        sweepAndPrune.removeGeometry(proxies[removed]);
+        alive[removed] = false;
+      }
+
+      geometries.emplace_back(new Sphere(vector(position(random), position(random), position(random)), size(random)));
+      proxies.push_back(sweepAndPrune.addGeometry(geometries.back().get()));
+      alive.push_back(true);
+    }
+  }
+
+  CollisionTester intersectionTester;
+  unsigned int intersections = 0;
+  for(const BroadPhasePair &pair : sweepAndPrune.getPairs()) {
+    intersections += intersectionTester.intersects(*pair.getGeometryA(), *pair.getGeometryB()) ? 1 : 0;
+  }
+  CHECK(intersections <= sweepAndPrune.getPairCount());
+}
+
+TEST_CASE("Dynamic aabb tree matches brute force")
+{
+  std::mt19937 random(4321);
+  std::uniform_real_distribution<real> position(-50, 50);
+  std::uniform_real_distribution<real> size(0.5, 3);
+  std::uniform_real_distribution<real> step(-1, 1);
+
+  std::vector<std::unique_ptr<Geometry>> geometries;
+  std::vector<int> leaves;
+  std::vector<bool> alive;
+  DynamicAabbTree tree(0.5);
+
+  for(unsigned int index = 0; index < 500; index++) {
+    if(index % 2 == 0) {
+      geometries.emplace_back(new Sphere(vector(position(random), position(random), position(random)), size(random)));
+    } else {
+      geometries.emplace_back(new AABB(vector(position(random), position(random), position(random)), vector(size(random), size(random), size(random))));
+    }
+    leaves.push_back(tree.insert(geometries.back().get()));
+    alive.push_back(true);
+  }
+  REQUIRE(tree.validate());
+  CHECK(tree.getHeight() < 20);
+
+  std::vector<BroadPhasePair> pairs;
+  tree.getMovedPairs(pairs);
+  CHECK(pairs.size() > 0);
+  tree.clearMoved();
+
+  for(unsigned int frame = 0; frame < 20; frame++) {
+    unsigned int reinserted = 0;
+    for(unsigned int index = 0; index < 50; index++) {
+      unsigned int moved = random() % geometries.size();
+      if(alive[moved]) {
+        geometries[moved]->setOrigin(geometries[moved]->getOrigin() + vector(step(random), step(random), step(random)));
+        reinserted += tree.move(leaves[moved]) ? 1 : 0;
+      }
+    }
+    CHECK(reinserted < 50);
+
+    unsigned int removed = random() % geometries.size();
+    if(alive[removed]) {
+      tree.remove(leaves[removed]);
+      alive[removed] = false;
+    }
+    REQUIRE(tree.validate());
+
+    std::set<std::pair<const Geometry *, const Geometry *>> expectedPairs;
+    std::set<std::pair<const Geometry *, const Geometry *>> expectedMovedPairs;
+    for(unsigned int i = 0; i < geometries.size(); i++) {
+      if(!alive[i]) {
+        continue;
+      }
+      CHECK(tree.getFatBounds(leaves[i]).contains(geometries[i]->getBounds()));
+      for(unsigned int j = i + 1; j < geometries.size(); j++) {
+        if(alive[j] && tree.getFatBounds(leaves[i]).overlaps(tree.getFatBounds(leaves[j]))) {
+          expectedPairs.insert(std::minmax(geometries[i].get(), geometries[j].get()));
+        }
+      }
+    }
+
+    pairs.clear();
+    tree.getPairs(pairs);
+    std::set<std::pair<const Geometry *, const Geometry *>> actualPairs;
+    for(const BroadPhasePair &pair : pairs) {
+      CHECK(actualPairs.insert(std::minmax(pair.getGeometryA(), pair.getGeometryB())).second);
+    }
+    CHECK(actualPairs == expectedPairs);
+
+    pairs.clear();
+    tree.getMovedPairs(pairs);
+    std::set<std::pair<const Geometry *, const Geometry *>> movedPairs;
+    for(const BroadPhasePair &pair : pairs) {
+      CHECK(movedPairs.insert(std::minmax(pair.getGeometryA(), pair.getGeometryB())).second);
+      CHECK(expectedPairs.count(std::minmax(pair.getGeometryA(), pair.getGeometryB())) == 1);
+    }
+    tree.clearMoved();
+
+    Bounds queryBounds(vector(-10, -10, -10), vector(10, 10, 10));
+    std::vector<const Geometry *> found = tree.query(queryBounds);
+    unsigned int expectedFound = 0;
+    for(unsigned int i = 0; i < geometries.size(); i++) {
+      expectedFound += alive[i] && tree.getFatBounds(leaves[i]).overlaps(queryBounds) ? 1 : 0;
+    }
+    CHECK(found.size() == expectedFound);
+  }
+}
+
+TEST_CASE("Spatial hash grid matches CollisionTester")
+{
+  std::mt19937 random(777);
+  std::uniform_real_distribution<real> position(-30, 30);
+  std::uniform_real_distribution<real> size(0.5, 1.5);
+
+  CollisionTester intersectionTester;
+  std::vector<std::unique_ptr<Sphere>> spheres;
+  SpatialHashGrid grid;
+
+  for(unsigned int index = 0; index < 2000; index++) {
+    spheres.emplace_back(new Sphere(vector(position(random), position(random), position(random)), size(random)));
+    grid.addSphere(spheres.back().get());
+  }
+
+  for(unsigned int frame = 0; frame < 3; frame++) {
+    grid.update();
+    CHECK(grid.getCellSize() >= 2 * 1.5 - 0.1);
+
+    std::vector<BroadPhasePair> pairs;
+    grid.getPairs(pairs);
+
+    std::set<std::pair<const Geometry *, const Geometry *>> actualPairs;
+    for(const BroadPhasePair &pair : pairs) {
+      CHECK(actualPairs.insert(std::minmax(pair.getGeometryA(), pair.getGeometryB())).second);
+    }
+
+    std::set<std::pair<const Geometry *, const Geometry *>> expectedPairs;
+    for(unsigned int i = 0; i < spheres.size(); i++) {
+      for(unsigned int j = i + 1; j < spheres.size(); j++) {
+        if(intersectionTester.intersects(*spheres[i], *spheres[j])) {
+          expectedPairs.insert(std::minmax((const Geometry *)spheres[i].get(), (const Geometry *)spheres[j].get()));
+        }
+      }
+    }
+    CHECK(!expectedPairs.empty());
+    CHECK(actualPairs == expectedPairs);
+
+    Sphere querySphere(vector(position(random), position(random), position(random)), 6);
+    std::vector<unsigned int> found;
+    grid.query(querySphere.getOrigin(), querySphere.getRadius(), found);
+    unsigned int expectedFound = 0;
+    for(auto &sphere : spheres) {
+      expectedFound += intersectionTester.intersects(querySphere, *sphere) ? 1 : 0;
+    }
+    CHECK(found.size() == expectedFound);
+    for(unsigned int index : found) {
+      CHECK(intersectionTester.intersects(querySphere, *grid.getSphere(index)));
+    }
+
+    found.clear();
+    grid.query(vector(1e6, 0, -1e6), 10, found);
+    CHECK(found.empty());
+
+    for(auto &sphere : spheres) {
+      sphere->setOrigin(sphere->getOrigin() + vector(size(random), -size(random), size(random)));
+    }
+  }
+}
+
+TEST_CASE("Batch kernels match CollisionTester")
+{
+  std::mt19937 random(4242);
+  std::uniform_real_distribution<real> position(-10, 10);
+  std::uniform_real_distribution<real> size(0.5, 3);
+
+  CollisionTester intersectionTester;
+  std::vector<std::unique_ptr<Sphere>> spheres;
+  std::vector<std::unique_ptr<AABB>> aabbs;
+  SphereBatch sphereBatch;
+  AabbBatch aabbBatch;
+
+  // odd count so that the scalar tail is exercised for every register width. Last sphere and aabb touch the query sphere exactly.
+  for(unsigned int index = 0; index < 1001; index++) {
+    spheres.emplace_back(new Sphere(vector(position(random), position(random), position(random)), size(random)));
+    aabbs.emplace_back(new AABB(vector(position(random), position(random), position(random)), vector(size(random), size(random), size(random))));
+  }
+  Sphere querySphere(vector(0, 0, 0), 4);
+  spheres.back()->setOrigin(vector(7, 0, 0));
+  spheres.back()->setRadius(3);
+  aabbs.back()->setOrigin(vector(0, 0, 5));
+  aabbs.back()->setHalfSizes(vector(1, 1, 1));
+
+  for(unsigned int index = 0; index < spheres.size(); index++) {
+    sphereBatch.add(*spheres[index]);
+    aabbBatch.add(*aabbs[index]);
+  }
+
+  std::vector<uint64_t> mask;
+  std::vector<unsigned int> indices;
+  auto checkResults = [&](const std::function<bool(unsigned int)> &expected) {
+    unsigned int expectedCount = 0;
+    for(unsigned int index = 0; index < spheres.size(); index++) {
+      bool expectedResult = expected(index);
+      CHECK(((mask[index / 64] >> (index % 64)) & 1) == (expectedResult ? 1 : 0));
+      expectedCount += expectedResult ? 1 : 0;
+    }
+    CHECK(indices.size() == expectedCount);
+    for(unsigned int position = 0; position < indices.size(); position++) {
+      CHECK(expected(indices[position]));
+      CHECK((position == 0 || indices[position - 1] < indices[position]));
+    }
+  };
+
+  BatchIntersectionHelper::sphereSphere(querySphere, sphereBatch, mask);
+  BatchIntersectionHelper::sphereSphere(querySphere, sphereBatch, indices);
+  CHECK(indices.back() == spheres.size() - 1);
+  checkResults([&](unsigned int index) { return intersectionTester.intersects(querySphere, *spheres[index]); });
+
+  indices.clear();
+  BatchIntersectionHelper::sphereAabb(querySphere, aabbBatch, mask);
+  BatchIntersectionHelper::sphereAabb(querySphere, aabbBatch, indices);
+  CHECK(indices.back() == aabbs.size() - 1);
+  checkResults([&](unsigned int index) { return intersectionTester.intersects(querySphere, *aabbs[index]); });
+
+  indices.clear();
+  BatchIntersectionHelper::sphereAabb(sphereBatch, *aabbs[0], mask);
+  BatchIntersectionHelper::sphereAabb(sphereBatch, *aabbs[0], indices);
+  checkResults([&](unsigned int index) { return intersectionTester.intersects(*spheres[index], *aabbs[0]); });
+
+  SphereBatch shiftedBatch;
+  for(unsigned int index = 0; index < spheres.size(); index++) {
+    shiftedBatch.add(*spheres[(index + 1) % spheres.size()]);
+  }
+  indices.clear();
+  BatchIntersectionHelper::sphereSphere(sphereBatch, shiftedBatch, mask);
+  BatchIntersectionHelper::sphereSphere(sphereBatch, shiftedBatch, indices);
+  checkResults([&](unsigned int index) { return intersectionTester.intersects(*spheres[index], *spheres[(index + 1) % spheres.size()]); });
+
+  indices.clear();
+  BatchIntersectionHelper::sphereAabb(sphereBatch, aabbBatch, mask);
+  BatchIntersectionHelper::sphereAabb(sphereBatch, aabbBatch, indices);
+  checkResults([&](unsigned int index) { return intersectionTester.intersects(*spheres[index], *aabbs[index]); });
+}
+
+TEST_CASE("Float batches are conservative proxies of real shapes")
+{
+  std::mt19937 random(2020);
+  std::uniform_real_distribution<real> position(990, 1010); // far from the origin, where float spacing is about 6e-5
+  std::uniform_real_distribution<real> size(0.5, 3);
+
+  std::vector<std::unique_ptr<Sphere>> spheres;
+  std::vector<std::unique_ptr<AABB>> aabbs;
+  FloatSphereBatch sphereBatch;
+  FloatAabbBatch aabbBatch;
+  for(unsigned int index = 0; index < 2001; index++) {
+    spheres.emplace_back(new Sphere(vector(position(random), position(random), position(random)), size(random)));
+    aabbs.emplace_back(new AABB(vector(position(random), position(random), position(random)), vector(size(random), size(random), size(random))));
+    sphereBatch.add(*spheres.back());
+    aabbBatch.add(*aabbs.back());
+  }
+  CHECK(sizeof(*sphereBatch.getX()) == sizeof(float));
+
+  // proxies contain their shapes
+  unsigned int notContained = 0;
+  for(unsigned int index = 0; index < spheres.size(); index++) {
+    notContained += (sphereBatch.getOrigin(index) - spheres[index]->getOrigin()).modulo() + spheres[index]->getRadius() > (real)sphereBatch.getRadius(index) ? 1 : 0;
+    vector mins = aabbBatch.getMins(index) - aabbs[index]->getMins();
+    vector maxs = aabbBatch.getMaxs(index) - aabbs[index]->getMaxs();
+    notContained += mins.x > 0 || mins.y > 0 || mins.z > 0 || maxs.x < 0 || maxs.y < 0 || maxs.z < 0 ? 1 : 0;
+  }
+  CHECK(notContained == 0);
+
+  // real queries against float batches: every real hit is found, and only a few near misses are added
+  CollisionTester intersectionTester;
+  unsigned int hits = 0, misses = 0, extras = 0;
+  for(unsigned int query = 0; query < 20; query++) {
+    Sphere querySphere(vector(position(random), position(random), position(random)), size(random) * 2);
+    std::vector<uint64_t> sphereMask, aabbMask;
+    BatchIntersectionHelper::sphereSphere(querySphere, sphereBatch, sphereMask);
+    BatchIntersectionHelper::sphereAabb(querySphere, aabbBatch, aabbMask);
+
+    for(unsigned int index = 0; index < spheres.size(); index++) {
+      bool expectedSphere = intersectionTester.intersects(querySphere, *spheres[index]);
+      bool expectedAabb = intersectionTester.intersects(querySphere, *aabbs[index]);
+      bool sphereResult = (sphereMask[index / 64] >> (index % 64)) & 1;
+      bool aabbResult = (aabbMask[index / 64] >> (index % 64)) & 1;
+      hits += (expectedSphere ? 1 : 0) + (expectedAabb ? 1 : 0);
+      misses += (expectedSphere && !sphereResult ? 1 : 0) + (expectedAabb && !aabbResult ? 1 : 0);
+      extras += (!expectedSphere && sphereResult ? 1 : 0) + (!expectedAabb && aabbResult ? 1 : 0);
+    }
+  }
+  CHECK(hits > 100);
+  CHECK(misses == 0);
+  CHECK(extras * 100 < hits);
+
+  // rays, nearest rounded, against boxes near them
+  FloatRayBatch rayBatch;
+  std::vector<Line> lines;
+  for(unsigned int index = 0; index < 37; index++) {
+    lines.emplace_back(vector(position(random), position(random), position(random)), vector(size(random) - 1.75, size(random) - 1.75, size(random) - 1.75));
+    rayBatch.add(lines.back());
+  }
+  unsigned int rayHits = 0, rayMismatches = 0;
+  for(unsigned int index = 0; index < 50; index++) {
+    std::vector<uint64_t> mask;
+    BatchIntersectionHelper::lineAabb(rayBatch, *aabbs[index], mask);
+    for(unsigned int ray = 0; ray < lines.size(); ray++) {
+      bool expected = IntersectionHelper::lineAabb(lines[ray], *aabbs[index]);
+      rayHits += expected ? 1 : 0;
+      rayMismatches += expected != (bool)((mask[0] >> ray) & 1) ? 1 : 0;
+    }
+  }
+  CHECK(rayHits > 0);
+  CHECK(rayMismatches <= 1); // grazing rays, within float rounding
+}
+
+TEST_CASE("Geometries and kernels templated on the scalar type")
+{
+  CHECK(sizeof(BasicSphere<float>) < sizeof(BasicSphere<double>));
+  CHECK(sizeof(BasicAABB<float>) < sizeof(BasicAABB<double>));
+  CHECK(sizeof(BasicGeometryContact<float>) < sizeof(BasicGeometryContact<double>));
+
+  std::mt19937 random(2026);
+  std::uniform_real_distribution<real> position(-10, 10);
+  std::uniform_real_distribution<real> size(0.5, 3);
+  typedef BasicGeometry<float>::vector FloatVector; // the vector of the math dependency when real is float
+  auto widen = [](const FloatVector &value) { return vectorCast<vector>(value); };
+
+  // real world against float proxies: mixed kernels test as if the proxies were widened to real
+  unsigned int hits = 0, mismatches = 0, disagreements = 0;
+  for(unsigned int index = 0; index < 500; index++) {
+    Sphere sphere(vector(position(random), position(random), position(random)), size(random));
+    AABB aabb(vector(position(random), position(random), position(random)), vector(size(random), size(random), size(random)));
+    Plane plane(vector(position(random), position(random), position(random)), vector(position(random), position(random), position(random)));
+    Line line(vector(position(random), position(random), position(random)), vector(position(random), position(random), position(random)));
+
+    BasicSphere<float> sphereProxy(FloatVector(position(random), position(random), position(random)), size(random));
+    BasicAABB<float> aabbProxy(FloatVector(position(random), position(random), position(random)), FloatVector(size(random), size(random), size(random)));
+    Sphere widenedSphere(widen(sphereProxy.getOrigin()), sphereProxy.getRadius());
+    AABB widenedAabb(widen(aabbProxy.getOrigin()), widen(aabbProxy.getHalfSizes()));
+
+    bool results[] = {
+        IntersectionHelper::sphereSphere(sphere, sphereProxy), IntersectionHelper::sphereSphere(sphereProxy, sphere),
+        IntersectionHelper::sphereAabb(sphere, aabbProxy), IntersectionHelper::sphereAabb(sphereProxy, aabb),
+        IntersectionHelper::aabbAabb(aabb, aabbProxy), IntersectionHelper::aabbAabb(aabbProxy, aabb),
+        IntersectionHelper::planeSphere(plane, sphereProxy), IntersectionHelper::planeAabb(plane, aabbProxy),
+        IntersectionHelper::lineSphere(line, sphereProxy), IntersectionHelper::lineAabb(line, aabbProxy)
+    };
+    bool expected[] = {
+        IntersectionHelper::sphereSphere(sphere, widenedSphere), IntersectionHelper::sphereSphere(widenedSphere, sphere),
+        IntersectionHelper::sphereAabb(sphere, widenedAabb), IntersectionHelper::sphereAabb(widenedSphere, aabb),
+        IntersectionHelper::aabbAabb(aabb, widenedAabb), IntersectionHelper::aabbAabb(widenedAabb, aabb),
+        IntersectionHelper::planeSphere(plane, widenedSphere), IntersectionHelper::planeAabb(plane, widenedAabb),
+        IntersectionHelper::lineSphere(line, widenedSphere), IntersectionHelper::lineAabb(line, widenedAabb)
+    };
+    for(unsigned int test = 0; test < sizeof(results) / sizeof(results[0]); test++) {
+      hits += expected[test] ? 1 : 0;
+      mismatches += results[test] != expected[test] ? 1 : 0;
+    }
+
+    // float against float: same results as in real, but for shapes grazing within float rounding
+    BasicSphere<float> anotherProxy(FloatVector(position(random), position(random), position(random)), size(random));
+    Sphere widenedAnother(widen(anotherProxy.getOrigin()), anotherProxy.getRadius());
+    disagreements += IntersectionHelper::sphereSphere(sphereProxy, anotherProxy) != IntersectionHelper::sphereSphere(widenedSphere, widenedAnother) ? 1 : 0;
+    disagreements += IntersectionHelper::sphereAabb(anotherProxy, aabbProxy) != IntersectionHelper::sphereAabb(widenedAnother, widenedAabb) ? 1 : 0;
+
+    // mixed contacts reference the operands and match the widened ones
+    std::vector<PairContact<real, float>> contacts = IntersectionHelper::sphereSphereContact(sphere, sphereProxy);
+    std::vector<GeometryContact> expectedContacts = IntersectionHelper::sphereSphereContact(sphere, widenedSphere);
+    REQUIRE(contacts.size() == expectedContacts.size());
+    if(!contacts.empty()) {
+      CHECK(contacts[0].getGeometryA() == &sphere);
+      CHECK(contacts[0].getGeometryB() == &sphereProxy);
+      CHECK(contacts[0].getPenetration() == expectedContacts[0].getPenetration());
+      CHECK(contacts[0].getNormal() == expectedContacts[0].getNormal());
+    }
+    std::vector<PairContact<float, real>> aabbContacts = IntersectionHelper::sphereAabbContact(sphereProxy, aabb);
+    CHECK(aabbContacts.size() == IntersectionHelper::sphereAabbContact(widenedSphere, aabb).size());
+    CHECK(IntersectionHelper::planeSphereContact(plane, sphereProxy).size() == IntersectionHelper::planeSphereContact(plane, widenedSphere).size());
+  }
+  CHECK(hits > 100);
+  CHECK(mismatches == 0);
+  CHECK(disagreements <= 2);
+
+  // float contacts stay in float
+  BasicSphere<float> sphere(FloatVector(0, 0, 0), 1);
+  BasicSphere<float> anotherSphere(FloatVector(1.5f, 0, 0), 1);
+  std::vector<PairContact<float, float>> contacts = IntersectionHelper::sphereSphereContact(sphere, anotherSphere);
+  REQUIRE(contacts.size() == 1);
+  CHECK(sizeof(contacts[0].getPenetration()) == sizeof(float));
+  CHECK(contacts[0].getPenetration() == Catch::Approx(0.5));
+  CHECK(contacts[0].getGeometryB() == &anotherSphere);
+}
+
+TEST_CASE("Ray Aabb slab test")
+{
+  AABB aabb(vector(10, 10, 0), vector(1, 1, 1));
+  real tEnter, tExit;
+
+  // diagonal ray - the previous implementation computed mins.x - origin.x / direction.x and missed it
+  Line line(vector(0, 0, 0), vector(1, 1, 0));
+  CHECK(IntersectionHelper::lineAabb(line, aabb, tEnter, tExit));
+  CHECK(tEnter == Catch::Approx(9 * sqrt(2)));
+  CHECK(tExit == Catch::Approx(11 * sqrt(2)));
+
+  line.setDirection(vector(-1, -1, 0));
+  CHECK(!IntersectionHelper::lineAabb(line, aabb));
+
+  // origin inside: negative entry
+  line.setOrigin(vector(10, 10, 0));
+  line.setDirection(vector(1, 0, 0));
+  CHECK(IntersectionHelper::lineAabb(line, aabb, tEnter, tExit));
+  CHECK(tEnter == Catch::Approx(-1));
+  CHECK(tExit == Catch::Approx(1));
+
+  // parallel to a face, inside, outside and exactly on the slab boundary
+  line.setOrigin(vector(0, 10, 0));
+  CHECK(IntersectionHelper::lineAabb(line, aabb));
+  line.setOrigin(vector(0, 12, 0));
+  CHECK(!IntersectionHelper::lineAabb(line, aabb));
+  line.setOrigin(vector(0, 11, 1));
+  CHECK(IntersectionHelper::lineAabb(line, aabb));
+  line.setOrigin(vector(20, 9, -1));
+  line.setDirection(vector(-1, 0, 0));
+  CHECK(IntersectionHelper::lineAabb(line, aabb));
+  line.setOrigin(vector(20, 11, 1));
+  CHECK(IntersectionHelper::lineAabb(line, aabb));
+
+  // batches match one by one results
+  std::mt19937 random(99);
+  std::uniform_real_distribution<real> position(-20, 20);
+  std::uniform_real_distribution<real> size(0.5, 4);
+
+  std::vector<std::unique_ptr<AABB>> aabbs;
+  AabbBatch aabbBatch;
+  for(unsigned int index = 0; index < 203; index++) {
+    aabbs.emplace_back(new AABB(vector(position(random), position(random), position(random)), vector(size(random), size(random), size(random))));
+    aabbBatch.add(*aabbs.back());
+  }
+  aabbs.back()->setOrigin(vector(0, 0, 0));
+  aabbBatch.set(aabbs.size() - 1, *aabbs.back());
+
+  std::vector<Line> lines;
+  RayBatch rayBatch;
+  for(unsigned int index = 0; index < 11; index++) {
+    lines.emplace_back(vector(position(random), position(random), position(random)), vector(position(random), position(random), index % 3 == 0 ? 0 : position(random)));
+    rayBatch.add(lines.back());
+  }
+
+  CollisionTester intersectionTester;
+  unsigned int hits = 0;
+  for(const Line &ray : lines) {
+    std::vector<uint64_t> mask;
+    std::vector<unsigned int> indices;
+    std::vector<real> tEnters;
+    BatchIntersectionHelper::lineAabb(ray, aabbBatch, mask, tEnters);
+    BatchIntersectionHelper::lineAabb(ray, aabbBatch, indices);
+
+    unsigned int expectedCount = 0;
+    for(unsigned int index = 0; index < aabbs.size(); index++) {
+      bool expected = IntersectionHelper::lineAabb(ray, *aabbs[index], tEnter, tExit);
+      CHECK(expected == intersectionTester.intersects(ray, *aabbs[index]));
+      CHECK(((mask[index / 64] >> (index % 64)) & 1) == (expected ? 1 : 0));
+      CHECK(tEnters[index] == tEnter);
+      expectedCount += expected ? 1 : 0;
+    }
+    CHECK(indices.size() == expectedCount);
+    hits += expectedCount;
+  }
+  CHECK(hits > 0);
+
+  for(auto &box : aabbs) {
+    std::vector<uint64_t> mask;
+    BatchIntersectionHelper::lineAabb(rayBatch, *box, mask);
+    for(unsigned int index = 0; index < lines.size(); index++) {
+      CHECK(((mask[0] >> index) & 1) == (IntersectionHelper::lineAabb(lines[index], *box) ? 1 : 0));
+    }
+  }
+}
+
+TEST_CASE("Plane Aabb Intersections")
+{
+  CollisionTester intersectionTester;
+
+  Plane plane(vector(0, 0, 0), vector(0, 1, 0));
+  AABB aabb(vector(3, 0.5, 0), vector(1, 1, 1));
+  CHECK(intersectionTester.intersects(plane, aabb));
+  CHECK(intersectionTester.intersects(aabb, plane));
+
+  aabb.setOrigin(vector(3, 2, 0));
+  CHECK(!intersectionTester.intersects(plane, aabb));
+  aabb.setOrigin(vector(3, -2, 0));
+  CHECK(!intersectionTester.intersects(plane, aabb));
+
+  plane.setNormal(vector(1, 1, 0).normalizado());
+  aabb.setOrigin(vector(1.5, 0, 0));
+  CHECK(intersectionTester.intersects(plane, aabb));
+  aabb.setOrigin(vector(2.5, 0, 0));
+  CHECK(!intersectionTester.intersects(plane, aabb));
+}
+
+TEST_CASE("Frustum culling")
+{
+  // box shaped frustum [-10, 10]^3 - normals point out of the frustum
+  Frustum frustum(std::vector<Plane> {
+    Plane(vector(10, 0, 0), vector(1, 0, 0)), Plane(vector(-10, 0, 0), vector(-1, 0, 0)),
+    Plane(vector(0, 10, 0), vector(0, 1, 0)), Plane(vector(0, -10, 0), vector(0, -1, 0)),
+    Plane(vector(0, 0, 10), vector(0, 0, 1)), Plane(vector(0, 0, -10), vector(0, 0, -1))
+  });
+  FrustumCuller culler(frustum);
+  CHECK(culler.getPlaneCount() == 6);
+  CHECK(culler.getAllPlanesMask() == 0x3F);
+
+  auto expectedResult = [](const vector &mins, const vector &maxs) {
+    if(mins.x > 10 || mins.y > 10 || mins.z > 10 || maxs.x < -10 || maxs.y < -10 || maxs.z < -10) {
+      return CullResult::OUTSIDE;
+    }
+    if(mins.x >= -10 && mins.y >= -10 && mins.z >= -10 && maxs.x <= 10 && maxs.y <= 10 && maxs.z <= 10) {
+      return CullResult::INSIDE;
+    }
+    return CullResult::INTERSECTING;
+  };
+
+  CHECK(culler.cull(Sphere(vector(0, 0, 0), 1)) == CullResult::INSIDE);
+  CHECK(culler.cull(Sphere(vector(10, 0, 0), 1)) == CullResult::INTERSECTING);
+  CHECK(culler.cull(Sphere(vector(11, 0, 0), 1)) == CullResult::INTERSECTING);
+  CHECK(culler.cull(Sphere(vector(0, -12, 0), 1)) == CullResult::OUTSIDE);
+  CHECK(culler.cull(AABB(vector(0, 0, 0), vector(20, 1, 1))) == CullResult::INTERSECTING);
+  CHECK(culler.cull(AABB(vector(0, 0, 15), vector(2, 2, 2))) == CullResult::OUTSIDE);
+  CHECK(culler.cull(Plane(vector(0, 0, 0), vector(0, 1, 0))) == CullResult::INTERSECTING);
+
+  std::mt19937 random(5);
+  std::uniform_real_distribution<real> position(-20, 20);
+  std::uniform_real_distribution<real> size(0.5, 4);
+
+  std::vector<std::unique_ptr<Sphere>> spheres;
+  std::vector<std::unique_ptr<AABB>> aabbs;
+  SphereBatch sphereBatch;
+  AabbBatch aabbBatch;
+  for(unsigned int index = 0; index < 501; index++) {
+    // spheres only on axes, where the box test above is exact for spheres too
+    vector center(0, 0, 0);
+    center = index % 3 == 0 ? vector(position(random), 0, 0) : (index % 3 == 1 ? vector(0, position(random), 0) : vector(0, 0, position(random)));
+    spheres.emplace_back(new Sphere(center, size(random)));
+    aabbs.emplace_back(new AABB(vector(position(random), position(random), position(random)), vector(size(random), size(random), size(random))));
+    sphereBatch.add(*spheres.back());
+    aabbBatch.add(*aabbs.back());
+  }
+
+  std::vector<CullResult> sphereResults;
+  std::vector<CullResult> aabbResults;
+  culler.cull(sphereBatch, sphereResults);
+  culler.cull(aabbBatch, aabbResults);
+
+  unsigned int counts[3] = {0, 0, 0};
+  for(unsigned int index = 0; index < spheres.size(); index++) {
+    const Sphere &sphere = *spheres[index];
+    vector radius(sphere.getRadius(), sphere.getRadius(), sphere.getRadius());
+    CHECK(culler.cull(sphere) == expectedResult(sphere.getOrigin() - radius, sphere.getOrigin() + radius));
+    CHECK(sphereResults[index] == culler.cull(sphere));
+
+    CHECK(culler.cull(*aabbs[index]) == expectedResult(aabbs[index]->getMins(), aabbs[index]->getMaxs()));
+    CHECK(aabbResults[index] == culler.cull(*aabbs[index]));
+    counts[(unsigned int)aabbResults[index]]++;
+  }
+  CHECK(counts[0] > 0);
+  CHECK(counts[1] > 0);
+  CHECK(counts[2] > 0);
+
+  // planes passed by a parent are skipped by children, and results are unchanged
+  uint32_t passedPlanes = 0;
+  CHECK(culler.cull(AABB(vector(-5, 0, 0), vector(5, 20, 20)), passedPlanes) == CullResult::INTERSECTING);
+  CHECK(passedPlanes == 0x3);
+
+  HierarchicalGeometry hierarchy(std::unique_ptr<Geometry>(new AABB(vector(-5, 0, 0), vector(5, 20, 20))));
+  std::unique_ptr<HierarchicalGeometry> inner(new HierarchicalGeometry(std::unique_ptr<Geometry>(new Sphere(vector(-5, 0, 0), 4))));
+  inner->addChildren(std::unique_ptr<Geometry>(new Sphere(vector(-5, 1, 0), 1)));
+  inner->addChildren(std::unique_ptr<Geometry>(new Sphere(vector(-6, -1, 0), 1)));
+  hierarchy.addChildren(std::move(inner));
+  hierarchy.addChildren(std::unique_ptr<Geometry>(new Sphere(vector(-5, 15, 0), 2)));
+  hierarchy.addChildren(std::unique_ptr<Geometry>(new AABB(vector(-5, 0, 9), vector(2, 2, 2))));
+  hierarchy.addChildren(std::unique_ptr<Geometry>(new Sphere(vector(-5, 0, -18), 2)));
+
+  std::vector<const Geometry *> visible;
+  culler.collectVisible(hierarchy, visible);
+  CHECK(visible.size() == 3);
+
+  visible.clear();
+  culler.collectVisible(Sphere(vector(30, 0, 0), 1), visible);
+  CHECK(visible.empty());
+
+  // the collision tester treats frustums as half spaces too - geometries fully inside intersect it
+  CollisionTester intersectionTester;
+  CHECK(intersectionTester.intersects(Sphere(vector(0, 0, 0), 1), frustum));
+  CHECK(intersectionTester.intersects(frustum, Sphere(vector(0, 0, 0), 1)));
+  CHECK(intersectionTester.intersects(AABB(vector(2, 3, 4), vector(1, 1, 1)), frustum));
+  CHECK(intersectionTester.intersects(Sphere(vector(10, 0, 0), 1), frustum));
+  CHECK(!intersectionTester.intersects(Sphere(vector(0, -12, 0), 1), frustum));
+  CHECK(intersectionTester.intersects(hierarchy, frustum));
+  for(unsigned int index = 0; index < spheres.size(); index++) {
+    CHECK(intersectionTester.intersects(*spheres[index], frustum) == (sphereResults[index] != CullResult::OUTSIDE));
+    CHECK(intersectionTester.intersects(*aabbs[index], frustum) == (aabbResults[index] != CullResult::OUTSIDE));
+  }
+
+  // hierarchies straddling the frustum are descended: this bounding volume reaches into it, its only child does not
+  HierarchicalGeometry outsideChildren(std::unique_ptr<Geometry>(new Sphere(vector(0, 14, 0), 6)));
+  outsideChildren.addChildren(std::unique_ptr<Geometry>(new Sphere(vector(0, 18, 0), 1)));
+  CHECK(culler.cull(outsideChildren) == CullResult::INTERSECTING);
+  CHECK(!intersectionTester.intersects(outsideChildren, frustum));
+}
+
+TEST_CASE("Hierarchies move children lazily and refit bounding volumes")
+{
+  CollisionTester intersectionTester;
+  HierarchicalGeometry vehicle(std::unique_ptr<Geometry>(new AABB(vector(0, 0, 0), vector(1, 1, 1))));
+  std::unique_ptr<HierarchicalGeometry> wheel(new HierarchicalGeometry(std::unique_ptr<Geometry>(new Sphere(vector(2, 0, 0), 0.5))));
+  wheel->addChildren(std::unique_ptr<Geometry>(new Sphere(vector(2, 0, 1), 0.5)));
+  vehicle.addChildren(std::move(wheel));
+  vehicle.addChildren(std::unique_ptr<Geometry>(new AABB(vector(0, 3, 0), vector(1, 1, 1))));
+
+  // bounding volumes grow to enclose children, bottom up, and keep their origin
+  const Sphere &wheelVolume = (const Sphere &)((const HierarchicalGeometry &)*vehicle.getChildren()[0]).getBoundingVolume();
+  CHECK(wheelVolume.getRadius() == Catch::Approx(1.5));
+  const AABB &vehicleVolume = (const AABB &)vehicle.getBoundingVolume();
+  CHECK(vehicleVolume.getOrigin() == vector(0, 0, 0));
+  CHECK(vehicleVolume.getHalfSizes() == vector(3.5, 4, 1.5)); // wheel bounding sphere reaches x 3.5 and z 1.5, the box y 4
+
+  // moving only touches the hierarchy, children follow when read
+  Sphere probe(vector(9, 4.5, 0), 0.6);
+  CHECK(!intersectionTester.intersects(probe, vehicle));
+  vehicle.setOrigin(vector(8, 0, 0));
+  CHECK(vehicle.getBounds().mins == vector(4.5, -4, -1.5));
+  CHECK(intersectionTester.intersects(probe, vehicle)); // touches the box, now at (8, 3, 0)
+  const HierarchicalGeometry &movedWheel = (const HierarchicalGeometry &)*vehicle.getChildren()[0];
+  CHECK(movedWheel.getOrigin() == vector(10, 0, 0));
+  CHECK(movedWheel.getChildren()[0]->getOrigin() == vector(10, 0, 1));
+  CHECK(vehicle.getChildren()[1]->getOrigin() == vector(8, 3, 0));
+
+  // moving a nested child refits every volume above it
+  ((HierarchicalGeometry &)*vehicle.getChildren()[0]).setChildOffset(0, vector(0, 0, 3));
+  CHECK(movedWheel.getChildren()[0]->getOrigin() == vector(10, 0, 3));
+  CHECK(((const Sphere &)movedWheel.getBoundingVolume()).getRadius() == Catch::Approx(3.5));
+  CHECK(vehicle.getBounds().maxs.z == Catch::Approx(3.5));
+
+  // many moves, then concurrent queries update once
+  for(unsigned int step = 0; step < 100; step++) {
+    vehicle.setOrigin(vector(step, 0, 0));
+  }
+  std::atomic<unsigned int> hits(0);
+  std::vector<std::thread> threads;
+  for(unsigned int thread = 0; thread < 4; thread++) {
+    threads.emplace_back([&]() {
+      hits += intersectionTester.intersects(Sphere(vector(101, 0, 3), 0.6), vehicle) ? 1 : 0;
+    });
+  }
+  for(std::thread &thread : threads) {
+    thread.join();
+  }
+  CHECK(hits == 4);
+  CHECK(movedWheel.getChildren()[0]->getOrigin() == vector(101, 0, 3));
+}
+
+TEST_CASE("Contact buffer does not allocate in steady state")
+{
+  CollisionTester intersectionTester;
+
+  std::vector<std::unique_ptr<Geometry>> scene;
+  for(int i = 0; i < 20; i++) {
+    scene.push_back(std::unique_ptr<Geometry>(new Sphere(vector(i * 1.5, 1, 0), 1)));
+    scene.push_back(std::unique_ptr<Geometry>(new AABB(vector(i * 1.5, 2, 0), vector(0.5, 0.5, 0.5))));
+  }
+  scene.push_back(std::unique_ptr<Geometry>(new Plane(vector(0, 0, 0), vector(0, 1, 0))));
+  std::unique_ptr<HierarchicalGeometry> hierarchy(new HierarchicalGeometry(std::unique_ptr<Geometry>(new AABB(vector(5, 1, 0), vector(5, 2, 2)))));
+  hierarchy->addChildren(std::unique_ptr<Geometry>(new Sphere(vector(3, 1, 0), 1)));
+  hierarchy->addChildren(std::unique_ptr<Geometry>(new Sphere(vector(6, 1, 0), 1)));
+  scene.push_back(std::move(hierarchy));
+
+  auto frame = [&](ContactBuffer &contacts) {
+    contacts.clear();
+    for(unsigned int i = 0; i < scene.size(); i++) {
+      for(unsigned int j = i + 1; j < scene.size(); j++) {
+        intersectionTester.detectCollision(*scene[i], *scene[j], contacts);
+      }
+    }
+  };
+
+  unsigned int expectedContacts = 0;
+  for(unsigned int i = 0; i < scene.size(); i++) {
+    for(unsigned int j = i + 1; j < scene.size(); j++) {
+      expectedContacts += intersectionTester.detectCollision(*scene[i], *scene[j]).size();
+    }
+  }
+  REQUIRE(expectedContacts > 0);
+
+  ContactBuffer unbounded;
+  frame(unbounded); // warm up: grows to the frame size
+  unsigned long allocationsBefore = allocationCount;
+  frame(unbounded);
+  unsigned long steadyStateAllocations = allocationCount - allocationsBefore;
+  CHECK(steadyStateAllocations == 0);
+  CHECK(unbounded.size() == expectedContacts);
+  CHECK(!unbounded.isOverflowed());
+
+  ContactBuffer bounded(1024);
+  allocationsBefore = allocationCount;
+  frame(bounded);
+  unsigned long boundedAllocations = allocationCount - allocationsBefore;
+  CHECK(boundedAllocations == 0);
+  CHECK(bounded.size() == expectedContacts);
+  CHECK(!bounded.isOverflowed());
+
+  ContactBuffer small(4);
+  allocationsBefore = allocationCount;
+  frame(small);
+  unsigned long overflowAllocations = allocationCount - allocationsBefore;
+  CHECK(overflowAllocations == 0);
+  CHECK(small.size() == 4);
+  CHECK(small.isOverflowed());
+  for(unsigned int i = 0; i < small.size(); i++) {
+    CHECK(small[i].getGeometryA() == unbounded[i].getGeometryA());
+    CHECK(small[i].getGeometryB() == unbounded[i].getGeometryB());
+  }
+
+  small.clear();
+  CHECK(small.empty());
+  CHECK(!small.isOverflowed());
+
+  Sphere sphere(vector(0, 0, 0), 1);
+  Sphere anotherSphere(vector(1, 0, 0), 1);
+  StaticCollisionTester::detectCollision(sphere, anotherSphere, small);
+  CHECK(small.size() == 1);
+
+  allocationsBefore = allocationCount;
+  std::vector<GeometryContact> contacts = intersectionTester.detectCollision(sphere, anotherSphere);
+  unsigned long vectorAllocations = allocationCount - allocationsBefore;
+  CHECK(vectorAllocations > 0); // the std::vector api allocates on every call with contacts
+}
+
+TEST_CASE("Contact cache warm starting and eviction")
+{
+  CollisionTester intersectionTester;
+  ContactCache cache;
+  ContactBuffer contacts;
+
+  Sphere sphere(vector(0, 0.9, 0), 1);
+  Sphere anotherSphere(vector(5, 0.8, 0), 1);
+  Plane plane(vector(0, 0, 0), vector(0, 1, 0));
+
+  cache.beginFrame();
+  contacts.clear();
+  intersectionTester.detectCollision(plane, sphere, contacts);
+  intersectionTester.detectCollision(anotherSphere, plane, contacts);
+  cache.addContacts(contacts);
+  CHECK(cache.endFrame() == 0);
+  REQUIRE(cache.size() == 2);
+
+  ContactManifold *manifold = cache.find(&sphere, &plane);
+  REQUIRE(manifold != nullptr);
+  CHECK(cache.find(&plane, &sphere) == manifold);
+  REQUIRE(manifold->size() == 1);
+  CHECK(!(*manifold)[0].isWarmStarted());
+  manifold->getPoint(0).setNormalImpulse(3);
+  manifold->getPoint(0).setTangentImpulse(vector(0.5, 0, 0));
+
+  // slightly moved: matched, impulses carried over - operand order does not matter
+  sphere.setOrigin(vector(0.01, 0.89, 0));
+  cache.beginFrame();
+  contacts.clear();
+  intersectionTester.detectCollision(sphere, plane, contacts);
+  intersectionTester.detectCollision(plane, anotherSphere, contacts);
+  cache.addContacts(contacts);
+  CHECK(cache.endFrame() == 0);
+
+  manifold = cache.find(&sphere, &plane);
+  REQUIRE(manifold != nullptr);
+  REQUIRE(manifold->size() == 1);
+  CHECK((*manifold)[0].isWarmStarted());
+  CHECK((*manifold)[0].getPersistence() == 1);
+  CHECK((*manifold)[0].getNormalImpulse() == 3);
+  CHECK((*manifold)[0].getTangentImpulse() == vector(0.5, 0, 0));
+  CHECK(((*manifold)[0].getContact().getGeometryA() == manifold->getGeometryA()));
+  const ContactManifold *otherManifold = cache.find(&plane, &anotherSphere);
+  REQUIRE(otherManifold != nullptr);
+  CHECK((*otherManifold)[0].getPersistence() == 1);
+
+  // teleported: same pair, but the contact is new
+  sphere.setOrigin(vector(3, 0.9, 0));
+  cache.beginFrame();
+  contacts.clear();
+  intersectionTester.detectCollision(sphere, plane, contacts);
+  intersectionTester.detectCollision(plane, anotherSphere, contacts);
+  cache.addContacts(contacts);
+  cache.endFrame();
+  manifold = cache.find(&sphere, &plane);
+  REQUIRE(manifold != nullptr);
+  CHECK(!(*manifold)[0].isWarmStarted());
+  CHECK((*manifold)[0].getNormalImpulse() == 0);
+
+  // separated: evicted
+  sphere.setOrigin(vector(0, 5, 0));
+  cache.beginFrame();
+  contacts.clear();
+  intersectionTester.detectCollision(sphere, plane, contacts);
+  intersectionTester.detectCollision(plane, anotherSphere, contacts);
+  cache.addContacts(contacts);
+  CHECK(cache.endFrame() == 1);
+  CHECK(cache.size() == 1);
+  CHECK(cache.find(&sphere, &plane) == nullptr);
+  otherManifold = cache.find(&anotherSphere, &plane);
+  REQUIRE(otherManifold != nullptr);
+  CHECK((*otherManifold)[0].getPersistence() == 3);
+
+  // a previous point carries over to one new point only, the closest
+  ContactCache matchingCache;
+  matchingCache.beginFrame();
+  matchingCache.addContact(GeometryContact(&sphere, &plane, vector(0, 0, 0), vector(0, 1, 0), 0.8, 0.1));
+  matchingCache.addContact(GeometryContact(&sphere, &plane, vector(1, 0, 0), vector(0, 1, 0), 0.8, 0.1));
+  matchingCache.endFrame();
+  ContactManifold &matchingManifold = matchingCache.getManifolds()[0];
+  REQUIRE(matchingManifold.size() == 2);
+  matchingManifold.getPoint(0).setNormalImpulse(2);
+  matchingManifold.getPoint(1).setNormalImpulse(5);
+
+  matchingCache.beginFrame();
+  matchingCache.addContact(GeometryContact(&sphere, &plane, vector(0.06, 0, 0), vector(0, 1, 0), 0.8, 0.1));
+  matchingCache.addContact(GeometryContact(&sphere, &plane, vector(0.02, 0, 0), vector(0, 1, 0), 0.8, 0.1));
+  matchingCache.addContact(GeometryContact(&sphere, &plane, vector(0.95, 0, 0), vector(0, 1, 0), 0.8, 0.1));
+  matchingCache.endFrame();
+  REQUIRE(matchingManifold.size() == 3);
+  CHECK(!matchingManifold[0].isWarmStarted());
+  CHECK(matchingManifold[0].getNormalImpulse() == 0);
+  CHECK(matchingManifold[1].isWarmStarted());
+  CHECK(matchingManifold[1].getNormalImpulse() == 2);
+  CHECK(matchingManifold[2].getNormalImpulse() == 5);
+
+  // manifolds keep the deepest points
+  ContactCache pointsCache;
+  pointsCache.beginFrame();
+  for(int i = 0; i < 6; i++) {
+    pointsCache.addContact(GeometryContact(&sphere, &plane, vector(i, 0, 0), vector(0, 1, 0), 0.8, i * 0.1));
+  }
+  pointsCache.endFrame();
+  REQUIRE(pointsCache.size() == 1);
+  const ContactManifold &pointsManifold = pointsCache.getManifolds()[0];
+  REQUIRE(pointsManifold.size() == ContactManifold::MAX_POINTS);
+  for(unsigned int i = 0; i < pointsManifold.size(); i++) {
+    CHECK(pointsManifold[i].getContact().getPenetration() >= (real)0.15);
+  }
+}
+
+TEST_CASE("Work stealing thread pool runs every chunk once")
+{
+  for(unsigned int threadCount : {1u, 2u, 5u}) {
+    WorkStealingThreadPool threadPool(threadCount);
+    CHECK(threadPool.getThreadCount() == threadCount);
+
+    for(unsigned int chunkCount : {0u, 1u, 3u, 1000u}) {
+      std::vector<std::atomic<unsigned int>> runs(chunkCount);
+      std::atomic<unsigned int> invalidWorkers(0);
+      threadPool.parallelFor(chunkCount, [&](unsigned int chunk, unsigned int worker) {
+        if(worker >= threadCount) {
+          invalidWorkers++;
+        }
+        volatile unsigned int spin = chunk % 7 == 0 ? 20000 : 10; // uneven chunks, for workers to steal
+        while(spin > 0) {
+          spin = spin - 1;
+        }
+        runs[chunk]++;
+      });
+
+      CHECK(invalidWorkers == 0);
+      unsigned int wrongRuns = 0;
+      for(std::atomic<unsigned int> &chunkRuns : runs) {
+        wrongRuns += chunkRuns != 1 ? 1 : 0;
+      }
+      CHECK(wrongRuns == 0);
+    }
+  }
+}
+
+TEST_CASE("Parallel narrow phase is deterministic at any thread count")
+{
+  std::mt19937 random(4321);
+  std::uniform_real_distribution<real> position(-10, 10);
+  std::uniform_real_distribution<real> size(0.5, 1.5);
+
+  CollisionTester intersectionTester;
+  std::vector<std::unique_ptr<Geometry>> geometries;
+  for(unsigned int index = 0; index < 300; index++) {
+    geometries.emplace_back(new Sphere(vector(position(random), position(random), position(random)), size(random)));
+    geometries.emplace_back(new AABB(vector(position(random), position(random), position(random)), vector(size(random), size(random), size(random))));
+  }
+  geometries.emplace_back(new Plane(vector(0, 0, 0), vector(0, 1, 0)));
+
+  std::vector<BroadPhasePair> pairs;
+  for(unsigned int i = 0; i < geometries.size(); i++) {
+    for(unsigned int j = i + 1; j < geometries.size(); j += 3) {
+      pairs.emplace_back(geometries[i].get(), geometries[j].get());
+    }
+  }
+
+  ContactBuffer expected;
+  for(const BroadPhasePair &pair : pairs) {
+    intersectionTester.detectCollision(*pair.getGeometryA(), *pair.getGeometryB(), expected);
+  }
+  REQUIRE(expected.size() > 100);
+
+  // warm started from per pair simplices: two frames, serially
+  std::vector<CachedSimplex> expectedSimplices(pairs.size());
+  ContactBuffer expectedWarm[2];
+  for(unsigned int frame = 0; frame < 2; frame++) {
+    for(unsigned int index = 0; index < pairs.size(); index++) {
+      intersectionTester.detectCollision(*pairs[index].getGeometryA(), *pairs[index].getGeometryB(), expectedWarm[frame], expectedSimplices[index]);
+    }
+    REQUIRE(expectedWarm[frame].size() == expected.size());
+  }
+
+  for(unsigned int threadCount : {1u, 2u, 3u, 8u}) {
+    WorkStealingThreadPool threadPool(threadCount);
+    ParallelCollisionTester parallelTester(intersectionTester, threadPool, 64);
+
+    std::vector<CachedSimplex> simplices;
+    for(unsigned int frame = 0; frame < 2; frame++) {
+      ContactBuffer contacts;
+      parallelTester.detectCollisions(pairs, contacts, simplices);
+      REQUIRE(contacts.size() == expectedWarm[frame].size());
+
+      unsigned int mismatches = 0;
+      for(unsigned int index = 0; index < contacts.size(); index++) {
+        mismatches += contacts[index].getPenetration() != expectedWarm[frame][index].getPenetration() ||
+            !(contacts[index].getIntersection() == expectedWarm[frame][index].getIntersection()) ? 1 : 0;
+      }
+      CHECK(mismatches == 0);
+    }
+
+    for(unsigned int frame = 0; frame < 2; frame++) {
+      ContactBuffer contacts;
+      parallelTester.detectCollisions(pairs, contacts);
+      REQUIRE(contacts.size() == expected.size());
+
+      unsigned int mismatches = 0;
+      for(unsigned int index = 0; index < contacts.size(); index++) {
+        mismatches += contacts[index].getGeometryA() != expected[index].getGeometryA() ||
+            contacts[index].getGeometryB() != expected[index].getGeometryB() ||
+            contacts[index].getPenetration() != expected[index].getPenetration() ||
+            !(contacts[index].getNormal() == expected[index].getNormal()) ||
+            !(contacts[index].getIntersection() == expected[index].getIntersection()) ? 1 : 0;
+      }
+      CHECK(mismatches == 0);
+    }
+
+    ContactBuffer bounded(10);
+    parallelTester.detectCollisions(pairs, bounded);
+    REQUIRE(bounded.size() == 10);
+    CHECK(bounded.isOverflowed());
+    CHECK(bounded[9].getGeometryA() == expected[9].getGeometryA());
+  }
+}
+
+TEST_CASE("Grid height map")
+{
+  // planar samples: triangle interpolation is exact anywhere
+  std::vector<real> planeSamples;
+  for(unsigned int row = 0; row < 5; row++) {
+    for(unsigned int column = 0; column < 4; column++) {
+      planeSamples.push_back(10 + 0.5 * column * 2 + 0.25 * row * 2);
+    }
+  }
+  GridHeightMap plane(4, 5, 2, planeSamples);
+  CHECK(plane.getWidth() == 6);
+  CHECK(plane.getDepth() == 8);
+  CHECK(plane.getHeight() == Catch::Approx(10 + 3 + 2));
+  CHECK(plane.heightAt(1.3, 2.9) == Catch::Approx(10 + 0.5 * 1.3 + 0.25 * 2.9));
+  CHECK(plane.heightAt(5.7, 0.2) == Catch::Approx(10 + 0.5 * 5.7 + 0.25 * 0.2));
+  CHECK(plane.heightAt(-10, 100) == Catch::Approx(10 + 0.25 * 8)); // clamped to the border
+  vector expectedNormal = vector(-0.5, 1, -0.25).normalizado();
+  vector normal = plane.normalAt(1.3, 2.9);
+  CHECK(normal.x == Catch::Approx(expectedNormal.x));
+  CHECK(normal.y == Catch::Approx(expectedNormal.y));
+  CHECK(normal.z == Catch::Approx(expectedNormal.z));
+  normal = plane.normalAt(1.9, 3.9);
+  CHECK(normal.x == Catch::Approx(expectedNormal.x));
+  CHECK(normal.z == Catch::Approx(expectedNormal.z));
+
+  // random samples: heights match samples at grid points, are continuous across cell diagonals and batches match one by one sampling
+  std::mt19937 random(99);
+  std::uniform_real_distribution<real> height(0, 5);
+  std::vector<real> samples;
+  for(unsigned int index = 0; index < 16 * 16; index++) {
+    samples.push_back(height(random));
+  }
+  GridHeightMap grid(16, 16, 0.5, samples);
+  CHECK(grid.heightAt(3 * 0.5, 7 * 0.5) == Catch::Approx(grid.getSample(3, 7)));
+  CHECK(grid.heightAt(15 * 0.5, 15 * 0.5) == Catch::Approx(grid.getSample(15, 15)));
+  CHECK(grid.heightAt(2.25 - 1e-4, 2.25) == Catch::Approx(grid.heightAt(2.25 + 1e-4, 2.25)).margin(1e-2));
+
+  std::uniform_real_distribution<real> position(-1, 8.5);
+  std::vector<real> x, z;
+  for(unsigned int index = 0; index < 200; index++) {
+    x.push_back(position(random));
+    z.push_back(position(random));
+  }
+  std::vector<real> heights(x.size());
+  grid.heightsAt(x.data(), z.data(), x.size(), heights.data());
+  const HeightMap &heightMap = grid;
+  std::vector<real> virtualHeights(x.size());
+  heightMap.HeightMap::heightsAt(x.data(), z.data(), x.size(), virtualHeights.data());
+  CHECK(heights == virtualHeights);
+
+  // height map geometry samples the grid directly, and batches match CollisionTester
+  HeightMapGeometry geometry(vector(-1, 0, -1), grid);
+  CHECK(geometry.getGridHeightMap() == &grid);
+  CHECK(geometry.heightAt(1.5, 2) == grid.heightAt(2.5, 3));
+  std::vector<real> geometryHeights(x.size());
+  geometry.heightsAt(x.data(), z.data(), x.size(), geometryHeights.data());
+  for(unsigned int index = 0; index < x.size(); index++) {
+    CHECK(geometryHeights[index] == geometry.heightAt(x[index], z[index]));
+  }
+
+  CollisionTester intersectionTester;
+  std::uniform_real_distribution<real> y(-1, 7);
+  std::uniform_real_distribution<real> radius(0.1, 1.5);
+  std::vector<std::unique_ptr<Sphere>> spheres;
+  SphereBatch batch;
+  for(unsigned int index = 0; index < 300; index++) {
+    spheres.emplace_back(new Sphere(vector(position(random), y(random), position(random)), radius(random)));
+    batch.add(*spheres.back());
+  }
+  std::vector<unsigned int> found;
+  BatchIntersectionHelper::sphereHeightmap(batch, geometry, found);
+  std::vector<unsigned int> expected;
+  for(unsigned int index = 0; index < spheres.size(); index++) {
+    if(intersectionTester.intersects(*spheres[index], geometry)) {
+      expected.push_back(index);
+    }
+  }
+  CHECK(!expected.empty());
+  CHECK(found == expected);
+
+  ContactBuffer contacts;
+  Sphere resting(vector(2, grid.heightAt(3, 3) + 0.5, 2), 0.6);
+  intersectionTester.detectCollision(resting, geometry, contacts);
+  REQUIRE(contacts.size() == 1);
+  CHECK(contacts[0].getNormal() == (resting.getOrigin() - contacts[0].getIntersection()).normalizado());
+  CHECK(contacts[0].getNormal().y > 0);
+  CHECK(contacts[0].getPenetration() > 0);
+}
+
+TEST_CASE("Height map pyramid ray casts and terrain queries")
+{
+  std::mt19937 random(2024);
+  std::uniform_real_distribution<real> height(0, 6);
+  unsigned int columns = 37, rows = 21;
+  real cellSize = 0.5;
+  std::vector<real> samples;
+  for(unsigned int index = 0; index < columns * rows; index++) {
+    samples.push_back(height(random));
+  }
+  GridHeightMap grid(columns, rows, cellSize, samples);
+  vector position(-3, 1, 2);
+  HeightMapGeometry heightmap(position, grid);
+
+  const MinMaxPyramid &pyramid = grid.getPyramid();
+  CHECK(pyramid.getColumns(0) == columns - 1);
+  CHECK(pyramid.getRows(0) == rows - 1);
+  CHECK(pyramid.getColumns(pyramid.getLevelCount() - 1) == 1);
+  CHECK(pyramid.getRows(pyramid.getLevelCount() - 1) == 1);
+  CHECK(pyramid.getMax(pyramid.getLevelCount() - 1, 0, 0) == grid.getHeight());
+
+  auto forEachTriangle = [&](const std::function<void(const vector &, const vector &, const vector &)> &visit) {
+    for(unsigned int row = 0; row + 1 < rows; row++) {
+      for(unsigned int column = 0; column + 1 < columns; column++) {
+        vector a = position + vector(column * cellSize, grid.getSample(column, row), row * cellSize);
+        vector b = position + vector((column + 1) * cellSize, grid.getSample(column + 1, row), row * cellSize);
+        vector c = position + vector(column * cellSize, grid.getSample(column, row + 1), (row + 1) * cellSize);
+        vector d = position + vector((column + 1) * cellSize, grid.getSample(column + 1, row + 1), (row + 1) * cellSize);
+        visit(a, b, c);
+        visit(d, c, b);
+      }
+    }
+  };
+
+  CollisionTester intersectionTester;
+  std::uniform_real_distribution<real> x(-6, 18);
+  std::uniform_real_distribution<real> y(-1, 12);
+  std::uniform_real_distribution<real> z(-1, 14);
+  std::uniform_real_distribution<real> unit(-1, 1);
+
+  unsigned int hits = 0, rayMismatches = 0;
+  for(unsigned int index = 0; index < 200; index++) {
+    Line line(vector(x(random), y(random), z(random)), vector(unit(random), unit(random) - 0.5, unit(random)).normalizado());
+
+    real expectedT = REAL_MAX;
+    forEachTriangle([&](const vector &a, const vector &b, const vector &c) {
+      real t;
+      if(IntersectionHelper::lineTriangle(line.getOrigin(), line.getDirection(), a, b, c, t)) {
+        expectedT = std::min(expectedT, t);
+      }
+    });
+
+    real t;
+    vector normal;
+    bool hit = IntersectionHelper::lineHeightmap(line, heightmap, t, normal);
+    CHECK(intersectionTester.intersects(line, heightmap) == hit);
+    if(hit != (expectedT < REAL_MAX) || (hit && std::fabs(t - expectedT) > 1e-3)) {
+      rayMismatches++;
+    }
+    if(hit) {
+      hits++;
+      vector point = line.getOrigin() + line.getDirection() * t;
+      CHECK(point.y == Catch::Approx(heightmap.heightAt(point.x, point.z) + position.y).margin(1e-3));
+      CHECK(normal.y > 0);
+    }
+  }
+  CHECK(hits > 20);
+  CHECK(rayMismatches == 0);
+
+  // vertical ray straight down
+  real t;
+  vector normal;
+  REQUIRE(IntersectionHelper::lineHeightmap(Line(vector(2.1, 20, 5.3), vector(0, -1, 0)), heightmap, t, normal));
+  CHECK(20 - t == Catch::Approx(heightmap.heightAt(2.1, 5.3) + position.y));
+  CHECK(!IntersectionHelper::lineHeightmap(Line(vector(2.1, 20, 5.3), vector(0, 1, 0)), heightmap, t, normal));
+
+  std::uniform_real_distribution<real> radius(0.1, 2);
+  unsigned int sphereMismatches = 0, sphereHits = 0;
+  for(unsigned int index = 0; index < 200; index++) {
+    Sphere sphere(vector(x(random), y(random), z(random)), radius(random));
+
+    real closestDistance = REAL_MAX;
+    forEachTriangle([&](const vector &a, const vector &b, const vector &c) {
+      vector delta = sphere.getOrigin() - IntersectionHelper::closestTrianglePoint(sphere.getOrigin(), a, b, c);
+      closestDistance = std::min(closestDistance, (real)delta.modulo());
+    });
+
+    bool expected = closestDistance <= sphere.getRadius();
+    if(intersectionTester.intersects(sphere, heightmap) != expected) {
+      sphereMismatches++;
+    }
+
+    ContactBuffer contacts;
+    intersectionTester.detectCollision(sphere, heightmap, contacts);
+    if(contacts.size() != (expected ? 1u : 0u)) {
+      sphereMismatches++;
+    }
+    if(expected && contacts.size() == 1) {
+      sphereHits++;
+      real distance = (sphere.getOrigin() - contacts[0].getIntersection()).modulo();
+      CHECK(distance == Catch::Approx(closestDistance).margin(1e-3));
+      CHECK(contacts[0].getPenetration() >= (real)-1e-4);
+    }
+  }
+  CHECK(sphereHits > 20);
+  CHECK(sphereMismatches == 0);
+
+  // a large sphere touching a slope away from the point below its center
+  std::vector<real> slopeSamples {0, 0, 0, 4, 4, 4};
+  GridHeightMap slope(3, 2, 2, slopeSamples);
+  HeightMapGeometry slopeGeometry(vector(0, 0, 0), slope);
+  Sphere nearSlope(vector(2, 1.5, -0.5), 2);
+  ContactBuffer slopeContacts;
+  intersectionTester.detectCollision(nearSlope, slopeGeometry, slopeContacts);
+  REQUIRE(slopeContacts.size() == 1);
+  CHECK(slopeContacts[0].getNormal().z < 0);
+
+  std::uniform_real_distribution<real> size(0.05, 3);
+  unsigned int aabbMismatches = 0, aabbHits = 0;
+  for(unsigned int index = 0; index < 300; index++) {
+    AABB aabb(vector(x(random), y(random), z(random)), vector(size(random), size(random) * 0.3, size(random)));
+    vector mins = aabb.getMins() - position;
+    vector maxs = aabb.getMaxs() - position;
+
+    real minHeight = REAL_MAX, maxHeight = -REAL_MAX;
+    for(unsigned int row = 0; row + 1 < rows; row++) {
+      for(unsigned int column = 0; column + 1 < columns; column++) {
+        real minX = std::max(mins.x, column * cellSize), maxX = std::min(maxs.x, (column + 1) * cellSize);
+        real minZ = std::max(mins.z, row * cellSize), maxZ = std::min(maxs.z, (row + 1) * cellSize);
+        if(minX > maxX || minZ > maxZ) {
+          continue;
+        }
+        real diagonal = (column + row + 1) * cellSize;
+        real points[8][2] = {{minX, minZ}, {maxX, minZ}, {minX, maxZ}, {maxX, maxZ}, {minX, diagonal - minX}, {maxX, diagonal - maxX}, {diagonal - minZ, minZ}, {diagonal - maxZ, maxZ}};
+        for(auto &point : points) {
+          if(minX <= point[0] && point[0] <= maxX && minZ <= point[1] && point[1] <= maxZ) {
+            minHeight = std::min(minHeight, grid.heightAt(point[0], point[1]));
+            maxHeight = std::max(maxHeight, grid.heightAt(point[0], point[1]));
+          }
+        }
+      }
+    }
+
+    bool expected = minHeight <= maxs.y && maxHeight >= mins.y;
+    aabbHits += expected ? 1 : 0;
+    if(intersectionTester.intersects(aabb, heightmap) != expected) {
+      aabbMismatches++;
+    }
+  }
+  CHECK(aabbHits > 20);
+  CHECK(aabbMismatches == 0);
+}
+
+TEST_CASE("Tiled height map streams tiles within budget")
+{
+  std::mt19937 random(77);
+  std::uniform_int_distribution<int> height(0, 160);
+  unsigned int columns = 70, rows = 45;
+  real cellSize = 0.5;
+  std::vector<real> samples;
+  for(unsigned int index = 0; index < columns * rows; index++) {
+    samples.push_back(height(random) / (real)16); // exact as float, so that both maps have the same samples
+  }
+  GridHeightMap grid(columns, rows, cellSize, samples);
+
+  TemporaryFile file("tiled_height_map_test.bin");
+  const String &path = file.path;
+  CHECK(!TiledHeightMap::write(path, 1, columns * rows, cellSize, samples, 16));
+  CHECK(!TiledHeightMap::write(path, columns * rows, 1, cellSize, samples, 16));
+  CHECK(!TiledHeightMap::write(path, columns, rows, cellSize, samples, 0));
+  CHECK(!TiledHeightMap::write(path, columns, rows + 1, cellSize, samples, 16));
+  REQUIRE(TiledHeightMap::write(path, columns, rows, cellSize, samples, 16));
+
+  CHECK(!TiledHeightMap("missing_tiled_height_map.bin").isOpen());
+  {
+    TiledHeightMap tiled(path, 6 * 17 * 17 * sizeof(real));
+    REQUIRE(tiled.isOpen());
+    CHECK(tiled.getTileCount() == 5 * 3);
+    CHECK(tiled.getWidth() == grid.getWidth());
+    CHECK(tiled.getDepth() == grid.getDepth());
+    CHECK(tiled.getHeight() == grid.getHeight());
+
+    std::uniform_real_distribution<real> x(-1, grid.getWidth() + 1);
+    std::uniform_real_distribution<real> z(-1, grid.getDepth() + 1);
+    std::vector<real> xs, zs;
+    unsigned int mismatches = 0;
+    for(unsigned int index = 0; index < 2000; index++) {
+      xs.push_back(x(random));
+      zs.push_back(z(random));
+      if(tiled.heightAt(xs.back(), zs.back()) != Catch::Approx(grid.heightAt(xs.back(), zs.back())) ||
+          !(tiled.normalAt(xs.back(), zs.back()) == grid.normalAt(xs.back(), zs.back()))) {
+        mismatches++;
+      }
+      CHECK(tiled.getResidentTileCount() * tiled.getTileBytes() <= tiled.getBudget());
+    }
+    CHECK(mismatches == 0);
+    CHECK(tiled.getMissCount() > 0);
+
+    std::vector<real> heights(xs.size());
+    tiled.heightsAt(xs.data(), zs.data(), xs.size(), heights.data());
+    for(unsigned int index = 0; index < xs.size(); index++) {
+      if(heights[index] != Catch::Approx(grid.heightAt(xs[index], zs[index]))) {
+        mismatches++;
+      }
+    }
+    CHECK(mismatches == 0);
+
+    // prefetching ahead of a query means it does not miss
+    tiled.waitForPrefetch();
+    tiled.prefetch(30, 18, 0.1);
+    tiled.waitForPrefetch();
+    CHECK(tiled.isResident(30 / 8, 18 / 8));
+    unsigned long misses = tiled.getMissCount();
+    CHECK(tiled.heightAt(30, 18) == Catch::Approx(grid.heightAt(30, 18)));
+    CHECK(tiled.getMissCount() == misses);
+    CHECK(tiled.getPrefetchCount() > 0);
+
+    // demanded tiles survive a burst of prefetches larger than the budget
+    const real demanded[3][2] = {{1, 1}, {33, 20}, {17, 9}};
+    for(const real *point : demanded) {
+      tiled.heightAt(point[0], point[1]);
+      tiled.waitForPrefetch();
+    }
+    tiled.prefetch(grid.getWidth() * 0.5, grid.getDepth() * 0.5, grid.getWidth());
+    tiled.waitForPrefetch();
+    misses = tiled.getMissCount();
+    for(const real *point : demanded) {
+      CHECK(tiled.isResident((unsigned int)(point[0] / 8), (unsigned int)(point[1] / 8)));
+      CHECK(tiled.heightAt(point[0], point[1]) == Catch::Approx(grid.heightAt(point[0], point[1])));
+    }
+    CHECK(tiled.getMissCount() == misses);
+
+    // usable anywhere a height map is
+    HeightMapGeometry heightmap(vector(10, 0, 10), tiled);
+    CollisionTester intersectionTester;
+    Sphere below(vector(20, tiled.heightAt(10, 10) - 0.05, 20), 0.1);
+    Sphere above(vector(20, grid.getHeight() + 1, 20), 0.1);
+    CHECK(intersectionTester.intersects(below, heightmap));
+    CHECK(!intersectionTester.intersects(above, heightmap));
+    CHECK(intersectionTester.detectCollision(below, heightmap).size() == 1);
+
+    // rays march over heightAt, and hit where rays against the same samples on a grid do
+    HeightMapGeometry gridHeightmap(vector(10, 0, 10), grid);
+    std::uniform_real_distribution<real> unit(-1, 1);
+    unsigned int hits = 0, rayMismatches = 0;
+    for(unsigned int index = 0; index < 200; index++) {
+      Line ray(vector(10 + x(random), 15, 10 + z(random)), vector(unit(random), -0.4 - std::fabs(unit(random)), unit(random)));
+      real t, expectedT;
+      vector normal, expectedNormal;
+      bool hit = IntersectionHelper::lineHeightmap(ray, heightmap, t, normal);
+      CHECK(intersectionTester.intersects(ray, heightmap) == hit);
+      if(hit != IntersectionHelper::lineHeightmap(ray, gridHeightmap, expectedT, expectedNormal) || (hit && (std::fabs(t - expectedT) > 1e-3 || !(normal == expectedNormal)))) {
+        rayMismatches++;
+      }
+      hits += hit ? 1 : 0;
+    }
+    CHECK(hits > 100);
+    CHECK(rayMismatches == 0);
+    real t;
+    vector normal;
+    REQUIRE(IntersectionHelper::lineHeightmap(Line(vector(21.3, 20, 17.9), vector(0, -1, 0)), heightmap, t, normal));
+    CHECK(20 - t == Catch::Approx(tiled.heightAt(11.3, 7.9)).margin(1e-4));
+    CHECK(!IntersectionHelper::lineHeightmap(Line(vector(21.3, 20, 17.9), vector(0, 1, 0)), heightmap, t, normal));
+  }
+
+  // prefetches still land once the budget is full of tiles queries read, in their own share of it, and do not evict those tiles
+  {
+    std::size_t tileBytes = 17 * 17 * sizeof(real);
+    TiledHeightMap tiled(path, 9 * tileBytes, 3 * tileBytes);
+    REQUIRE(tiled.isOpen());
+    CHECK(tiled.getPrefetchBudget() == 3 * tileBytes);
+    for(unsigned int column = 0; column < 3; column++) {
+      for(unsigned int row = 0; row < 3; row++) {
+        tiled.heightAt(column * 8 + 4, row * 8 + 4);
+        tiled.waitForPrefetch();
+      }
+    }
+    CHECK(tiled.getResidentTileCount() == 9);
+
+    for(unsigned int row = 0; row < 3; row++) {
+      tiled.prefetch(36, row * 8 + 4, 0.1);
+    }
+    tiled.waitForPrefetch();
+    CHECK(tiled.getResidentTileCount() == 9);
+    for(unsigned int row = 0; row < 3; row++) {
+      CHECK(tiled.isResident(1, row));
+      CHECK(tiled.isResident(2, row));
+      CHECK(tiled.isResident(4, row));
+    }
+
+    unsigned long misses = tiled.getMissCount();
+    for(unsigned int row = 0; row < 3; row++) {
+      CHECK(tiled.heightAt(36, row * 8 + 4) == Catch::Approx(grid.heightAt(36, row * 8 + 4)));
+      CHECK(tiled.heightAt(12, row * 8 + 4) == Catch::Approx(grid.heightAt(12, row * 8 + 4)));
+    }
+    CHECK(tiled.getMissCount() == misses);
+  }
+
+  // no room for prefetches besides the one tile always kept
+  {
+    TiledHeightMap tiled(path, 17 * 17 * sizeof(real));
+    CHECK(tiled.getPrefetchBudget() == 0);
+    tiled.prefetch(4, 4, 0.1);
+    tiled.waitForPrefetch();
+    CHECK(tiled.getResidentTileCount() == 0);
+    CHECK(tiled.getPrefetchCount() == 0);
+  }
+}
+
+TEST_CASE("Oriented bounding boxes")
+{
+  CollisionTester intersectionTester;
+  real halfSquareRoot = std::sqrt((real)0.5);
+
+  OOBB rotated(vector(0, 0, 0), vector(1, 1, 1), vector(halfSquareRoot, 0, halfSquareRoot), vector(0, 1, 0)); // 45 degrees around y
+  CHECK(rotated.getAxis(2) == vector(-halfSquareRoot, 0, halfSquareRoot));
+  CHECK(rotated.getBounds().maxs == vector(2 * halfSquareRoot, 1, 2 * halfSquareRoot));
+  CHECK(rotated.contains(vector(1.3, 0, 0)));
+  CHECK(!rotated.contains(vector(1, 0, 1)));
+  CHECK(rotated.toWorld(rotated.toLocal(vector(0.3, -2, 5))) == vector(0.3, -2, 5));
+
+  CHECK(intersectionTester.intersects(Line(vector(-5, 0, 1.2), vector(1, 0, 0)), rotated));
+  CHECK(!intersectionTester.intersects(Line(vector(-5, 0, 1.5), vector(1, 0, 0)), rotated));
+  CHECK(!intersectionTester.intersects(Line(vector(5, 0, 0), vector(1, 0, 0)), rotated));
+  CHECK(intersectionTester.intersects(Plane(vector(1.3, 0, 0), vector(1, 0, 0)), rotated));
+  CHECK(!intersectionTester.intersects(Plane(vector(1.5, 0, 0), vector(1, 0, 0)), rotated));
+  CHECK(intersectionTester.intersects(Sphere(vector(1.6, 0, 0), 0.2), rotated));
+  CHECK(!intersectionTester.intersects(Sphere(vector(1.2, 0, 1.2), 0.2), rotated));
+  CHECK(intersectionTester.intersects(AABB(vector(2, 0, 0), vector(0.6, 0.5, 0.1)), rotated));
+  CHECK(!intersectionTester.intersects(AABB(vector(1, 0, 1), vector(0.25, 0.5, 0.25)), rotated));
+
+  std::mt19937 random(15);
+  std::uniform_real_distribution<real> position(-4, 4);
+  std::uniform_real_distribution<real> size(0.1, 2);
+  std::uniform_real_distribution<real> unit(-1, 1);
+  auto randomOobb = [&]() {
+    return OOBB(vector(position(random), position(random), position(random)), vector(size(random), size(random), size(random)),
+        vector(unit(random), unit(random), unit(random)), vector(unit(random), unit(random), unit(random)));
+  };
+
+  unsigned int aabbMismatches = 0, overlapping = 0, withoutContacts = 0, contactMismatches = 0;
+  for(unsigned int index = 0; index < 2000; index++) {
+    AABB aabb(vector(position(random), position(random), position(random)), vector(size(random), size(random), size(random)));
+    AABB anotherAabb(vector(position(random), position(random), position(random)), vector(size(random), size(random), size(random)));
+    if(intersectionTester.intersects(aabb, OOBB(anotherAabb.getOrigin(), anotherAabb.getHalfSizes())) != intersectionTester.intersects(aabb, anotherAabb)) {
+      aabbMismatches++;
+    }
+
+    OOBB oobb = randomOobb();
+    OOBB anotherOobb = randomOobb();
+    bool intersects = intersectionTester.intersects(oobb, anotherOobb);
+    CHECK(intersects == StaticCollisionTester::intersects(anotherOobb, oobb));
+    CHECK(intersectionTester.intersects(aabb, oobb) == intersectionTester.intersects(OOBB(aabb.getOrigin(), aabb.getHalfSizes()), oobb));
+
+    if(intersects) {
+      overlapping++;
+      // a point inside both boxes, when sampling finds one, proves overlap
+      CHECK(oobb.getBounds().overlaps(anotherOobb.getBounds()));
+    }
+
+    ContactBuffer contacts;
+    intersectionTester.detectCollision(oobb, anotherOobb, contacts);
+    CHECK(contacts.size() <= 4);
+    if(!contacts.empty() && !intersects) {
+      contactMismatches++;
+    }
+    if(contacts.empty() && intersects) {
+      withoutContacts++;
+    }
+    for(const GeometryContact &contact : contacts) {
+      CHECK(contact.getNormal().modulo() == Catch::Approx(1));
+      CHECK(contact.getPenetration() >= 0);
+      CHECK(contact.getGeometryA() == &oobb);
+      // b is on the negative side of the normal
+      CHECK((contact.getIntersection() - anotherOobb.getOrigin()) * contact.getNormal() >= (oobb.getOrigin() - anotherOobb.getOrigin()) * contact.getNormal() - 2 * (oobb.getHalfSizes().modulo() + anotherOobb.getHalfSizes().modulo()));
+    }
+  }
+  CHECK(aabbMismatches == 0);
+  CHECK(contactMismatches == 0);
+  CHECK(overlapping > 100);
+  CHECK(withoutContacts <= overlapping / 50);
+
+  // crate resting on a rotated floor: face contact, 4 points
+  OOBB floor(vector(0, -1, 0), vector(10, 1, 10), vector(std::cos((real)0.5), 0, std::sin((real)0.5)), vector(0, 1, 0));
+  OOBB crate(vector(1, 0.49, 2), vector(0.5, 0.5, 0.5), vector(std::cos((real)0.2), 0, std::sin((real)0.2)), vector(0, 1, 0));
+  std::vector<GeometryContact> resting = intersectionTester.detectCollision(crate, floor);
+  REQUIRE(resting.size() == 4);
+  for(const GeometryContact &contact : resting) {
+    CHECK(contact.getNormal() == vector(0, 1, 0));
+    CHECK(contact.getPenetration() == Catch::Approx(0.01).margin(1e-4));
+    CHECK(contact.getIntersection().y == Catch::Approx(-0.005).margin(1e-4));
+  }
+
+  // same in reverse order flips the normal
+  std::vector<GeometryContact> reversed = intersectionTester.detectCollision(floor, crate);
+  REQUIRE(reversed.size() == 4);
+  CHECK(reversed[0].getNormal() == vector(0, -1, 0));
+  CHECK(reversed[0].getGeometryA() == &floor);
+
+  // crate standing on an edge: 2 points
+  OOBB edgeCrate(vector(0, 2 * halfSquareRoot * 0.5 - 0.02, 0), vector(0.5, 0.5, 0.5), vector(halfSquareRoot, halfSquareRoot, 0), vector(-halfSquareRoot, halfSquareRoot, 0));
+  std::vector<GeometryContact> edge = intersectionTester.detectCollision(edgeCrate, floor);
+  REQUIRE(edge.size() == 2);
+  CHECK(edge[0].getNormal() == vector(0, 1, 0));
+  CHECK(edge[0].getPenetration() == Catch::Approx(0.02).margin(1e-4));
+
+  // crossing edges: single contact between the edges
+  OOBB lower(vector(0, 0, 0), vector(1, 1, 1), vector(1, 0, 0), vector(0, halfSquareRoot, halfSquareRoot));
+  OOBB upper(vector(0, 4 * halfSquareRoot - 0.1, 0), vector(1, 1, 1), vector(halfSquareRoot, halfSquareRoot, 0), vector(-halfSquareRoot, halfSquareRoot, 0));
+  std::vector<GeometryContact> crossing = intersectionTester.detectCollision(lower, upper);
+  REQUIRE(crossing.size() == 1);
+  CHECK(crossing[0].getNormal() == vector(0, -1, 0));
+  CHECK(crossing[0].getPenetration() == Catch::Approx(0.1).margin(1e-4));
+  CHECK(crossing[0].getIntersection() == vector(0, 2 * halfSquareRoot - 0.05, 0));
+
+  // aabb on an oobb: normal from the oobb to the aabb
+  std::vector<GeometryContact> aabbContacts = intersectionTester.detectCollision(AABB(vector(1, 0.45, 2), vector(0.5, 0.5, 0.5)), floor);
+  REQUIRE(aabbContacts.size() == 4);
+  CHECK(aabbContacts[0].getNormal() == vector(0, 1, 0));
+
+  // box on a plane
+  Plane ground(vector(0, 0, 0), vector(0, 1, 0));
+  std::vector<GeometryContact> planeContacts = intersectionTester.detectCollision(ground, OOBB(vector(0, 0.45, 0), vector(0.5, 0.5, 0.5), vector(1, 0, 1), vector(0, 1, 0)));
+  REQUIRE(planeContacts.size() == 4);
+  CHECK(planeContacts[0].getPenetration() == Catch::Approx(0.05));
+  CHECK(planeContacts[0].getNormal() == vector(0, 1, 0));
+  CHECK(intersectionTester.detectCollision(ground, OOBB(vector(0, 0.55, 0), vector(0.5, 0.5, 0.5))).empty());
+
+  // spheres: outside and center inside the box
+  std::vector<GeometryContact> sphereContacts = intersectionTester.detectCollision(Sphere(vector(1.6, 0, 0), 0.3), rotated);
+  REQUIRE(sphereContacts.size() == 1);
+  CHECK(sphereContacts[0].getNormal() == vector(1, 0, 0)); // closest to the vertical edge at x = sqrt(2)
+  CHECK(sphereContacts[0].getPenetration() == Catch::Approx(0.3 - (1.6 - 2 * halfSquareRoot)));
+  Sphere inside(vector(0, 0.8, 0), 0.1);
+  sphereContacts = intersectionTester.detectCollision(inside, rotated);
+  REQUIRE(sphereContacts.size() == 1);
+  CHECK(sphereContacts[0].getNormal() == vector(0, 1, 0));
+  CHECK(sphereContacts[0].getPenetration() == Catch::Approx(0.3));
+}
+
+TEST_CASE("GJK and EPA convex fallback")
+{
+  CollisionTester intersectionTester;
+
+  // aabb / aabb contacts have no hand written kernel: GJK / EPA backs them
+  AABB aabb(vector(0, 0, 0), vector(1, 1, 1));
+  AABB overlapping(vector(1.9, 0.5, 0.3), vector(1, 1, 1));
+  std::vector<GeometryContact> contacts = intersectionTester.detectCollision(overlapping, aabb);
+  REQUIRE(contacts.size() == 1);
+  CHECK(contacts[0].getNormal() == vector(1, 0, 0));
+  CHECK(contacts[0].getPenetration() == Catch::Approx(0.1));
+  CHECK(contacts[0].getGeometryA() == &overlapping);
+  CHECK(StaticCollisionTester::detectCollision(overlapping, aabb).size() == 1);
+  CHECK(intersectionTester.detectCollision(AABB(vector(2.1, 0, 0), vector(1, 1, 1)), aabb).empty());
+
+  // contacts warm start from the caller's simplex of the pair: a coherent second frame takes fewer GJK iterations, for the same contact
+  AABB tilted(vector(1.7, 0.9, -0.4), vector(0.8, 1.2, 0.6));
+  CachedSimplex simplex;
+  ContactBuffer firstFrame, secondFrame, cold;
+  intersectionTester.detectCollision(tilted, aabb, firstFrame, simplex);
+  unsigned int firstFrameIterations = simplex.getIterations();
+  tilted.setOrigin(vector(1.68, 0.91, -0.4));
+  intersectionTester.detectCollision(tilted, aabb, secondFrame, simplex);
+  intersectionTester.detectCollision(tilted, aabb, cold);
+  REQUIRE(firstFrame.size() == 1);
+  REQUIRE(secondFrame.size() == 1);
+  REQUIRE(cold.size() == 1);
+  CHECK(firstFrameIterations > 1);
+  CHECK(simplex.getIterations() < firstFrameIterations);
+  CHECK(secondFrame[0].getPenetration() == Catch::Approx(cold[0].getPenetration()));
+  CHECK(secondFrame[0].getNormal() == cold[0].getNormal());
+
+  // kept in the contact manifold, in either operand order
+  ContactCache contactCache;
+  ContactBuffer cachedContacts;
+  contactCache.beginFrame();
+  contactCache.detectCollision(intersectionTester, tilted, aabb, cachedContacts);
+  contactCache.endFrame();
+  REQUIRE(contactCache.find(&tilted, &aabb) != nullptr);
+  CHECK(contactCache.find(&tilted, &aabb)->getSimplex().getIterations() > 1); // new manifold, cold start
+  tilted.setOrigin(vector(1.7, 0.9, -0.4));
+  cachedContacts.clear();
+  contactCache.beginFrame();
+  contactCache.detectCollision(intersectionTester, aabb, tilted, cachedContacts);
+  contactCache.endFrame();
+  REQUIRE(cachedContacts.size() == 1);
+  CHECK(contactCache.find(&tilted, &aabb)->getSimplex().getIterations() < firstFrameIterations);
+  CHECK(cachedContacts[0].getPenetration() == Catch::Approx(firstFrame[0].getPenetration()));
+  CHECK(contactCache.find(&tilted, &aabb)->size() == 1);
+
+  std::mt19937 random(16);
+  std::uniform_real_distribution<real> position(-3, 3);
+  std::uniform_real_distribution<real> size(0.1, 2);
+  std::uniform_real_distribution<real> unit(-1, 1);
+
+  unsigned int mismatches = 0, overlaps = 0, distanceMismatches = 0, depthMismatches = 0, pushMismatches = 0;
+  for(unsigned int index = 0; index < 2000; index++) {
+    Sphere sphere(vector(position(random), position(random), position(random)), size(random));
+    Sphere anotherSphere(vector(position(random), position(random), position(random)), size(random));
+    AABB box(vector(position(random), position(random), position(random)), vector(size(random), size(random), size(random)));
+    OOBB oobb(vector(position(random), position(random), position(random)), vector(size(random), size(random), size(random)),
+        vector(unit(random), unit(random), unit(random)), vector(unit(random), unit(random), unit(random)));
+    OOBB anotherOobb(vector(position(random), position(random), position(random)), vector(size(random), size(random), size(random)),
+        vector(unit(random), unit(random), unit(random)), vector(unit(random), unit(random), unit(random)));
+
+    mismatches += GjkEpa::intersects(sphere, anotherSphere) != IntersectionHelper::sphereSphere(sphere, anotherSphere) ? 1 : 0;
+    mismatches += GjkEpa::intersects(sphere, box) != IntersectionHelper::sphereAabb(sphere, box) ? 1 : 0;
+    mismatches += GjkEpa::intersects(sphere, oobb) != IntersectionHelper::sphereOobb(sphere, oobb) ? 1 : 0;
+    mismatches += GjkEpa::intersects(box, oobb) != IntersectionHelper::aabbOobb(box, oobb) ? 1 : 0;
+    mismatches += GjkEpa::intersects((const Geometry &)oobb, (const Geometry &)anotherOobb) != IntersectionHelper::oobbOobb(oobb, anotherOobb) ? 1 : 0;
+
+    real gap = (sphere.getOrigin() - anotherSphere.getOrigin()).modulo() - sphere.getRadius() - anotherSphere.getRadius();
+    GjkResult result = GjkEpa::distance(sphere, anotherSphere);
+    if(gap > 0) {
+      distanceMismatches += result.intersecting || std::fabs(result.distance - gap) > 1e-3 || std::fabs((result.pointA - sphere.getOrigin()).modulo() - sphere.getRadius()) > 1e-3 ? 1 : 0;
+    }
+
+    vector normal, pointA, pointB;
+    real depth;
+    if(gap < -1e-3 && GjkEpa::penetration(sphere, anotherSphere, normal, depth, pointA, pointB)) {
+      depthMismatches += std::fabs(depth + gap) > -gap * 0.01 ? 1 : 0;
+    }
+
+    if(GjkEpa::penetration(oobb, anotherOobb, normal, depth, pointA, pointB)) {
+      overlaps++;
+      OOBB separated(oobb.getOrigin() + normal * (depth + 1e-3), oobb.getHalfSizes(), oobb.getAxis(0), oobb.getAxis(1));
+      OOBB stillOverlapping(oobb.getOrigin() + normal * (depth * 0.98 - 1e-3), oobb.getHalfSizes(), oobb.getAxis(0), oobb.getAxis(1));
+      pushMismatches += IntersectionHelper::oobbOobb(separated, anotherOobb) || (depth > 0.05 && !IntersectionHelper::oobbOobb(stillOverlapping, anotherOobb)) ? 1 : 0;
+    }
+  }
+  CHECK(overlaps > 100);
+  CHECK(mismatches <= 2); // touching pairs, within tolerance
+  CHECK(distanceMismatches == 0);
+  CHECK(depthMismatches <= 2);
+  CHECK(pushMismatches == 0);
+
+  // coherent frames start from the cached simplex
+  SimplexCache cache;
+  OOBB fixed(vector(0, 0, 0), vector(1, 1, 1), vector(1, 1, 0), vector(-1, 1, 0));
+  unsigned int coldIterations = 0, warmIterations = 0;
+  for(unsigned int frame = 0; frame < 200; frame++) {
+    OOBB moving(vector(-3 + frame * 0.03, 0.2, 0.1), vector(1, 0.5, 0.7), vector(1, frame * 0.001, 0), vector(0, 1, 0));
+    Simplex simplex, anotherSimplex;
+    GjkResult cold, warm;
+    GjkEpa::gjk(moving, fixed, simplex, true, cold, nullptr);
+    GjkEpa::gjk(moving, fixed, anotherSimplex, true, warm, &cache);
+    CHECK(cold.intersecting == warm.intersecting);
+    coldIterations += cold.iterations;
+    warmIterations += warm.iterations;
+  }
+  CHECK(warmIterations <= 200 * 2);
+  CHECK(warmIterations < coldIterations);
+}
+
+static std::unique_ptr<Geometry> translated(const Geometry &geometry, const vector &offset) {
+  switch(geometry.getType()) {
+    case GeometryType::SPHERE:
+      return std::unique_ptr<Geometry>(new Sphere(geometry.getOrigin() + offset, ((const Sphere &)geometry).getRadius()));
+    case GeometryType::AABB:
+      return std::unique_ptr<Geometry>(new AABB(geometry.getOrigin() + offset, ((const AABB &)geometry).getHalfSizes()));
+    case GeometryType::OOBB: {
+      const OOBB &oobb = (const OOBB &)geometry;
+      return std::unique_ptr<Geometry>(new OOBB(geometry.getOrigin() + offset, oobb.getHalfSizes(), oobb.getAxis(0), oobb.getAxis(1)));
+    }
+    case GeometryType::PLANE:
+      return std::unique_ptr<Geometry>(new Plane(geometry.getOrigin() + offset, ((const Plane &)geometry).getNormal()));
+    default:
+      return std::unique_ptr<Geometry>();
+  }
+}
+
+TEST_CASE("Continuous collision detection")
+{
+  CollisionTester intersectionTester;
+  ContinuousCollisionTester sweepTester;
+  TimeOfImpact result;
+
+  // a fast projectile tunnels through a thin wall with discrete tests
+  Sphere bullet(vector(-10, 0.5, 0), 0.05);
+  AABB wall(vector(0, 0, 0), vector(0.05, 2, 2));
+  vector bulletEnd(10, 0.5, 0);
+  CHECK(!intersectionTester.intersects(bullet, wall));
+  CHECK(!intersectionTester.intersects(Sphere(bulletEnd, 0.05), wall));
+  REQUIRE(sweepTester.timeOfImpact(bullet, bulletEnd, wall, wall.getOrigin(), result));
+  CHECK(result.time == Catch::Approx(9.9 / 20));
+  CHECK(result.normal == vector(-1, 0, 0));
+  CHECK(result.intersection == vector(-0.05, 0.5, 0));
+
+  REQUIRE(sweepTester.timeOfImpact(wall, wall.getOrigin(), bullet, bulletEnd, result));
+  CHECK(result.time == Catch::Approx(9.9 / 20));
+  CHECK(result.normal == vector(1, 0, 0));
+
+  ContactBuffer contacts;
+  CHECK(sweepTester.detectCollision(bullet, bulletEnd, wall, wall.getOrigin(), contacts) == Catch::Approx(9.9 / 20));
+  REQUIRE(contacts.size() == 1);
+  CHECK(contacts[0].getGeometryA() == &bullet);
+  CHECK(sweepTester.detectCollision(bullet, vector(-10, 3, 0), wall, wall.getOrigin(), contacts) == 1);
+  CHECK(contacts.size() == 1);
+
+  // edges and corners are rounded by the sphere radius
+  vector edge(-0.05, 2, 0);
+  REQUIRE(sweepTester.timeOfImpact(Sphere(vector(-2, 3.95, 0), 0.5), vector(2, -0.05, 0), wall, wall.getOrigin(), result));
+  CHECK(result.time == Catch::Approx((1.95 * std::sqrt(2.0) - 0.5) / (4 * std::sqrt(2.0))));
+  CHECK(result.intersection == edge);
+  CHECK(result.normal == vector(-1, 1, 0).normalizado());
+  CHECK(!sweepTester.timeOfImpact(Sphere(vector(-2.5, 0.45, 0), 0.5), vector(0.5, 3.45, 0), wall, wall.getOrigin(), result)); // through the corner of the grown box only
+
+  vector corner(0.05, 2, 2);
+  REQUIRE(sweepTester.timeOfImpact(Sphere(corner + vector(1, 1, 1), 0.5), corner - vector(1, 1, 1), wall, wall.getOrigin(), result));
+  CHECK(result.time == Catch::Approx((std::sqrt(3.0) - 0.5) / (2 * std::sqrt(3.0))));
+  CHECK(result.intersection == corner);
+
+  // both moving
+  REQUIRE(sweepTester.timeOfImpact(Sphere(vector(-5, 0, 0), 1), vector(5, 0, 0), Sphere(vector(5, 0, 0), 1), vector(-5, 0, 0), result));
+  CHECK(result.time == Catch::Approx(0.4));
+  CHECK(result.intersection == vector(0, 0, 0));
+  CHECK(result.normal == vector(-1, 0, 0));
+
+  // planes are half spaces
+  Plane ground(vector(0, 0, 0), vector(0, 1, 0));
+  REQUIRE(sweepTester.timeOfImpact(Sphere(vector(0, 10, 0), 1), vector(0, -30, 0), ground, ground.getOrigin(), result));
+  CHECK(result.time == Catch::Approx(9.0 / 40));
+  CHECK(result.normal == vector(0, 1, 0));
+  CHECK(!sweepTester.timeOfImpact(Sphere(vector(0, 10, 0), 1), vector(0, 20, 0), ground, ground.getOrigin(), result));
+  REQUIRE(sweepTester.timeOfImpact(ground, ground.getOrigin(), OOBB(vector(0, 10, 0), vector(1, 1, 1), vector(1, 1, 0), vector(-1, 1, 0)), vector(0, -30, 0), result));
+  CHECK(result.time == Catch::Approx((10 - std::sqrt(2.0)) / 40));
+  CHECK(result.normal == vector(0, -1, 0));
+
+  // already intersecting at the start
+  REQUIRE(sweepTester.timeOfImpact(Sphere(vector(0.1, 0, 0), 0.5), vector(0.1, 0, 0), wall, wall.getOrigin(), result));
+  CHECK(result.time == 0);
+
+  // conservative advancement: a rotated crate through a thin rotated wall
+  OOBB crate(vector(-10, 0.2, 0.1), vector(0.2, 0.2, 0.2), vector(1, 1, 1), vector(0, 1, -1));
+  OOBB rotatedWall(vector(0, 0, 0), vector(0.05, 3, 3), vector(1, 0.2, 0), vector(0, 1, 0));
+  REQUIRE(sweepTester.timeOfImpact(crate, vector(10, 0.2, 0.1), rotatedWall, rotatedWall.getOrigin(), result));
+  CHECK(result.iterations <= 4);
+  std::unique_ptr<Geometry> atImpact = translated(crate, vector(20, 0, 0) * result.time);
+  std::unique_ptr<Geometry> pastImpact = translated(crate, vector(20, 0, 0) * (result.time + 0.001));
+  CHECK(!intersectionTester.intersects(*atImpact, rotatedWall));
+  CHECK(intersectionTester.intersects(*pastImpact, rotatedWall));
+  CHECK(GjkEpa::distance(*atImpact, rotatedWall).distance <= sweepTester.getTolerance());
+  CHECK(result.normal * vector(1, 0, 0) < 0);
+
+  // grazing a box edge converges slowly: out of iterations is inconclusive, and only as far as is known to be safe
+  Sphere grazing(vector(-5, 1.5, 1.5), 0.5 * std::sqrt(2.0));
+  OOBB box(vector(0, 0, 0), vector(1, 1, 1), vector(1, 0, 0), vector(0, 1, 0));
+  REQUIRE(sweepTester.timeOfImpact(grazing, vector(5, 1.5, 1.5), box, box.getOrigin(), result));
+  CHECK(result.iterations > 3);
+  real grazingTime = result.time;
+  CHECK(!ContinuousCollisionTester::conservativeAdvancement(grazing, vector(10, 0, 0), box, vector(0, 0, 0), sweepTester.getTolerance(), result, 3));
+  CHECK(!result.hit);
+  CHECK(result.inconclusive);
+  CHECK(result.time > 0);
+  CHECK(result.time < grazingTime);
+  CHECK(!intersectionTester.intersects(*translated(grazing, vector(10, 0, 0) * result.time), box));
+
+  // against sampling discrete tests along the motion
+  std::mt19937 random(17);
+  std::uniform_real_distribution<real> position(-2, 2);
+  std::uniform_real_distribution<real> motion(-6, 6);
+  std::uniform_real_distribution<real> size(0.1, 1);
+  std::uniform_real_distribution<real> unit(-1, 1);
+  auto randomGeometry = [&](unsigned int type) {
+    vector origin(position(random), position(random), position(random));
+    switch(type) {
+      case 0:
+        return std::unique_ptr<Geometry>(new Sphere(origin, size(random)));
+      case 1:
+        return std::unique_ptr<Geometry>(new AABB(origin, vector(size(random), size(random), size(random))));
+      case 2:
+        return std::unique_ptr<Geometry>(new OOBB(origin, vector(size(random), size(random), size(random)), vector(unit(random), unit(random), unit(random)), vector(unit(random), unit(random), unit(random))));
+      default:
+        return std::unique_ptr<Geometry>(new Plane(origin - vector(0, 10, 0), vector(unit(random) * 0.2, 1, unit(random) * 0.2))); // below everything
+    }
+  };
+
+  const unsigned int steps = 1000;
+  unsigned int hits = 0, mismatches = 0;
+  for(unsigned int type = 0; type < 3; type++) {
+    for(unsigned int anotherType = 0; anotherType < 4; anotherType++) {
+      for(unsigned int index = 0; index < 100; index++) {
+        std::unique_ptr<Geometry> geometry = randomGeometry(type);
+        std::unique_ptr<Geometry> anotherGeometry = randomGeometry(anotherType);
+        vector displacement = vector(motion(random), motion(random), motion(random)) - (anotherType == 3 ? vector(0, 8, 0) : vector(0, 0, 0));
+        vector anotherDisplacement = anotherType == 3 ? vector(0, 0, 0) : vector(motion(random), motion(random), motion(random));
+
+        int firstStep = -1;
+        for(unsigned int step = 0; step <= steps && firstStep < 0; step++) {
+          real time = (real)step / steps;
+          if(intersectionTester.intersects(*translated(*geometry, displacement * time), *translated(*anotherGeometry, anotherDisplacement * time))) {
+            firstStep = step;
+          }
+        }
+
+        bool hit = sweepTester.timeOfImpact(*geometry, geometry->getOrigin() + displacement, *anotherGeometry, anotherGeometry->getOrigin() + anotherDisplacement, result);
+        if(firstStep < 0) {
+          mismatches += hit ? 1 : 0; // grazing between samples
+        } else {
+          hits++;
+          mismatches += !hit || result.time > (real)firstStep / steps + 1e-4 || result.time < (real)(firstStep - 1) / steps - 1e-3 ? 1 : 0;
+        }
+      }
+    }
+  }
+  CHECK(hits > 200);
+  CHECK(mismatches <= 3); // grazing approaches, within tolerance of touching before the discrete tests see them
+}
+
+TEST_CASE("Collision stats merge per thread counters")
+{
+  CollisionStats stats;
+  std::vector<std::thread> threads;
+  for(unsigned int thread = 0; thread < 4; thread++) {
+    threads.emplace_back([&stats, thread]() {
+      for(unsigned int index = 0; index < 1000; index++) {
+        stats.record(CollisionOperation::INTERSECTION, GeometryType::SPHERE, GeometryType::AABB, true, false, index % 4 == thread, 10);
+      }
+      stats.record(CollisionOperation::CONTACT, GeometryType::AABB, GeometryType::SPHERE, true, true, true, 5);
+      stats.record(CollisionOperation::CONTACT, GeometryType::LINE, GeometryType::LINE, false, false, false, 1);
+    });
+  }
+  for(std::thread &thread : threads) {
+    thread.join();
+  }
+  CHECK(stats.getThreadCount() == 4);
+
+  CollisionStatsSnapshot snapshot = stats.snapshot();
+  const CollisionPairStats &sphereAabb = snapshot.get(CollisionOperation::INTERSECTION, GeometryType::SPHERE, GeometryType::AABB);
+  CHECK(sphereAabb.calls == 4000);
+  CHECK(sphereAabb.hits == 1000);
+  CHECK(sphereAabb.swapped == 0);
+  CHECK(sphereAabb.nanoseconds == 40000);
+  CHECK(snapshot.get(CollisionOperation::CONTACT, GeometryType::AABB, GeometryType::SPHERE).swapped == 4);
+  CHECK(snapshot.get(CollisionOperation::CONTACT, GeometryType::LINE, GeometryType::LINE).unsupported == 4);
+  CHECK(snapshot.total(CollisionOperation::CONTACT).calls == 8);
+
+  stats.record(CollisionOperation::INTERSECTION, GeometryType::SPHERE, GeometryType::AABB, true, false, true, 10);
+  CollisionStatsSnapshot delta = stats.snapshot() - snapshot;
+  CHECK(delta.total(CollisionOperation::INTERSECTION).calls == 1);
+  CHECK(delta.total(CollisionOperation::INTERSECTION).hits == 1);
+  CHECK(delta.total(CollisionOperation::CONTACT).calls == 0);
+
+  CollisionTester tester;
+  String report = tester.toString(snapshot);
+  CHECK(report.find("intersects SPHERE<->AABB: calls 4000, hits 1000, swapped 0, unsupported 0, 40us (10ns/call)") == 0); // slowest first
+  CHECK(report.find("contacts LINE<->LINE: calls 4, hits 0, swapped 0, unsupported 4") != String::npos);
+
+#ifdef GEOMETRY_COLLISION_STATS
+  CollisionStatsSnapshot before = tester.getStats().snapshot();
+  Sphere sphere(vector(0, 0, 0), 1);
+  AABB aabb(vector(1, 0, 0), vector(1, 1, 1));
+  Line line(vector(0, 0, 0), vector(1, 0, 0));
+  CHECK(tester.intersects(sphere, aabb));
+  CHECK(tester.intersects(aabb, sphere));
+  CHECK(!tester.intersects(line, line));
+  ContactBuffer contacts;
+  tester.detectCollision(aabb, sphere, contacts);
+  CHECK(contacts.size() > 0);
+
+  CollisionStatsSnapshot after = tester.getStats().snapshot() - before;
+  CHECK(after.get(CollisionOperation::INTERSECTION, GeometryType::SPHERE, GeometryType::AABB).hits == 1);
+  CHECK(after.get(CollisionOperation::INTERSECTION, GeometryType::AABB, GeometryType::SPHERE).swapped == 1);
+  CHECK(after.get(CollisionOperation::INTERSECTION, GeometryType::LINE, GeometryType::LINE).unsupported == 1);
+  CHECK(after.get(CollisionOperation::CONTACT, GeometryType::AABB, GeometryType::SPHERE).hits == 1);
+#endif
+}
+
+TEST_CASE("Linear bvh matches the hierarchy it was compiled from")
+{
+  std::mt19937 random(2022);
+  std::uniform_real_distribution<real> unit(-1, 1);
+  std::uniform_real_distribution<real> size(0.2, 1);
+
+  std::function<std::unique_ptr<Geometry>(const vector &, real, unsigned int)> build = [&](const vector &center, real radius, unsigned int depth) {
+    vector origin = center + vector(unit(random), unit(random), unit(random)) * radius;
+    if(depth == 0) {
+      switch(random() % 3) {
+        case 0:
+          return std::unique_ptr<Geometry>(new Sphere(origin, size(random)));
+        case 1:
+          return std::unique_ptr<Geometry>(new AABB(origin, vector(size(random), size(random), size(random))));
+        default:
+          return std::unique_ptr<Geometry>(new OOBB(origin, vector(size(random), size(random), size(random)), vector(unit(random), unit(random), unit(random)), vector(unit(random), unit(random), unit(random))));
+      }
+    }
+
+    std::unique_ptr<HierarchicalGeometry> hierarchy(new HierarchicalGeometry(depth % 2 == 0 ?
+        std::unique_ptr<Geometry>(new Sphere(origin, 0)) : std::unique_ptr<Geometry>(new AABB(origin, vector(0, 0, 0))))); // refit to the children
+    for(unsigned int child = 0; child < 3; child++) {
+      hierarchy->addChildren(build(origin, radius * 0.5, depth - 1));
+    }
+    return std::unique_ptr<Geometry>(std::move(hierarchy));
+  };
+
+  CollisionTester tester;
+  std::unique_ptr<Geometry> hierarchy = build(vector(0, 0, 0), 8, 3);
+  LinearBvh bvh(*hierarchy);
+  CHECK(bvh.size() == 1 + 3 + 9 + 27);
+  CHECK(bvh.getNode(0).escape == bvh.size());
+  CHECK(!bvh.getNode(0).leaf);
+  CHECK(bvh.getNode(1).escape == 1 + 1 + 3 * 4); // second child starts after the first one, its three children and their leaves
+
+  std::vector<std::unique_ptr<Geometry>> queries;
+  for(unsigned int index = 0; index < 400; index++) {
+    vector origin = hierarchy->getOrigin() + vector(unit(random), unit(random), unit(random)) * 6;
+    switch(index % 4) {
+      case 0:
+        queries.emplace_back(new Sphere(origin, size(random) * 3));
+        break;
+      case 1:
+        queries.emplace_back(new AABB(origin, vector(size(random), size(random), size(random)) * 2));
+        break;
+      case 2:
+        queries.emplace_back(new OOBB(origin, vector(size(random), size(random), size(random)) * 2, vector(unit(random), unit(random), unit(random)), vector(unit(random), unit(random), unit(random))));
+        break;
+      default:
+        queries.emplace_back(new Line(origin, vector(unit(random), unit(random), unit(random))));
+    }
+  }
+
+  unsigned int hits = 0, mismatches = 0, contactCount = 0;
+  ContactBuffer treeContacts, bvhContacts;
+  for(auto &query : queries) {
+    bool expected = tester.intersects(*query, *hierarchy);
+    hits += expected ? 1 : 0;
+    mismatches += expected != tester.intersects(*query, bvh) ? 1 : 0;
+
+    treeContacts.clear();
+    bvhContacts.clear();
+    tester.detectCollision(*query, *hierarchy, treeContacts);
+    tester.detectCollision(*query, bvh, bvhContacts);
+    contactCount += treeContacts.size();
+    mismatches += treeContacts.size() != bvhContacts.size() ? 1 : 0;
+    for(unsigned int index = 0; index < std::min(treeContacts.size(), bvhContacts.size()); index++) {
+      const GeometryContact &contact = treeContacts[index];
+      const GeometryContact &bvhContact = bvhContacts[index];
+      mismatches += contact.getGeometryA() != bvhContact.getGeometryA() || contact.getGeometryB() != bvhContact.getGeometryB()
+          || !(contact.getIntersection() == bvhContact.getIntersection()) || !(contact.getNormal() == bvhContact.getNormal())
+          || contact.getPenetration() != Catch::Approx(bvhContact.getPenetration()) ? 1 : 0;
+    }
+  }
+  CHECK(hits > 40);
+  CHECK(contactCount > 40);
+  CHECK(mismatches == 0);
+
+  // sets of geometries, with an unbounded plane at the top level
+  std::vector<std::unique_ptr<Geometry>> scene;
+  std::vector<const Geometry *> geometries;
+  for(unsigned int index = 0; index < 101; index++) {
+    scene.push_back(build(vector(0, 0, 0), 8, index % 5 == 0 ? 1 : 0));
+    geometries.push_back(scene.back().get());
+  }
+  scene.emplace_back(new Plane(vector(0, -10, 0), vector(0, 1, 0)));
+  geometries.push_back(scene.back().get());
+
+  LinearBvh sceneBvh(geometries);
+  CHECK(sceneBvh.getNode(0).type == GeometryType::PLANE);
+  CHECK(sceneBvh.getSource(0) == scene.back().get());
+
+  hits = mismatches = 0;
+  for(auto &query : queries) {
+    if(query->getType() == GeometryType::LINE) {
+      continue; // lines are rays against aabbs, but whole lines against spheres
+    }
+    bool expected = false;
+    unsigned int expectedContacts = 0;
+    treeContacts.clear();
+    for(const Geometry *geometry : geometries) {
+      expected = expected || tester.intersects(*query, *geometry);
+      tester.detectCollision(*query, *geometry, treeContacts);
+    }
+    expectedContacts = treeContacts.size();
+    hits += expected ? 1 : 0;
+    mismatches += expected != tester.intersects(*query, sceneBvh) ? 1 : 0;
+
+    bvhContacts.clear();
+    tester.detectCollision(*query, sceneBvh, bvhContacts);
+    mismatches += expectedContacts != bvhContacts.size() ? 1 : 0;
+  }
+  CHECK(hits > 40);
+  CHECK(mismatches == 0);
+}
+
+TEST_CASE("Morton bvh builder matches testing every geometry")
+{
+  std::mt19937 random(2023);
+  std::uniform_real_distribution<real> unit(-1, 1);
+  std::uniform_real_distribution<real> size(0.2, 1);
+
+  std::vector<std::unique_ptr<Geometry>> scene;
+  std::vector<const Geometry *> geometries;
+  for(unsigned int index = 0; index < 3000; index++) {
+    vector origin = vector(unit(random), unit(random), unit(random)) * 40;
+    if(index % 100 == 0) {
+      std::unique_ptr<HierarchicalGeometry> hierarchy(new HierarchicalGeometry(std::unique_ptr<Geometry>(new Sphere(origin, 0))));
+      hierarchy->addChildren(std::unique_ptr<Geometry>(new Sphere(origin + vector(1, 0, 0), size(random))));
+      hierarchy->addChildren(std::unique_ptr<Geometry>(new AABB(origin - vector(1, 0, 0), vector(size(random), size(random), size(random)))));
+      scene.push_back(std::move(hierarchy));
+    } else if(index % 10 == 3) {
+      scene.emplace_back(new Sphere(scene[index - 1]->getOrigin(), size(random))); // same center as the previous one, same morton code
+    } else {
+      switch(index % 3) {
+        case 0:
+          scene.emplace_back(new Sphere(origin, size(random)));
+          break;
+        case 1:
+          scene.emplace_back(new AABB(origin, vector(size(random), size(random), size(random))));
+          break;
+        default:
+          scene.emplace_back(new OOBB(origin, vector(size(random), size(random), size(random)), vector(unit(random), unit(random), unit(random)), vector(unit(random), unit(random), unit(random))));
+      }
+    }
+    geometries.push_back(scene.back().get());
+  }
+  scene.emplace_back(new Plane(vector(0, -40, 0), vector(0, 1, 0)));
+  geometries.push_back(scene.back().get());
+
+  std::vector<std::unique_ptr<Geometry>> queries;
+  for(unsigned int index = 0; index < 300; index++) {
+    vector origin = vector(unit(random), unit(random), unit(random)) * 40;
+    switch(index % 3) {
+      case 0:
+        queries.emplace_back(new Sphere(origin, size(random) * 4));
+        break;
+      case 1:
+        queries.emplace_back(new AABB(origin, vector(size(random), size(random), size(random)) * 3));
+        break;
+      default:
+        queries.emplace_back(new OOBB(origin, vector(size(random), size(random), size(random)) * 3, vector(unit(random), unit(random), unit(random)), vector(unit(random), unit(random), unit(random))));
+    }
+  }
+
+  CollisionTester tester;
+  std::vector<bool> expectedHits;
+  std::vector<unsigned int> expectedContacts;
+  ContactBuffer contacts;
+  for(auto &query : queries) {
+    bool expected = false;
+    contacts.clear();
+    for(const Geometry *geometry : geometries) {
+      expected = expected || tester.intersects(*query, *geometry);
+      tester.detectCollision(*query, *geometry, contacts);
+    }
+    expectedHits.push_back(expected);
+    expectedContacts.push_back(contacts.size());
+  }
+  CHECK(std::count(expectedHits.begin(), expectedHits.end(), true) > 60);
+
+  LinearBvh reference;
+  for(bool wideCodes : { true, false }) {
+    for(unsigned int threadCount : { 1u, 2u, 4u }) {
+      WorkStealingThreadPool threadPool(threadCount);
+      MortonBvhBuilder builder(threadPool, wideCodes, 64);
+      CHECK(builder.getCodeBits() == (wideCodes ? 63u : 30u));
+
+      LinearBvh bvh;
+      builder.build(geometries, bvh);
+      builder.build(geometries, bvh); // scratch buffers reused
+      CHECK(bvh.size() == 1 + 2 * 3000 - 1);
+      CHECK(bvh.getNode(0).type == GeometryType::PLANE);
+      CHECK(bvh.getNode(1).escape == bvh.size());
+
+      unsigned int mismatches = 0;
+      for(unsigned int index = 0; index < queries.size(); index++) {
+        mismatches += expectedHits[index] != tester.intersects(*queries[index], bvh) ? 1 : 0;
+        contacts.clear();
+        tester.detectCollision(*queries[index], bvh, contacts);
+        mismatches += expectedContacts[index] != contacts.size() ? 1 : 0;
+      }
+      CHECK(mismatches == 0);
+
+      if(threadCount == 1) {
+        reference = bvh;
+      } else { // same tree whatever the number of threads
+        unsigned int differences = 0;
+        for(unsigned int index = 0; index < bvh.size(); index++) {
+          differences += bvh.getNode(index).type != reference.getNode(index).type || bvh.getNode(index).shape != reference.getNode(index).shape
+              || bvh.getNode(index).escape != reference.getNode(index).escape || bvh.getSource(index) != reference.getSource(index) ? 1 : 0;
+        }
+        CHECK(differences == 0);
+      }
+    }
+  }
+
+  WorkStealingThreadPool threadPool(2);
+  MortonBvhBuilder builder(threadPool);
+  LinearBvh bvh;
+  builder.build(std::vector<const Geometry *> { geometries[1] }, bvh);
+  CHECK(bvh.size() == 1);
+  CHECK(bvh.getNode(0).escape == 1);
+  CHECK(tester.intersects(*geometries[1], bvh));
+  builder.build(std::vector<const Geometry *> { }, bvh);
+  CHECK(bvh.empty());
+}
+
+TEST_CASE("Scene cache round trips a compiled bvh")
+{
+  std::mt19937 random(2024);
+  std::uniform_real_distribution<real> unit(-1, 1);
+  std::uniform_real_distribution<real> size(0.2, 1);
+
+  std::vector<std::unique_ptr<Geometry>> scene;
+  std::vector<const Geometry *> geometries;
+  for(unsigned int index = 0; index < 500; index++) {
+    vector origin = vector(unit(random), unit(random), unit(random)) * 20;
+    switch(index % 3) {
+      case 0:
+        scene.emplace_back(new Sphere(origin, size(random)));
+        break;
+      case 1:
+        scene.emplace_back(new AABB(origin, vector(size(random), size(random), size(random))));
+        break;
+      default:
+        scene.emplace_back(new OOBB(origin, vector(size(random), size(random), size(random)), vector(unit(random), unit(random), unit(random)), vector(unit(random), unit(random), unit(random))));
+    }
+    geometries.push_back(scene.back().get());
+  }
+  scene.emplace_back(new Plane(vector(0, -20, 0), vector(0.1, 1, 0)));
+  geometries.push_back(scene.back().get());
+  scene.emplace_back(new Line(vector(0, 0, 0), vector(1, 1, 0)));
+  geometries.push_back(scene.back().get());
+
+  LinearBvh original(geometries);
+  TemporaryFile file("scene_cache_test.bin");
+  const String &path = file.path;
+  REQUIRE(SceneCache::write(path, original));
+
+  LinearBvh loaded;
+  {
+    SceneCache cache(path);
+    REQUIRE(cache.isOpen());
+    CHECK(cache.getNodeCount() == original.size());
+    CHECK(cache.load(loaded));
+  }
+  CHECK(SceneCache::validate(loaded, original));
+  CHECK(loaded.getSource(0) == nullptr);
+
+  CollisionTester tester;
+  unsigned int hits = 0, mismatches = 0;
+  ContactBuffer originalContacts, loadedContacts;
+  for(unsigned int index = 0; index < 200; index++) {
+    Sphere query(vector(unit(random), unit(random), unit(random)) * 20, size(random) * 3);
+    bool expected = tester.intersects(query, original);
+    hits += expected ? 1 : 0;
+    mismatches += expected != tester.intersects(query, loaded) ? 1 : 0;
+
+    originalContacts.clear();
+    loadedContacts.clear();
+    tester.detectCollision(query, original, originalContacts);
+    tester.detectCollision(query, loaded, loadedContacts);
+    mismatches += originalContacts.size() != loadedContacts.size() ? 1 : 0;
+    for(unsigned int contact = 0; contact < std::min(originalContacts.size(), loadedContacts.size()); contact++) {
+      const GeometryContact &originalContact = originalContacts[contact];
+      const GeometryContact &loadedContact = loadedContacts[contact];
+      mismatches += (originalContact.getGeometryA() == &query) != (loadedContact.getGeometryA() == &query)
+          || !(originalContact.getIntersection() == loadedContact.getIntersection()) || !(originalContact.getNormal() == loadedContact.getNormal()) ? 1 : 0;
+      const Geometry *shape = loadedContact.getGeometryA() == &query ? loadedContact.getGeometryB() : loadedContact.getGeometryA();
+      mismatches += std::find(geometries.begin(), geometries.end(), shape) != geometries.end() ? 1 : 0; // the loaded shape, not the source
+    }
+  }
+  CHECK(hits > 20);
+  CHECK(mismatches == 0);
+
+  // compiled hierarchies keep their bounding volumes as internal nodes
+  HierarchicalGeometry hierarchy(std::unique_ptr<Geometry>(new Sphere(vector(0, 0, 0), 0)));
+  hierarchy.addChildren(std::unique_ptr<Geometry>(new AABB(vector(1, 0, 0), vector(0.5, 0.5, 0.5))));
+  hierarchy.addChildren(std::unique_ptr<Geometry>(new Sphere(vector(-1, 0, 0), 0.5)));
+  LinearBvh compiled(hierarchy);
+  REQUIRE(SceneCache::write(path, compiled));
+  {
+    SceneCache cache(path);
+    REQUIRE(cache.load(loaded));
+  }
+  CHECK(SceneCache::validate(loaded, compiled));
+  CHECK(!SceneCache::validate(loaded, original));
+
+  // checksum, truncation and version mismatches fail to open
+  std::vector<unsigned char> contents;
+  {
+    FILE *input = fopen(path.c_str(), "rb");
+    REQUIRE(input != nullptr);
+    int value;
+    while((value = fgetc(input)) != EOF) {
+      contents.push_back((unsigned char)value);
+    }
+    fclose(input);
+  }
+  auto rewrite = [&path](const std::vector<unsigned char> &bytes) {
+    FILE *output = fopen(path.c_str(), "wb");
+    fwrite(bytes.data(), 1, bytes.size(), output);
+    fclose(output);
+  };
+
+  std::vector<unsigned char> corrupted = contents;
+  corrupted.back() ^= 1;
+  rewrite(corrupted);
+  CHECK(!SceneCache(path).isOpen());
+
+  rewrite(std::vector<unsigned char>(contents.begin(), contents.end() - 8));
+  CHECK(!SceneCache(path).isOpen());
+
+  // the header is covered too: a corrupted sphere count still within bounds would pass every other check
+  corrupted = contents;
+  corrupted[offsetof(SceneCacheHeader, counts) + SceneCacheHeader::SPHERES * sizeof(uint32_t)] ^= 1;
+  rewrite(corrupted);
+  CHECK(!SceneCache(path).isOpen());
+
+  corrupted = contents;
+  corrupted[4]++; // version
+  rewrite(corrupted);
+  SceneCache stale(path);
+  CHECK(!stale.isOpen());
+  CHECK(!stale.load(loaded));
+  CHECK(loaded.empty());
+
+  CHECK(!SceneCache("missing_scene_cache.bin").isOpen());
+
+  // hierarchies are leaves of morton bvhs, kept by reference, and cannot be cached
+  WorkStealingThreadPool threadPool(1);
+  MortonBvhBuilder(threadPool).build(std::vector<const Geometry *> {geometries[0], &hierarchy}, loaded);
+  CHECK(!SceneCache::write(path, loaded));
+}
+
+TEST_CASE("Separation cache skips pairs that cannot have closed their gap")
+{
+  std::mt19937 random(2025);
+  std::uniform_real_distribution<real> unit(-1, 1);
+  std::uniform_real_distribution<real> size(0.3, 1);
+
+  std::vector<std::unique_ptr<Geometry>> bodies;
+  std::vector<vector> velocities;
+  for(unsigned int index = 0; index < 60; index++) {
+    vector origin = vector(unit(random), unit(random), unit(random)) * 6;
+    switch(index % 3) {
+      case 0:
+        bodies.emplace_back(new Sphere(origin, size(random)));
+        break;
+      case 1:
+        bodies.emplace_back(new AABB(origin, vector(size(random), size(random), size(random))));
+        break;
+      default:
+        bodies.emplace_back(new OOBB(origin, vector(size(random), size(random), size(random)), vector(unit(random), unit(random), unit(random)), vector(unit(random), unit(random), unit(random))));
+    }
+    velocities.push_back(vector(unit(random), unit(random), unit(random)) * 0.02);
+  }
+  Plane ground(vector(0, -6, 0), vector(0, 1, 0)); // not cached, always tested
+
+  CollisionTester tester;
+  SeparationCache cache(tester, 8192);
+  ContactBuffer expected, contacts;
+  unsigned int hits = 0, mismatches = 0, cacheable = 0;
+  for(unsigned int frame = 0; frame < 100; frame++) {
+    for(unsigned int index = 0; index < bodies.size(); index++) {
+      Geometry &body = *bodies[index];
+      body.setOrigin(body.getOrigin() + velocities[index]);
+      if(body.getType() == GeometryType::OOBB) { // spinning
+        OOBB &oobb = (OOBB &)body;
+        oobb.setAxes(oobb.getAxis(0) + oobb.getAxis(1) * 0.01, oobb.getAxis(1));
+      } else if(body.getType() == GeometryType::SPHERE && frame % 10 == 0) { // growing
+        Sphere &sphere = (Sphere &)body;
+        sphere.setRadius(sphere.getRadius() * 1.02);
+      }
+    }
+
+    for(unsigned int first = 0; first < bodies.size(); first++) {
+      for(unsigned int second = first + 1; second < bodies.size(); second++) {
+        bool hit = tester.intersects(*bodies[first], *bodies[second]);
+        hits += hit ? 1 : 0;
+        cacheable += SeparationCache::isCacheable(bodies[first]->getType(), bodies[second]->getType()) ? 1 : 0;
+        mismatches += hit != cache.intersects(*bodies[first], *bodies[second]) ? 1 : 0;
+      }
+      expected.clear();
+      contacts.clear();
+      tester.detectCollision(*bodies[first], ground, expected);
+      cache.detectCollision(*bodies[first], ground, contacts);
+      mismatches += expected.size() != contacts.size() ? 1 : 0;
+    }
+  }
+  CHECK(hits > 100);
+  CHECK(mismatches == 0);
+  CHECK(cacheable > 0);
+  CHECK(cache.getQueryCount() == cacheable); // spheres and aabbs among themselves, and the ground, go straight to the tester
+  CHECK(cache.getSkipRate() > 0.5);
+
+  // contacts go through the same cache, with skips counted alike
+  cache.resetCounters();
+  CHECK(cache.getQueryCount() == 0);
+  unsigned int contactMismatches = 0;
+  for(unsigned int frame = 0; frame < 10; frame++) {
+    for(unsigned int index = 0; index < bodies.size(); index++) {
+      bodies[index]->setOrigin(bodies[index]->getOrigin() - velocities[index]);
+    }
+    for(unsigned int first = 0; first < bodies.size(); first++) {
+      for(unsigned int second = first + 1; second < bodies.size(); second++) {
+        expected.clear();
+        contacts.clear();
+        tester.detectCollision(*bodies[first], *bodies[second], expected);
+        cache.detectCollision(*bodies[first], *bodies[second], contacts);
+        contactMismatches += expected.size() != contacts.size() ? 1 : 0;
+      }
+    }
+  }
+  CHECK(contactMismatches == 0);
+  CHECK(cache.getSkipCount() > 0);
+
+  // far apart: the distance is a lower bound, and teleporting past it is caught
+  Sphere sphere(vector(0, 0, 0), 1);
+  OOBB box(vector(5, 0, 0), vector(1, 1, 1));
+  CHECK(SeparationCache::separation(sphere, box) == Catch::Approx(3).epsilon(1e-4));
+  CHECK(SeparationCache::separation(sphere, box) <= 3);
+  CHECK(!cache.intersects(sphere, box));
+  sphere.setOrigin(vector(3.5, 0, 0));
+  CHECK(cache.intersects(sphere, box));
+
+  // bounding spheres of long boxes overlap, the axis in the entry still separates them
+  OOBB plank(vector(0, 0, 0), vector(4, 0.1, 1));
+  OOBB anotherPlank(vector(0, 1, 0), vector(4, 0.1, 1));
+  cache.clear();
+  cache.resetCounters();
+  CHECK(!cache.intersects(plank, anotherPlank));
+  CHECK(!cache.intersects(plank, anotherPlank));
+  CHECK(cache.getSkipCount() == 1);
+  anotherPlank.setOrigin(vector(0, 0.15, 0));
+  CHECK(cache.intersects(plank, anotherPlank));
+}